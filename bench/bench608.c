@@ -0,0 +1,399 @@
+/*
+bench608.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "608.h"
+#include "log.h"
+
+// Microbenchmarks for the readers, writers and timecode helpers, over the tracks gencorpus writes.
+// Results go to a JSON file with one object per benchmark and corpus, so two builds' files can be compared key by key.
+
+#ifdef COUNT_ALLOCATIONS
+// Linked with --wrap, so every allocation lib608 makes comes through here
+static u64 allocations = 0;
+static u64 allocated_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	allocations++;
+	allocated_bytes += size;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	allocations++;
+	allocated_bytes += count * size;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	allocations++;
+	allocated_bytes += size;
+	return __real_realloc(ptr, size);
+}
+#endif
+
+typedef struct {
+	const char* name;
+	const char* path;
+	scc_entry* track; // as ReadSCC returns it
+	size_t length;
+	u32 records;
+	FILE* scc;
+	FILE* raw;
+	FILE* nw4r;
+	u64 scc_size;
+	u64 raw_size;
+	u64 nw4r_size;
+} corpus;
+
+typedef struct {
+	f64 seconds;
+	u32 iterations;
+	u64 allocations;
+	u64 allocated_bytes;
+	f64 started;
+	u64 started_allocations;
+	u64 started_bytes;
+} bench_timer;
+
+static f64 min_time = 0.5;
+static f64 fps = 30/1.001f;
+static u32 sink = 0; // keeps the timecode loops from being optimized away
+static bool8 first_result = true;
+
+static f64 now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (f64) ts.tv_sec + ((f64) ts.tv_nsec / 1e9);
+}
+
+static void startTimer(bench_timer* t) {
+#ifdef COUNT_ALLOCATIONS
+	t->started_allocations = allocations;
+	t->started_bytes = allocated_bytes;
+#endif
+	t->started = now();
+}
+
+static void stopTimer(bench_timer* t) {
+	t->seconds += now() - t->started;
+	t->iterations++;
+#ifdef COUNT_ALLOCATIONS
+	t->allocations += allocations - t->started_allocations;
+	t->allocated_bytes += allocated_bytes - t->started_bytes;
+#endif
+}
+
+// At least three runs, and enough of them to fill min_time
+static bool8 keepGoing(const bench_timer* t) {
+	return t->iterations < 3 || t->seconds < min_time;
+}
+
+static void report(FILE* out, const char* benchmark, const char* corpus_name, const bench_timer* t, u64 bytes, u64 records) {
+	f64 seconds = t->seconds / t->iterations;
+	fprintf(out, "%s\n\t\t{\"benchmark\": \"%s\", \"corpus\": ", first_result ? "" : ",", benchmark);
+	if (corpus_name != NULL) {
+		fprintf(out, "\"%s\"", corpus_name);
+	}
+	else {
+		fprintf(out, "null");
+	}
+	fprintf(out, ", \"iterations\": %u, \"seconds\": %.9f, \"bytes\": %llu, \"records\": %llu, ", t->iterations, seconds, (unsigned long long) bytes, (unsigned long long) records);
+	if (bytes != 0) {
+		fprintf(out, "\"mb_per_s\": %.3f, ", (f64) bytes / seconds / 1e6);
+	}
+	else {
+		fprintf(out, "\"mb_per_s\": null, ");
+	}
+	fprintf(out, "\"records_per_s\": %.1f, ", (f64) records / seconds);
+#ifdef COUNT_ALLOCATIONS
+	fprintf(out, "\"allocations\": %llu, \"allocated_bytes\": %llu}", (unsigned long long) (t->allocations / t->iterations), (unsigned long long) (t->allocated_bytes / t->iterations));
+#else
+	fprintf(out, "\"allocations\": null, \"allocated_bytes\": null}");
+#endif
+	first_result = false;
+	log_write(LOG_INFO, use_colors, "%-10s %-12s %10.3f MB/s %14.1f records/s\n", benchmark, corpus_name != NULL ? corpus_name : "-", bytes != 0 ? (f64) bytes / seconds / 1e6 : 0, (f64) records / seconds);
+}
+
+static u32 countRecords(const scc_entry* in, size_t length) {
+	u32 records = 0;
+	size_t read_bytes = 0;
+	while (read_bytes < length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		records++;
+	}
+	return records;
+}
+
+static u64 fileSize(FILE* file) {
+	fflush(file);
+	fseek(file, 0, SEEK_END);
+	u64 size = (u64) ftell(file);
+	rewind(file);
+	return size;
+}
+
+// Loads the track, and writes the raw and NW4R files the readers are timed on
+static bool8 loadCorpus(corpus* c) {
+	c->scc = fopen(c->path, "rb");
+	if (c->scc == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", c->path, errno, strerror(errno));
+		return false;
+	}
+	c->track = ReadSCC(c->scc, &c->length);
+	if (c->track == NULL) {
+		return false;
+	}
+	c->records = countRecords(c->track, c->length);
+	c->scc_size = fileSize(c->scc);
+	c->raw = tmpfile();
+	c->nw4r = tmpfile();
+	if (c->raw == NULL || c->nw4r == NULL) {
+		log_write(LOG_FATAL, use_colors, "Couldn't set up corpus %s\n", c->name);
+		return false;
+	}
+	size_t length = c->length;
+	WriteRaw(c->track, &length, c->raw, fps, default_timecode, default_timecode);
+	length = c->length;
+	WriteNW4R(c->track, &length, c->nw4r, 0, false);
+	c->raw_size = fileSize(c->raw);
+	c->nw4r_size = fileSize(c->nw4r);
+	return true;
+}
+
+static void benchCorpus(FILE* out, corpus* c) {
+	bench_timer t;
+	size_t length;
+	FILE* scratch = tmpfile();
+	if (scratch == NULL) {
+		log_write(LOG_FATAL, use_colors, "Couldn't set up benchmarks for %s\n", c->name);
+		return;
+	}
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		rewind(c->scc);
+		startTimer(&t);
+		scc_entry* track = ReadSCC(c->scc, &length);
+		stopTimer(&t);
+		free(track);
+	}
+	report(out, "ReadSCC", c->name, &t, c->scc_size, c->records);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		rewind(scratch);
+		length = c->length;
+		startTimer(&t);
+		WriteSCC(c->track, &length, scratch);
+		fflush(scratch);
+		stopTimer(&t);
+	}
+	report(out, "WriteSCC", c->name, &t, c->scc_size, c->records);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		rewind(c->raw);
+		startTimer(&t);
+		scc_entry* track = ReadRaw(c->raw, &length, fps, default_timecode, false);
+		stopTimer(&t);
+		free(track);
+	}
+	report(out, "ReadRaw", c->name, &t, c->raw_size, c->records);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		rewind(scratch);
+		length = c->length;
+		startTimer(&t);
+		WriteRaw(c->track, &length, scratch, fps, default_timecode, default_timecode);
+		fflush(scratch);
+		stopTimer(&t);
+	}
+	report(out, "WriteRaw", c->name, &t, c->raw_size, c->records);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		rewind(c->nw4r);
+		startTimer(&t);
+		scc_entry* track = ReadNW4R(c->nw4r, &length);
+		stopTimer(&t);
+		free(track);
+	}
+	report(out, "ReadNW4R", c->name, &t, c->nw4r_size, c->records);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		rewind(scratch);
+		length = c->length;
+		startTimer(&t);
+		WriteNW4R(c->track, &length, scratch, 0, false);
+		fflush(scratch);
+		stopTimer(&t);
+	}
+	report(out, "WriteNW4R", c->name, &t, c->nw4r_size, c->records);
+
+	fclose(scratch);
+}
+
+// Ten hours of frames, both ways, dropframe and not
+#define TC_FRAMES (10 * 108000)
+
+static void benchTimecodes(FILE* out) {
+	bench_timer t;
+	timecode* tcs = malloc(sizeof(timecode) * TC_FRAMES);
+	if (tcs == NULL) {
+		log_write(LOG_FATAL, use_colors, "Couldn't set up timecode benchmarks\n");
+		return;
+	}
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		startTimer(&t);
+		for (s64 i = 0; i < TC_FRAMES; i++) {
+			tcs[i] = int2tc(i, fps, (i & 1) != 0);
+		}
+		stopTimer(&t);
+	}
+	report(out, "int2tc", NULL, &t, 0, TC_FRAMES);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		startTimer(&t);
+		for (s64 i = 0; i < TC_FRAMES; i++) {
+			sink += (u32) tc2int(tcs[i], fps);
+		}
+		stopTimer(&t);
+	}
+	report(out, "tc2int", NULL, &t, 0, TC_FRAMES);
+
+	memset(&t, 0, sizeof(t));
+	while (keepGoing(&t)) {
+		startTimer(&t);
+		for (u32 round = 0; round < 64; round++) {
+			for (u32 cc = 0; cc < 0x10000; cc++) {
+				sink += fixParity((u16) cc);
+			}
+		}
+		stopTimer(&t);
+	}
+	report(out, "fixParity", NULL, &t, 64 * 0x20000, 64 * 0x10000);
+	free(tcs);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s [options] <corpus.scc>...\n\n"
+	"--output\t-o <file>\n"
+	"\tWhere the JSON results go. Defaults to bench.json.\n"
+	"--min_time <seconds>\n"
+	"\tRun each benchmark for at least this long. Defaults to 0.5.\n"
+	"--fps <fps>\n"
+	"\tFrame rate for the raw files and timecodes. Defaults to 29.97.\n"
+	"\n", name);
+}
+
+int main(int argc, char **argv) {
+	char* output_file = "bench.json";
+	corpus* corpora = calloc((size_t) argc, sizeof(corpus));
+	int corpus_count = 0;
+	if (corpora == NULL) {
+		return 5;
+	}
+	change_log_level(LOG_FATAL | LOG_ERROR | LOG_INFO | LOG_APPLICATION);
+	for (int i = 1; i < argc; i++) {
+		bool8 has_value = i + 1 < argc;
+		if ((strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-o") == 0) && has_value) {
+			output_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--min_time") == 0 && has_value) {
+			if (sscanf(argv[++i], "%lf", &min_time) != 1) {
+				log_write(LOG_ERROR, use_colors, "Invalid parameter for option --min_time: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--fps") == 0 && has_value) {
+			if (sscanf(argv[++i], "%lf", &fps) != 1 || fps <= 0) {
+				log_write(LOG_ERROR, use_colors, "Invalid parameter for option --fps: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+			usage(argv[0]);
+			return 2;
+		}
+		else {
+			corpus* c = &corpora[corpus_count++];
+			c->path = argv[i];
+			const char* slash = strrchr(argv[i], '/');
+			c->name = slash != NULL ? slash + 1 : argv[i];
+		}
+	}
+
+	FILE* out = fopen(output_file, "w");
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		return 3;
+	}
+	fprintf(out, "{\n\t\"lib608\": \"");
+	if (strcmp("", library_version.git_rev) != 0) {
+		fprintf(out, "%s", library_version.git_rev);
+	}
+	else {
+		fprintf(out, "%hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	fprintf(out, "\",\n\t\"fps\": %.6f,\n\t\"min_time\": %.3f,\n\t\"allocations_counted\": %s,\n\t\"corpora\": [", fps, min_time,
+#ifdef COUNT_ALLOCATIONS
+	"true"
+#else
+	"false"
+#endif
+	);
+	int ret = 0;
+	bool8 first_corpus = true;
+	for (int i = 0; i < corpus_count; i++) {
+		corpus* c = &corpora[i];
+		if (!loadCorpus(c)) {
+			ret = 5;
+			c->track = NULL;
+			continue;
+		}
+		fprintf(out, "%s\n\t\t{\"name\": \"%s\", \"records\": %u, \"scc_bytes\": %llu, \"raw_bytes\": %llu, \"nw4r_bytes\": %llu}", first_corpus ? "" : ",", c->name, c->records, (unsigned long long) c->scc_size, (unsigned long long) c->raw_size, (unsigned long long) c->nw4r_size);
+		first_corpus = false;
+	}
+	fprintf(out, "\n\t],\n\t\"results\": [");
+	for (int i = 0; i < corpus_count; i++) {
+		if (corpora[i].track != NULL) {
+			benchCorpus(out, &corpora[i]);
+		}
+	}
+	benchTimecodes(out);
+	fprintf(out, "\n\t]\n}\n");
+	fclose(out);
+
+	for (int i = 0; i < corpus_count; i++) {
+		corpus* c = &corpora[i];
+		free(c->track);
+		if (c->scc != NULL) fclose(c->scc);
+		if (c->raw != NULL) fclose(c->raw);
+		if (c->nw4r != NULL) fclose(c->nw4r);
+	}
+	free(corpora);
+	log_write(LOG_INFO, use_colors, "Results written to %s (sink %u)\n", output_file, sink);
+	return ret;
+}
@@ -0,0 +1,305 @@
+/*
+gencorpus.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "608.h"
+#include "log.h"
+
+// Writes synthetic SCC tracks for the benchmarks. The same seed always gives the same track,
+// so results from two builds are measured on the same bytes.
+
+enum {
+	PROFILE_POPON,
+	PROFILE_ROLLUP,
+	PROFILE_XDS,
+	PROFILE_GAPS
+};
+
+static const char* const profile_names[] = {"popon", "rollup", "xds", "gaps"};
+
+static const char* const words[] = {
+	"the", "a", "you", "I", "we", "it", "that", "what", "is", "was", "are", "have", "don't", "know",
+	"think", "going", "right", "here", "there", "now", "just", "about", "really", "never", "little",
+	"CAPTIONS", "(MUSIC)", "[LAUGHTER]", "NARRATOR:", "Okay,", "Well,", "yes.", "no.", "time", "home",
+	"tonight", "weather", "tomorrow", "morning", "news", "story", "people", "city", "minutes", "caf\xc3\xa9"
+};
+
+static u32 seed = 1;
+
+// Park-Miller, so the corpus doesn't depend on the libc's rand()
+static u32 nextRandom(u32 range) {
+	seed = (u32) (((u64) seed * 48271) % 0x7fffffff);
+	return seed % range;
+}
+
+// The first frame at or after frame whose timecode reads back no earlier than min_frame.
+// int2tc and tc2int don't always round-trip at 29.97, and WriteRaw stops at the first record that reads back out of order.
+static timecode orderedTimecode(s64 frame, s64 min_frame, f64 fps, s64* actual) {
+	timecode tc = int2tc(frame, fps, false);
+	*actual = tc2int(tc, fps);
+	while (*actual < min_frame) {
+		tc = int2tc(++frame, fps, false);
+		*actual = tc2int(tc, fps);
+	}
+	return tc;
+}
+
+static void orderTrack(scc_entry* in, size_t length, f64 fps) {
+	s64 next_frame = 0;
+	size_t read_bytes = 0;
+	while (read_bytes < length) {
+		scc_entry* entry = (scc_entry*) (((u8*) in) + read_bytes);
+		s64 frame = tc2int(entry->pts.tc, fps);
+		entry->pts.tc = orderedTimecode(frame, next_frame, fps, &frame);
+		next_frame = frame + entry->entry_count;
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+}
+
+static void makeLine(char* out, size_t size, u32 max_length) {
+	size_t length = 0;
+	out[0] = 0;
+	while (1) {
+		const char* word = words[nextRandom(sizeof(words) / sizeof(words[0]))];
+		size_t word_length = strlen(word);
+		if (length + word_length + 1 > max_length || length + word_length + 2 > size) {
+			break;
+		}
+		if (length != 0) {
+			out[length++] = ' ';
+		}
+		memcpy(out + length, word, word_length + 1);
+		length += word_length;
+	}
+}
+
+static scc_entry* encodeCaptions(u8 profile, u8 channel, f64 fps, s64 duration_ms, size_t* length) {
+	cc_encoder enc;
+	if (!InitEncoder(&enc, profile == PROFILE_ROLLUP ? CC_MODE_ROLLUP : CC_MODE_POPON, channel, 3, false, fps, false)) {
+		return NULL;
+	}
+	char text[4 * CC_COLUMNS + 8];
+	s64 ms = 1000;
+	while (ms < duration_ms) {
+		u32 lines = profile == PROFILE_ROLLUP ? 1 : 1 + nextRandom(3);
+		size_t offset = 0;
+		for (u32 i = 0; i < lines; i++) {
+			if (i != 0) {
+				text[offset++] = '\n';
+			}
+			makeLine(text + offset, sizeof(text) - offset, 12 + nextRandom(CC_COLUMNS - 11));
+			offset += strlen(text + offset);
+		}
+		s64 shown = profile == PROFILE_ROLLUP ? 1200 + nextRandom(1800) : 1500 + nextRandom(2500);
+		if (!EncodeCue(&enc, ms, ms + shown, text)) {
+			free(enc.data);
+			return NULL;
+		}
+		ms += shown;
+		if (profile == PROFILE_GAPS) {
+			// Mostly a few cues close together, then minutes of nothing
+			ms += nextRandom(8) == 0 ? 60000 + nextRandom(540000) : nextRandom(1000);
+		}
+		else if (profile == PROFILE_POPON) {
+			ms += nextRandom(1000);
+		}
+	}
+	scc_entry* track = FinishEncoder(&enc, length);
+	if (track != NULL) {
+		orderTrack(track, *length, fps);
+	}
+	return track;
+}
+
+typedef struct {
+	scc_entry* data;
+	size_t offset;
+	size_t allocated;
+} track_builder;
+
+// Returns the frame after the record, or -1 if the track couldn't grow
+static s64 appendRecord(track_builder* b, s64 frame, f64 fps, const u16* cc, unsigned int count) {
+	size_t size = sizeof(scc_entry) + (sizeof(u16) * count);
+	if (b->allocated - b->offset < size) {
+		size_t allocated = b->allocated == 0 ? 65536 : b->allocated * 2;
+		scc_entry* data = realloc(b->data, allocated);
+		if (data == NULL) {
+			log_write(LOG_FATAL, use_colors, "gencorpus: Couldn't allocate track\n");
+			return -1;
+		}
+		b->data = data;
+		b->allocated = allocated;
+	}
+	scc_entry* entry = (scc_entry*) (((u8*) b->data) + b->offset);
+	entry->pts.tc = orderedTimecode(frame, frame, fps, &frame);
+	entry->entry_count = count;
+	memcpy(entry->entries, cc, sizeof(u16) * count);
+	b->offset += size;
+	return frame + count;
+}
+
+// One packet per record: start and type, the data two bytes a word, then the end code and checksum
+static unsigned int makeXDSPacket(u16* cc, u8 xds_class, u8 type, const u8* data, unsigned int data_length) {
+	unsigned int count = 0;
+	u32 sum = xds_class + type + 0x0f;
+	cc[count++] = (u16) ((xds_class << 8) | type);
+	for (unsigned int i = 0; i < data_length; i += 2) {
+		u8 second = i + 1 < data_length ? data[i+1] : 0;
+		cc[count++] = (u16) ((data[i] << 8) | second);
+		sum += data[i] + second;
+	}
+	cc[count++] = (u16) (0x0f00 | ((128 - (sum % 128)) % 128));
+	return count;
+}
+
+// Program names, ratings and the time of day back to back, as a busy field 2 carries them
+static scc_entry* encodeXDS(f64 fps, s64 duration_ms, size_t* length) {
+	track_builder b = {NULL, 0, 0};
+	s64 end_frame = (s64) ((f64) duration_ms * fps / 1000);
+	s64 frame = 30;
+	u16 cc[XDS_MAX_DATA];
+	while (frame < end_frame) {
+		u8 data[XDS_MAX_DATA];
+		unsigned int data_length;
+		unsigned int count;
+		switch (nextRandom(3)) {
+			case 0: {
+				char name[XDS_MAX_DATA];
+				makeLine(name, sizeof(name), 8 + nextRandom(20));
+				data_length = (unsigned int) strlen(name);
+				// Latin-1 in XDS text; the generator's one non-ASCII word is UTF-8
+				for (unsigned int i = 0; i < data_length; i++) {
+					data[i] = (u8) name[i] & 0x7f;
+				}
+				count = makeXDSPacket(cc, XDS_CLASS_CURRENT, 0x03, data, data_length);
+				break;
+			}
+			case 1:
+				data[0] = 0x40 | (u8) nextRandom(8);
+				data[1] = 0x40;
+				count = makeXDSPacket(cc, XDS_CLASS_CURRENT, 0x05, data, 2);
+				break;
+			default: {
+				s64 seconds = frame / 30;
+				data[0] = 0x40 | (u8) ((seconds / 60) % 60);
+				data[1] = 0x40 | (u8) ((seconds / 3600) % 24);
+				data[2] = 0x40 | (u8) (1 + nextRandom(28));
+				data[3] = 0x40 | (u8) (1 + nextRandom(12));
+				data[4] = 0x40 | (u8) (1 + nextRandom(7));
+				data[5] = 0x40 | (u8) (nextRandom(30));
+				count = makeXDSPacket(cc, XDS_CLASS_MISC, 0x01, data, 6);
+				break;
+			}
+		}
+		frame = appendRecord(&b, frame, fps, cc, count);
+		if (frame < 0) {
+			free(b.data);
+			return NULL;
+		}
+		frame += nextRandom(3);
+	}
+	*length = b.offset;
+	return b.data;
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s [options] <output.scc>\n\n"
+	"--profile <popon|rollup|xds|gaps>\n"
+	"\tThe kind of track. gaps is pop-on with minutes of silence between bursts. Defaults to popon.\n"
+	"--hours <hours>\n"
+	"\tLength of the track. Defaults to 1.\n"
+	"--field <1|2>\n"
+	"\tCaptions on CC1 or CC3. XDS tracks are always field 2. Defaults to 1.\n"
+	"--seed <n>\n"
+	"\tDefaults to 1.\n"
+	"\n", name);
+}
+
+int main(int argc, char **argv) {
+	u8 profile = PROFILE_POPON;
+	f64 hours = 1;
+	u8 field = 1;
+	f64 fps = 30/1.001f;
+	char* output_file = NULL;
+	change_log_level(LOG_FATAL | LOG_ERROR | LOG_WARN | LOG_APPLICATION);
+	for (int i = 1; i < argc; i++) {
+		bool8 has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--profile") == 0 && has_value) {
+			char* name = argv[++i];
+			u8 p = 0;
+			while (p <= PROFILE_GAPS && strcmp(name, profile_names[p]) != 0) {
+				p++;
+			}
+			if (p > PROFILE_GAPS) {
+				log_write(LOG_ERROR, use_colors, "Unknown profile %s\n", name);
+				return 1;
+			}
+			profile = p;
+		}
+		else if (strcmp(argv[i], "--hours") == 0 && has_value) {
+			if (sscanf(argv[++i], "%lf", &hours) != 1 || hours <= 0) {
+				log_write(LOG_ERROR, use_colors, "Invalid parameter for option --hours: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--field") == 0 && has_value) {
+			if (sscanf(argv[++i], "%hhu", &field) != 1 || field < 1 || field > 2) {
+				log_write(LOG_ERROR, use_colors, "Invalid parameter for option --field: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+			if (sscanf(argv[++i], "%u", &seed) != 1 || seed % 0x7fffffff == 0) {
+				log_write(LOG_ERROR, use_colors, "Invalid parameter for option --seed: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+			usage(argv[0]);
+			return 2;
+		}
+		else if (output_file == NULL) {
+			output_file = argv[i];
+		}
+		else {
+			log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[i]);
+		}
+	}
+	if (output_file == NULL) {
+		usage(argv[0]);
+		return 3;
+	}
+
+	s64 duration_ms = (s64) (hours * 3600000);
+	size_t length = 0;
+	scc_entry* track;
+	if (profile == PROFILE_XDS) {
+		track = encodeXDS(fps, duration_ms, &length);
+	}
+	else {
+		track = encodeCaptions(profile, field == 2 ? 2 : 0, fps, duration_ms, &length);
+	}
+	if (track == NULL) {
+		return 5;
+	}
+	FILE* out_file = fopen(output_file, "w");
+	if (out_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		free(track);
+		return 3;
+	}
+	u32 written = WriteSCC(track, &length, out_file);
+	fclose(out_file);
+	free(track);
+	return written != 0 ? 0 : 5;
+}
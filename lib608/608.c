@@ -120,3 +120,77 @@ u16 fixParity(u16 in) {
 	log_write(LOG_TRACE, use_colors, "FixParity: in %04x, out %04x\n", in, out);
 	return out;
 }
+
+static void cursorLoadEntry(scc_cursor* cursor) {
+	// skip empty records
+	while (cursor->read_bytes < cursor->length) {
+		const scc_entry* entry = (const scc_entry*) cursor->input_ptr;
+		if (entry->entry_count != 0) {
+			cursor->entry_frame = tc2int(entry->pts.tc, cursor->fps);
+			if (cursor->entry_frame < cursor->frame) {
+				log_write(LOG_DEBUG, use_colors, "NextSCCWord: Timecode %02d:%02hhu:%02hhu%c%02hhu overlaps the data before it, delaying by %d frames\n", entry->pts.tc.hours, entry->pts.tc.minutes, entry->pts.tc.seconds, entry->pts.tc.drop ? ';' : ':', entry->pts.tc.frames, (s32) (cursor->frame - cursor->entry_frame));
+			}
+			return;
+		}
+		cursor->read_bytes += sizeof(scc_entry);
+		cursor->input_ptr += sizeof(scc_entry);
+	}
+}
+
+void InitSCCCursor(scc_cursor* cursor, const scc_entry* in, size_t length, f64 fps, s64 frame) {
+	cursor->input_ptr = (const u8*) in;
+	cursor->read_bytes = 0;
+	cursor->length = in == NULL ? 0 : length;
+	cursor->index = 0;
+	cursor->entry_frame = 0;
+	cursor->frame = frame;
+	cursor->fps = fps;
+	cursorLoadEntry(cursor);
+}
+
+// Fetches the byte pair for the cursor's frame and moves on to the next frame. Returns false if the frame is padding.
+bool8 NextSCCWord(scc_cursor* cursor, u16* cc) {
+	if (cursor->read_bytes >= cursor->length || (cursor->index == 0 && cursor->entry_frame > cursor->frame)) {
+		cursor->frame++;
+		*cc = 0;
+		return false;
+	}
+	const scc_entry* entry = (const scc_entry*) cursor->input_ptr;
+	*cc = entry->entries[cursor->index++];
+	cursor->frame++;
+	if (cursor->index >= entry->entry_count) {
+		cursor->index = 0;
+		cursor->read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		cursor->input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		cursorLoadEntry(cursor);
+	}
+	return true;
+}
+
+bool8 SCCCursorDone(const scc_cursor* cursor) {
+	return cursor->read_bytes >= cursor->length;
+}
+
+// First frame after the last byte pair of the track
+s64 GetSCCEndFrame(const scc_entry* in, size_t length, f64 fps) {
+	s64 end_frame = 0;
+	if (in == NULL) {
+		return 0;
+	}
+	size_t read_bytes = 0;
+	const u8* input_ptr = (const u8*) in;
+	while (read_bytes < length) {
+		const scc_entry* entry = (const scc_entry*) input_ptr;
+		s64 frame = tc2int(entry->pts.tc, fps);
+		// overlapping records get pushed back by the previous one, like WriteRaw would do if it didn't abort
+		if (frame < end_frame) {
+			frame = end_frame;
+		}
+		if (entry->entry_count != 0) {
+			end_frame = frame + entry->entry_count;
+		}
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	return end_frame;
+}
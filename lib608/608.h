@@ -68,6 +68,548 @@ typedef struct {
 	char git_rev[16];
 } VersionInfo;
 
+// Walks an scc_entry track one frame at a time, as WriteRaw lays it out
+typedef struct {
+	const u8* input_ptr;
+	size_t read_bytes;
+	size_t length;
+	unsigned int index; // next word of the current entry
+	s64 entry_frame;
+	s64 frame;
+	f64 fps;
+} scc_cursor;
+
+// Splits a stream of byte pairs (one per frame) into scc_entry records, the way ReadRaw does
+typedef struct {
+	scc_entry* data;
+	size_t allocated;
+	size_t offset; // offset of the record currently being filled
+	f64 fps;
+	bool8 drop;
+	unsigned int null_cnt;
+	unsigned int cc_cnt;
+	int record_count;
+	int channel;
+	bool8 output;
+	bool8 received_cr;
+	bool8 eol;
+} raw_segmenter;
+
+// Sidecar seek index of an SCC file: a checkpoint every SCC_INDEX_INTERVAL records.
+// Frames are TimecodeToFrame labels at 30 fps. Records may be in any order, so each checkpoint
+// keeps the latest frame before it and the earliest frame from it on.
+#define SCC_INDEX_INTERVAL 256
+typedef struct {
+	s64 offset; // of the line in the SCC file
+	s64 max_before;
+	s64 min_after;
+	u32 line;
+	u32 reserved;
+} scc_checkpoint;
+
+typedef struct {
+	u64 file_size; // of the SCC file when indexed, to spot stale indexes
+	s64 file_mtime;
+	u32 count;
+	scc_checkpoint* checkpoints;
+} scc_index;
+
+// Input formats PeekFormat can tell apart
+#define CC_PROBE_SIZE 72 // an NW4R header and the magic of a DATA section right after it
+enum {
+	CC_FORMAT_UNKNOWN,
+	CC_FORMAT_RAW,
+	CC_FORMAT_SCC,
+	CC_FORMAT_NW4R,
+	CC_FORMAT_MCC,
+	CC_FORMAT_RCWT,
+	CC_FORMAT_CCX
+};
+
+// A byte stream for the readers and writers: InitFileIO, InitMemoryIO and InitFdIO fill one in,
+// or set the callbacks and ctx yourself. Callbacks set error on failure; a short read without it is the end of the stream.
+typedef struct cc_io {
+	size_t (*read)(struct cc_io* io, void* buffer, size_t size); // NULL for an output-only stream
+	size_t (*write)(struct cc_io* io, const void* buffer, size_t size); // NULL for an input-only stream
+	bool8 (*seek)(struct cc_io* io, u64 offset); // from the start; NULL if the stream can't seek
+	char* (*gets)(struct cc_io* io, char* buffer, int size); // like fgets; NULL reads a byte at a time
+	bool8 (*flush)(struct cc_io* io); // NULL if writes aren't buffered
+	void* ctx;
+	bool8 error;
+	bool8 eof;
+} cc_io;
+
+#define CC_MEMORY_IO_INITIAL 65536
+typedef struct {
+	u8* data;
+	size_t size; // bytes of data
+	size_t allocated; // 0 for a caller's buffer that's only read
+	size_t position;
+} cc_memory_io;
+
+#define CC_FD_IO_BUFFER 65536
+typedef struct {
+	int fd;
+	u8 buffer[CC_FD_IO_BUFFER];
+	size_t start; // unread input is buffer[start, end)
+	size_t end; // or unwritten output is buffer[0, end)
+	bool8 writing;
+} cc_fd_io;
+
+// A stream whose first bytes were already read (by PeekFormat), for the *Prefixed readers.
+// InitPrefixedFile points io at file_io, so a cc_prefixed_file set up that way can't be copied.
+typedef struct {
+	cc_io* io;
+	cc_io file_io;
+	const u8* prefix;
+	size_t prefix_size;
+	size_t prefix_pos;
+	u64 position; // bytes consumed so far, prefix included
+} cc_prefixed_file;
+
+// 608 display model
+#define CC_ROWS 15
+#define CC_COLUMNS 32
+
+#define CC_ATTR_COLOR 0x07 // white, green, blue, cyan, red, yellow, magenta
+#define CC_ATTR_ITALICS 0x08
+#define CC_ATTR_UNDERLINE 0x10
+
+enum {
+	CC_MODE_NONE,
+	CC_MODE_POPON,
+	CC_MODE_ROLLUP,
+	CC_MODE_PAINTON,
+	CC_MODE_TEXT
+};
+
+enum {
+	CC_EVENT_DISPLAY,
+	CC_EVENT_CLEAR
+};
+
+typedef struct {
+	u16 chars[CC_ROWS][CC_COLUMNS]; // Unicode code points, 0 is an empty cell
+	u8 attrs[CC_ROWS][CC_COLUMNS];
+} cc_screen;
+
+typedef struct {
+	cc_screen displayed;
+	cc_screen nondisplayed;
+	u8 mode;
+	u8 rollup_rows;
+	u8 row;
+	u8 column;
+	u8 attr;
+	bool8 showing;
+	bool8 dirty; // displayed memory changed since the last event
+	s64 dirty_frame;
+} cc_channel_state;
+
+typedef struct {
+	u8 type;
+	u8 channel; // 0-3 for CC1-CC4
+	s64 frame;
+	timecode pts;
+	const cc_screen* screen; // displayed memory of the channel
+} cc_caption_event;
+
+typedef void (*cc_event_callback)(const cc_caption_event* event, void* ctx);
+typedef void (*cc_pair_callback)(u16 cc, s64 frame, void* ctx);
+typedef void (*scc_entry_callback)(const scc_entry* entry, void* ctx);
+
+// Plain data, so the whole decoder state can be copied around
+typedef struct {
+	cc_channel_state channels[4];
+	u16 last_control[2]; // per field, to drop repeated control codes
+	u8 active[2]; // data channel selected by the last control code, per field
+	bool8 xds[2];
+	s64 last_frame[2];
+	f64 fps;
+	bool8 drop;
+	cc_event_callback callback;
+	void* ctx;
+} cc_decoder;
+
+// Decoder state part way through a track, so seeks replay only from the nearest one
+#define CC_DECODER_CHECKPOINT_INTERVAL 1800 // frames, about a minute
+typedef struct {
+	size_t offset; // of the next record to decode
+	unsigned int index; // words of that record already decoded
+	cc_decoder dec;
+} cc_decoder_checkpoint;
+
+// Random access to the screens of one field of an scc_entry track
+typedef struct {
+	const scc_entry* track;
+	size_t length;
+	u8 field;
+	cc_decoder_checkpoint* checkpoints;
+	u32 count;
+	cc_decoder_checkpoint current; // where the last seek left off
+} cc_decoder_index;
+
+// An opened CCX file; see ccx.c for the layout
+#define CCX_INDEX_INTERVAL 64 // records per timecode index entry
+#define CCX_CHANNELS 3
+#define CCX_CHANNEL_XDS 2 // 0 and 1 are the field's data channels (CC1/CC2 or CC3/CC4)
+typedef struct {
+	u8* base;
+	u64 size;
+	bool8 mapped;
+	f64 fps;
+	u8 field;
+	scc_entry* data;
+	size_t length;
+	const scc_checkpoint* index;
+	u32 index_count;
+	const u32* channel_offsets[CCX_CHANNELS]; // DATA offsets of the records carrying each channel's words
+	u32 channel_counts[CCX_CHANNELS];
+	cc_decoder_checkpoint* checkpoints;
+	u32 checkpoint_count;
+	u32 section_crc[4];
+	u64 section_offset[4];
+	u64 section_size[4];
+} cc_ccx;
+
+enum {
+	CC_EXPORT_SRT,
+	CC_EXPORT_VTT,
+	CC_EXPORT_TTML
+};
+
+#define CC_EXPORT_TEXT_SIZE 2048
+#define CC_EXPORT_BUFFER_SIZE 16384
+
+// Writes a cue whenever the caption on one channel changes or clears
+typedef struct {
+	FILE* out;
+	u8 format;
+	u8 channel;
+	f64 fps;
+	u32 cue_count;
+	u32 written_bytes;
+	bool8 open; // a caption is on screen and its cue hasn't been written yet
+	s64 start_frame;
+	char text[CC_EXPORT_TEXT_SIZE];
+	char buffer[CC_EXPORT_BUFFER_SIZE]; // reused for every cue
+} cc_exporter;
+
+// Splits the cues of one channel into fixed length WebVTT segments for HLS
+typedef struct {
+	const char* prefix; // segments are <prefix><index>.vtt, the playlist <prefix>.m3u8
+	FILE* segment;
+	FILE* playlist;
+	u8 channel;
+	f64 fps;
+	s64 start_frame; // local time 0 of the first segment
+	s64 segment_ms;
+	u64 mpegts; // 90kHz timestamp of local time 0
+	u32 segment_index; // segment currently being written
+	u32 cue_count;
+	bool8 open;
+	s64 cue_start_ms;
+	char text[CC_EXPORT_TEXT_SIZE];
+	char buffer[CC_EXPORT_BUFFER_SIZE];
+} cc_hls_segmenter;
+
+// Extended Data Services (Field 2)
+enum {
+	XDS_CLASS_CURRENT = 0x01,
+	XDS_CLASS_FUTURE = 0x03,
+	XDS_CLASS_CHANNEL = 0x05,
+	XDS_CLASS_MISC = 0x07,
+	XDS_CLASS_PUBLIC_SERVICE = 0x09,
+	XDS_CLASS_RESERVED = 0x0b,
+	XDS_CLASS_PRIVATE = 0x0d
+};
+
+enum {
+	XDS_PACKET_OTHER,
+	XDS_PACKET_PROGRAM_NAME,
+	XDS_PACKET_RATING,
+	XDS_PACKET_TIME_OF_DAY,
+	XDS_PACKET_NETWORK_NAME,
+	XDS_PACKET_CALL_LETTERS
+};
+
+enum {
+	XDS_RATING_MPAA,
+	XDS_RATING_US_TV,
+	XDS_RATING_CANADA_EN,
+	XDS_RATING_CANADA_FR,
+	XDS_RATING_UNKNOWN
+};
+
+#define XDS_MAX_DATA 32
+
+typedef struct {
+	u8 xds_class; // start code of the packet
+	u8 type;
+	u8 kind; // XDS_PACKET_*, only decoded if the checksum matched
+	bool8 checksum_ok;
+	s64 frame; // frame of the end code
+	u8 length;
+	u8 data[XDS_MAX_DATA];
+	union {
+		char text[XDS_MAX_DATA+1]; // program and network names
+		struct {
+			char call_letters[5];
+			u8 channel; // 0 if not sent
+		} station;
+		struct {
+			u8 system;
+			u8 level;
+			const char* name;
+			bool8 dialogue;
+			bool8 language;
+			bool8 sex;
+			bool8 violence; // fantasy violence for TV-Y7
+		} rating;
+		struct {
+			u16 year;
+			u8 month;
+			u8 day;
+			u8 day_of_week; // 1 is Sunday
+			u8 hour;
+			u8 minute;
+			bool8 dst;
+			bool8 leap_day;
+			bool8 zero_seconds;
+			bool8 tape_delayed;
+		} time;
+	};
+} xds_packet;
+
+typedef void (*xds_packet_callback)(const xds_packet* packet, void* ctx);
+
+// One partial packet per class, since a packet can only be interrupted by a packet of another class
+typedef struct {
+	struct {
+		bool8 active;
+		u8 type;
+		u8 length;
+		u8 sum; // running checksum of everything received so far
+		u8 data[XDS_MAX_DATA];
+	} partial[7];
+	s8 current; // class receiving data bytes, -1 outside of XDS
+	u32 packet_count;
+	u32 error_count;
+	xds_packet_callback callback;
+	void* ctx;
+} xds_assembler;
+
+// Turns timed text into byte pairs for one channel
+#define CC_ENCODER_MAX_WORDS 1024
+
+typedef struct {
+	u8 mode; // CC_MODE_POPON or CC_MODE_ROLLUP
+	u8 channel; // 0-3 for CC1-CC4
+	u8 rollup_rows;
+	bool8 center;
+	f64 fps;
+	bool8 drop;
+	bool8 started; // roll-up mode has been sent
+	bool8 clear_pending; // the last caption still needs an EDM
+	s64 clear_frame;
+	s64 next_frame; // first frame after the last record
+	u32 cue_count;
+	scc_entry* data;
+	size_t offset;
+	size_t allocated;
+	u16 words[CC_ENCODER_MAX_WORDS]; // record being built
+} cc_encoder;
+
+// Interleaves several tracks into the one byte pair per frame of a field
+#define CC_MUX_XDS 4 // channel of an input carrying XDS packets; 0-3 are CC1-CC4
+#define CC_MUX_MAX_INPUTS 8
+#define CC_MUX_RECORD_MAX 64 // longest NW4R record MuxSCC writes
+
+enum {
+	CC_MUX_RAW,
+	CC_MUX_NW4R
+};
+
+typedef struct {
+	const scc_entry* track;
+	size_t length;
+	u8 channel; // where the track goes: 0-3 for CC1-CC4, or CC_MUX_XDS
+} cc_mux_input;
+
+typedef struct {
+	scc_cursor cursor;
+	u8 channel;
+	bool8 pending; // word is due and waiting for the field
+	u16 word;
+	s64 due; // frame the track wanted word on, after its earlier delays
+	u16 mode_code; // last RCL/RU/RDC/RTD sent, to take the channel back with
+	u32 delayed_words;
+	s64 max_delay;
+} cc_mux_source;
+
+typedef struct {
+	cc_mux_source sources[CC_MUX_MAX_INPUTS];
+	u8 count;
+	u8 field; // 0 or 1
+	s64 frame;
+	s8 owner; // caption source that sent the last channel-setting control code
+	bool8 xds_open; // the field is in the middle of an XDS packet
+	u8 xds_class; // start code of the interrupted XDS packet, if any
+	u8 xds_type;
+	u16 last_word; // sent on the previous frame
+	u32 resumes; // control codes inserted to take a channel back
+} cc_mux;
+
+// Frame rates and speed are rationals, e.g. 30000/1001 for 29.97 fps
+typedef struct {
+	u32 in_num;
+	u32 in_den;
+	u32 out_num;
+	u32 out_den;
+	u32 speed_num; // playback speed, e.g. 25/24 for a PAL speed-up; 1/1 for none
+	u32 speed_den;
+	s64 offset; // output frames added after conversion
+	bool8 out_drop;
+} cc_retime;
+
+typedef struct {
+	u32 records;
+	u32 removed; // landed before 00:00:00:00
+	u32 overlaps; // no longer fit the byte pair per frame after the records before them
+	s64 max_overlap;
+	s64 end_frame;
+} cc_retime_report;
+
+// One video event of an edit decision list, in frames at the nominal rate
+typedef struct {
+	s64 src_in;
+	s64 src_out; // exclusive
+	s64 rec_in;
+} cc_edl_event;
+
+// What ScheduleSCC changed, in frames
+typedef struct {
+	u32 moved;
+	u32 early; // loaded earlier than requested (pre-roll)
+	u32 late;
+	u32 over_warn_shift; // moved further than the warning threshold, which only decides what gets logged
+	s64 max_early;
+	s64 max_late;
+	s64 total_error;
+} cc_schedule_report;
+
+// Does what SortSCC and ScheduleSCC do to a whole track, for records arriving one at a time.
+// At most CC_STREAM_WINDOW records wait to be put in order, and as many wait for their schedule to settle,
+// so records further out of order than that, or clashing runs longer than that, come out differently.
+#define CC_STREAM_WINDOW 256
+#define CC_STREAM_SLOTS (2 * CC_STREAM_WINDOW + 2)
+
+typedef struct {
+	scc_entry* entry; // buffer kept for the next record to use the slot
+	size_t allocated;
+	s64 frame; // tc2int of the pts, clamped to 0 like SortSCC's keys
+	s64 requested; // tc2int of the pts
+	s64 words_before; // words of every record scheduled before this one
+	u64 sequence;
+} cc_stream_record;
+
+typedef struct {
+	s64 sum;
+	s64 count;
+	u64 last; // sequence number of the block's last record
+} cc_stream_block;
+
+typedef struct {
+	cc_stream_record records[CC_STREAM_SLOTS];
+	u16 free_slots[CC_STREAM_SLOTS];
+	u16 free_count;
+	u16 pending[CC_STREAM_WINDOW + 1]; // in frame order, waiting for later records that could go before them
+	u16 pending_count;
+	u16 scheduled[CC_STREAM_SLOTS]; // in order, waiting for their block to settle
+	u16 scheduled_head;
+	u16 scheduled_count;
+	cc_stream_block blocks[CC_STREAM_SLOTS];
+	u16 block_head;
+	u16 block_count;
+	s64 released_frame; // latest frame that left the ordering window
+	s64 total_words;
+	s64 floor; // u of the last block handed on; later blocks can't go below it
+	u64 sequence;
+	f64 fps;
+	s64 warn_shift; // moves further than this are logged as warnings, not limited
+	bool8 schedule;
+	u32 record_count;
+	u32 reordered; // records put back in order
+	u32 unordered; // records that came too late to be put in order
+	cc_schedule_report report;
+	scc_entry_callback callback;
+	void* ctx;
+} cc_stream_scheduler;
+
+// Lays out records frame by frame as they come, the way WriteRaw does a whole track.
+// InitRawWriter points out at file_io, so a writer set up that way can't be copied.
+typedef struct {
+	cc_io* out;
+	cc_io file_io;
+	f64 fps;
+	s64 frame; // next frame to write
+	s64 end_frame;
+	bool8 started;
+	bool8 failed; // an out of order record stopped the output, as it stops WriteRaw
+	u32 written_bytes;
+} cc_raw_writer;
+
+// What PatchRaw rewrote, in frames from the first byte pair of the file
+typedef struct {
+	u32 ranges;
+	s64 frames; // byte pairs written
+	s64 first_frame; // -1 if nothing changed
+	s64 last_frame;
+	bool8 resized; // the file grew or was cut to the new track's length
+} cc_patch_report;
+
+#define CC_PATCH_GAP 32 // changed ranges closer than this many frames are written as one
+
+// One of the outputs WriteFanOut writes a track to
+typedef struct {
+	u8 format; // CC_FORMAT_RAW, CC_FORMAT_SCC or CC_FORMAT_NW4R
+	cc_io* out;
+	u8 field; // for the NW4R header
+	bool8 swap; // NW4R byte order, as in WriteNW4R
+	u32 written_bytes;
+	bool8 failed; // a write error or an out of order raw record stopped this output; the others go on
+	cc_raw_writer raw;
+} cc_fanout_output;
+
+// Counters for one conversion. While SetStats points at one, the readers and writers add to it.
+enum {
+	CC_PHASE_READ,
+	CC_PHASE_PROCESS, // sorting and scheduling
+	CC_PHASE_WRITE,
+	CC_PHASES
+};
+
+typedef struct {
+	u64 bytes_in;
+	u64 bytes_out;
+	u32 records_in;
+	u32 records_out;
+	u64 words_in; // caption words, not counting padding
+	u64 words_out;
+	u64 padding_in; // 0x8080 frames read from raw-like input
+	u64 padding_out; // 0x8080 frames written to raw output
+	u32 reallocs; // times a reader grew its output buffer
+	size_t peak_buffer; // largest output buffer a reader held
+	u32 parity_errors; // words whose parity bits were wrong (stripped either way)
+	u32 malformed_lines; // SCC lines skipped or cut short
+	u32 out_of_order; // records that had to be put back in order, or that stopped the output
+	f64 seconds[CC_PHASES]; // wall time in each phase; a streamed read includes what its callbacks did
+	f64 started;
+	f64 total;
+} cc_stats;
+
+#define CC_TRACE_EVENTS 65536 // default ring size; the oldest events go once it's full
+
 extern const timecode default_timecode;
 extern const VersionInfo library_version;
 
@@ -81,18 +623,209 @@ u32 byteswap32(u32 in);
 u64 byteswap48(u64 in);
 u64 byteswap64(u64 in);
 u16 fixParity(u16 in);
+void InitSCCCursor(scc_cursor* cursor, const scc_entry* in, size_t length, f64 fps, s64 frame);
+bool8 NextSCCWord(scc_cursor* cursor, u16* cc);
+bool8 SCCCursorDone(const scc_cursor* cursor);
+s64 GetSCCEndFrame(const scc_entry* in, size_t length, f64 fps);
 
 // scc.c
 scc_entry* ReadSCC(FILE* scc, size_t* length);
-u32 WriteSCC(scc_entry* in, size_t* length, FILE* out);
+u32 WriteSCC(const scc_entry* in, const size_t* length, FILE* out);
+u32 WriteSCCIO(const scc_entry* in, const size_t* length, cc_io* out);
 bool8 IsSCCFile(FILE* file);
+scc_entry* ReadSCCIndexed(FILE* scc, size_t* length, scc_index* index);
+scc_entry* ReadSCCRangeIndexed(FILE* scc, size_t* length, scc_index* index, s64 first, s64 end);
+scc_entry* ReadSCCRange(FILE* scc, size_t* length, const scc_index* index, s64 first, s64 end);
+u32 WriteSCCIndex(const scc_index* index, FILE* out);
+bool8 ReadSCCIndex(FILE* in, scc_index* index);
+bool8 IsSCCIndexCurrent(const scc_index* index, FILE* scc);
+void FreeSCCIndex(scc_index* index);
+bool8 DecodeSCCFile(cc_decoder* dec, FILE* scc, u8 field);
+scc_entry* ReadSCCPrefixed(cc_prefixed_file* scc, size_t* length);
+bool8 DecodeSCCFilePrefixed(cc_decoder* dec, cc_prefixed_file* scc, u8 field);
+bool8 StreamSCC(FILE* scc, scc_entry_callback callback, void* ctx);
+bool8 StreamSCCPrefixed(cc_prefixed_file* scc, scc_entry_callback callback, void* ctx);
+u32 WriteSCCHeader(FILE* out);
+u32 WriteSCCHeaderIO(cc_io* out);
+u32 WriteSCCEntry(const scc_entry* entry, FILE* out);
+u32 WriteSCCEntryIO(const scc_entry* entry, cc_io* out);
+
+// mcc.c
+scc_entry* ReadMCC(FILE* mcc, size_t* length, scc_entry** field2, size_t* length2);
+u32 WriteMCC(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, FILE* out, f64 fps);
+u32 WriteMCCIO(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, cc_io* out, f64 fps);
+bool8 IsMCCFile(FILE* file);
+scc_entry* ReadMCCPrefixed(cc_prefixed_file* mcc, size_t* length, scc_entry** field2, size_t* length2);
 
 // raw.c
 extern unsigned int MAX_NULLS; // only ReadRaw uses this value
 scc_entry* ReadRaw(FILE* raw, size_t* length, f32 fps, timecode start, bool8 drop);
+scc_entry* ReadRawWindow(FILE* raw, size_t* length, f32 fps, timecode start, bool8 drop, s64 first, s64 end);
 scc_entry* ReadNW4R(FILE* nw4r, size_t* length);
-u32 WriteRaw(scc_entry* in, size_t* length, FILE* out, f32 fps, timecode start, timecode end);
-u32 WriteNW4R(scc_entry* in, size_t* length, FILE* out, u8 field, bool8 swap);
+bool8 StreamRaw(FILE* raw, f64 fps, timecode start, cc_pair_callback callback, void* ctx);
+bool8 DecodeRaw(cc_decoder* dec, FILE* raw, timecode start, u8 field);
+u32 WriteRaw(const scc_entry* in, const size_t* length, FILE* out, f32 fps, timecode start, timecode end);
+u32 WriteRawIO(const scc_entry* in, const size_t* length, cc_io* out, f32 fps, timecode start, timecode end);
+u32 WriteNW4R(const scc_entry* in, const size_t* length, FILE* out, u8 field, bool8 swap);
+u32 WriteNW4RIO(const scc_entry* in, const size_t* length, cc_io* out, u8 field, bool8 swap);
+u32 WriteNW4RHeader(FILE* out, u8 field, bool8 swap, size_t length);
+u32 WriteNW4RHeaderIO(cc_io* out, u8 field, bool8 swap, size_t length);
+u32 WriteNW4REntryIO(const scc_entry* entry, cc_io* out, bool8 swap);
+u32 WriteRawHeader(FILE* out);
+u32 WriteRawHeaderIO(cc_io* out);
 bool8 IsRawFile(FILE* file);
 bool8 IsNW4RFile(FILE* file);
 u8 GetNW4RField(FILE* file);
+bool8 InitRawSegmenter(raw_segmenter* seg, f64 fps, bool8 drop);
+bool8 SegmentRawPair(raw_segmenter* seg, u16 cc, s64 frame);
+bool8 SegmentRawGap(raw_segmenter* seg, s64 frame, s64 next_frame);
+scc_entry* FinishRawSegmenter(raw_segmenter* seg, size_t* length);
+scc_entry* ReadRawPrefixed(cc_prefixed_file* raw, size_t* length, f32 fps, timecode start, bool8 drop);
+scc_entry* ReadNW4RPrefixed(cc_prefixed_file* nw4r, size_t* length);
+bool8 StreamRawPrefixed(cc_prefixed_file* raw, f64 fps, timecode start, cc_pair_callback callback, void* ctx);
+bool8 DecodeRawPrefixed(cc_decoder* dec, cc_prefixed_file* raw, timecode start, u8 field);
+void DrainRawSegmenter(raw_segmenter* seg, scc_entry_callback callback, void* ctx);
+bool8 InitRawWriter(cc_raw_writer* writer, FILE* out, f64 fps, timecode start, timecode end);
+bool8 InitRawWriterIO(cc_raw_writer* writer, cc_io* out, f64 fps, timecode start, timecode end);
+bool8 WriteRawEntry(cc_raw_writer* writer, const scc_entry* entry);
+u32 FinishRawWriter(cc_raw_writer* writer);
+bool8 PatchRaw(FILE* raw, const scc_entry* old, size_t old_length, const scc_entry* in, size_t length, f64 fps, timecode start, timecode end, cc_patch_report* report);
+
+// fanout.c
+bool8 WriteFanOut(const scc_entry* in, const size_t* length, cc_fanout_output* outputs, u8 count, f64 fps, timecode start, timecode end);
+
+// probe.c
+u8 ProbeFormat(const u8* buffer, size_t size);
+u8 ProbeNW4RField(const u8* buffer, size_t size);
+const char* GetFormatName(u8 format);
+u8 PeekFormat(FILE* file, u8* buffer, size_t* size);
+u8 PeekFormatIO(cc_io* io, u8* buffer, size_t* size);
+void InitPrefixedFile(cc_prefixed_file* in, FILE* file, const u8* prefix, size_t prefix_size);
+void InitPrefixedIO(cc_prefixed_file* in, cc_io* io, const u8* prefix, size_t prefix_size);
+size_t PrefixedRead(cc_prefixed_file* in, void* buffer, size_t size);
+char* PrefixedGets(cc_prefixed_file* in, char* buffer, int size);
+bool8 PrefixedSkipTo(cc_prefixed_file* in, u64 offset);
+
+// io.c
+void InitFileIO(cc_io* io, FILE* file);
+void InitMemoryIO(cc_io* io, cc_memory_io* mem, const void* data, size_t size);
+bool8 InitMemoryOutputIO(cc_io* io, cc_memory_io* mem);
+void InitFdIO(cc_io* io, cc_fd_io* fd_io, int fd);
+size_t IORead(cc_io* io, void* buffer, size_t size);
+size_t IOWrite(cc_io* io, const void* buffer, size_t size);
+bool8 IOSeek(cc_io* io, u64 offset);
+char* IOGets(cc_io* io, char* buffer, int size);
+bool8 IOFlush(cc_io* io);
+
+// stats.c
+extern cc_stats* cc_active_stats; // readers and writers check this before counting
+void InitStats(cc_stats* stats);
+cc_stats* SetStats(cc_stats* stats);
+void FinishStats(cc_stats* stats);
+f64 StatsClock();
+f64 StatsStart();
+void StatsPhase(u8 phase, f64 started);
+void StatsPhaseSpan(u8 phase, const char* span, f64 started);
+void StatsBuffer(size_t allocated, bool8 grown);
+void StatsParity(u16 word);
+void StatsTrack(const scc_entry* in, size_t length, bool8 output);
+u32 WriteStatsJSON(const cc_stats* stats, FILE* out, const char* input, const char* output);
+
+// trace.c
+bool8 StartTrace(size_t capacity);
+void StopTrace();
+bool8 TraceActive();
+f64 TraceStart();
+void TraceSpan(const char* name, f64 started);
+void TraceRecord(const char* name, s64 frame, u32 words);
+u32 WriteTraceJSON(FILE* out);
+
+// mux.c
+bool8 InitMux(cc_mux* mux, const cc_mux_input* inputs, u8 count, u8 field, f64 fps);
+bool8 NextMuxWord(cc_mux* mux, u16* cc);
+bool8 MuxDone(const cc_mux* mux);
+s64 NextMuxFrame(const cc_mux* mux);
+u32 MuxSCC(const cc_mux_input* inputs, u8 count, u8 field, u8 format, FILE* out, f64 fps, bool8 swap);
+
+// ccx.c
+u32 CRC32(const void* data, size_t size, u32 crc);
+u32 WriteCCX(const scc_entry* in, size_t length, FILE* out, f64 fps, u8 field, bool8 checkpoints);
+bool8 IsCCXFile(FILE* file);
+bool8 OpenCCX(cc_ccx* ccx, FILE* file);
+bool8 VerifyCCX(const cc_ccx* ccx);
+size_t SeekCCX(const cc_ccx* ccx, timecode tc);
+bool8 InitCCXDecoderIndex(const cc_ccx* ccx, cc_decoder_index* idx);
+void CloseCCX(cc_ccx* ccx);
+
+// rcwt.c
+scc_entry* ReadRCWT(FILE* rcwt, size_t* length, scc_entry** field2, size_t* length2, f64 fps, bool8 drop);
+u32 WriteRCWT(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, FILE* out, f64 fps);
+u32 WriteRCWTIO(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, cc_io* out, f64 fps);
+bool8 IsRCWTFile(FILE* file);
+scc_entry* ReadRCWTPrefixed(cc_prefixed_file* rcwt, size_t* length, scc_entry** field2, size_t* length2, f64 fps, bool8 drop);
+
+// decoder.c
+void InitDecoder(cc_decoder* dec, f64 fps, cc_event_callback callback, void* ctx);
+void DecodePair(cc_decoder* dec, u8 field, u16 cc, s64 frame);
+void DecodeEntry(cc_decoder* dec, const scc_entry* entry, u8 field);
+bool8 DecodeSCC(cc_decoder* dec, scc_entry* in, size_t* length, u8 field);
+void FinishDecoder(cc_decoder* dec);
+bool8 InitDecoderIndex(cc_decoder_index* idx, const scc_entry* track, size_t length, f64 fps, u8 field, s64 interval);
+const cc_screen* SeekDecoder(cc_decoder_index* idx, s64 frame, u8 channel);
+void FreeDecoderIndex(cc_decoder_index* idx);
+size_t GetScreenText(const cc_screen* screen, char* out, size_t size);
+u16 GetCCChar(u16 cc);
+
+// export.c
+s64 Frame2MS(s64 frame, f64 fps);
+size_t FormatCue(char* out, size_t size, u8 format, u32 index, s64 start_ms, s64 end_ms, const char* text);
+bool8 InitExporter(cc_exporter* exp, FILE* out, u8 format, u8 channel, f64 fps);
+void ExportEvent(const cc_caption_event* event, void* ctx);
+u32 FinishExporter(cc_exporter* exp);
+u32 ExportCaptions(scc_entry* in, size_t* length, FILE* out, u8 format, u8 channel, f64 fps);
+bool8 InitHLSSegmenter(cc_hls_segmenter* seg, const char* prefix, u8 channel, f64 fps, timecode start, f64 segment_duration, u64 mpegts);
+void SegmentHLSEvent(const cc_caption_event* event, void* ctx);
+u32 FinishHLSSegmenter(cc_hls_segmenter* seg);
+u32 SegmentHLS(scc_entry* in, size_t* length, const char* prefix, u8 channel, f64 fps, timecode start, f64 segment_duration, u64 mpegts);
+
+// encoder.c
+bool8 InitEncoder(cc_encoder* enc, u8 mode, u8 channel, u8 rollup_rows, bool8 center, f64 fps, bool8 drop);
+bool8 EncodeCue(cc_encoder* enc, s64 start_ms, s64 end_ms, const char* text);
+scc_entry* FinishEncoder(cc_encoder* enc, size_t* length);
+scc_entry* EncodeTextFile(FILE* in, size_t* length, u8 mode, u8 channel, u8 rollup_rows, bool8 center, f64 fps, bool8 drop);
+
+// retime.c
+s64 TimecodeToFrame(timecode tc, u32 nominal);
+timecode FrameToTimecode(s64 frame, u32 nominal, bool8 drop);
+bool8 RetimeSCC(scc_entry* in, size_t* length, const cc_retime* retime, cc_retime_report* report);
+
+// edl.c
+cc_edl_event* ReadEDL(FILE* edl, u32 nominal, size_t* count);
+scc_entry* ApplyEDL(const scc_entry* in, size_t length, const cc_edl_event* events, size_t count, u32 nominal, s64 rebase, size_t* out_length);
+u32 ApplyEDLRaw(FILE* in, FILE* out, const cc_edl_event* events, size_t count, s64 rebase);
+
+// schedule.c
+bool8 ScheduleSCC(scc_entry* in, size_t* length, f64 fps, s64 warn_shift, cc_schedule_report* report);
+void InitStreamScheduler(cc_stream_scheduler* sched, f64 fps, bool8 schedule, s64 warn_shift, scc_entry_callback callback, void* ctx);
+bool8 PushStreamScheduler(cc_stream_scheduler* sched, const scc_entry* entry);
+bool8 FinishStreamScheduler(cc_stream_scheduler* sched);
+
+// sort.c
+scc_entry* MergeSCC(scc_entry** tracks, size_t* lengths, u8 count, size_t* length, f64 fps, u32* moved);
+bool8 SortSCC(scc_entry** in, size_t* length, f64 fps, u32* moved);
+
+// xds.c
+void InitXDSAssembler(xds_assembler* xds, xds_packet_callback callback, void* ctx);
+void AssembleXDSPair(xds_assembler* xds, u16 cc, s64 frame);
+bool8 AssembleXDS(xds_assembler* xds, scc_entry* in, size_t* length, f64 fps);
+u32 ReadXDS(FILE* raw, f64 fps, timecode start, xds_packet_callback callback, void* ctx);
+
+// cdp.c
+u8 GetCDPFrameRate(f64 fps);
+u8 GetCDPCCCount(u8 frame_rate);
+f64 GetCDPFPS(u8 frame_rate);
+size_t GetCDPSize(u8 frame_rate);
+size_t BuildCDP(u8* out, u8 frame_rate, u16 sequence, u16 cc1, u16 cc2);
+bool8 ParseCDP(const u8* cdp, size_t size, u16* cc1, u16* cc2);
+u8* PacketizeCDP(scc_entry* field1, size_t* length1, scc_entry* field2, size_t* length2, f64 fps, timecode start, timecode end, size_t* packet_count);
+scc_entry* DepacketizeCDP(u8* in, size_t size, size_t* length, scc_entry** field2, size_t* length2, timecode start, bool8 drop);
@@ -0,0 +1,416 @@
+/*
+ccx.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include "config.h" // for HAVE_MMAP and large file support, before any system header
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "608.h"
+#include "log.h"
+
+// Indexed caption container. Like NW4R BCC, the DATA section is packed scc_entry records, but every section starts
+// on a page boundary and carries a CRC-32, so a file can be mapped and used in place:
+//	DATA: the records, usable directly as an scc_entry track
+//	TIDX: an scc_checkpoint every CCX_INDEX_INTERVAL records (offsets into DATA), for seeking by timecode
+//	CHAN: for each data channel and XDS, a count and the DATA offsets of the records carrying its words
+//	CKPT: optional decoder checkpoints, as InitDecoderIndex takes them
+// Files are written in host byte order, and the BOM marks which; files from a host with the other byte order are rejected.
+
+#define CCX_ALIGN 4096
+
+enum {
+	CCX_DATA,
+	CCX_TIDX,
+	CCX_CHAN,
+	CCX_CKPT,
+	CCX_SECTIONS
+};
+
+typedef struct {
+	char magic[4]; // CCX1
+	u16 bom;
+	u8 version_high;
+	u8 version_low;
+	u64 size;
+	u16 header_size;
+	u16 section_count;
+	u8 field;
+	u8 reserved[3];
+	f64 fps;
+	u32 checkpoint_size; // sizeof(cc_decoder_checkpoint); checkpoints are only used by builds with the same layout
+	u32 header_crc; // of this header with header_crc set to 0
+	struct {
+		char tag[4];
+		u32 crc;
+		u64 offset;
+		u64 size;
+	} sections[CCX_SECTIONS];
+} ccx_hdr;
+
+static const char* const section_tags[CCX_SECTIONS] = {"DATA", "TIDX", "CHAN", "CKPT"};
+
+static u32 crc_table[256];
+static bool8 crc_ready = false;
+
+u32 CRC32(const void* data, size_t size, u32 crc) {
+	if (!crc_ready) {
+		for (u32 i = 0; i < 256; i++) {
+			u32 c = i;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			crc_table[i] = c;
+		}
+		crc_ready = true;
+	}
+	const u8* ptr = (const u8*) data;
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = crc_table[(crc ^ ptr[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// Data channel 1 or 2 of the field, or XDS, for every word of a record; the channel carries over from the records before
+static u8 recordChannels(const scc_entry* entry, u8* active) {
+	u8 channels = 0;
+	for (unsigned int i = 0; i < entry->entry_count; i++) {
+		u8 b1 = (entry->entries[i] >> 8) & 0x7f;
+		if (b1 == 0 && (entry->entries[i] & 0x7f) == 0) {
+			continue; // padding
+		}
+		if (b1 > 0 && b1 < 0x10) {
+			*active = b1 == 0x0f ? 0xff : CCX_CHANNEL_XDS; // text after the end code has no channel until a control code
+			channels |= 1 << CCX_CHANNEL_XDS;
+			continue;
+		}
+		if (b1 >= 0x10 && b1 < 0x20) {
+			*active = (b1 & 0x08) ? 1 : 0;
+		}
+		if (*active != 0xff) {
+			channels |= 1 << *active;
+		}
+	}
+	return channels;
+}
+
+static bool8 writePadded(FILE* out, const void* data, size_t size, u64* position) {
+	static const u8 zeros[CCX_ALIGN] = {0};
+	if (size != 0 && fwrite(data, 1, size, out) != size) {
+		return false;
+	}
+	*position += size;
+	size_t padding = (CCX_ALIGN - (*position % CCX_ALIGN)) % CCX_ALIGN;
+	if (padding != 0 && fwrite(zeros, 1, padding, out) != padding) {
+		return false;
+	}
+	*position += padding;
+	return true;
+}
+
+// Writes a track as a CCX file. Records are stored in the order given; sorted tracks seek best.
+u32 WriteCCX(const scc_entry* in, size_t length, FILE* out, f64 fps, u8 field, bool8 checkpoints) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "WriteCCX: invalid input pointer\n");
+		return 0;
+	}
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteCCX: invalid file descriptor\n");
+		return 0;
+	}
+	u32 nominal = (u32) (fps + 0.5);
+	// Count records first, so the index and channel sections can be sized exactly
+	u32 record_count = 0;
+	for (size_t read_bytes = 0; read_bytes < length; record_count++) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	u32 index_count = (record_count + CCX_INDEX_INTERVAL - 1) / CCX_INDEX_INTERVAL;
+	scc_checkpoint* index = malloc(sizeof(scc_checkpoint) * (index_count != 0 ? index_count : 1));
+	// Channel section: the counts, then each channel's offsets; at worst every record is in every channel
+	u32* chan = malloc(sizeof(u32) * (CCX_CHANNELS + ((size_t) record_count * CCX_CHANNELS)));
+	cc_decoder_index dec_index;
+	memset(&dec_index, 0, sizeof(cc_decoder_index));
+	u32 written_bytes = 0;
+	if (index == NULL || chan == NULL) {
+		log_write(LOG_FATAL, use_colors, "WriteCCX: Couldn't allocate index buffers\n");
+		goto CCX_write_end;
+	}
+	u32* chan_offsets[CCX_CHANNELS];
+	for (int i = 0; i < CCX_CHANNELS; i++) {
+		chan[i] = 0;
+		chan_offsets[i] = chan + CCX_CHANNELS + ((size_t) record_count * i);
+	}
+	s64 max_frame = -1;
+	u8 active = 0xff;
+	u32 record = 0;
+	for (size_t read_bytes = 0; read_bytes < length; record++) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		s64 frame = TimecodeToFrame(entry->pts.tc, nominal);
+		if (record % CCX_INDEX_INTERVAL == 0) {
+			scc_checkpoint* checkpoint = &index[record / CCX_INDEX_INTERVAL];
+			checkpoint->offset = read_bytes;
+			checkpoint->max_before = max_frame;
+			checkpoint->min_after = frame;
+			checkpoint->line = record;
+			checkpoint->reserved = 0;
+		}
+		if (frame < index[record / CCX_INDEX_INTERVAL].min_after) {
+			index[record / CCX_INDEX_INTERVAL].min_after = frame;
+		}
+		max_frame = frame > max_frame ? frame : max_frame;
+		u8 channels = recordChannels(entry, &active);
+		for (int i = 0; i < CCX_CHANNELS; i++) {
+			if (channels & (1 << i)) {
+				chan_offsets[i][chan[i]++] = (u32) read_bytes;
+			}
+		}
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	for (s64 i = (s64) index_count - 2; i >= 0; i--) {
+		if (index[i+1].min_after < index[i].min_after) {
+			index[i].min_after = index[i+1].min_after;
+		}
+	}
+	// Pack the channel offsets behind the counts
+	size_t chan_size = CCX_CHANNELS;
+	for (int i = 0; i < CCX_CHANNELS; i++) {
+		memmove(chan + chan_size, chan_offsets[i], sizeof(u32) * chan[i]);
+		chan_size += chan[i];
+	}
+	if (checkpoints && !InitDecoderIndex(&dec_index, in, length, fps, field, 0)) {
+		goto CCX_write_end;
+	}
+
+	ccx_hdr header;
+	memset(&header, 0, sizeof(ccx_hdr));
+	memcpy(header.magic, "CCX1", 4);
+	header.bom = 0xfeff;
+	header.version_high = 1;
+	header.version_low = 0;
+	header.header_size = sizeof(ccx_hdr);
+	header.section_count = CCX_SECTIONS;
+	header.field = field & 0x1;
+	header.fps = fps;
+	header.checkpoint_size = sizeof(cc_decoder_checkpoint);
+	const void* section_data[CCX_SECTIONS] = {in, index, chan, dec_index.checkpoints};
+	u64 section_size[CCX_SECTIONS] = {length, sizeof(scc_checkpoint) * index_count, sizeof(u32) * chan_size, sizeof(cc_decoder_checkpoint) * dec_index.count};
+	u64 position = CCX_ALIGN;
+	for (int i = 0; i < CCX_SECTIONS; i++) {
+		memcpy(header.sections[i].tag, section_tags[i], 4);
+		header.sections[i].offset = position;
+		header.sections[i].size = section_size[i];
+		header.sections[i].crc = CRC32(section_data[i], section_size[i], 0);
+		position += ((section_size[i] + CCX_ALIGN - 1) / CCX_ALIGN) * CCX_ALIGN;
+	}
+	header.size = position;
+	header.header_crc = CRC32(&header, sizeof(ccx_hdr), 0);
+
+	position = 0;
+	if (!writePadded(out, &header, sizeof(ccx_hdr), &position)) {
+		goto CCX_file_error;
+	}
+	for (int i = 0; i < CCX_SECTIONS; i++) {
+		if (!writePadded(out, section_data[i], section_size[i], &position)) {
+			goto CCX_file_error;
+		}
+	}
+	written_bytes = (u32) position;
+	log_write(LOG_DEBUG, use_colors, "WriteCCX: wrote %d bytes: %d records, %d index entries, %d checkpoints\n", written_bytes, record_count, index_count, dec_index.count);
+	goto CCX_write_end;
+CCX_file_error:
+	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	written_bytes = (u32) position;
+CCX_write_end:
+	free(index);
+	free(chan);
+	FreeDecoderIndex(&dec_index);
+	return written_bytes;
+}
+
+bool8 IsCCXFile(FILE* file) {
+	if (file == NULL) {
+		log_write(LOG_ERROR, use_colors, "IsCCXFile: Invalid file descriptor\n");
+		return false;
+	}
+	char magic[4];
+	bool8 ret = fread(magic, 1, 4, file) == 4 && memcmp(magic, "CCX1", 4) == 0;
+	// Seek back to allow input functions and further checks to work properly
+	fseek(file, 0, SEEK_SET);
+	log_write(LOG_DEBUG, use_colors, "IsCCXFile: %s\n", ret ? "True" : "False");
+	return ret;
+}
+
+// Maps a CCX file (or reads it, where mmap isn't available). Only the header is checked here; see VerifyCCX.
+// The mapping is private and writable, so the records can go to functions that modify their input.
+bool8 OpenCCX(cc_ccx* ccx, FILE* file) {
+	if (ccx == NULL || file == NULL) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: Invalid file descriptor\n");
+		return false;
+	}
+	memset(ccx, 0, sizeof(cc_ccx));
+	ccx_hdr header;
+	if (fseek(file, 0, SEEK_SET) != 0 || fread(&header, 1, sizeof(ccx_hdr), file) != sizeof(ccx_hdr)) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: unexpected end of file\n");
+		return false;
+	}
+	u32 crc = header.header_crc;
+	header.header_crc = 0;
+	if (memcmp(header.magic, "CCX1", 4) != 0 || header.bom != 0xfeff || header.header_size != sizeof(ccx_hdr) || header.section_count != CCX_SECTIONS) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: Input is not a CCX file written on this host\n");
+		return false;
+	}
+	if (CRC32(&header, sizeof(ccx_hdr), 0) != crc) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: header checksum mismatch\n");
+		return false;
+	}
+	for (int i = 0; i < CCX_SECTIONS; i++) {
+		if (header.sections[i].offset % CCX_ALIGN != 0 || header.sections[i].offset + header.sections[i].size > header.size) {
+			log_write(LOG_ERROR, use_colors, "OpenCCX: section %.4s is out of bounds\n", header.sections[i].tag);
+			return false;
+		}
+	}
+	ccx->size = header.size;
+#if HAVE_MMAP
+	struct stat st;
+	if (fstat(fileno(file), &st) != 0 || (u64) st.st_size < header.size) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: file is truncated\n");
+		return false;
+	}
+	void* base = mmap(NULL, ccx->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+	if (base == MAP_FAILED) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: Couldn't map file (%d: %s)\n", errno, strerror(errno));
+		return false;
+	}
+	ccx->base = base;
+	ccx->mapped = true;
+#else
+	ccx->base = malloc(ccx->size);
+	if (ccx->base == NULL) {
+		log_write(LOG_FATAL, use_colors, "OpenCCX: Couldn't allocate %d bytes\n", (u32) ccx->size);
+		return false;
+	}
+	if (fseek(file, 0, SEEK_SET) != 0 || fread(ccx->base, 1, ccx->size, file) != ccx->size) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: file is truncated\n");
+		CloseCCX(ccx);
+		return false;
+	}
+#endif
+	for (int i = 0; i < CCX_SECTIONS; i++) {
+		ccx->section_crc[i] = header.sections[i].crc;
+		ccx->section_offset[i] = header.sections[i].offset;
+		ccx->section_size[i] = header.sections[i].size;
+	}
+	ccx->fps = header.fps;
+	ccx->field = header.field;
+	ccx->data = (scc_entry*) (ccx->base + header.sections[CCX_DATA].offset);
+	ccx->length = header.sections[CCX_DATA].size;
+	ccx->index = (const scc_checkpoint*) (ccx->base + header.sections[CCX_TIDX].offset);
+	ccx->index_count = (u32) (header.sections[CCX_TIDX].size / sizeof(scc_checkpoint));
+	const u32* chan = (const u32*) (ccx->base + header.sections[CCX_CHAN].offset);
+	size_t chan_words = header.sections[CCX_CHAN].size / sizeof(u32);
+	size_t chan_used = CCX_CHANNELS;
+	for (int i = 0; i < CCX_CHANNELS && chan_words >= CCX_CHANNELS; i++) {
+		ccx->channel_offsets[i] = chan + chan_used;
+		ccx->channel_counts[i] = chan[i];
+		chan_used += chan[i];
+	}
+	if (chan_used > chan_words) {
+		log_write(LOG_ERROR, use_colors, "OpenCCX: channel section is inconsistent\n");
+		CloseCCX(ccx);
+		return false;
+	}
+	if (header.checkpoint_size == sizeof(cc_decoder_checkpoint)) {
+		ccx->checkpoints = (cc_decoder_checkpoint*) (ccx->base + header.sections[CCX_CKPT].offset);
+		ccx->checkpoint_count = (u32) (header.sections[CCX_CKPT].size / sizeof(cc_decoder_checkpoint));
+	}
+	else if (header.sections[CCX_CKPT].size != 0) {
+		log_write(LOG_WARN, use_colors, "OpenCCX: decoder checkpoints were written by an incompatible build (ignoring)\n");
+	}
+	log_write(LOG_DEBUG, use_colors, "OpenCCX: %d bytes of Field %d data, %d index entries, %d checkpoints\n", (u32) ccx->length, ccx->field + 1, ccx->index_count, ccx->checkpoint_count);
+	return true;
+}
+
+// Checks every section against its CRC-32. This touches the whole file, so it's left out of OpenCCX.
+bool8 VerifyCCX(const cc_ccx* ccx) {
+	bool8 ret = true;
+	for (int i = 0; i < CCX_SECTIONS; i++) {
+		if (CRC32(ccx->base + ccx->section_offset[i], ccx->section_size[i], 0) != ccx->section_crc[i]) {
+			log_write(LOG_ERROR, use_colors, "VerifyCCX: %s section checksum mismatch\n", section_tags[i]);
+			ret = false;
+		}
+	}
+	return ret;
+}
+
+// Offset in the DATA section of the first record at or after tc (in stored order), or the length of the data if there's none
+size_t SeekCCX(const cc_ccx* ccx, timecode tc) {
+	u32 nominal = (u32) (ccx->fps + 0.5);
+	s64 frame = TimecodeToFrame(tc, nominal);
+	if (ccx->index_count == 0) {
+		return ccx->length;
+	}
+	// The last index entry that nothing at or after frame comes before
+	u32 low = 0;
+	u32 high = ccx->index_count;
+	while (high - low > 1) {
+		u32 mid = (low + high) / 2;
+		if (ccx->index[mid].max_before < frame) {
+			low = mid;
+		}
+		else {
+			high = mid;
+		}
+	}
+	size_t offset = ccx->index[low].offset;
+	while (offset < ccx->length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) ccx->data) + offset);
+		if (TimecodeToFrame(entry->pts.tc, nominal) >= frame) {
+			break;
+		}
+		offset += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	return offset;
+}
+
+// Sets up idx over the stored checkpoints, without decoding anything. Free the file with CloseCCX, not FreeDecoderIndex.
+bool8 InitCCXDecoderIndex(const cc_ccx* ccx, cc_decoder_index* idx) {
+	if (ccx->checkpoint_count == 0) {
+		log_write(LOG_ERROR, use_colors, "InitCCXDecoderIndex: file has no decoder checkpoints\n");
+		return false;
+	}
+	memset(idx, 0, sizeof(cc_decoder_index));
+	idx->track = ccx->data;
+	idx->length = ccx->length;
+	idx->field = ccx->field;
+	idx->checkpoints = ccx->checkpoints;
+	idx->count = ccx->checkpoint_count;
+	idx->current = ccx->checkpoints[0];
+	return true;
+}
+
+void CloseCCX(cc_ccx* ccx) {
+	if (ccx->base == NULL) {
+		return;
+	}
+#if HAVE_MMAP
+	if (ccx->mapped) {
+		munmap(ccx->base, ccx->size);
+	}
+	else {
+		free(ccx->base);
+	}
+#else
+	free(ccx->base);
+#endif
+	ccx->base = NULL;
+	ccx->data = NULL;
+}
@@ -0,0 +1,269 @@
+/*
+cdp.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <math.h> // fabs
+#include "608.h"
+#include "log.h"
+
+// SMPTE 334-2 caption distribution packets, as carried in VANC
+
+static const struct {
+	f64 fps;
+	u8 cc_count;
+} cdp_rates[9] = {
+	{0, 0}, // forbidden
+	{24/1.001f, 25},
+	{24, 25},
+	{25, 24},
+	{30/1.001f, 20},
+	{30, 20},
+	{50, 12},
+	{60/1.001f, 10},
+	{60, 10}
+};
+
+// CDP header (7 bytes) + ccdata_section header (2 bytes) + triplets + footer (4 bytes)
+#define CDP_OVERHEAD 13
+
+u8 GetCDPFrameRate(f64 fps) {
+	for (u8 i = 1; i < 9; i++) {
+		if (fabs(cdp_rates[i].fps - fps) < 0.01f) {
+			return i;
+		}
+	}
+	log_write(LOG_ERROR, use_colors, "GetCDPFrameRate: %f fps can't be carried in a CDP\n", fps);
+	return 0;
+}
+
+u8 GetCDPCCCount(u8 frame_rate) {
+	if (frame_rate == 0 || frame_rate > 8) {
+		return 0;
+	}
+	return cdp_rates[frame_rate].cc_count;
+}
+
+f64 GetCDPFPS(u8 frame_rate) {
+	if (frame_rate == 0 || frame_rate > 8) {
+		return 0;
+	}
+	return cdp_rates[frame_rate].fps;
+}
+
+size_t GetCDPSize(u8 frame_rate) {
+	return CDP_OVERHEAD + (3 * GetCDPCCCount(frame_rate));
+}
+
+// Writes one CDP with a single Field 1 and Field 2 byte pair to out. The rest of the triplets are DTVCC padding.
+size_t BuildCDP(u8* out, u8 frame_rate, u16 sequence, u16 cc1, u16 cc2) {
+	u8 cc_count = GetCDPCCCount(frame_rate);
+	if (cc_count == 0) {
+		log_write(LOG_ERROR, use_colors, "BuildCDP: invalid frame rate code %hhu\n", frame_rate);
+		return 0;
+	}
+	size_t size = CDP_OVERHEAD + (3 * cc_count);
+	u8* ptr = out;
+	*ptr++ = 0x96; // cdp_identifier
+	*ptr++ = 0x69;
+	*ptr++ = (u8) size;
+	*ptr++ = (u8) ((frame_rate << 4) | 0x0f);
+	*ptr++ = 0x43; // ccdata_present, caption_service_active, reserved bit
+	*ptr++ = (u8) (sequence >> 8);
+	*ptr++ = (u8) (sequence & 0xff);
+	*ptr++ = 0x72; // ccdata_id
+	*ptr++ = (u8) (0xe0 | cc_count);
+	cc1 = fixParity(cc1);
+	cc2 = fixParity(cc2);
+	*ptr++ = 0xfc; // cc_valid, NTSC_CC_FIELD_1
+	*ptr++ = (u8) (cc1 >> 8);
+	*ptr++ = (u8) (cc1 & 0xff);
+	*ptr++ = 0xfd; // cc_valid, NTSC_CC_FIELD_2
+	*ptr++ = (u8) (cc2 >> 8);
+	*ptr++ = (u8) (cc2 & 0xff);
+	for (unsigned int i = 2; i < cc_count; i++) {
+		*ptr++ = 0xfa; // !cc_valid, DTVCC_PACKET_START
+		*ptr++ = 0;
+		*ptr++ = 0;
+	}
+	*ptr++ = 0x74; // cdp_footer_id
+	*ptr++ = (u8) (sequence >> 8);
+	*ptr++ = (u8) (sequence & 0xff);
+	u8 checksum = 0;
+	for (u8* i = out; i < ptr; i++) {
+		checksum += *i;
+	}
+	*ptr++ = (u8) (0x100 - checksum);
+	return size;
+}
+
+// Pulls the first Field 1 and Field 2 byte pairs out of a single CDP. Pairs that aren't present are left as they were.
+bool8 ParseCDP(const u8* cdp, size_t size, u16* cc1, u16* cc2) {
+	if (size < CDP_OVERHEAD || cdp[0] != 0x96 || cdp[1] != 0x69 || cdp[2] < CDP_OVERHEAD || cdp[2] > size) {
+		log_write(LOG_WARN, use_colors, "ParseCDP: Input is not a CDP\n");
+		return false;
+	}
+	u8 cdp_length = cdp[2];
+	u8 checksum = 0;
+	for (unsigned int i = 0; i < cdp_length; i++) {
+		checksum += cdp[i];
+	}
+	if (checksum != 0) {
+		log_write(LOG_WARN, use_colors, "ParseCDP: Checksum mismatch\n");
+		return false;
+	}
+	const u8* ptr = cdp + 7;
+	const u8* end_ptr = cdp + cdp_length;
+	bool8 got1 = false;
+	bool8 got2 = false;
+	while (ptr < end_ptr && *ptr != 0x74) {
+		if (*ptr == 0x71) { // time_code_section
+			ptr += 5;
+		}
+		else if (*ptr == 0x72) { // ccdata_section
+			u8 cc_count = ptr[1] & 0x1f;
+			ptr += 2;
+			for (unsigned int i = 0; i < cc_count && ptr + 3 <= end_ptr; i++, ptr += 3) {
+				if ((ptr[0] & 0x04) == 0) {
+					continue;
+				}
+				if ((ptr[0] & 0x03) == 0 && !got1) {
+					*cc1 = ((ptr[1] << 8) | ptr[2]) & 0x7f7f;
+					got1 = true;
+				}
+				else if ((ptr[0] & 0x03) == 1 && !got2) {
+					*cc2 = ((ptr[1] << 8) | ptr[2]) & 0x7f7f;
+					got2 = true;
+				}
+			}
+		}
+		else if (*ptr == 0x73) { // ccsvcinfo_section
+			ptr += 2 + (7 * (ptr[1] & 0x0f));
+		}
+		else if (*ptr >= 0x75 && *ptr <= 0xef) { // future sections carry their own length
+			ptr += 2 + ptr[1];
+		}
+		else {
+			log_write(LOG_WARN, use_colors, "ParseCDP: Unknown section 0x%02hhx\n", *ptr);
+			break;
+		}
+	}
+	return true;
+}
+
+u8* PacketizeCDP(scc_entry* field1, size_t* length1, scc_entry* field2, size_t* length2, f64 fps, timecode start, timecode end, size_t* packet_count) {
+	if (field1 == NULL && field2 == NULL) {
+		log_write(LOG_FATAL, use_colors, "PacketizeCDP: invalid input pointer\n");
+		return NULL;
+	}
+	u8 frame_rate = GetCDPFrameRate(fps);
+	if (frame_rate == 0) {
+		return NULL;
+	}
+	size_t l1 = field1 != NULL ? *length1 : 0;
+	size_t l2 = field2 != NULL ? *length2 : 0;
+	s64 current_frame = tc2int(start, fps);
+	s64 last_frame = tc2int(end, fps);
+	if (l1 != 0 && tc2int(field1->pts.tc, fps) < current_frame) {
+		log_write(LOG_WARN, use_colors, "PacketizeCDP: start pts of Field 1 data before specified start time (using pts of first entry)\n");
+		current_frame = tc2int(field1->pts.tc, fps);
+	}
+	if (l2 != 0 && tc2int(field2->pts.tc, fps) < current_frame) {
+		log_write(LOG_WARN, use_colors, "PacketizeCDP: start pts of Field 2 data before specified start time (using pts of first entry)\n");
+		current_frame = tc2int(field2->pts.tc, fps);
+	}
+	s64 end1 = GetSCCEndFrame(field1, l1, fps);
+	s64 end2 = GetSCCEndFrame(field2, l2, fps);
+	// Pad one frame past the data, same as WriteRaw, so ReadRaw-style segmentation sees the end of the last record
+	if (last_frame <= end1) {
+		last_frame = end1 + 1;
+	}
+	if (last_frame <= end2) {
+		last_frame = end2 + 1;
+	}
+	if (last_frame <= current_frame) {
+		last_frame = current_frame + 1;
+	}
+	size_t cdp_size = GetCDPSize(frame_rate);
+	*packet_count = (size_t) (last_frame - current_frame);
+	// Every packet has the same size, so everything fits in one buffer
+	u8* out = malloc(*packet_count * cdp_size);
+	if (out == NULL) {
+		log_write(LOG_FATAL, use_colors, "PacketizeCDP: Couldn't allocate output buffer\n");
+		return NULL;
+	}
+	scc_cursor cursor1, cursor2;
+	InitSCCCursor(&cursor1, field1, l1, fps, current_frame);
+	InitSCCCursor(&cursor2, field2, l2, fps, current_frame);
+	u8* output_ptr = out;
+	for (size_t i = 0; i < *packet_count; i++) {
+		u16 cc1, cc2;
+		NextSCCWord(&cursor1, &cc1);
+		NextSCCWord(&cursor2, &cc2);
+		output_ptr += BuildCDP(output_ptr, frame_rate, (u16) i, cc1, cc2);
+	}
+	log_write(LOG_DEBUG, use_colors, "PacketizeCDP: built %d packets of %d bytes\n", (u32) *packet_count, (u32) cdp_size);
+	return out;
+}
+
+scc_entry* DepacketizeCDP(u8* in, size_t size, size_t* length, scc_entry** field2, size_t* length2, timecode start, bool8 drop) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "DepacketizeCDP: invalid input pointer\n");
+		return NULL;
+	}
+	if (size < CDP_OVERHEAD || in[0] != 0x96 || in[1] != 0x69) {
+		log_write(LOG_ERROR, use_colors, "DepacketizeCDP: Input is not a CDP\n");
+		return NULL;
+	}
+	u8 frame_rate = in[3] >> 4;
+	if (GetCDPCCCount(frame_rate) == 0) {
+		log_write(LOG_ERROR, use_colors, "DepacketizeCDP: invalid frame rate code %hhu\n", frame_rate);
+		return NULL;
+	}
+	f64 fps = cdp_rates[frame_rate].fps;
+	raw_segmenter seg1, seg2;
+	if (!InitRawSegmenter(&seg1, fps, drop)) {
+		return NULL;
+	}
+	if (field2 != NULL && !InitRawSegmenter(&seg2, fps, drop)) {
+		free(seg1.data);
+		return NULL;
+	}
+	s64 current_frame = tc2int(start, fps);
+	size_t pos = 0;
+	u32 packets = 0;
+	while (pos + CDP_OVERHEAD <= size) {
+		u8* cdp = in + pos;
+		u8 cdp_length = cdp[2];
+		if (cdp[0] != 0x96 || cdp[1] != 0x69 || cdp_length < CDP_OVERHEAD || pos + cdp_length > size) {
+			log_write(LOG_WARN, use_colors, "DepacketizeCDP: Invalid CDP at offset 0x%08x (stopping)\n", (u32) pos);
+			break;
+		}
+		u16 cc1 = 0;
+		u16 cc2 = 0;
+		if (!ParseCDP(cdp, cdp_length, &cc1, &cc2)) {
+			log_write(LOG_WARN, use_colors, "DepacketizeCDP: ignoring data of CDP %d\n", packets);
+		}
+		if (!SegmentRawPair(&seg1, cc1, current_frame)) {
+			if (field2 != NULL) {
+				free(seg2.data);
+			}
+			return NULL;
+		}
+		if (field2 != NULL && !SegmentRawPair(&seg2, cc2, current_frame)) {
+			free(seg1.data);
+			return NULL;
+		}
+		current_frame++;
+		packets++;
+		pos += cdp_length;
+	}
+	log_write(LOG_DEBUG, use_colors, "DepacketizeCDP: Read %d packets\n", packets);
+	if (field2 != NULL) {
+		*field2 = FinishRawSegmenter(&seg2, length2);
+	}
+	return FinishRawSegmenter(&seg1, length);
+}
@@ -0,0 +1,620 @@
+/*
+decoder.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Opcodes for the control code dispatch table
+enum {
+	OP_NONE,
+	OP_PAC,
+	OP_MIDROW,
+	OP_SPECIAL,
+	OP_EXTENDED,
+	OP_TAB,
+	OP_RCL,
+	OP_BS,
+	OP_DER,
+	OP_RU,
+	OP_RDC,
+	OP_TEXT,
+	OP_EDM,
+	OP_CR,
+	OP_ENM,
+	OP_EOC,
+	OP_IGNORE // valid codes that don't affect the display (AOF, AON, FON, background attributes)
+};
+
+// Indexed by ((b1 & 0x07) << 7) | b2, for b1 0x10-0x17 with the channel bit stripped
+static u8 op_table[8][128];
+static u8 arg_table[8][128];
+static bool8 tables_ready = false;
+
+// Row for each PAC, indexed by ((b1 & 0x07) << 1) | ((b2 & 0x20) >> 5); 0xff is unused
+static const u8 pac_rows[16] = {10, 0xff, 0, 1, 2, 3, 11, 12, 13, 14, 4, 5, 6, 7, 8, 9};
+
+// Standard characters that differ from ASCII
+static u16 basic_chars[128];
+
+static const u16 special_chars[16] = {
+	0xae, 0xb0, 0xbd, 0xbf, 0x2122, 0xa2, 0xa3, 0x266a,
+	0xe0, 0xa0, 0xe8, 0xe2, 0xea, 0xee, 0xf4, 0xfb
+};
+
+static const u16 extended_chars[2][32] = {
+	{ // Spanish, French, miscellaneous
+		0xc1, 0xc9, 0xd3, 0xda, 0xdc, 0xfc, 0x2018, 0xa1,
+		0x2a, 0x27, 0x2014, 0xa9, 0x2120, 0x2022, 0x201c, 0x201d,
+		0xc0, 0xc2, 0xc7, 0xc8, 0xca, 0xcb, 0xeb, 0xce,
+		0xcf, 0xef, 0xd4, 0xd9, 0xf9, 0xdb, 0xab, 0xbb
+	},
+	{ // Portuguese, German, Danish
+		0xc3, 0xe3, 0xcd, 0xcc, 0xec, 0xd2, 0xf2, 0xd5,
+		0xf5, 0x7b, 0x7d, 0x5c, 0x5e, 0x5f, 0x7c, 0x7e,
+		0xc4, 0xe4, 0xd6, 0xf6, 0xdf, 0xa5, 0xa4, 0x2502,
+		0xc5, 0xe5, 0xd8, 0xf8, 0x250c, 0x2510, 0x2514, 0x2518
+	}
+};
+
+static void initTables() {
+	for (int i = 0; i < 128; i++) {
+		basic_chars[i] = (u16) i;
+	}
+	basic_chars[0x2a] = 0xe1;
+	basic_chars[0x5c] = 0xe9;
+	basic_chars[0x5e] = 0xed;
+	basic_chars[0x5f] = 0xf3;
+	basic_chars[0x60] = 0xfa;
+	basic_chars[0x7b] = 0xe7;
+	basic_chars[0x7c] = 0xf7;
+	basic_chars[0x7d] = 0xd1;
+	basic_chars[0x7e] = 0xf1;
+	basic_chars[0x7f] = 0x2588;
+	memset(op_table, OP_NONE, sizeof(op_table));
+	memset(arg_table, 0, sizeof(arg_table));
+	for (int b1 = 0; b1 < 8; b1++) {
+		for (int b2 = 0x40; b2 < 0x80; b2++) {
+			u8 row = pac_rows[(b1 << 1) | ((b2 & 0x20) >> 5)];
+			if (row == 0xff) {
+				continue;
+			}
+			op_table[b1][b2] = OP_PAC;
+			arg_table[b1][b2] = row;
+		}
+	}
+	for (int b2 = 0x20; b2 < 0x30; b2++) {
+		op_table[0][b2] = OP_IGNORE; // background attributes
+		op_table[1][b2] = OP_MIDROW;
+		op_table[1][b2+0x10] = OP_SPECIAL;
+		arg_table[1][b2+0x10] = (u8) (b2 - 0x20);
+	}
+	// Extended characters, the argument picks the set (bit 5) and the character
+	for (int b2 = 0x20; b2 < 0x40; b2++) {
+		op_table[2][b2] = OP_EXTENDED;
+		arg_table[2][b2] = (u8) (b2 - 0x20);
+		op_table[3][b2] = OP_EXTENDED;
+		arg_table[3][b2] = (u8) b2;
+	}
+	// Miscellaneous control codes, 0x14 for Field 1 and 0x15 for Field 2
+	static const u8 misc_ops[16] = {
+		OP_RCL, OP_BS, OP_IGNORE, OP_IGNORE, OP_DER, OP_RU, OP_RU, OP_RU,
+		OP_IGNORE, OP_RDC, OP_TEXT, OP_TEXT, OP_EDM, OP_CR, OP_ENM, OP_EOC
+	};
+	for (int i = 0; i < 16; i++) {
+		op_table[4][0x20+i] = misc_ops[i];
+		op_table[5][0x20+i] = misc_ops[i];
+	}
+	arg_table[4][0x25] = arg_table[5][0x25] = 2;
+	arg_table[4][0x26] = arg_table[5][0x26] = 3;
+	arg_table[4][0x27] = arg_table[5][0x27] = 4;
+	for (int i = 1; i < 4; i++) {
+		op_table[7][0x20+i] = OP_TAB;
+		arg_table[7][0x20+i] = (u8) i;
+	}
+	op_table[7][0x2d] = op_table[7][0x2e] = op_table[7][0x2f] = OP_IGNORE; // BT, FA, FAU
+	tables_ready = true;
+}
+
+static bool8 screenEmpty(const cc_screen* screen) {
+	for (int row = 0; row < CC_ROWS; row++) {
+		for (int col = 0; col < CC_COLUMNS; col++) {
+			if (screen->chars[row][col] != 0 && screen->chars[row][col] != 0x20 && screen->chars[row][col] != 0xa0) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void emitEvent(cc_decoder* dec, u8 channel, s64 frame) {
+	cc_channel_state* ch = &dec->channels[channel];
+	ch->dirty = false;
+	bool8 empty = screenEmpty(&ch->displayed);
+	if (empty && !ch->showing) {
+		return;
+	}
+	ch->showing = !empty;
+	if (dec->callback == NULL) {
+		return;
+	}
+	cc_caption_event event;
+	event.type = empty ? CC_EVENT_CLEAR : CC_EVENT_DISPLAY;
+	event.channel = channel;
+	event.frame = frame;
+	event.pts = int2tc(frame, dec->fps, dec->drop);
+	event.screen = &ch->displayed;
+	dec->callback(&event, dec->ctx);
+}
+
+static void flushChannel(cc_decoder* dec, u8 channel) {
+	if (dec->channels[channel].dirty) {
+		emitEvent(dec, channel, dec->channels[channel].dirty_frame);
+	}
+}
+
+static void flushField(cc_decoder* dec, u8 field) {
+	for (u8 channel = field*2; channel < (field*2)+2; channel++) {
+		flushChannel(dec, channel);
+	}
+}
+
+static void markDirty(cc_channel_state* ch, s64 frame) {
+	if (!ch->dirty) {
+		ch->dirty = true;
+		ch->dirty_frame = frame;
+	}
+}
+
+static cc_screen* targetScreen(cc_channel_state* ch, s64 frame) {
+	if (ch->mode == CC_MODE_ROLLUP || ch->mode == CC_MODE_PAINTON) {
+		markDirty(ch, frame);
+		return &ch->displayed;
+	}
+	return &ch->nondisplayed;
+}
+
+static void putChar(cc_channel_state* ch, u16 c, s64 frame) {
+	if (ch->mode == CC_MODE_TEXT) {
+		return;
+	}
+	cc_screen* screen = targetScreen(ch, frame);
+	screen->chars[ch->row][ch->column] = c;
+	screen->attrs[ch->row][ch->column] = ch->attr;
+	if (ch->column < CC_COLUMNS-1) {
+		ch->column++;
+	}
+}
+
+static void rollUp(cc_channel_state* ch) {
+	int top = ch->row - ch->rollup_rows + 1;
+	if (top < 0) {
+		top = 0;
+	}
+	for (int row = 0; row < ch->row; row++) {
+		if (row >= top) {
+			memcpy(ch->displayed.chars[row], ch->displayed.chars[row+1], sizeof(ch->displayed.chars[row]));
+			memcpy(ch->displayed.attrs[row], ch->displayed.attrs[row+1], sizeof(ch->displayed.attrs[row]));
+		}
+		else {
+			memset(ch->displayed.chars[row], 0, sizeof(ch->displayed.chars[row]));
+		}
+	}
+	memset(ch->displayed.chars[ch->row], 0, sizeof(ch->displayed.chars[ch->row]));
+	memset(ch->displayed.attrs[ch->row], 0, sizeof(ch->displayed.attrs[ch->row]));
+}
+
+// Moves the roll-up window so its base row is new_row
+static void moveWindow(cc_channel_state* ch, u8 new_row) {
+	cc_screen moved;
+	memset(&moved, 0, sizeof(cc_screen));
+	for (int i = 0; i < ch->rollup_rows; i++) {
+		int from = ch->row - i;
+		int to = new_row - i;
+		if (from < 0 || to < 0) {
+			break;
+		}
+		memcpy(moved.chars[to], ch->displayed.chars[from], sizeof(moved.chars[to]));
+		memcpy(moved.attrs[to], ch->displayed.attrs[from], sizeof(moved.attrs[to]));
+	}
+	memcpy(&ch->displayed, &moved, sizeof(cc_screen));
+}
+
+void InitDecoder(cc_decoder* dec, f64 fps, cc_event_callback callback, void* ctx) {
+	if (!tables_ready) {
+		initTables();
+	}
+	memset(dec, 0, sizeof(cc_decoder));
+	for (int i = 0; i < 4; i++) {
+		dec->channels[i].row = CC_ROWS-1;
+		dec->channels[i].rollup_rows = 2;
+	}
+	dec->fps = fps;
+	dec->last_frame[0] = -2;
+	dec->last_frame[1] = -2;
+	dec->callback = callback;
+	dec->ctx = ctx;
+}
+
+void DecodePair(cc_decoder* dec, u8 field, u16 cc, s64 frame) {
+	field &= 0x1;
+	// A gap between byte pairs ends a burst, so pending changes get reported
+	if (frame > dec->last_frame[field] + 1) {
+		flushField(dec, field);
+	}
+	dec->last_frame[field] = frame;
+	u8 b1 = (cc >> 8) & 0x7f;
+	u8 b2 = cc & 0x7f;
+	if (b1 == 0 && b2 == 0) {
+		// Padding ends a burst too, since raw, RCWT and muxed tracks pad every frame and never leave a gap
+		flushField(dec, field);
+		return;
+	}
+	if (b1 < 0x10) {
+		// XDS, text after it belongs to the XDS packet until the end code
+		dec->xds[field] = b1 != 0x0f;
+		dec->last_control[field] = 0;
+		return;
+	}
+	if (b1 >= 0x20) {
+		dec->last_control[field] = 0;
+		if (dec->xds[field]) {
+			return;
+		}
+		cc_channel_state* ch = &dec->channels[(field*2) + dec->active[field]];
+		putChar(ch, basic_chars[b1], frame);
+		if (b2 >= 0x20) {
+			putChar(ch, basic_chars[b2], frame);
+		}
+		return;
+	}
+	// Control codes are sent twice; the repeat is dropped
+	if (cc == dec->last_control[field]) {
+		dec->last_control[field] = 0;
+		return;
+	}
+	dec->last_control[field] = cc;
+	u8 op = op_table[b1 & 0x07][b2];
+	if (op == OP_NONE) {
+		log_write(LOG_DEBUG, use_colors, "DecodePair: Unknown control code 0x%04x at frame %d\n", cc, (s32) frame);
+		return;
+	}
+	dec->xds[field] = false;
+	dec->active[field] = (b1 & 0x08) >> 3;
+	u8 channel = (field*2) + dec->active[field];
+	cc_channel_state* ch = &dec->channels[channel];
+	u8 arg = arg_table[b1 & 0x07][b2];
+	switch (op) {
+		case OP_PAC:
+			if (ch->mode == CC_MODE_ROLLUP && arg != ch->row) {
+				moveWindow(ch, arg);
+				markDirty(ch, frame);
+			}
+			ch->row = arg;
+			if (b2 & 0x10) {
+				ch->column = (u8) (((b2 & 0x0e) >> 1) * 4);
+				ch->attr = (u8) ((b2 & 0x01) ? CC_ATTR_UNDERLINE : 0);
+			}
+			else {
+				ch->column = 0;
+				u8 color = (b2 & 0x0e) >> 1;
+				ch->attr = (u8) ((color == 7 ? CC_ATTR_ITALICS : color) | ((b2 & 0x01) ? CC_ATTR_UNDERLINE : 0));
+			}
+			break;
+		case OP_MIDROW: {
+			u8 color = (b2 & 0x0e) >> 1;
+			if (color == 7) {
+				ch->attr = (u8) ((ch->attr & CC_ATTR_COLOR) | CC_ATTR_ITALICS | ((b2 & 0x01) ? CC_ATTR_UNDERLINE : 0));
+			}
+			else {
+				ch->attr = (u8) (color | ((b2 & 0x01) ? CC_ATTR_UNDERLINE : 0));
+			}
+			putChar(ch, 0x20, frame);
+			break;
+		}
+		case OP_SPECIAL:
+			putChar(ch, special_chars[arg], frame);
+			break;
+		case OP_EXTENDED:
+			// Replaces the standard character sent before it as a fallback
+			if (ch->column > 0) {
+				ch->column--;
+			}
+			putChar(ch, extended_chars[arg >> 5][arg & 0x1f], frame);
+			break;
+		case OP_TAB:
+			ch->column = (u8) (ch->column + arg < CC_COLUMNS ? ch->column + arg : CC_COLUMNS-1);
+			break;
+		case OP_RCL:
+			ch->mode = CC_MODE_POPON;
+			break;
+		case OP_BS:
+			if (ch->mode != CC_MODE_TEXT && ch->column > 0) {
+				cc_screen* screen = targetScreen(ch, frame);
+				ch->column--;
+				screen->chars[ch->row][ch->column] = 0;
+			}
+			break;
+		case OP_DER:
+			if (ch->mode != CC_MODE_TEXT) {
+				cc_screen* screen = targetScreen(ch, frame);
+				memset(&screen->chars[ch->row][ch->column], 0, sizeof(u16) * (CC_COLUMNS - ch->column));
+			}
+			break;
+		case OP_RU:
+			if (ch->mode == CC_MODE_POPON || ch->mode == CC_MODE_PAINTON) {
+				memset(&ch->displayed, 0, sizeof(cc_screen));
+				memset(&ch->nondisplayed, 0, sizeof(cc_screen));
+				markDirty(ch, frame);
+				ch->row = CC_ROWS-1;
+			}
+			ch->mode = CC_MODE_ROLLUP;
+			ch->rollup_rows = arg;
+			ch->column = 0;
+			break;
+		case OP_RDC:
+			ch->mode = CC_MODE_PAINTON;
+			break;
+		case OP_TEXT:
+			ch->mode = CC_MODE_TEXT;
+			break;
+		case OP_EDM:
+			// Pending roll-up and paint-on changes are reported before the screen they were made on goes away
+			flushChannel(dec, channel);
+			memset(&ch->displayed, 0, sizeof(cc_screen));
+			emitEvent(dec, channel, frame);
+			break;
+		case OP_CR:
+			if (ch->mode == CC_MODE_ROLLUP) {
+				flushChannel(dec, channel);
+				rollUp(ch);
+				markDirty(ch, frame);
+			}
+			ch->column = 0;
+			break;
+		case OP_ENM:
+			memset(&ch->nondisplayed, 0, sizeof(cc_screen));
+			break;
+		case OP_EOC: {
+			flushChannel(dec, channel);
+			cc_screen swap;
+			memcpy(&swap, &ch->displayed, sizeof(cc_screen));
+			memcpy(&ch->displayed, &ch->nondisplayed, sizeof(cc_screen));
+			memcpy(&ch->nondisplayed, &swap, sizeof(cc_screen));
+			ch->mode = CC_MODE_POPON;
+			emitEvent(dec, channel, frame);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+// Frame of a record's first word. Overlapping records are pushed back, as they would be on air.
+static s64 entryFrame(cc_decoder* dec, const scc_entry* entry, u8 field) {
+	s64 frame = tc2int(entry->pts.tc, dec->fps);
+	if (frame <= dec->last_frame[field & 0x1]) {
+		frame = dec->last_frame[field & 0x1] + 1;
+	}
+	return frame;
+}
+
+// Decodes a single record, so streaming readers don't need the whole track in memory
+void DecodeEntry(cc_decoder* dec, const scc_entry* entry, u8 field) {
+	dec->drop = entry->pts.tc.drop;
+	s64 frame = entryFrame(dec, entry, field);
+	for (unsigned int i = 0; i < entry->entry_count; i++) {
+		DecodePair(dec, field, entry->entries[i], frame + i);
+	}
+}
+
+bool8 DecodeSCC(cc_decoder* dec, scc_entry* in, size_t* length, u8 field) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "DecodeSCC: invalid input pointer\n");
+		return false;
+	}
+	size_t read_bytes = 0;
+	u8* input_ptr = (u8*) in;
+	scc_entry* entry = (scc_entry*) input_ptr;
+	while (read_bytes < *length) {
+		DecodeEntry(dec, entry, field);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		entry = (scc_entry*) input_ptr;
+	}
+	log_write(LOG_DEBUG, use_colors, "DecodeSCC: Decoded %d bytes of Field %d data\n", (u32) *length, (field & 0x1) + 1);
+	return true;
+}
+
+// Reports pending changes, then clears whatever is still on screen one frame after the last byte pair
+void FinishDecoder(cc_decoder* dec) {
+	for (u8 field = 0; field < 2; field++) {
+		flushField(dec, field);
+		for (u8 channel = field*2; channel < (field*2)+2; channel++) {
+			cc_channel_state* ch = &dec->channels[channel];
+			if (ch->showing) {
+				memset(&ch->displayed, 0, sizeof(cc_screen));
+				emitEvent(dec, channel, dec->last_frame[field] + 1);
+			}
+		}
+	}
+}
+
+// Decodes from a checkpoint's position through the words on frames up to until
+static void replayUntil(cc_decoder_index* idx, cc_decoder_checkpoint* pos, s64 until) {
+	while (pos->offset < idx->length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) idx->track) + pos->offset);
+		// A record that was started carries on from the frame after its last decoded word
+		s64 frame = pos->index == 0 ? entryFrame(&pos->dec, entry, idx->field) : pos->dec.last_frame[idx->field] + 1 - pos->index;
+		pos->dec.drop = entry->pts.tc.drop;
+		for (; pos->index < entry->entry_count; pos->index++) {
+			if (frame + pos->index > until) {
+				return;
+			}
+			DecodePair(&pos->dec, idx->field, entry->entries[pos->index], frame + pos->index);
+		}
+		pos->offset += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		pos->index = 0;
+	}
+}
+
+// Decodes the whole track once, keeping the decoder's state every interval frames (0 for the default) of captioned material.
+// Silent stretches don't take checkpoints, so a full-day track with sparse captions stays small.
+bool8 InitDecoderIndex(cc_decoder_index* idx, const scc_entry* track, size_t length, f64 fps, u8 field, s64 interval) {
+	if (idx == NULL || track == NULL) {
+		log_write(LOG_FATAL, use_colors, "InitDecoderIndex: invalid input pointer\n");
+		return false;
+	}
+	if (interval <= 0) {
+		interval = CC_DECODER_CHECKPOINT_INTERVAL;
+	}
+	memset(idx, 0, sizeof(cc_decoder_index));
+	idx->track = track;
+	idx->length = length;
+	idx->field = field & 0x1;
+	u32 allocated = 64;
+	idx->checkpoints = malloc(sizeof(cc_decoder_checkpoint) * allocated);
+	if (idx->checkpoints == NULL) {
+		log_write(LOG_FATAL, use_colors, "InitDecoderIndex: Couldn't allocate checkpoints\n");
+		return false;
+	}
+	// Events aren't wanted when seeking, only the screens
+	InitDecoder(&idx->current.dec, fps, NULL, NULL);
+	idx->checkpoints[idx->count++] = idx->current;
+	while (idx->current.offset < length) {
+		const cc_decoder_checkpoint* last = &idx->checkpoints[idx->count-1];
+		if (idx->current.offset != last->offset && idx->current.dec.last_frame[idx->field] - last->dec.last_frame[idx->field] >= interval) {
+			if (idx->count == allocated) {
+				cc_decoder_checkpoint* _checkpoints = realloc(idx->checkpoints, sizeof(cc_decoder_checkpoint) * allocated * 2);
+				if (_checkpoints == NULL) {
+					log_write(LOG_FATAL, use_colors, "InitDecoderIndex: Couldn't reallocate checkpoints\n");
+					FreeDecoderIndex(idx);
+					return false;
+				}
+				idx->checkpoints = _checkpoints;
+				allocated *= 2;
+			}
+			idx->checkpoints[idx->count++] = idx->current;
+		}
+		// One record at a time
+		const scc_entry* entry = (const scc_entry*) (((const u8*) track) + idx->current.offset);
+		replayUntil(idx, &idx->current, entryFrame(&idx->current.dec, entry, idx->field) + entry->entry_count - 1);
+	}
+	log_write(LOG_DEBUG, use_colors, "InitDecoderIndex: %d checkpoints for %d bytes of Field %d data\n", idx->count, (u32) length, idx->field + 1);
+	idx->current = idx->checkpoints[0];
+	return true;
+}
+
+// Returns what a channel shows after every byte pair up to and including frame (in tc2int frames at the index's fps).
+// Restores the last checkpoint at or before frame, unless the previous seek already got closer, and replays the rest.
+const cc_screen* SeekDecoder(cc_decoder_index* idx, s64 frame, u8 channel) {
+	// Checkpoints loaded from a file never went through InitDecoder
+	if (!tables_ready) {
+		initTables();
+	}
+	u32 low = 0;
+	u32 high = idx->count;
+	while (high - low > 1) {
+		u32 mid = (low + high) / 2;
+		if (idx->checkpoints[mid].dec.last_frame[idx->field] <= frame) {
+			low = mid;
+		}
+		else {
+			high = mid;
+		}
+	}
+	const cc_decoder_checkpoint* checkpoint = &idx->checkpoints[low];
+	s64 current_frame = idx->current.dec.last_frame[idx->field];
+	if (current_frame > frame || current_frame < checkpoint->dec.last_frame[idx->field] || idx->current.offset < checkpoint->offset) {
+		memcpy(&idx->current, checkpoint, sizeof(cc_decoder_checkpoint));
+	}
+	replayUntil(idx, &idx->current, frame);
+	return &idx->current.dec.channels[channel & 0x3].displayed;
+}
+
+void FreeDecoderIndex(cc_decoder_index* idx) {
+	free(idx->checkpoints);
+	idx->checkpoints = NULL;
+	idx->count = 0;
+}
+
+// Unicode code point of a standard character (0x20-0x7f) or a special/extended character code, 0 for anything else
+u16 GetCCChar(u16 cc) {
+	if (!tables_ready) {
+		initTables();
+	}
+	if (cc >= 0x20 && cc < 0x80) {
+		return basic_chars[cc];
+	}
+	u8 b1 = (cc >> 8) & 0x77; // strip the channel bit
+	u8 b2 = cc & 0x7f;
+	if (b1 == 0x11 && b2 >= 0x30 && b2 < 0x40) {
+		return special_chars[b2 - 0x30];
+	}
+	if ((b1 == 0x12 || b1 == 0x13) && b2 >= 0x20 && b2 < 0x40) {
+		return extended_chars[b1 - 0x12][b2 - 0x20];
+	}
+	return 0;
+}
+
+// Writes the screen as UTF-8, one line per non-empty row. Returns the number of bytes written, excluding the terminator.
+size_t GetScreenText(const cc_screen* screen, char* out, size_t size) {
+	if (size == 0) {
+		return 0;
+	}
+	char* out_ptr = out;
+	char* end_ptr = out + size - 1;
+	for (int row = 0; row < CC_ROWS; row++) {
+		int first = 0;
+		int last = CC_COLUMNS-1;
+		while (first < CC_COLUMNS && (screen->chars[row][first] == 0 || screen->chars[row][first] == 0x20 || screen->chars[row][first] == 0xa0)) {
+			first++;
+		}
+		if (first == CC_COLUMNS) {
+			continue;
+		}
+		while (last > first && (screen->chars[row][last] == 0 || screen->chars[row][last] == 0x20 || screen->chars[row][last] == 0xa0)) {
+			last--;
+		}
+		if (out_ptr != out) {
+			if (out_ptr >= end_ptr) {
+				break;
+			}
+			*out_ptr++ = '\n';
+		}
+		for (int col = first; col <= last; col++) {
+			u16 c = screen->chars[row][col];
+			if (c == 0 || c == 0xa0) {
+				c = 0x20;
+			}
+			if (c < 0x80) {
+				if (out_ptr + 1 > end_ptr) {
+					break;
+				}
+				*out_ptr++ = (char) c;
+			}
+			else if (c < 0x800) {
+				if (out_ptr + 2 > end_ptr) {
+					break;
+				}
+				*out_ptr++ = (char) (0xc0 | (c >> 6));
+				*out_ptr++ = (char) (0x80 | (c & 0x3f));
+			}
+			else {
+				if (out_ptr + 3 > end_ptr) {
+					break;
+				}
+				*out_ptr++ = (char) (0xe0 | (c >> 12));
+				*out_ptr++ = (char) (0x80 | ((c >> 6) & 0x3f));
+				*out_ptr++ = (char) (0x80 | (c & 0x3f));
+			}
+		}
+	}
+	*out_ptr = 0;
+	return (size_t) (out_ptr - out);
+}
@@ -0,0 +1,316 @@
+/*
+edl.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include "608.h"
+#include "log.h"
+
+// Cuts a caption track to match a CMX3600 edit decision list, in one pass over the source.
+// Events have to keep the source's order (cuts, closed gaps and inserted breaks do), so every word is
+// placed as it's read. At each splice, the captions of the outgoing segment are erased and the incoming
+// segment gets the last caption mode back, since it may start in the middle of a caption.
+
+typedef struct {
+	const cc_edl_event* events;
+	size_t count;
+	size_t current; // event the source is in, or the next one
+	size_t entered; // events whose splice codes have been written
+	s64 rebase;
+	// Source state, for resuming at splices
+	bool8 seen[2]; // per data channel
+	u8 misc_b1[2]; // first byte of the channel's miscellaneous control codes, which carries the field
+	u16 mode_code[2];
+	// Output
+	s64 next_frame;
+	FILE* out;
+	u8 buffer[4096];
+	size_t buffered;
+	u32 written_bytes;
+	scc_entry* data;
+	size_t allocated;
+	size_t offset; // offset of the record being filled
+	s64 record_frame;
+	u32 nominal;
+	bool8 drop;
+	bool8 error;
+} edl_state;
+
+static bool8 parseTimecode(const char* str, u32 nominal, s64* frame) {
+	s16 hrs;
+	u8 min, sec, frames;
+	char separator;
+	if (sscanf(str, "%hd:%hhu:%hhu%c%hhu", &hrs, &min, &sec, &separator, &frames) != 5) {
+		return false;
+	}
+	timecode tc = default_timecode;
+	tc.hours = hrs;
+	tc.minutes = min;
+	tc.seconds = sec;
+	tc.frames = frames;
+	tc.drop = separator == ';' || separator == '.' || separator == ',';
+	*frame = TimecodeToFrame(tc, nominal);
+	return true;
+}
+
+// Reads the video events of a CMX3600 EDL. Returns NULL if there are none or if they reorder the source.
+cc_edl_event* ReadEDL(FILE* edl, u32 nominal, size_t* count) {
+	if (edl == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadEDL: invalid file descriptor\n");
+		return NULL;
+	}
+	size_t allocated = 64;
+	cc_edl_event* events = malloc(sizeof(cc_edl_event) * allocated);
+	if (events == NULL) {
+		log_write(LOG_FATAL, use_colors, "ReadEDL: Couldn't allocate event buffer\n");
+		return NULL;
+	}
+	*count = 0;
+	char line[512];
+	u32 line_number = 0;
+	while (fgets(line, sizeof(line), edl) != NULL) {
+		line_number++;
+		// Event lines: number, reel, track, transition (D and W have a duration after them), then source in/out and record in/out
+		char* tokens[12];
+		int token_count = 0;
+		for (char* token = strtok(line, " \t\r\n"); token != NULL && token_count < 12; token = strtok(NULL, " \t\r\n")) {
+			tokens[token_count++] = token;
+		}
+		if (token_count < 8 || !isdigit((unsigned char) tokens[0][0])) {
+			continue; // TITLE:, FCM:, comments and the like
+		}
+		if (strchr(tokens[2], 'V') == NULL && strchr(tokens[2], 'B') == NULL) {
+			continue; // audio only
+		}
+		cc_edl_event event;
+		s64 rec_out;
+		if (!parseTimecode(tokens[token_count-4], nominal, &event.src_in) || !parseTimecode(tokens[token_count-3], nominal, &event.src_out) || !parseTimecode(tokens[token_count-2], nominal, &event.rec_in) || !parseTimecode(tokens[token_count-1], nominal, &rec_out)) {
+			log_write(LOG_WARN, use_colors, "ReadEDL: line %d has an invalid timecode (ignoring)\n", line_number);
+			continue;
+		}
+		if (event.src_out <= event.src_in) {
+			continue; // cuts to black and the like carry no source material
+		}
+		if (*count == allocated) {
+			cc_edl_event* _events = realloc(events, sizeof(cc_edl_event) * allocated * 2);
+			if (_events == NULL) {
+				log_write(LOG_FATAL, use_colors, "ReadEDL: Couldn't reallocate event buffer\n");
+				free(events);
+				return NULL;
+			}
+			events = _events;
+			allocated *= 2;
+		}
+		events[(*count)++] = event;
+	}
+	if (*count == 0) {
+		log_write(LOG_ERROR, use_colors, "ReadEDL: no video events found\n");
+		free(events);
+		return NULL;
+	}
+	for (size_t i = 1; i < *count; i++) {
+		if (events[i].src_in < events[i-1].src_out || events[i].rec_in < events[i-1].rec_in + (events[i-1].src_out - events[i-1].src_in)) {
+			log_write(LOG_ERROR, use_colors, "ReadEDL: event %d goes back in the source or the record; only edits that keep the program's order are supported\n", (u32) i + 1);
+			free(events);
+			return NULL;
+		}
+	}
+	log_write(LOG_DEBUG, use_colors, "ReadEDL: %d events\n", (u32) *count);
+	return events;
+}
+
+static bool8 flushRaw(edl_state* edl) {
+	edl->written_bytes += fwrite(edl->buffer, 1, edl->buffered, edl->out);
+	edl->buffered = 0;
+	if (ferror(edl->out)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		edl->error = true;
+		return false;
+	}
+	return true;
+}
+
+static void putRawWord(edl_state* edl, u16 cc) {
+	if (edl->buffered == sizeof(edl->buffer) && !flushRaw(edl)) {
+		return;
+	}
+	edl->buffer[edl->buffered++] = (u8) (cc >> 8);
+	edl->buffer[edl->buffered++] = (u8) (cc & 0xff);
+}
+
+// Places a word on the output timeline; words that would land on a taken frame go on the next free one
+static void emitWord(edl_state* edl, u16 cc, s64 frame) {
+	if (edl->error) {
+		return;
+	}
+	frame -= edl->rebase;
+	if (frame < edl->next_frame) {
+		frame = edl->next_frame;
+	}
+	if (edl->out != NULL) {
+		for (; edl->next_frame < frame; edl->next_frame++) {
+			putRawWord(edl, fixParity(0));
+		}
+		putRawWord(edl, fixParity(cc));
+	}
+	else {
+		scc_entry* entry = (scc_entry*) (((u8*) edl->data) + edl->offset);
+		if (entry->entry_count != 0 && frame != edl->record_frame + entry->entry_count) {
+			edl->offset += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+			entry = (scc_entry*) (((u8*) edl->data) + edl->offset);
+			entry->entry_count = 0;
+		}
+		if (entry->entry_count == 0) {
+			edl->record_frame = frame;
+			entry->pts.tc = FrameToTimecode(frame, edl->nominal, edl->drop);
+		}
+		entry->entries[entry->entry_count++] = cc;
+		// Room for the next word, whether it extends this record or opens one after it
+		if (edl->allocated - edl->offset < (2 * sizeof(scc_entry)) + (sizeof(u16) * (entry->entry_count + 2)) + 0x20) {
+			scc_entry* _data = realloc(edl->data, edl->allocated * 2);
+			if (_data == NULL) {
+				log_write(LOG_FATAL, use_colors, "ApplyEDL: Couldn't reallocate output buffer\n");
+				edl->error = true;
+				return;
+			}
+			edl->data = _data;
+			edl->allocated *= 2;
+		}
+	}
+	edl->next_frame = frame + 1;
+}
+
+// Erases what the outgoing segment left on screen and in memory, then resumes each channel's mode
+static void enterEvent(edl_state* edl, size_t index) {
+	if (index == 0) {
+		return;
+	}
+	s64 frame = edl->events[index].rec_in;
+	for (u8 channel = 0; channel < 2; channel++) {
+		if (!edl->seen[channel]) {
+			continue;
+		}
+		u16 codes[3] = {(u16) ((edl->misc_b1[channel] << 8) | 0x2c), (u16) ((edl->misc_b1[channel] << 8) | 0x2e), edl->mode_code[channel]};
+		for (int i = 0; i < 3; i++) {
+			if (codes[i] != 0) {
+				emitWord(edl, codes[i], frame);
+				emitWord(edl, codes[i], frame);
+			}
+		}
+	}
+}
+
+static void trackSource(edl_state* edl, u16 cc) {
+	u8 b1 = (cc >> 8) & 0x7f;
+	u8 b2 = cc & 0x7f;
+	// Miscellaneous control codes: 0x14/0x15 for the first data channel, 0x1c/0x1d for the second
+	if ((b1 & 0x76) != 0x14 || b2 < 0x20 || b2 > 0x2f) {
+		return;
+	}
+	u8 channel = (b1 & 0x08) ? 1 : 0;
+	edl->seen[channel] = true;
+	edl->misc_b1[channel] = b1;
+	if (b2 == 0x20 || (b2 >= 0x25 && b2 <= 0x27) || b2 == 0x29 || b2 == 0x2b) {
+		edl->mode_code[channel] = cc;
+	}
+}
+
+static void feedWord(u16 cc, s64 frame, void* ctx) {
+	edl_state* edl = (edl_state*) ctx;
+	while (edl->entered < edl->count && edl->events[edl->entered].src_in <= frame) {
+		enterEvent(edl, edl->entered++);
+	}
+	while (edl->current < edl->count && frame >= edl->events[edl->current].src_out) {
+		edl->current++;
+	}
+	if (cc == 0) {
+		return;
+	}
+	if (edl->current < edl->count && frame >= edl->events[edl->current].src_in) {
+		emitWord(edl, cc, edl->events[edl->current].rec_in + (frame - edl->events[edl->current].src_in));
+	}
+	trackSource(edl, cc);
+}
+
+static void initState(edl_state* edl, const cc_edl_event* events, size_t count, s64 rebase) {
+	memset(edl, 0, sizeof(edl_state));
+	edl->events = events;
+	edl->count = count;
+	edl->rebase = rebase;
+}
+
+// Cuts an in-memory track (timecodes are SMPTE labels at the nominal rate) and returns the edited track
+scc_entry* ApplyEDL(const scc_entry* in, size_t length, const cc_edl_event* events, size_t count, u32 nominal, s64 rebase, size_t* out_length) {
+	if (in == NULL || events == NULL) {
+		log_write(LOG_FATAL, use_colors, "ApplyEDL: invalid input pointer\n");
+		return NULL;
+	}
+	edl_state edl;
+	initState(&edl, events, count, rebase);
+	edl.nominal = nominal;
+	edl.drop = length != 0 && in->pts.tc.drop;
+	edl.allocated = length + 8192;
+	edl.data = malloc(edl.allocated);
+	if (edl.data == NULL) {
+		log_write(LOG_FATAL, use_colors, "ApplyEDL: Couldn't allocate output buffer\n");
+		return NULL;
+	}
+	edl.data->entry_count = 0;
+	size_t read_bytes = 0;
+	while (read_bytes < length && !edl.error) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		s64 frame = TimecodeToFrame(entry->pts.tc, nominal);
+		for (unsigned int i = 0; i < entry->entry_count; i++) {
+			feedWord(entry->entries[i], frame + i, &edl);
+		}
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	// Splices past the end of the source still clear the screen
+	while (edl.entered < edl.count && !edl.error) {
+		enterEvent(&edl, edl.entered++);
+	}
+	if (edl.error) {
+		free(edl.data);
+		return NULL;
+	}
+	scc_entry* last = (scc_entry*) (((u8*) edl.data) + edl.offset);
+	*out_length = edl.offset + (last->entry_count != 0 ? sizeof(scc_entry) + (sizeof(u16) * last->entry_count) : 0);
+	log_write(LOG_DEBUG, use_colors, "ApplyEDL: %d events, %d bytes of input, %d bytes of output\n", (u32) count, (u32) length, (u32) *out_length);
+	return edl.data;
+}
+
+// Cuts a raw file into another while reading it; raw frames count from 0
+u32 ApplyEDLRaw(FILE* in, FILE* out, const cc_edl_event* events, size_t count, s64 rebase) {
+	if (in == NULL || out == NULL || events == NULL) {
+		log_write(LOG_ERROR, use_colors, "ApplyEDLRaw: invalid file descriptor\n");
+		return 0;
+	}
+	edl_state* edl = malloc(sizeof(edl_state));
+	if (edl == NULL) {
+		log_write(LOG_FATAL, use_colors, "ApplyEDLRaw: Couldn't allocate state\n");
+		return 0;
+	}
+	initState(edl, events, count, rebase);
+	edl->out = out;
+	u32 written_bytes = WriteRawHeader(out);
+	if (written_bytes == 0 || !StreamRaw(in, 30, default_timecode, feedWord, edl)) {
+		free(edl);
+		return written_bytes;
+	}
+	while (edl->entered < edl->count && !edl->error) {
+		enterEvent(edl, edl->entered++);
+	}
+	// Write an extra 0x8080 at the end to match WriteRaw
+	putRawWord(edl, fixParity(0));
+	flushRaw(edl);
+	written_bytes += edl->written_bytes;
+	log_write(LOG_DEBUG, use_colors, "ApplyEDLRaw: %d events, wrote %d bytes\n", (u32) count, written_bytes);
+	free(edl);
+	return written_bytes;
+}
@@ -0,0 +1,616 @@
+/*
+encoder.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h> // llround
+#include "608.h"
+#include "log.h"
+
+// Timed text (SubRip or WebVTT cues) to pop-on or roll-up byte pairs
+
+typedef struct {
+	u16 c; // Unicode code point
+	u8 attr;
+	bool8 midrow; // mid-row code, which takes up a column like a space
+} text_cell;
+
+#define MAX_LINE_CELLS 512
+#define POPON_MAX_ROWS 4
+
+// Unicode to 608 lookup, built from the decoder's character tables
+static u16 latin_codes[256];
+static struct {
+	u16 unicode;
+	u16 code;
+} other_codes[32];
+static u8 other_count = 0;
+static bool8 tables_ready = false;
+
+// Standard characters sent before each extended character, for decoders that don't know it
+static const char extended_fallback[2][32] = {
+	{
+		'A', 'E', 'O', 'U', 'U', 'u', '\'', '!', ' ', '\'', '-', 'c', ' ', '.', '"', '"',
+		'A', 'A', 'C', 'E', 'E', 'E', 'e', 'I', 'I', 'i', 'O', 'U', 'u', 'U', '"', '"'
+	},
+	{
+		'A', 'a', 'I', 'I', 'i', 'O', 'o', 'O', 'o', '[', ']', '/', ' ', '-', ' ', '-',
+		'A', 'a', 'O', 'o', 's', 'Y', ' ', ' ', 'A', 'a', 'O', 'o', '+', '+', '+', '+'
+	}
+};
+
+// PAC index (see pac_rows in decoder.c) for each row
+static const u8 pac_index[CC_ROWS] = {2, 3, 4, 5, 10, 11, 12, 13, 14, 15, 0, 6, 7, 8, 9};
+
+static void addCode(u16 unicode, u16 code) {
+	if (unicode < 0x100) {
+		if (latin_codes[unicode] == 0) {
+			latin_codes[unicode] = code;
+		}
+		return;
+	}
+	for (u8 i = 0; i < other_count; i++) {
+		if (other_codes[i].unicode == unicode) {
+			return;
+		}
+	}
+	if (other_count < 32) {
+		other_codes[other_count].unicode = unicode;
+		other_codes[other_count].code = code;
+		other_count++;
+	}
+}
+
+static void initTables() {
+	// Standard characters are preferred, then special, then extended
+	for (u16 cc = 0x20; cc < 0x80; cc++) {
+		addCode(GetCCChar(cc), cc);
+	}
+	for (u16 cc = 0x1130; cc < 0x1140; cc++) {
+		addCode(GetCCChar(cc), cc);
+	}
+	for (u16 cc = 0x1220; cc < 0x1240; cc++) {
+		addCode(GetCCChar(cc), cc);
+	}
+	for (u16 cc = 0x1320; cc < 0x1340; cc++) {
+		addCode(GetCCChar(cc), cc);
+	}
+	tables_ready = true;
+}
+
+static u16 lookupCode(u32 c) {
+	if (c < 0x100) {
+		if (latin_codes[c] != 0) {
+			return latin_codes[c];
+		}
+	}
+	else {
+		for (u8 i = 0; i < other_count; i++) {
+			if (other_codes[i].unicode == c) {
+				return other_codes[i].code;
+			}
+		}
+	}
+	switch (c) {
+		case 0x2019: // right single quote
+			return 0x27;
+		case 0x2013: // en dash
+			return 0x2d;
+		default:
+			log_write(LOG_TRACE, use_colors, "EncodeCue: no 608 character for U+%04x\n", c);
+			return 0x3f;
+	}
+}
+
+// Applies the channel bit, and the Field 2 first byte of the miscellaneous control codes
+static u16 controlCode(const cc_encoder* enc, u16 code) {
+	u8 b1 = (u8) (code >> 8);
+	u8 b2 = (u8) (code & 0x7f);
+	// PACs for rows 14 and 15 share the 0x14 first byte, and keep it on Field 2
+	if (b1 == 0x14 && b2 >= 0x20 && b2 <= 0x2f && (enc->channel & 0x2)) {
+		b1 = 0x15;
+	}
+	if (enc->channel & 0x1) {
+		b1 |= 0x08;
+	}
+	return (u16) ((b1 << 8) | (code & 0xff));
+}
+
+static u16 pacCode(u8 row, u8 low) {
+	u8 i = pac_index[row];
+	return (u16) (((0x10 | (i >> 1)) << 8) | 0x40 | ((i & 0x1) << 5) | low);
+}
+
+typedef struct {
+	cc_encoder* enc;
+	unsigned int count;
+	u8 pending; // standard character waiting for the second half of its pair, 0 if none
+	bool8 overflow;
+} word_builder;
+
+static void addWord(word_builder* b, u16 word) {
+	if (b->count < CC_ENCODER_MAX_WORDS) {
+		b->enc->words[b->count++] = word;
+	}
+	else {
+		b->overflow = true;
+	}
+}
+
+static void flushChar(word_builder* b) {
+	if (b->pending != 0) {
+		addWord(b, (u16) (b->pending << 8));
+		b->pending = 0;
+	}
+}
+
+static void addChar(word_builder* b, u8 c) {
+	if (b->pending != 0) {
+		addWord(b, (u16) ((b->pending << 8) | c));
+		b->pending = 0;
+	}
+	else {
+		b->pending = c;
+	}
+}
+
+// Control codes are always sent twice
+static void addControl(word_builder* b, u16 code) {
+	flushChar(b);
+	u16 word = controlCode(b->enc, code);
+	addWord(b, word);
+	addWord(b, word);
+}
+
+static void emitChar(word_builder* b, u16 c) {
+	u16 code = lookupCode(c);
+	if (code < 0x80) {
+		addChar(b, (u8) code);
+	}
+	else if ((code >> 8) == 0x11) {
+		addControl(b, code);
+	}
+	else {
+		addChar(b, (u8) extended_fallback[(code >> 8) - 0x12][(code & 0xff) - 0x20]);
+		addControl(b, code);
+	}
+}
+
+static void emitRow(word_builder* b, const text_cell* cells, unsigned int count, u8 row) {
+	unsigned int col = b->enc->center ? (CC_COLUMNS - count) / 2 : 0;
+	u8 attr = cells[0].attr;
+	u8 underline = (attr & CC_ATTR_UNDERLINE) ? 1 : 0;
+	if ((attr & CC_ATTR_ITALICS) && col == 0) {
+		addControl(b, pacCode(row, (u8) (0x0e | underline)));
+	}
+	else {
+		// Italics can't be combined with an indent, so a mid-row code goes in the column before the text
+		unsigned int pac_col = (attr & CC_ATTR_ITALICS) ? col - 1 : col;
+		addControl(b, pacCode(row, (u8) (0x10 | ((pac_col / 4) << 1) | underline)));
+		if (pac_col % 4 != 0) {
+			addControl(b, (u16) (0x1720 + (pac_col % 4)));
+		}
+		if (attr & CC_ATTR_ITALICS) {
+			addControl(b, (u16) (0x112e | underline));
+		}
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		if (cells[i].midrow) {
+			addControl(b, (u16) (0x1120 | ((cells[i].attr & CC_ATTR_ITALICS) ? 0x0e : 0) | ((cells[i].attr & CC_ATTR_UNDERLINE) ? 1 : 0)));
+		}
+		else {
+			emitChar(b, cells[i].c);
+		}
+	}
+}
+
+// Attribute changes become mid-row codes, taking the place of a neighbouring space where there is one
+static void addCell(text_cell* cells, unsigned int* count, u16 c, u8 attr) {
+	if (*count > 0 && attr != cells[*count-1].attr) {
+		text_cell* last = &cells[*count-1];
+		if (c == ' ') {
+			last = &cells[(*count)++];
+			last->c = ' ';
+		}
+		else if (last->c == ' ' && !last->midrow) {
+			last->attr = attr;
+			last->midrow = true;
+			last = NULL;
+		}
+		else {
+			last = &cells[(*count)++];
+			last->c = ' ';
+		}
+		if (last != NULL) {
+			last->attr = attr;
+			last->midrow = true;
+		}
+		if (c == ' ') {
+			return;
+		}
+	}
+	cells[*count].c = c;
+	cells[*count].attr = attr;
+	cells[*count].midrow = false;
+	(*count)++;
+}
+
+// Converts one line of cue text into cells, following <i> and <u> tags and dropping the rest. Returns the number of cells.
+static unsigned int buildCells(const char* text, const char* end, u8* attr, text_cell* cells) {
+	static const struct {
+		const char* name;
+		u8 length;
+		char c;
+	} entities[] = {
+		{"&amp;", 5, '&'}, {"&lt;", 4, '<'}, {"&gt;", 4, '>'}, {"&quot;", 6, '"'}, {"&apos;", 6, '\''}
+	};
+	unsigned int count = 0;
+	const char* ptr = text;
+	while (ptr < end && count < MAX_LINE_CELLS - 2) {
+		u32 c = (u8) *ptr;
+		if (c == '<') {
+			const char* close = memchr(ptr, '>', (size_t) (end - ptr));
+			if (close != NULL) {
+				bool8 closing = ptr[1] == '/';
+				const char* tag = ptr + (closing ? 2 : 1);
+				u8 bit = 0;
+				if (tag[1] == '>' || tag[1] == '.' || tag[1] == ' ') {
+					bit = tag[0] == 'i' ? CC_ATTR_ITALICS : tag[0] == 'u' ? CC_ATTR_UNDERLINE : 0;
+				}
+				*attr = (u8) (closing ? (*attr & ~bit) : (*attr | bit));
+				ptr = close + 1;
+				continue;
+			}
+		}
+		if (c == '&') {
+			bool8 found = false;
+			for (unsigned int i = 0; i < sizeof(entities) / sizeof(entities[0]); i++) {
+				if ((size_t) (end - ptr) >= entities[i].length && strncmp(ptr, entities[i].name, entities[i].length) == 0) {
+					addCell(cells, &count, (u16) entities[i].c, *attr);
+					ptr += entities[i].length;
+					found = true;
+					break;
+				}
+			}
+			if (!found && (size_t) (end - ptr) >= 6 && strncmp(ptr, "&nbsp;", 6) == 0) {
+				addCell(cells, &count, 0xa0, *attr);
+				ptr += 6;
+				found = true;
+			}
+			if (found) {
+				continue;
+			}
+		}
+		// UTF-8
+		unsigned int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+		if (extra != 0) {
+			c &= 0x3f >> extra;
+		}
+		ptr++;
+		for (unsigned int i = 0; i < extra && ptr < end; i++, ptr++) {
+			c = (c << 6) | ((u8) *ptr & 0x3f);
+		}
+		if (c == '\r' || c == '\t') {
+			c = ' ';
+		}
+		addCell(cells, &count, (u16) (c > 0xffff ? 0x3f : c), *attr);
+	}
+	return count;
+}
+
+// Greedy word wrap to 32 columns. Returns the new row count.
+static unsigned int wrapCells(const text_cell* cells, unsigned int count, text_cell rows[][CC_COLUMNS], u8* lengths, unsigned int row_count, unsigned int max_rows) {
+	unsigned int pos = 0;
+	while (pos < count) {
+		// Spaces at a break are dropped; a mid-row code there is covered by the next row's PAC
+		while (pos < count && cells[pos].c == ' ') {
+			pos++;
+		}
+		if (pos == count) {
+			break;
+		}
+		if (row_count == max_rows) {
+			log_write(LOG_WARN, use_colors, "EncodeCue: cue text doesn't fit in %d rows (truncating)\n", max_rows);
+			break;
+		}
+		unsigned int end = pos + CC_COLUMNS;
+		if (end >= count) {
+			end = count;
+		}
+		else {
+			unsigned int brk = end;
+			while (brk > pos && cells[brk].c != ' ') {
+				brk--;
+			}
+			if (brk > pos) {
+				end = brk;
+			}
+		}
+		unsigned int last = end;
+		while (last > pos && cells[last-1].c == ' ') {
+			last--;
+		}
+		memcpy(rows[row_count], &cells[pos], sizeof(text_cell) * (last - pos));
+		lengths[row_count] = (u8) (last - pos);
+		row_count++;
+		pos = end;
+	}
+	return row_count;
+}
+
+static bool8 appendRecord(cc_encoder* enc, s64 frame, const u16* words, unsigned int count) {
+	size_t size = sizeof(scc_entry) + (sizeof(u16) * count);
+	if (enc->allocated - enc->offset < size) {
+		size_t allocated = enc->allocated * 2 > enc->offset + size ? enc->allocated * 2 : enc->offset + size;
+		scc_entry* data = realloc(enc->data, allocated);
+		if (data == NULL) {
+			log_write(LOG_FATAL, use_colors, "EncodeCue: Couldn't reallocate output buffer\n");
+			return false;
+		}
+		enc->data = data;
+		enc->allocated = allocated;
+	}
+	scc_entry* entry = (scc_entry*) (((u8*) enc->data) + enc->offset);
+	entry->pts.tc = int2tc(frame, enc->fps, enc->drop);
+	entry->entry_count = count;
+	memcpy(entry->entries, words, sizeof(u16) * count);
+	enc->offset += size;
+	enc->next_frame = frame + count;
+	return true;
+}
+
+static bool8 appendClear(cc_encoder* enc) {
+	enc->clear_pending = false;
+	u16 edm = controlCode(enc, 0x142c);
+	u16 words[2] = {edm, edm};
+	return appendRecord(enc, enc->clear_frame > enc->next_frame ? enc->clear_frame : enc->next_frame, words, 2);
+}
+
+bool8 InitEncoder(cc_encoder* enc, u8 mode, u8 channel, u8 rollup_rows, bool8 center, f64 fps, bool8 drop) {
+	if (mode != CC_MODE_POPON && mode != CC_MODE_ROLLUP) {
+		log_write(LOG_ERROR, use_colors, "InitEncoder: only pop-on and roll-up captions can be encoded\n");
+		return false;
+	}
+	if (!tables_ready) {
+		initTables();
+	}
+	memset(enc, 0, sizeof(cc_encoder));
+	enc->mode = mode;
+	enc->channel = channel & 0x3;
+	enc->rollup_rows = rollup_rows < 2 ? 2 : rollup_rows > 4 ? 4 : rollup_rows;
+	enc->center = center;
+	enc->fps = fps;
+	enc->drop = drop;
+	enc->allocated = 8192;
+	enc->data = malloc(enc->allocated);
+	if (enc->data == NULL) {
+		log_write(LOG_FATAL, use_colors, "InitEncoder: Memory allocation for output data failed\n");
+		return false;
+	}
+	return true;
+}
+
+// Encodes one cue. Cues have to be passed in order; the caption is shown at start_ms and cleared at end_ms unless the next cue replaces it first.
+bool8 EncodeCue(cc_encoder* enc, s64 start_ms, s64 end_ms, const char* text) {
+	text_cell cells[MAX_LINE_CELLS];
+	text_cell rows[CC_ROWS][CC_COLUMNS];
+	u8 lengths[CC_ROWS];
+	unsigned int row_count = 0;
+	unsigned int max_rows = enc->mode == CC_MODE_POPON ? POPON_MAX_ROWS : CC_ROWS;
+	u8 attr = 0;
+	f64 started = TraceStart();
+	const char* line = text;
+	while (*line != 0) {
+		const char* eol = strchr(line, '\n');
+		if (eol == NULL) {
+			eol = line + strlen(line);
+		}
+		unsigned int count = buildCells(line, eol, &attr, cells);
+		row_count = wrapCells(cells, count, rows, lengths, row_count, max_rows);
+		line = *eol != 0 ? eol + 1 : eol;
+	}
+	if (row_count == 0) {
+		return true;
+	}
+	s64 start_frame = llround((f64) start_ms * enc->fps / 1000.0f);
+	s64 end_frame = llround((f64) end_ms * enc->fps / 1000.0f);
+	if (end_frame <= start_frame) {
+		end_frame = start_frame + 1;
+	}
+	word_builder b = {enc, 0, 0, false};
+	unsigned int show_index = 0; // word that puts the caption on screen
+	if (enc->mode == CC_MODE_POPON) {
+		addControl(&b, 0x1420); // RCL
+		addControl(&b, 0x142e); // ENM
+		for (unsigned int r = 0; r < row_count; r++) {
+			emitRow(&b, rows[r], lengths[r], (u8) (CC_ROWS - row_count + r));
+		}
+		flushChar(&b);
+		show_index = b.count;
+		addControl(&b, 0x142f); // EOC
+	}
+	else {
+		addControl(&b, (u16) (0x1425 + enc->rollup_rows - 2)); // RU2-RU4
+		show_index = b.count;
+		for (unsigned int r = 0; r < row_count; r++) {
+			addControl(&b, 0x142d); // CR
+			emitRow(&b, rows[r], lengths[r], CC_ROWS-1);
+		}
+		flushChar(&b);
+	}
+	if (b.overflow) {
+		log_write(LOG_ERROR, use_colors, "EncodeCue: cue %d is too long to encode\n", enc->cue_count + 1);
+		return false;
+	}
+	s64 frame = start_frame - show_index;
+	// The previous caption is cleared, unless this one replaces it before the clear could be sent
+	if (enc->clear_pending) {
+		s64 clear_frame = enc->clear_frame > enc->next_frame ? enc->clear_frame : enc->next_frame;
+		if (frame >= clear_frame + 2) {
+			if (!appendClear(enc)) {
+				return false;
+			}
+		}
+		enc->clear_pending = false;
+	}
+	if (frame < enc->next_frame) {
+		log_write(LOG_DEBUG, use_colors, "EncodeCue: cue %d is %d frames late (not enough bandwidth)\n", enc->cue_count + 1, (s32) (enc->next_frame - frame));
+		frame = enc->next_frame;
+	}
+	if (!appendRecord(enc, frame, enc->words, b.count)) {
+		return false;
+	}
+	enc->clear_pending = true;
+	enc->clear_frame = end_frame;
+	enc->cue_count++;
+	TraceSpan("encode", started);
+	return true;
+}
+
+scc_entry* FinishEncoder(cc_encoder* enc, size_t* length) {
+	if (enc->clear_pending && !appendClear(enc)) {
+		free(enc->data);
+		enc->data = NULL;
+		return NULL;
+	}
+	log_write(LOG_DEBUG, use_colors, "FinishEncoder: Encoded %d cues into %d bytes\n", enc->cue_count, (u32) enc->offset);
+	*length = enc->offset;
+	scc_entry* out = enc->data;
+	enc->data = NULL;
+	return out;
+}
+
+// Parses an SRT or WebVTT timestamp (hh:mm:ss,mmm, hh:mm:ss.mmm or mm:ss.mmm)
+static bool8 parseCueTime(const char* s, s64* ms) {
+	while (*s == ' ' || *s == '\t') {
+		s++;
+	}
+	s64 groups[3];
+	int group_count = 0;
+	while (group_count < 3) {
+		if (*s < '0' || *s > '9') {
+			return false;
+		}
+		s64 value = 0;
+		while (*s >= '0' && *s <= '9') {
+			value = (value * 10) + (*s++ - '0');
+		}
+		groups[group_count++] = value;
+		if (*s != ':') {
+			break;
+		}
+		s++;
+	}
+	if (group_count < 2 || (*s != '.' && *s != ',')) {
+		return false;
+	}
+	s++;
+	s64 fraction = 0;
+	int digits = 0;
+	while (*s >= '0' && *s <= '9' && digits < 3) {
+		fraction = (fraction * 10) + (*s++ - '0');
+		digits++;
+	}
+	for (; digits < 3; digits++) {
+		fraction *= 10;
+	}
+	s64 seconds = group_count == 3 ? (groups[0] * 3600) + (groups[1] * 60) + groups[2] : (groups[0] * 60) + groups[1];
+	*ms = (seconds * 1000) + fraction;
+	return true;
+}
+
+scc_entry* EncodeTextFile(FILE* in, size_t* length, u8 mode, u8 channel, u8 rollup_rows, bool8 center, f64 fps, bool8 drop) {
+	if (in == NULL) {
+		log_write(LOG_ERROR, use_colors, "EncodeTextFile: invalid file descriptor\n");
+		return NULL;
+	}
+	// Subtitle files are small, so the whole file is read and cues are parsed in place
+	size_t allocated = 65536;
+	size_t size = 0;
+	char* buffer = malloc(allocated);
+	if (buffer == NULL) {
+		log_write(LOG_FATAL, use_colors, "EncodeTextFile: couldn't allocate read buffer\n");
+		return NULL;
+	}
+	while (1) {
+		size += fread(buffer + size, 1, allocated - size - 1, in);
+		if (size < allocated - 1) {
+			break;
+		}
+		char* _buffer = realloc(buffer, allocated * 2);
+		if (_buffer == NULL) {
+			log_write(LOG_FATAL, use_colors, "EncodeTextFile: couldn't reallocate read buffer\n");
+			free(buffer);
+			return NULL;
+		}
+		buffer = _buffer;
+		allocated *= 2;
+	}
+	if (ferror(in)) {
+		log_write(LOG_ERROR, use_colors, "EncodeTextFile: Error reading file (%d: %s)\n", errno, strerror(errno));
+		free(buffer);
+		return NULL;
+	}
+	buffer[size] = 0;
+	cc_encoder* enc = malloc(sizeof(cc_encoder));
+	if (enc == NULL || !InitEncoder(enc, mode, channel, rollup_rows, center, fps, drop)) {
+		free(enc);
+		free(buffer);
+		return NULL;
+	}
+	char* ptr = buffer;
+	if (strncmp(ptr, "\xef\xbb\xbf", 3) == 0) {
+		ptr += 3;
+	}
+	// Every cue has a timing line; cue numbers, the WEBVTT header, and NOTE and STYLE blocks are skipped over
+	char* arrow;
+	while ((arrow = strstr(ptr, "-->")) != NULL) {
+		char* line_start = arrow;
+		while (line_start > ptr && line_start[-1] != '\n') {
+			line_start--;
+		}
+		s64 start_ms;
+		s64 end_ms;
+		char* text = strchr(arrow, '\n');
+		if (!parseCueTime(line_start, &start_ms) || !parseCueTime(arrow + 3, &end_ms)) {
+			log_write(LOG_WARN, use_colors, "EncodeTextFile: Malformed cue timing (ignoring)\n");
+			ptr = arrow + 3;
+			continue;
+		}
+		if (text == NULL) {
+			break;
+		}
+		text++;
+		// Cue text runs up to the next blank line
+		char* text_end = text;
+		while (*text_end != 0 && *text_end != '\n' && !(text_end[0] == '\r' && text_end[1] == '\n')) {
+			char* eol = strchr(text_end, '\n');
+			text_end = eol != NULL ? eol + 1 : text_end + strlen(text_end);
+		}
+		char* next = text_end;
+		while (text_end > text && (text_end[-1] == '\n' || text_end[-1] == '\r')) {
+			text_end--;
+		}
+		char saved = *text_end;
+		*text_end = 0;
+		bool8 ok = EncodeCue(enc, start_ms, end_ms, text);
+		*text_end = saved;
+		if (!ok) {
+			free(enc->data);
+			free(enc);
+			free(buffer);
+			return NULL;
+		}
+		ptr = next;
+	}
+	free(buffer);
+	scc_entry* out = FinishEncoder(enc, length);
+	free(enc);
+	return out;
+}
@@ -0,0 +1,349 @@
+/*
+export.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h> // llround
+#include "608.h"
+#include "log.h"
+
+// SubRip, WebVTT and TTML output of decoded captions
+
+static const char* const vtt_header = "WEBVTT\n\n";
+static const char* const ttml_header =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<tt xmlns=\"http://www.w3.org/ns/ttml\" xml:lang=\"en\">\n"
+	"  <body>\n"
+	"    <div>\n";
+static const char* const ttml_footer =
+	"    </div>\n"
+	"  </body>\n"
+	"</tt>\n";
+
+s64 Frame2MS(s64 frame, f64 fps) {
+	return llround((f64) frame * 1000.0f / fps);
+}
+
+static size_t formatTime(char* out, size_t size, s64 ms, char separator) {
+	if (ms < 0) {
+		ms = 0;
+	}
+	int written = snprintf(out, size, "%02d:%02d:%02d%c%03d", (int) (ms / 3600000), (int) ((ms / 60000) % 60), (int) ((ms / 1000) % 60), separator, (int) (ms % 1000));
+	return written < 0 ? 0 : (size_t) written;
+}
+
+// Copies text, escaping markup characters and turning newlines into line breaks as the format needs
+static size_t formatText(char* out, size_t size, u8 format, const char* text) {
+	char* out_ptr = out;
+	char* end_ptr = out + size - 1;
+	for (const char* i = text; *i != 0; i++) {
+		const char* rep = NULL;
+		char c[2] = {*i, 0};
+		if (format != CC_EXPORT_SRT && *i == '&') {
+			rep = "&amp;";
+		}
+		else if (format != CC_EXPORT_SRT && *i == '<') {
+			rep = "&lt;";
+		}
+		else if (format != CC_EXPORT_SRT && *i == '>') {
+			rep = "&gt;";
+		}
+		else if (format == CC_EXPORT_TTML && *i == '\n') {
+			rep = "<br/>";
+		}
+		else {
+			rep = c;
+		}
+		size_t rep_length = strlen(rep);
+		if (out_ptr + rep_length > end_ptr) {
+			break;
+		}
+		memcpy(out_ptr, rep, rep_length);
+		out_ptr += rep_length;
+	}
+	*out_ptr = 0;
+	return (size_t) (out_ptr - out);
+}
+
+// Writes a single cue to out. Returns the number of bytes written, excluding the terminator.
+size_t FormatCue(char* out, size_t size, u8 format, u32 index, s64 start_ms, s64 end_ms, const char* text) {
+	char start[16];
+	char end[16];
+	formatTime(start, sizeof(start), start_ms, format == CC_EXPORT_SRT ? ',' : '.');
+	formatTime(end, sizeof(end), end_ms, format == CC_EXPORT_SRT ? ',' : '.');
+	int written = 0;
+	switch (format) {
+		case CC_EXPORT_SRT:
+			written = snprintf(out, size, "%u\n%s --> %s\n", index, start, end);
+			break;
+		case CC_EXPORT_VTT:
+			written = snprintf(out, size, "%s --> %s\n", start, end);
+			break;
+		case CC_EXPORT_TTML:
+			written = snprintf(out, size, "      <p begin=\"%s\" end=\"%s\">", start, end);
+			break;
+		default:
+			log_write(LOG_ERROR, use_colors, "FormatCue: unknown format %hhu\n", format);
+			return 0;
+	}
+	if (written < 0 || (size_t) written >= size) {
+		return 0;
+	}
+	size_t length = (size_t) written;
+	length += formatText(out + length, size - length, format, text);
+	const char* tail = format == CC_EXPORT_TTML ? "</p>\n" : "\n\n";
+	if (length + strlen(tail) >= size) {
+		return 0;
+	}
+	strcpy(out + length, tail);
+	return length + strlen(tail);
+}
+
+static void writeCue(cc_exporter* exp, s64 end_frame) {
+	exp->open = false;
+	if (end_frame <= exp->start_frame) {
+		return;
+	}
+	exp->cue_count++;
+	size_t length = FormatCue(exp->buffer, CC_EXPORT_BUFFER_SIZE, exp->format, exp->cue_count, Frame2MS(exp->start_frame, exp->fps), Frame2MS(end_frame, exp->fps), exp->text);
+	exp->written_bytes += fwrite(exp->buffer, 1, length, exp->out);
+	if (ferror(exp->out)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	}
+}
+
+bool8 InitExporter(cc_exporter* exp, FILE* out, u8 format, u8 channel, f64 fps) {
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "InitExporter: invalid file descriptor\n");
+		return false;
+	}
+	if (format > CC_EXPORT_TTML) {
+		log_write(LOG_ERROR, use_colors, "InitExporter: unknown format %hhu\n", format);
+		return false;
+	}
+	memset(exp, 0, sizeof(cc_exporter));
+	exp->out = out;
+	exp->format = format;
+	exp->channel = channel & 0x3;
+	exp->fps = fps;
+	const char* header = format == CC_EXPORT_VTT ? vtt_header : format == CC_EXPORT_TTML ? ttml_header : "";
+	exp->written_bytes = fwrite(header, 1, strlen(header), out);
+	if (ferror(out)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+// Decoder callback; ctx is the cc_exporter
+void ExportEvent(const cc_caption_event* event, void* ctx) {
+	cc_exporter* exp = (cc_exporter*) ctx;
+	if (event->channel != exp->channel) {
+		return;
+	}
+	if (exp->open) {
+		writeCue(exp, event->frame);
+	}
+	if (event->type == CC_EVENT_DISPLAY) {
+		GetScreenText(event->screen, exp->text, CC_EXPORT_TEXT_SIZE);
+		exp->start_frame = event->frame;
+		exp->open = true;
+	}
+}
+
+// Writes the footer. The decoder should be finished first, so the last caption has been cleared.
+u32 FinishExporter(cc_exporter* exp) {
+	if (exp->open) {
+		writeCue(exp, exp->start_frame + 1);
+	}
+	if (exp->format == CC_EXPORT_TTML) {
+		exp->written_bytes += fwrite(ttml_footer, 1, strlen(ttml_footer), exp->out);
+		if (ferror(exp->out)) {
+			log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		}
+	}
+	log_write(LOG_DEBUG, use_colors, "FinishExporter: Wrote %d cues in %d bytes\n", exp->cue_count, exp->written_bytes);
+	return exp->written_bytes;
+}
+
+u32 ExportCaptions(scc_entry* in, size_t* length, FILE* out, u8 format, u8 channel, f64 fps) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "ExportCaptions: invalid input pointer\n");
+		return 0;
+	}
+	cc_exporter* exp = malloc(sizeof(cc_exporter));
+	if (exp == NULL) {
+		log_write(LOG_FATAL, use_colors, "ExportCaptions: Couldn't allocate exporter\n");
+		return 0;
+	}
+	if (!InitExporter(exp, out, format, channel, fps)) {
+		free(exp);
+		return 0;
+	}
+	cc_decoder dec;
+	InitDecoder(&dec, fps, ExportEvent, exp);
+	DecodeSCC(&dec, in, length, (channel >> 1) & 0x1);
+	FinishDecoder(&dec);
+	u32 written_bytes = FinishExporter(exp);
+	free(exp);
+	return written_bytes;
+}
+
+// HLS WebVTT segments. Cues are written in time order, so each segment is finished before the next one is opened.
+
+static bool8 openSegment(cc_hls_segmenter* seg) {
+	snprintf(seg->buffer, CC_EXPORT_BUFFER_SIZE, "%s%u.vtt", seg->prefix, seg->segment_index);
+	seg->segment = fopen(seg->buffer, "w");
+	if (seg->segment == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", seg->buffer, errno, strerror(errno));
+		return false;
+	}
+	fprintf(seg->segment, "WEBVTT\nX-TIMESTAMP-MAP=MPEGTS:%llu,LOCAL:00:00:00.000\n\n", (unsigned long long) seg->mpegts);
+	// The playlist sits next to the segments, so it names them without the directory
+	const char* name = strrchr(seg->prefix, '/');
+	name = name != NULL ? name + 1 : seg->prefix;
+	fprintf(seg->playlist, "#EXTINF:%.3f,\n%s%u.vtt\n", (f64) seg->segment_ms / 1000.0f, name, seg->segment_index);
+	return true;
+}
+
+static void closeSegment(cc_hls_segmenter* seg) {
+	if (seg->segment == NULL) {
+		return;
+	}
+	if (ferror(seg->segment)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	}
+	fclose(seg->segment);
+	seg->segment = NULL;
+}
+
+// Writes empty segments up to segment index, then leaves it open
+static bool8 seekSegment(cc_hls_segmenter* seg, u32 index) {
+	while (seg->segment_index < index) {
+		closeSegment(seg);
+		seg->segment_index++;
+		if (!openSegment(seg)) {
+			return false;
+		}
+	}
+	return seg->segment != NULL;
+}
+
+// Writes the cue into every segment it overlaps, cut at the segment boundaries
+static void writeSegmentedCue(cc_hls_segmenter* seg, s64 start_ms, s64 end_ms) {
+	seg->open = false;
+	if (start_ms < 0) {
+		start_ms = 0;
+	}
+	while (start_ms < end_ms) {
+		u32 index = (u32) (start_ms / seg->segment_ms);
+		if (!seekSegment(seg, index)) {
+			return;
+		}
+		s64 piece_end = ((s64) index + 1) * seg->segment_ms;
+		if (piece_end > end_ms) {
+			piece_end = end_ms;
+		}
+		size_t length = FormatCue(seg->buffer, CC_EXPORT_BUFFER_SIZE, CC_EXPORT_VTT, 0, start_ms, piece_end, seg->text);
+		fwrite(seg->buffer, 1, length, seg->segment);
+		seg->cue_count++;
+		start_ms = piece_end;
+	}
+}
+
+bool8 InitHLSSegmenter(cc_hls_segmenter* seg, const char* prefix, u8 channel, f64 fps, timecode start, f64 segment_duration, u64 mpegts) {
+	if (prefix == NULL) {
+		log_write(LOG_ERROR, use_colors, "InitHLSSegmenter: invalid output prefix\n");
+		return false;
+	}
+	s64 segment_ms = llround(segment_duration * 1000.0f);
+	if (segment_ms <= 0) {
+		log_write(LOG_ERROR, use_colors, "InitHLSSegmenter: invalid segment duration %f\n", segment_duration);
+		return false;
+	}
+	memset(seg, 0, sizeof(cc_hls_segmenter));
+	seg->prefix = prefix;
+	seg->channel = channel & 0x3;
+	seg->fps = fps;
+	seg->start_frame = tc2int(start, fps);
+	seg->segment_ms = segment_ms;
+	seg->mpegts = mpegts;
+	snprintf(seg->buffer, CC_EXPORT_BUFFER_SIZE, "%s.m3u8", prefix);
+	seg->playlist = fopen(seg->buffer, "w");
+	if (seg->playlist == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", seg->buffer, errno, strerror(errno));
+		return false;
+	}
+	fprintf(seg->playlist, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:%d\n#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n", (int) ((segment_ms + 999) / 1000));
+	if (!openSegment(seg)) {
+		fclose(seg->playlist);
+		seg->playlist = NULL;
+		return false;
+	}
+	return true;
+}
+
+// Decoder callback; ctx is the cc_hls_segmenter
+void SegmentHLSEvent(const cc_caption_event* event, void* ctx) {
+	cc_hls_segmenter* seg = (cc_hls_segmenter*) ctx;
+	if (event->channel != seg->channel || seg->playlist == NULL) {
+		return;
+	}
+	s64 ms = Frame2MS(event->frame - seg->start_frame, seg->fps);
+	if (seg->open) {
+		writeSegmentedCue(seg, seg->cue_start_ms, ms);
+	}
+	if (event->type == CC_EVENT_DISPLAY) {
+		GetScreenText(event->screen, seg->text, CC_EXPORT_TEXT_SIZE);
+		seg->cue_start_ms = ms;
+		seg->open = true;
+	}
+}
+
+// Closes the last segment and the playlist. Returns the number of segments written.
+u32 FinishHLSSegmenter(cc_hls_segmenter* seg) {
+	if (seg->playlist == NULL) {
+		return 0;
+	}
+	if (seg->open) {
+		writeSegmentedCue(seg, seg->cue_start_ms, seg->cue_start_ms + Frame2MS(1, seg->fps));
+	}
+	closeSegment(seg);
+	fprintf(seg->playlist, "#EXT-X-ENDLIST\n");
+	if (ferror(seg->playlist)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	}
+	fclose(seg->playlist);
+	seg->playlist = NULL;
+	log_write(LOG_DEBUG, use_colors, "FinishHLSSegmenter: Wrote %d cue pieces in %d segments\n", seg->cue_count, seg->segment_index + 1);
+	return seg->segment_index + 1;
+}
+
+u32 SegmentHLS(scc_entry* in, size_t* length, const char* prefix, u8 channel, f64 fps, timecode start, f64 segment_duration, u64 mpegts) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "SegmentHLS: invalid input pointer\n");
+		return 0;
+	}
+	cc_hls_segmenter* seg = malloc(sizeof(cc_hls_segmenter));
+	if (seg == NULL) {
+		log_write(LOG_FATAL, use_colors, "SegmentHLS: Couldn't allocate segmenter\n");
+		return 0;
+	}
+	if (!InitHLSSegmenter(seg, prefix, channel, fps, start, segment_duration, mpegts)) {
+		free(seg);
+		return 0;
+	}
+	cc_decoder dec;
+	InitDecoder(&dec, fps, SegmentHLSEvent, seg);
+	DecodeSCC(&dec, in, length, (channel >> 1) & 0x1);
+	FinishDecoder(&dec);
+	u32 segment_count = FinishHLSSegmenter(seg);
+	free(seg);
+	return segment_count;
+}
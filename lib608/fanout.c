@@ -0,0 +1,100 @@
+/*
+fanout.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Writes one track to several outputs in a single pass over its records, so a parse can serve every deliverable.
+// Each output comes out as its own writer would make it. The stats counters add up across the outputs.
+
+static void startOutput(cc_fanout_output* output, const size_t* length, f64 fps, timecode start, timecode end) {
+	output->written_bytes = 0;
+	output->failed = false;
+	if (output->out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteFanOut: invalid file descriptor\n");
+		output->failed = true;
+		return;
+	}
+	switch (output->format) {
+		case CC_FORMAT_RAW:
+			output->failed = !InitRawWriterIO(&output->raw, output->out, fps, start, end);
+			output->written_bytes = output->raw.written_bytes;
+			break;
+		case CC_FORMAT_SCC:
+			output->written_bytes = WriteSCCHeaderIO(output->out);
+			output->failed = output->written_bytes == 0;
+			break;
+		case CC_FORMAT_NW4R:
+			output->written_bytes = WriteNW4RHeaderIO(output->out, output->field, output->swap, *length);
+			output->failed = output->written_bytes == 0;
+			if (cc_active_stats != NULL) {
+				cc_active_stats->bytes_out += output->written_bytes;
+			}
+			break;
+		default:
+			log_write(LOG_ERROR, use_colors, "WriteFanOut: format %d can't be written record by record\n", output->format);
+			output->failed = true;
+			break;
+	}
+}
+
+static void writeOutput(cc_fanout_output* output, const scc_entry* entry) {
+	u32 entry_bytes;
+	switch (output->format) {
+		case CC_FORMAT_RAW:
+			output->failed = !WriteRawEntry(&output->raw, entry);
+			output->written_bytes = output->raw.written_bytes;
+			break;
+		case CC_FORMAT_SCC:
+			entry_bytes = WriteSCCEntryIO(entry, output->out);
+			output->failed = entry_bytes == 0;
+			output->written_bytes += entry_bytes;
+			break;
+		case CC_FORMAT_NW4R:
+			entry_bytes = WriteNW4REntryIO(entry, output->out, output->swap);
+			output->failed = entry_bytes == 0;
+			output->written_bytes += entry_bytes;
+			break;
+	}
+}
+
+// Returns false if any output failed; the ones that didn't are still complete
+bool8 WriteFanOut(const scc_entry* in, const size_t* length, cc_fanout_output* outputs, u8 count, f64 fps, timecode start, timecode end) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "WriteFanOut: invalid input pointer\n");
+		return false;
+	}
+	f64 started = StatsStart();
+	for (u8 i = 0; i < count; i++) {
+		startOutput(&outputs[i], length, fps, start, end);
+	}
+	size_t read_bytes = 0;
+	while (read_bytes < *length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		for (u8 i = 0; i < count; i++) {
+			if (!outputs[i].failed) {
+				writeOutput(&outputs[i], entry);
+			}
+		}
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	bool8 ok = true;
+	for (u8 i = 0; i < count; i++) {
+		cc_fanout_output* output = &outputs[i];
+		if (output->format == CC_FORMAT_RAW && output->out != NULL) {
+			// Also counts a raw output's bytes, and ends one an out of order record stopped the way WriteRaw would
+			output->written_bytes = FinishRawWriter(&output->raw);
+		}
+		ok = ok && !output->failed;
+		log_write(LOG_DEBUG, use_colors, "WriteFanOut: output %d wrote %d bytes\n", i, output->written_bytes);
+	}
+	StatsPhase(CC_PHASE_WRITE, started);
+	return ok;
+}
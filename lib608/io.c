@@ -0,0 +1,326 @@
+/*
+io.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include "config.h" // for HAVE_UNISTD_H and large file support, before any system header
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include "608.h"
+#include "log.h"
+
+// The byte streams under the *Prefixed readers and the *IO writers. A FILE*, a memory buffer and a file
+// descriptor are built in; anything else can fill in a cc_io's callbacks and ctx itself.
+
+// FILE*
+static size_t fileRead(cc_io* io, void* buffer, size_t size) {
+	FILE* file = (FILE*) io->ctx;
+	size_t done = fread(buffer, 1, size, file);
+	io->error = ferror(file) != 0;
+	io->eof = feof(file) != 0;
+	return done;
+}
+
+static size_t fileWrite(cc_io* io, const void* buffer, size_t size) {
+	FILE* file = (FILE*) io->ctx;
+	size_t done = fwrite(buffer, 1, size, file);
+	io->error = ferror(file) != 0;
+	return done;
+}
+
+static bool8 fileSeek(cc_io* io, u64 offset) {
+	FILE* file = (FILE*) io->ctx;
+	if (fseek(file, (long) offset, SEEK_SET) != 0) {
+		return false;
+	}
+	io->eof = false;
+	return true;
+}
+
+static char* fileGets(cc_io* io, char* buffer, int size) {
+	FILE* file = (FILE*) io->ctx;
+	char* line = fgets(buffer, size, file);
+	io->error = ferror(file) != 0;
+	io->eof = feof(file) != 0;
+	return line;
+}
+
+static bool8 fileFlush(cc_io* io) {
+	return fflush((FILE*) io->ctx) == 0;
+}
+
+void InitFileIO(cc_io* io, FILE* file) {
+	io->read = fileRead;
+	io->write = fileWrite;
+	io->seek = fileSeek;
+	io->gets = fileGets;
+	io->flush = fileFlush;
+	io->ctx = file;
+	io->error = false;
+	io->eof = false;
+}
+
+// Memory
+static size_t memoryRead(cc_io* io, void* buffer, size_t size) {
+	cc_memory_io* mem = (cc_memory_io*) io->ctx;
+	size_t left = mem->size - mem->position;
+	size_t done = left < size ? left : size;
+	memcpy(buffer, mem->data + mem->position, done);
+	mem->position += done;
+	if (done < size) {
+		io->eof = true;
+	}
+	return done;
+}
+
+static size_t memoryWrite(cc_io* io, const void* buffer, size_t size) {
+	cc_memory_io* mem = (cc_memory_io*) io->ctx;
+	if (mem->allocated - mem->position < size) {
+		size_t allocated = mem->allocated;
+		while (allocated - mem->position < size) {
+			allocated *= 2;
+		}
+		u8* data = realloc(mem->data, allocated);
+		if (data == NULL) {
+			log_write(LOG_FATAL, use_colors, "IOWrite: Couldn't grow memory buffer\n");
+			io->error = true;
+			return 0;
+		}
+		mem->data = data;
+		mem->allocated = allocated;
+	}
+	memcpy(mem->data + mem->position, buffer, size);
+	mem->position += size;
+	if (mem->position > mem->size) {
+		mem->size = mem->position;
+	}
+	return size;
+}
+
+static bool8 memorySeek(cc_io* io, u64 offset) {
+	cc_memory_io* mem = (cc_memory_io*) io->ctx;
+	if (offset > mem->size) {
+		return false;
+	}
+	mem->position = (size_t) offset;
+	io->eof = false;
+	return true;
+}
+
+static char* memoryGets(cc_io* io, char* buffer, int size) {
+	cc_memory_io* mem = (cc_memory_io*) io->ctx;
+	if (size <= 0) {
+		return NULL;
+	}
+	size_t left = mem->size - mem->position;
+	if (left == 0) {
+		io->eof = true;
+		return NULL;
+	}
+	size_t max = (size_t) size - 1 < left ? (size_t) size - 1 : left;
+	const u8* eol = memchr(mem->data + mem->position, '\n', max);
+	size_t done = eol != NULL ? (size_t) (eol - (mem->data + mem->position)) + 1 : max;
+	memcpy(buffer, mem->data + mem->position, done);
+	buffer[done] = 0;
+	mem->position += done;
+	return buffer;
+}
+
+// Reads from size bytes at data, which the caller keeps for as long as io is used. The stream can't be written.
+void InitMemoryIO(cc_io* io, cc_memory_io* mem, const void* data, size_t size) {
+	mem->data = (u8*) data;
+	mem->size = size;
+	mem->allocated = 0;
+	mem->position = 0;
+	io->read = memoryRead;
+	io->write = NULL;
+	io->seek = memorySeek;
+	io->gets = memoryGets;
+	io->flush = NULL;
+	io->ctx = mem;
+	io->error = false;
+	io->eof = false;
+}
+
+// Writes into a buffer that grows as needed; mem->data holds mem->size bytes after, and the caller frees it
+bool8 InitMemoryOutputIO(cc_io* io, cc_memory_io* mem) {
+	mem->data = malloc(CC_MEMORY_IO_INITIAL);
+	if (mem->data == NULL) {
+		log_write(LOG_FATAL, use_colors, "InitMemoryOutputIO: Couldn't allocate memory buffer\n");
+		return false;
+	}
+	mem->size = 0;
+	mem->allocated = CC_MEMORY_IO_INITIAL;
+	mem->position = 0;
+	io->read = memoryRead;
+	io->write = memoryWrite;
+	io->seek = memorySeek;
+	io->gets = memoryGets;
+	io->flush = NULL;
+	io->ctx = mem;
+	io->error = false;
+	io->eof = false;
+	return true;
+}
+
+#if HAVE_UNISTD_H
+// File descriptors, through one buffer that holds either unread input or unwritten output
+static bool8 fdFlush(cc_io* io) {
+	cc_fd_io* fd_io = (cc_fd_io*) io->ctx;
+	if (!fd_io->writing) {
+		return true;
+	}
+	size_t done = 0;
+	while (done < fd_io->end) {
+		ssize_t written = write(fd_io->fd, fd_io->buffer + done, fd_io->end - done);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			io->error = true;
+			return false;
+		}
+		done += (size_t) written;
+	}
+	fd_io->end = 0;
+	fd_io->writing = false;
+	return true;
+}
+
+static size_t fdRead(cc_io* io, void* buffer, size_t size) {
+	cc_fd_io* fd_io = (cc_fd_io*) io->ctx;
+	if (fd_io->writing && !fdFlush(io)) {
+		return 0;
+	}
+	size_t done = 0;
+	while (done < size) {
+		if (fd_io->start == fd_io->end) {
+			ssize_t got = read(fd_io->fd, fd_io->buffer, sizeof(fd_io->buffer));
+			if (got < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				io->error = true;
+				break;
+			}
+			if (got == 0) {
+				io->eof = true;
+				break;
+			}
+			fd_io->start = 0;
+			fd_io->end = (size_t) got;
+		}
+		size_t take = fd_io->end - fd_io->start < size - done ? fd_io->end - fd_io->start : size - done;
+		memcpy(((u8*) buffer) + done, fd_io->buffer + fd_io->start, take);
+		fd_io->start += take;
+		done += take;
+	}
+	return done;
+}
+
+static size_t fdWrite(cc_io* io, const void* buffer, size_t size) {
+	cc_fd_io* fd_io = (cc_fd_io*) io->ctx;
+	if (!fd_io->writing) {
+		// Unread input is dropped, so the write lands where the reader had got to
+		if (fd_io->start != fd_io->end && lseek(fd_io->fd, -(off_t) (fd_io->end - fd_io->start), SEEK_CUR) < 0) {
+			io->error = true;
+			return 0;
+		}
+		fd_io->start = 0;
+		fd_io->end = 0;
+		fd_io->writing = true;
+	}
+	size_t done = 0;
+	while (done < size) {
+		if (fd_io->end == sizeof(fd_io->buffer) && !fdFlush(io)) {
+			break;
+		}
+		fd_io->writing = true;
+		size_t take = sizeof(fd_io->buffer) - fd_io->end < size - done ? sizeof(fd_io->buffer) - fd_io->end : size - done;
+		memcpy(fd_io->buffer + fd_io->end, ((const u8*) buffer) + done, take);
+		fd_io->end += take;
+		done += take;
+	}
+	return done;
+}
+
+static bool8 fdSeek(cc_io* io, u64 offset) {
+	cc_fd_io* fd_io = (cc_fd_io*) io->ctx;
+	if (!fdFlush(io) || lseek(fd_io->fd, (off_t) offset, SEEK_SET) < 0) {
+		return false;
+	}
+	fd_io->start = 0;
+	fd_io->end = 0;
+	io->eof = false;
+	return true;
+}
+
+// Writes are buffered: call IOFlush before closing fd
+void InitFdIO(cc_io* io, cc_fd_io* fd_io, int fd) {
+	fd_io->fd = fd;
+	fd_io->start = 0;
+	fd_io->end = 0;
+	fd_io->writing = false;
+	io->read = fdRead;
+	io->write = fdWrite;
+	io->seek = fdSeek;
+	io->gets = NULL;
+	io->flush = fdFlush;
+	io->ctx = fd_io;
+	io->error = false;
+	io->eof = false;
+}
+#endif
+
+size_t IORead(cc_io* io, void* buffer, size_t size) {
+	if (io->read == NULL) {
+		io->error = true;
+		return 0;
+	}
+	return io->read(io, buffer, size);
+}
+
+size_t IOWrite(cc_io* io, const void* buffer, size_t size) {
+	if (io->write == NULL) {
+		io->error = true;
+		return 0;
+	}
+	return io->write(io, buffer, size);
+}
+
+bool8 IOSeek(cc_io* io, u64 offset) {
+	return io->seek != NULL && io->seek(io, offset);
+}
+
+// fgets, a byte at a time for streams that don't bring their own
+char* IOGets(cc_io* io, char* buffer, int size) {
+	if (io->gets != NULL) {
+		return io->gets(io, buffer, size);
+	}
+	if (size <= 0) {
+		return NULL;
+	}
+	int done = 0;
+	while (done < size - 1) {
+		char c;
+		if (IORead(io, &c, 1) != 1) {
+			break;
+		}
+		buffer[done++] = c;
+		if (c == '\n') {
+			break;
+		}
+	}
+	buffer[done] = 0;
+	return done != 0 ? buffer : NULL;
+}
+
+bool8 IOFlush(cc_io* io) {
+	return io->flush == NULL || io->flush(io);
+}
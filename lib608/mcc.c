@@ -0,0 +1,552 @@
+/*
+mcc.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "608.h"
+#include "log.h"
+
+// MacCaption MCC: one SMPTE 291 ANC packet (DID 0x61, SDID 0x01, wrapping a CDP) per timecode line
+
+static const char* const mcc_header =
+	"File Format=MacCaption_MCC V1.0\n"
+	"\n"
+	"///////////////////////////////////////////////////////////////////////////////////\n"
+	"// Computer Prompting and Captioning Company\n"
+	"// Ancillary Data Packet Transfer File\n"
+	"//\n"
+	"// Permission to generate this format is granted provided that\n"
+	"//   1. This ANC Transfer file format is used on an as-is basis and no warranty is given, and\n"
+	"//   2. This entire descriptive information text is included in a generated .mcc file.\n"
+	"//\n"
+	"// General file format:\n"
+	"//   HH:MM:SS:FF(tab)[Hexadecimal ANC data in groups of 2 characters]\n"
+	"//     Hexadecimal data starts with the Ancillary Data Packet DID (Data ID defined in S291M)\n"
+	"//       and concludes with the Check Sum following the User Data Words.\n"
+	"//     Each time code line must contain at most one complete ancillary data packet.\n"
+	"//     To transfer additional ANC Data successive lines may contain identical time code.\n"
+	"//     Time Code Rate=[24, 25, 30, 30DF, 50, 60]\n"
+	"//\n"
+	"//   ANC data bytes may be represented by one ASCII character according to the following schema:\n"
+	"//     G  FAh 00h 00h\n"
+	"//     H  2 x (FAh 00h 00h)\n"
+	"//     I  3 x (FAh 00h 00h)\n"
+	"//     J  4 x (FAh 00h 00h)\n"
+	"//     K  5 x (FAh 00h 00h)\n"
+	"//     L  6 x (FAh 00h 00h)\n"
+	"//     M  7 x (FAh 00h 00h)\n"
+	"//     N  8 x (FAh 00h 00h)\n"
+	"//     O  9 x (FAh 00h 00h)\n"
+	"//     P  FBh 80h 80h\n"
+	"//     Q  FCh 80h 80h\n"
+	"//     R  FDh 80h 80h\n"
+	"//     S  96h 69h\n"
+	"//     T  61h 01h\n"
+	"//     U  E1h 00h 00h 00h\n"
+	"//     Z  00h\n"
+	"//\n"
+	"///////////////////////////////////////////////////////////////////////////////////\n"
+	"\n";
+
+// Expansions for the letter codes G through Z, indexed by (letter - 'G')
+static const struct {
+	u8 length;
+	u8 bytes[27];
+} mcc_codes[20] = {
+	{3, {0xfa, 0, 0}},
+	{6, {0xfa, 0, 0, 0xfa, 0, 0}},
+	{9, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{12, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{15, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{18, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{21, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{24, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{27, {0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0, 0xfa, 0, 0}},
+	{3, {0xfb, 0x80, 0x80}},
+	{3, {0xfc, 0x80, 0x80}},
+	{3, {0xfd, 0x80, 0x80}},
+	{2, {0x96, 0x69}},
+	{2, {0x61, 0x01}},
+	{4, {0xe1, 0, 0, 0}},
+	{0, {0}}, // V
+	{0, {0}}, // W
+	{0, {0}}, // X
+	{0, {0}}, // Y
+	{1, {0}}
+};
+
+static const char hex_digits[16] = "0123456789ABCDEF";
+
+// The longest line needs 2 characters per byte of the largest ANC packet, plus the timecode
+#define MCC_LINE_SIZE 1024
+
+// Integer rates come first, so a "24", "30" or "60" time code rate is read back as integer fps
+static const struct {
+	const char* rate;
+	f64 fps;
+	bool8 drop;
+} mcc_rates[10] = {
+	{"24", 24, false},
+	{"24", 24/1.001f, false},
+	{"25", 25, false},
+	{"30", 30, false},
+	{"30", 30/1.001f, false},
+	{"30DF", 30/1.001f, true},
+	{"50", 50, false},
+	{"60", 60, false},
+	{"60", 60/1.001f, false},
+	{"60DF", 60/1.001f, true}
+};
+
+// Greedily substitutes the letter codes while hex encoding an ANC packet
+static size_t compressMCC(const u8* in, size_t size, char* out) {
+	char* out_ptr = out;
+	size_t i = 0;
+	while (i < size) {
+		switch (in[i]) {
+			case 0xfa:
+				if (i + 3 <= size && in[i+1] == 0 && in[i+2] == 0) {
+					unsigned int run = 1;
+					i += 3;
+					while (run < 9 && i + 3 <= size && in[i] == 0xfa && in[i+1] == 0 && in[i+2] == 0) {
+						run++;
+						i += 3;
+					}
+					*out_ptr++ = (char) ('G' + run - 1);
+					continue;
+				}
+				break;
+			case 0xfb:
+			case 0xfc:
+			case 0xfd:
+				if (i + 3 <= size && in[i+1] == 0x80 && in[i+2] == 0x80) {
+					*out_ptr++ = (char) ('P' + in[i] - 0xfb);
+					i += 3;
+					continue;
+				}
+				break;
+			case 0x96:
+				if (i + 2 <= size && in[i+1] == 0x69) {
+					*out_ptr++ = 'S';
+					i += 2;
+					continue;
+				}
+				break;
+			case 0x61:
+				if (i + 2 <= size && in[i+1] == 0x01) {
+					*out_ptr++ = 'T';
+					i += 2;
+					continue;
+				}
+				break;
+			case 0xe1:
+				if (i + 4 <= size && in[i+1] == 0 && in[i+2] == 0 && in[i+3] == 0) {
+					*out_ptr++ = 'U';
+					i += 4;
+					continue;
+				}
+				break;
+			case 0x00:
+				*out_ptr++ = 'Z';
+				i++;
+				continue;
+			default:
+				break;
+		}
+		*out_ptr++ = hex_digits[in[i] >> 4];
+		*out_ptr++ = hex_digits[in[i] & 0xf];
+		i++;
+	}
+	return (size_t) (out_ptr - out);
+}
+
+// Expands hex digits and letter codes back into bytes. Returns the number of bytes, stopping at the end of the line.
+static size_t expandMCC(const char* in, u8* out, size_t max) {
+	static s8 nibbles[256];
+	static bool8 init = false;
+	if (!init) {
+		memset(nibbles, -1, sizeof(nibbles));
+		for (int i = 0; i < 10; i++) {
+			nibbles['0' + i] = (s8) i;
+		}
+		for (int i = 0; i < 6; i++) {
+			nibbles['A' + i] = (s8) (10 + i);
+			nibbles['a' + i] = (s8) (10 + i);
+		}
+		init = true;
+	}
+	u8* out_ptr = out;
+	u8* end_ptr = out + max;
+	const u8* in_ptr = (const u8*) in;
+	while (*in_ptr != 0) {
+		u8 c = *in_ptr;
+		if (c >= 'G' && c <= 'Z') {
+			u8 len = mcc_codes[c - 'G'].length;
+			if (out_ptr + len > end_ptr) {
+				break;
+			}
+			memcpy(out_ptr, mcc_codes[c - 'G'].bytes, len);
+			out_ptr += len;
+			in_ptr++;
+		}
+		else if (nibbles[c] >= 0 && nibbles[in_ptr[1]] >= 0) {
+			if (out_ptr >= end_ptr) {
+				break;
+			}
+			*out_ptr++ = (u8) ((nibbles[c] << 4) | nibbles[in_ptr[1]]);
+			in_ptr += 2;
+		}
+		else {
+			break; // newline, or garbage
+		}
+	}
+	return (size_t) (out_ptr - out);
+}
+
+scc_entry* ReadMCC(FILE* mcc, size_t* length, scc_entry** field2, size_t* length2) {
+	if (mcc == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadMCC: invalid file descriptor\n");
+		return NULL;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, mcc, NULL, 0);
+	return ReadMCCPrefixed(&in, length, field2, length2);
+}
+
+// Same as ReadMCC, for a stream whose first bytes were already read (see PeekFormat)
+scc_entry* ReadMCCPrefixed(cc_prefixed_file* mcc, size_t* length, scc_entry** field2, size_t* length2) {
+	if (mcc == NULL || mcc->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadMCC: invalid file descriptor\n");
+		return NULL;
+	}
+	char* read_buffer = malloc(MCC_LINE_SIZE);
+	if (read_buffer == NULL) {
+		log_write(LOG_FATAL, use_colors, "ReadMCC: couldn't allocate read buffer\n");
+		return NULL;
+	}
+	f64 stats_started = StatsStart();
+	u8 v1, v2;
+	if (PrefixedGets(mcc, read_buffer, MCC_LINE_SIZE) == NULL || sscanf(read_buffer, "File Format=MacCaption_MCC V%1hhd.%1hhd", &v1, &v2) != 2) {
+		// check read error
+		if (mcc->io->error) {
+			log_write(LOG_ERROR, use_colors, "ReadMCC: Error reading file (%d: %s)\n", errno, strerror(errno));
+		}
+		// check eof
+		else if (mcc->io->eof && mcc->position == 0) {
+			log_write(LOG_ERROR, use_colors, "ReadMCC: unexpected end of file\n");
+		}
+		else {
+			log_write(LOG_ERROR, use_colors, "ReadMCC: Input is not an MCC file\n");
+		}
+		free(read_buffer);
+		return NULL;
+	}
+	if (v1 > 2) {
+		log_write(LOG_WARN, use_colors, "ReadMCC: MCC version not v1.0 or v2.0, decoding errors may happen\n");
+	}
+	log_write(LOG_DEBUG, use_colors, "Found MacCaption MCC file v%hhd.%hhd\n", v1, v2);
+	u8 anc[MCC_LINE_SIZE/2];
+	f64 fps = 30/1.001f;
+	bool8 drop = true;
+	raw_segmenter seg1, seg2;
+	bool8 started = false;
+	s64 next_frame = 0;
+	int line = 1;
+	int record_count = 0;
+	timecode tc = default_timecode;
+	s16 hr = 0;
+	u8 min = 0;
+	u8 sec = 0;
+	u8 frames = 0;
+	char sep = ':';
+	int skip = 0;
+	while (PrefixedGets(mcc, read_buffer, MCC_LINE_SIZE) != NULL) {
+		line++;
+		if (strncmp(read_buffer, "Time Code Rate=", 15) == 0) {
+			if (started) {
+				log_write(LOG_WARN, use_colors, "ReadMCC: Time Code Rate at line %d comes after caption data (ignoring)\n", line);
+				continue;
+			}
+			unsigned int i;
+			for (i = 0; i < 10; i++) {
+				size_t rate_len = strlen(mcc_rates[i].rate);
+				if (strncmp(read_buffer+15, mcc_rates[i].rate, rate_len) == 0 && (read_buffer[15+rate_len] == '\n' || read_buffer[15+rate_len] == '\r' || read_buffer[15+rate_len] == 0)) {
+					break;
+				}
+			}
+			if (i == 10) {
+				log_write(LOG_WARN, use_colors, "ReadMCC: Unknown time code rate at line %d, assuming 30DF\n", line);
+				continue;
+			}
+			fps = mcc_rates[i].fps;
+			drop = mcc_rates[i].drop;
+			log_write(LOG_DEBUG, use_colors, "ReadMCC: Time Code Rate %s\n", mcc_rates[i].rate);
+			continue;
+		}
+		if (read_buffer[0] < '0' || read_buffer[0] > '9' || sscanf(read_buffer, "%hd:%02hhd:%02hhd%c%02hhd%n", &hr, &min, &sec, &sep, &frames, &skip) != 5) {
+			// comments, blank lines and the rest of the header
+			continue;
+		}
+		if (!started) {
+			if (!InitRawSegmenter(&seg1, fps, drop)) {
+				free(read_buffer);
+				return NULL;
+			}
+			if (field2 != NULL && !InitRawSegmenter(&seg2, fps, drop)) {
+				free(seg1.data);
+				free(read_buffer);
+				return NULL;
+			}
+		}
+		tc.hours = hr;
+		tc.minutes = (u8) (min & 0x3f);
+		tc.seconds = (u8) (sec & 0x3f);
+		tc.frames = (u8) (frames & 0x7f);
+		tc.drop = (bool8) (sep == ';' || sep == ',');
+		s64 frame = tc2int(tc, fps);
+		if (started && frame < next_frame) {
+			log_write(LOG_DEBUG, use_colors, "ReadMCC: Extra packet for %02d:%02hhu:%02hhu%c%02hhu at line %d (ignoring)\n", tc.hours, tc.minutes, tc.seconds, sep, tc.frames, line);
+			continue;
+		}
+		char* data_ptr = read_buffer + skip;
+		while (*data_ptr == '\t' || *data_ptr == ' ') {
+			data_ptr++;
+		}
+		// MCC v2.0 at 50/60 fps can add a field flag to the timecode
+		if (*data_ptr == '.') {
+			data_ptr += 2;
+			while (*data_ptr == '\t' || *data_ptr == ' ') {
+				data_ptr++;
+			}
+		}
+		size_t anc_size = expandMCC(data_ptr, anc, sizeof(anc));
+		u16 cc1 = 0;
+		u16 cc2 = 0;
+		if (anc_size < 4 || anc[0] != 0x61 || anc[1] != 0x01 || (size_t) anc[2] + 4 > anc_size) {
+			log_write(LOG_WARN, use_colors, "ReadMCC: Line %d is not a caption ANC packet (ignoring)\n", line);
+			if (cc_active_stats != NULL) {
+				cc_active_stats->malformed_lines++;
+			}
+		}
+		else if (!ParseCDP(anc+3, anc[2], &cc1, &cc2)) {
+			log_write(LOG_WARN, use_colors, "ReadMCC: Invalid CDP at line %d (ignoring)\n", line);
+			if (cc_active_stats != NULL) {
+				cc_active_stats->malformed_lines++;
+			}
+		}
+		if (started) {
+			if (!SegmentRawGap(&seg1, next_frame, frame) || (field2 != NULL && !SegmentRawGap(&seg2, next_frame, frame))) {
+				goto MCC_alloc_error;
+			}
+		}
+		if (!SegmentRawPair(&seg1, cc1, frame) || (field2 != NULL && !SegmentRawPair(&seg2, cc2, frame))) {
+			goto MCC_alloc_error;
+		}
+		started = true;
+		next_frame = frame + 1;
+		record_count++;
+	}
+	free(read_buffer);
+	if (mcc->io->error) {
+		log_write(LOG_ERROR, use_colors, "ReadMCC: Error reading file (%d: %s)\n", errno, strerror(errno));
+	}
+	if (!started) {
+		log_write(LOG_ERROR, use_colors, "ReadMCC: No caption data found\n");
+		return NULL;
+	}
+	// Close the final record, as a raw file would
+	if (!SegmentRawPair(&seg1, 0, next_frame) || (field2 != NULL && !SegmentRawPair(&seg2, 0, next_frame))) {
+		read_buffer = NULL;
+		goto MCC_alloc_error;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += mcc->position;
+	}
+	StatsPhase(CC_PHASE_READ, stats_started);
+	log_write(LOG_DEBUG, use_colors, "ReadMCC: Read %d packets from %d lines of input\n", record_count, line);
+	if (field2 != NULL) {
+		*field2 = FinishRawSegmenter(&seg2, length2);
+	}
+	return FinishRawSegmenter(&seg1, length);
+MCC_alloc_error:
+	// SegmentRawPair frees the buffer of the segmenter that failed
+	free(seg1.data);
+	if (field2 != NULL) {
+		free(seg2.data);
+	}
+	free(read_buffer);
+	return NULL;
+}
+
+u32 WriteMCC(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, FILE* out, f64 fps) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteMCCIO(in, length, in2, length2, out != NULL ? &io : NULL, fps);
+}
+
+u32 WriteMCCIO(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, cc_io* out, f64 fps) {
+	if (in == NULL && in2 == NULL) {
+		log_write(LOG_FATAL, use_colors, "WriteMCC: invalid input pointer\n");
+		return 0;
+	}
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteMCC: invalid file descriptor\n");
+		return 0;
+	}
+	u8 frame_rate = GetCDPFrameRate(fps);
+	if (frame_rate == 0) {
+		return 0;
+	}
+	size_t l1 = in != NULL ? *length : 0;
+	size_t l2 = in2 != NULL ? *length2 : 0;
+	bool8 drop = (l1 != 0 && in->pts.tc.drop) || (l2 != 0 && in2->pts.tc.drop);
+	const char* rate = NULL;
+	for (unsigned int i = 0; i < 10; i++) {
+		if (GetCDPFrameRate(mcc_rates[i].fps) == frame_rate && mcc_rates[i].drop == drop) {
+			rate = mcc_rates[i].rate;
+			break;
+		}
+	}
+	if (rate == NULL) {
+		// drop frame requested for a rate without a DF time code
+		log_write(LOG_WARN, use_colors, "WriteMCC: drop frame isn't supported at %f fps (using non drop frame)\n", fps);
+		drop = false;
+		for (unsigned int i = 0; i < 10; i++) {
+			if (GetCDPFrameRate(mcc_rates[i].fps) == frame_rate) {
+				rate = mcc_rates[i].rate;
+				break;
+			}
+		}
+	}
+	char* out_buf = malloc(MCC_LINE_SIZE);
+	if (out_buf == NULL) {
+		log_write(LOG_FATAL, use_colors, "WriteMCC: Couldn't allocate output buffer\n");
+		return 0;
+	}
+	f64 stats_started = StatsStart();
+	unsigned int written_bytes = IOWrite(out, mcc_header, strlen(mcc_header));
+	if (out->error) {
+		goto MCC_file_error;
+	}
+	// Derived from the captions, so the same track always gets the same UUID and the caller's rand() is left alone.
+	// Park-Miller spreads the CRC over the 16 bytes.
+	u32 seed = CRC32(in, l1, 0);
+	seed = CRC32(in2, l2, seed) % 0x7fffffff;
+	if (seed == 0) {
+		seed = 1;
+	}
+	u8 uuid[16];
+	for (int i = 0; i < 16; i++) {
+		seed = (u32) (((u64) seed * 48271) % 0x7fffffff);
+		uuid[i] = (u8) (seed >> 8);
+	}
+	uuid[6] = (uuid[6] & 0x0f) | 0x40;
+	uuid[8] = (uuid[8] & 0x3f) | 0x80;
+	time_t now = time(NULL);
+	struct tm* local = localtime(&now);
+	char date[64] = "";
+	char clock[16] = "";
+	if (local != NULL) {
+		strftime(date, sizeof(date), "%A, %B %d, %Y", local);
+		strftime(clock, sizeof(clock), "%H:%M:%S", local);
+	}
+	int header_len = snprintf(out_buf, MCC_LINE_SIZE, "UUID=%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X\nCreation Program=Luma's EIA-608 Tools %s\nCreation Date=%s\nCreation Time=%s\nTime Code Rate=%s\n\n", uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7], uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15], library_version.git_rev, date, clock, rate);
+	written_bytes += IOWrite(out, out_buf, (size_t) header_len);
+	if (out->error) {
+		goto MCC_file_error;
+	}
+	s64 current_frame = 0;
+	bool8 have_start = false;
+	if (l1 != 0) {
+		current_frame = tc2int(in->pts.tc, fps);
+		have_start = true;
+	}
+	if (l2 != 0 && (!have_start || tc2int(in2->pts.tc, fps) < current_frame)) {
+		current_frame = tc2int(in2->pts.tc, fps);
+	}
+	s64 last_frame = GetSCCEndFrame(in, l1, fps);
+	s64 end2 = GetSCCEndFrame(in2, l2, fps);
+	if (last_frame < end2) {
+		last_frame = end2;
+	}
+	last_frame++; // trailing 0x8080, as WriteRaw does
+	scc_cursor cursor1, cursor2;
+	InitSCCCursor(&cursor1, in, l1, fps, current_frame);
+	InitSCCCursor(&cursor2, in2, l2, fps, current_frame);
+	u8 anc[3 + 255 + 1];
+	u16 sequence = 0;
+	unsigned int lines = 0;
+	for (; current_frame < last_frame; current_frame++) {
+		u16 cc1, cc2;
+		NextSCCWord(&cursor1, &cc1);
+		NextSCCWord(&cursor2, &cc2);
+		size_t cdp_size = BuildCDP(anc+3, frame_rate, sequence++, cc1, cc2);
+		anc[0] = 0x61; // DID
+		anc[1] = 0x01; // SDID
+		anc[2] = (u8) cdp_size; // DC
+		u8 checksum = 0;
+		for (size_t i = 0; i < cdp_size + 3; i++) {
+			checksum += anc[i];
+		}
+		anc[cdp_size+3] = checksum;
+		timecode ts = int2tc(current_frame, fps, drop);
+		int line_len = snprintf(out_buf, MCC_LINE_SIZE, "%02d:%02hhd:%02hhd%c%02hhd\t", ts.hours, ts.minutes, ts.seconds, ts.drop ? ';' : ':', ts.frames);
+		line_len += (int) compressMCC(anc, cdp_size + 4, out_buf + line_len);
+		out_buf[line_len++] = '\n';
+		written_bytes += IOWrite(out, out_buf, (size_t) line_len);
+		if (out->error) {
+			goto MCC_file_error;
+		}
+		lines++;
+	}
+	log_write(LOG_DEBUG, use_colors, "WriteMCC: Wrote %d bytes in %d lines, from %d bytes of input\n", written_bytes, lines, (u32) (l1 + l2));
+	goto MCC_stats;
+MCC_file_error:
+	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+MCC_stats:
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += written_bytes;
+		StatsTrack(in, l1, true);
+		StatsTrack(in2, l2, true);
+	}
+	StatsPhase(CC_PHASE_WRITE, stats_started);
+	free(out_buf);
+	return written_bytes;
+}
+
+bool8 IsMCCFile(FILE* file) {
+	bool8 ret = false;
+	if (file == NULL) {
+		log_write(LOG_ERROR, use_colors, "IsMCCFile: invalid file descriptor\n");
+		return false;
+	}
+	u8 v1, v2;
+	if (fscanf(file, "File Format=MacCaption_MCC V%1hhd.%1hhd", &v1, &v2) != 2) {
+		// check read error
+		if (ferror(file)) {
+			log_write(LOG_ERROR, use_colors, "IsMCCFile: Error reading file (%d: %s)\n", errno, strerror(errno));
+			return false;
+		}
+		// check eof
+		else if (feof(file)) {
+			log_write(LOG_ERROR, use_colors, "IsMCCFile: unexpected end of file\n");
+			fseek(file, 0, SEEK_SET);
+			return false;
+		}
+		ret = false; // if file was read successfully but is not MCC format
+	}
+	else {
+		ret = true;
+	}
+	// Seek back to allow input functions and further checks to work properly
+	fseek(file, 0, SEEK_SET);
+	log_write(LOG_DEBUG, use_colors, "IsMCCFile: %s\n", ret ? "True" : "False");
+	return ret;
+}
@@ -0,0 +1,383 @@
+/*
+mux.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Interleaves tracks for different channels into the one byte pair per frame a field carries.
+// Text characters don't say which channel they belong to; the decoder goes by the last control code.
+// So a track can only take the field over with a control code, the channel owning the field keeps it while it has text
+// (or the second half of a doubled control code) due, and captions may only cut into an XDS packet with a control code. XDS packets get a continue code when they resume.
+// Words that can't go out on time are delayed, with all the words after them, until the track has a gap to catch up in.
+
+static bool8 isControlCode(u16 cc) {
+	u8 b1 = (cc >> 8) & 0x7f;
+	return b1 >= 0x10 && b1 <= 0x1f;
+}
+
+static bool8 isMiscControlCode(u16 cc) {
+	u8 b1 = (cc >> 8) & 0x76;
+	u8 b2 = cc & 0x7f;
+	return b1 == 0x14 && b2 >= 0x20 && b2 <= 0x2f;
+}
+
+// Moves a control code to the channel (0-3) it's being sent on; 0x0800 is the CC2/CC4 bit,
+// and miscellaneous control codes use 0x0100 for Field 2
+static u16 setChannel(u16 cc, u8 channel) {
+	if (!isControlCode(cc)) {
+		return cc;
+	}
+	bool8 misc = isMiscControlCode(cc);
+	cc = (u16) ((cc & ~0x0800) | ((channel & 0x1) ? 0x0800 : 0));
+	if (misc) {
+		cc = (u16) ((cc & ~0x0100) | ((channel & 0x2) ? 0x0100 : 0));
+	}
+	return cc;
+}
+
+static bool8 isModeCode(u16 cc) {
+	u8 b2 = cc & 0x7f;
+	return isMiscControlCode(cc) && (b2 == 0x20 || (b2 >= 0x25 && b2 <= 0x27) || b2 == 0x29 || b2 == 0x2b);
+}
+
+// Fetches the source's next word if it's due by the mux's frame
+static void fetchWord(cc_mux_source* src, s64 frame) {
+	while (!src->pending && !SCCCursorDone(&src->cursor)) {
+		scc_cursor* cursor = &src->cursor;
+		// A delayed track catches up over its own padding
+		if (cursor->index == 0 && cursor->entry_frame > cursor->frame && cursor->frame < frame) {
+			cursor->frame = cursor->entry_frame < frame ? cursor->entry_frame : frame;
+		}
+		if (cursor->frame > frame) {
+			return;
+		}
+		s64 word_frame = cursor->frame;
+		u16 cc;
+		if (NextSCCWord(cursor, &cc) && cc != 0) {
+			src->pending = true;
+			src->word = cc;
+			src->due = word_frame;
+		}
+	}
+}
+
+bool8 InitMux(cc_mux* mux, const cc_mux_input* inputs, u8 count, u8 field, f64 fps) {
+	if (mux == NULL || (inputs == NULL && count != 0)) {
+		log_write(LOG_FATAL, use_colors, "InitMux: invalid input pointer\n");
+		return false;
+	}
+	if (count > CC_MUX_MAX_INPUTS) {
+		log_write(LOG_ERROR, use_colors, "InitMux: can't mux more than %d inputs\n", CC_MUX_MAX_INPUTS);
+		return false;
+	}
+	memset(mux, 0, sizeof(cc_mux));
+	mux->field = field & 0x1;
+	mux->owner = -1;
+	for (u8 i = 0; i < count; i++) {
+		u8 channel_field = inputs[i].channel >= 2 ? 1 : 0; // CC3, CC4 and XDS are carried in Field 2
+		if (inputs[i].channel > CC_MUX_XDS) {
+			log_write(LOG_ERROR, use_colors, "InitMux: input %d has an invalid channel %d\n", i, inputs[i].channel);
+			return false;
+		}
+		if (channel_field != mux->field) {
+			log_write(LOG_ERROR, use_colors, "InitMux: input %d is for Field %d, not Field %d\n", i, channel_field + 1, mux->field + 1);
+			return false;
+		}
+		cc_mux_source* src = &mux->sources[mux->count++];
+		InitSCCCursor(&src->cursor, inputs[i].track, inputs[i].length, fps, 0);
+		src->channel = inputs[i].channel;
+	}
+	return true;
+}
+
+bool8 MuxDone(const cc_mux* mux) {
+	for (u8 i = 0; i < mux->count; i++) {
+		if (mux->sources[i].pending || !SCCCursorDone(&mux->sources[i].cursor)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// First frame from the current one on where any input has data, for skipping over padding
+s64 NextMuxFrame(const cc_mux* mux) {
+	s64 next = -1;
+	for (u8 i = 0; i < mux->count; i++) {
+		const cc_mux_source* src = &mux->sources[i];
+		s64 frame;
+		if (src->pending) {
+			return mux->frame;
+		}
+		if (SCCCursorDone(&src->cursor)) {
+			continue;
+		}
+		frame = mux->frame;
+		if (src->cursor.index == 0 && src->cursor.entry_frame > frame) {
+			frame = src->cursor.entry_frame;
+		}
+		if (next < 0 || frame < next) {
+			next = frame;
+		}
+	}
+	return next < 0 ? mux->frame : next;
+}
+
+// Picks the source that sends on this frame, or -1 for padding
+static s8 pickSource(const cc_mux* mux) {
+	s8 best = -1;
+	// The channel owning the field finishes its text and doubled control codes, unless they would be read as XDS data
+	if (mux->owner >= 0 && mux->sources[mux->owner].pending) {
+		const cc_mux_source* owner = &mux->sources[mux->owner];
+		if (isControlCode(owner->word) ? setChannel(owner->word, owner->channel) == mux->last_word : !mux->xds_open) {
+			return mux->owner;
+		}
+	}
+	for (u8 i = 0; i < mux->count; i++) {
+		const cc_mux_source* src = &mux->sources[i];
+		if (!src->pending || src->channel == CC_MUX_XDS || !isControlCode(src->word)) {
+			continue;
+		}
+		if (best < 0 || src->due < mux->sources[best].due) {
+			best = (s8) i;
+		}
+	}
+	if (best >= 0) {
+		return best;
+	}
+	for (u8 i = 0; i < mux->count; i++) {
+		if (mux->sources[i].pending && mux->sources[i].channel == CC_MUX_XDS) {
+			return (s8) i;
+		}
+	}
+	// Nobody can send cleanly; the longest waiting caption takes the channel back
+	for (u8 i = 0; i < mux->count; i++) {
+		const cc_mux_source* src = &mux->sources[i];
+		if (src->pending && (best < 0 || src->due < mux->sources[best].due)) {
+			best = (s8) i;
+		}
+	}
+	return best;
+}
+
+// Fetches the byte pair for the mux's frame and moves on to the next frame. Returns false if the frame is padding.
+bool8 NextMuxWord(cc_mux* mux, u16* cc) {
+	for (u8 i = 0; i < mux->count; i++) {
+		fetchWord(&mux->sources[i], mux->frame);
+	}
+	s8 index = pickSource(mux);
+	*cc = 0;
+	if (index < 0) {
+		mux->last_word = 0;
+		mux->frame++;
+		return false;
+	}
+	cc_mux_source* src = &mux->sources[index];
+	bool8 consume = true;
+	if (src->channel == CC_MUX_XDS) {
+		u8 b1 = (src->word >> 8) & 0x7f;
+		bool8 start = b1 >= 0x01 && b1 <= 0x0e && (b1 & 0x1);
+		bool8 resume = b1 >= 0x01 && b1 <= 0x0e && !start;
+		if (!start && !resume && !mux->xds_open && mux->xds_class != 0) {
+			// Captions cut in; pick the packet back up first
+			*cc = (u16) (((mux->xds_class + 1) << 8) | mux->xds_type);
+			mux->xds_open = true;
+			mux->resumes++;
+			consume = false;
+		}
+		else if (start) {
+			mux->xds_class = b1;
+			mux->xds_type = src->word & 0x7f;
+			mux->xds_open = true;
+		}
+		else if (resume) {
+			mux->xds_open = true;
+		}
+		else if (b1 == 0x0f) {
+			mux->xds_open = false;
+			mux->xds_class = 0;
+		}
+		if (consume) {
+			*cc = src->word;
+		}
+	}
+	else {
+		u16 word = setChannel(src->word, src->channel);
+		if (!isControlCode(word) && (index != mux->owner || mux->xds_open) && src->mode_code != 0) {
+			// Characters on their own would land on another channel, so resend the track's last mode code first
+			word = src->mode_code;
+			consume = false;
+			mux->resumes++;
+			log_write(LOG_DEBUG, use_colors, "NextMuxWord: resending 0x%04x at frame %d to take the channel back\n", word, (s32) mux->frame);
+		}
+		if (isControlCode(word)) {
+			mux->owner = index;
+			mux->xds_open = false;
+			if (isModeCode(word)) {
+				src->mode_code = word;
+			}
+		}
+		*cc = word;
+	}
+	mux->last_word = *cc;
+	if (consume) {
+		src->pending = false;
+		if (mux->frame > src->due) {
+			src->delayed_words++;
+			src->max_delay = mux->frame - src->due > src->max_delay ? mux->frame - src->due : src->max_delay;
+		}
+	}
+	mux->frame++;
+	return true;
+}
+
+static bool8 flushRecord(FILE* out, scc_entry* record, u8 format, bool8 swap, size_t* data_size) {
+	if (format != CC_MUX_NW4R || record->entry_count == 0) {
+		return true;
+	}
+	unsigned int count = record->entry_count;
+	size_t size = sizeof(scc_entry) + (sizeof(u16) * count);
+	if (swap) {
+		record->entry_count = byteswap32(count);
+		record->pts.raw = byteswap32(record->pts.raw);
+		for (unsigned int i = 0; i < count; i++) {
+			record->entries[i] = byteswap16(record->entries[i]);
+		}
+	}
+	fwrite(record, 1, size, out);
+	record->entry_count = 0;
+	*data_size += size;
+	return !ferror(out);
+}
+
+// Streams the muxed field straight to a raw (Field 1 only) or NW4R file, without building the merged track
+u32 MuxSCC(const cc_mux_input* inputs, u8 count, u8 field, u8 format, FILE* out, f64 fps, bool8 swap) {
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "MuxSCC: invalid file descriptor\n");
+		return 0;
+	}
+	if (format == CC_MUX_RAW && field != 0) {
+		log_write(LOG_ERROR, use_colors, "MuxSCC: raw files only carry Field 1\n");
+		return 0;
+	}
+	cc_mux mux;
+	if (!InitMux(&mux, inputs, count, field, fps)) {
+		return 0;
+	}
+	bool8 drop = false;
+	for (u8 i = 0; i < count; i++) {
+		if (inputs[i].track != NULL && inputs[i].length != 0) {
+			drop = inputs[i].track->pts.tc.drop;
+			break;
+		}
+	}
+	long header_pos = ftell(out);
+	u32 written_bytes = format == CC_MUX_NW4R ? WriteNW4RHeader(out, field, swap, 0) : WriteRawHeader(out);
+	if (written_bytes == 0) {
+		return 0;
+	}
+	u8 buffer[4096];
+	size_t buffered = 0;
+	size_t data_size = 0;
+	s64 record_frame = 0;
+	scc_entry* record = malloc(sizeof(scc_entry) + (sizeof(u16) * CC_MUX_RECORD_MAX));
+	if (record == NULL) {
+		log_write(LOG_FATAL, use_colors, "MuxSCC: Couldn't allocate record buffer\n");
+		return 0;
+	}
+	record->entry_count = 0;
+	while (!MuxDone(&mux)) {
+		s64 next_frame = NextMuxFrame(&mux);
+		if (next_frame > mux.frame) {
+			if (format == CC_MUX_RAW) {
+				for (s64 i = mux.frame; i < next_frame; i++) {
+					if (buffered == sizeof(buffer)) {
+						written_bytes += fwrite(buffer, 1, buffered, out);
+						buffered = 0;
+					}
+					buffer[buffered++] = 0x80;
+					buffer[buffered++] = 0x80;
+				}
+			}
+			mux.frame = next_frame;
+		}
+		s64 frame = mux.frame;
+		u16 cc;
+		if (!NextMuxWord(&mux, &cc)) {
+			if (format == CC_MUX_RAW) {
+				if (buffered == sizeof(buffer)) {
+					written_bytes += fwrite(buffer, 1, buffered, out);
+					buffered = 0;
+				}
+				buffer[buffered++] = 0x80;
+				buffer[buffered++] = 0x80;
+			}
+			continue;
+		}
+		if (format == CC_MUX_RAW) {
+			u16 write = fixParity(cc);
+			if (buffered == sizeof(buffer)) {
+				written_bytes += fwrite(buffer, 1, buffered, out);
+				buffered = 0;
+			}
+			buffer[buffered++] = (u8) (write >> 8);
+			buffer[buffered++] = (u8) (write & 0xff);
+		}
+		else {
+			if (record->entry_count != 0 && (frame != record_frame + record->entry_count || record->entry_count == CC_MUX_RECORD_MAX)) {
+				if (!flushRecord(out, record, format, swap, &data_size)) {
+					goto mux_file_error;
+				}
+			}
+			if (record->entry_count == 0) {
+				record_frame = frame;
+				record->pts.tc = int2tc(frame, fps, drop);
+			}
+			record->entries[record->entry_count++] = cc;
+		}
+		if (ferror(out)) {
+			goto mux_file_error;
+		}
+	}
+	if (format == CC_MUX_RAW) {
+		// Write an extra 0x8080 at the end to match WriteRaw
+		if (buffered == sizeof(buffer)) {
+			written_bytes += fwrite(buffer, 1, buffered, out);
+			buffered = 0;
+		}
+		buffer[buffered++] = 0x80;
+		buffer[buffered++] = 0x80;
+		written_bytes += fwrite(buffer, 1, buffered, out);
+	}
+	else {
+		if (!flushRecord(out, record, format, swap, &data_size)) {
+			goto mux_file_error;
+		}
+		written_bytes += data_size;
+		// Now that the size is known, go back and fix up the headers
+		if (header_pos < 0 || fseek(out, header_pos, SEEK_SET) != 0 || WriteNW4RHeader(out, field, swap, data_size) == 0 || fseek(out, 0, SEEK_END) != 0) {
+			log_write(LOG_ERROR, use_colors, "MuxSCC: Couldn't update the NW4R header (is the output seekable?)\n");
+		}
+	}
+	if (ferror(out)) {
+		goto mux_file_error;
+	}
+	free(record);
+	for (u8 i = 0; i < mux.count; i++) {
+		if (mux.sources[i].delayed_words != 0) {
+			log_write(LOG_DEBUG, use_colors, "MuxSCC: input %d: %d words delayed, by up to %d frames\n", i, mux.sources[i].delayed_words, (s32) mux.sources[i].max_delay);
+		}
+	}
+	log_write(LOG_DEBUG, use_colors, "MuxSCC: wrote %d bytes from %d inputs, %d resume codes inserted\n", written_bytes, mux.count, mux.resumes);
+	return written_bytes;
+mux_file_error:
+	free(record);
+	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	return written_bytes;
+}
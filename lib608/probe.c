@@ -0,0 +1,218 @@
+/*
+probe.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Format detection from one peeked buffer, and reads that pick up after it.
+// The Is*File checks seek back to the start of the file, which pipes and stdin can't do; probing
+// reads the first CC_PROBE_SIZE bytes once, and the *Prefixed readers consume those bytes before the stream.
+
+static const char* const format_names[] = {"unknown", "raw", "SCC", "NW4R", "MCC", "RCWT", "CCX"};
+
+// The header fields IsNW4RFile needs, without depending on raw.c's struct layout
+static bool8 probeNW4R(const u8* buffer, size_t size) {
+	if (size < 4 || (memcmp(buffer, "BCC1", 4) != 0 && memcmp(buffer, "BCC2", 4) != 0)) {
+		return false;
+	}
+	if (size < 0x40) {
+		return false;
+	}
+	u16 bom, section_count;
+	memcpy(&bom, buffer + 4, 2);
+	memcpy(&section_count, buffer + 14, 2);
+	bool8 swap = bom != 0xfeff;
+	if (swap) {
+		section_count = byteswap16(section_count);
+	}
+	if (section_count == 0) {
+		return false;
+	}
+	for (unsigned int i = 0; i < section_count && i < 6; i++) {
+		u32 offset;
+		memcpy(&offset, buffer + 16 + (8 * i), 4);
+		if (swap) {
+			offset = byteswap32(offset);
+		}
+		if (offset == 0) {
+			continue;
+		}
+		if (offset + 4 > size) {
+			// The section is past the peeked bytes; ReadNW4R will find out
+			return true;
+		}
+		if (memcmp(buffer + offset, "DATA", 4) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Same check as the fscanf in IsSCCFile and IsMCCFile: the literal, then a digit, a dot and a digit
+static bool8 probeText(const u8* buffer, size_t size, const char* magic) {
+	size_t magic_len = strlen(magic);
+	if (size < magic_len + 3 || memcmp(buffer, magic, magic_len) != 0) {
+		return false;
+	}
+	return buffer[magic_len] >= '0' && buffer[magic_len] <= '9' && buffer[magic_len+1] == '.' && buffer[magic_len+2] >= '0' && buffer[magic_len+2] <= '9';
+}
+
+u8 ProbeFormat(const u8* buffer, size_t size) {
+	if (buffer == NULL) {
+		return CC_FORMAT_UNKNOWN;
+	}
+	if (size >= 4 && memcmp(buffer, "CCX1", 4) == 0) {
+		return CC_FORMAT_CCX;
+	}
+	if (probeNW4R(buffer, size)) {
+		return CC_FORMAT_NW4R;
+	}
+	if (size >= 4 && memcmp(buffer, "\xff\xff\xff\xff", 4) == 0) {
+		return CC_FORMAT_RAW;
+	}
+	if (probeText(buffer, size, "File Format=MacCaption_MCC V")) {
+		return CC_FORMAT_MCC;
+	}
+	if (size >= 3 && buffer[0] == 0xcc && buffer[1] == 0xcc && buffer[2] == 0xed) {
+		return CC_FORMAT_RCWT;
+	}
+	if (probeText(buffer, size, "Scenarist_SCC V")) {
+		return CC_FORMAT_SCC;
+	}
+	return CC_FORMAT_UNKNOWN;
+}
+
+// Same results as GetNW4RField
+u8 ProbeNW4RField(const u8* buffer, size_t size) {
+	if (buffer == NULL || size < 4) {
+		return 254;
+	}
+	if (memcmp(buffer, "BCC1", 4) == 0) {
+		return 0;
+	}
+	if (memcmp(buffer, "BCC2", 4) == 0) {
+		return 1;
+	}
+	return 254;
+}
+
+const char* GetFormatName(u8 format) {
+	return format <= CC_FORMAT_CCX ? format_names[format] : format_names[CC_FORMAT_UNKNOWN];
+}
+
+// Reads up to CC_PROBE_SIZE bytes into buffer, which the caller keeps for the *Prefixed readers
+u8 PeekFormat(FILE* file, u8* buffer, size_t* size) {
+	if (file == NULL) {
+		log_write(LOG_ERROR, use_colors, "PeekFormat: Invalid file descriptor\n");
+		return CC_FORMAT_UNKNOWN;
+	}
+	cc_io io;
+	InitFileIO(&io, file);
+	return PeekFormatIO(&io, buffer, size);
+}
+
+u8 PeekFormatIO(cc_io* io, u8* buffer, size_t* size) {
+	if (io == NULL || buffer == NULL) {
+		log_write(LOG_ERROR, use_colors, "PeekFormat: Invalid file descriptor\n");
+		return CC_FORMAT_UNKNOWN;
+	}
+	f64 started = TraceStart();
+	*size = IORead(io, buffer, CC_PROBE_SIZE);
+	if (io->error) {
+		log_write(LOG_ERROR, use_colors, "PeekFormat: Error reading file (%d: %s)\n", errno, strerror(errno));
+		return CC_FORMAT_UNKNOWN;
+	}
+	u8 format = ProbeFormat(buffer, *size);
+	TraceSpan("probe", started);
+	log_write(LOG_DEBUG, use_colors, "PeekFormat: %s (from %d bytes)\n", GetFormatName(format), (u32) *size);
+	return format;
+}
+
+// prefix holds the first prefix_size bytes of the stream, and file is positioned right after them
+void InitPrefixedFile(cc_prefixed_file* in, FILE* file, const u8* prefix, size_t prefix_size) {
+	InitFileIO(&in->file_io, file);
+	InitPrefixedIO(in, file != NULL ? &in->file_io : NULL, prefix, prefix_size);
+}
+
+void InitPrefixedIO(cc_prefixed_file* in, cc_io* io, const u8* prefix, size_t prefix_size) {
+	in->io = io;
+	in->prefix = prefix;
+	in->prefix_size = prefix == NULL ? 0 : prefix_size;
+	in->prefix_pos = 0;
+	in->position = 0;
+}
+
+// fread, for the prefix and then the file
+size_t PrefixedRead(cc_prefixed_file* in, void* buffer, size_t size) {
+	size_t done = 0;
+	if (in->prefix_pos < in->prefix_size) {
+		done = in->prefix_size - in->prefix_pos < size ? in->prefix_size - in->prefix_pos : size;
+		memcpy(buffer, in->prefix + in->prefix_pos, done);
+		in->prefix_pos += done;
+	}
+	if (done < size) {
+		done += IORead(in->io, ((u8*) buffer) + done, size - done);
+	}
+	in->position += done;
+	return done;
+}
+
+// fgets, for the prefix and then the file; a line can start in the prefix and end in the file
+char* PrefixedGets(cc_prefixed_file* in, char* buffer, int size) {
+	if (size <= 0) {
+		return NULL;
+	}
+	size_t done = 0;
+	size_t max = (size_t) size - 1;
+	while (in->prefix_pos < in->prefix_size && done < max) {
+		char c = (char) in->prefix[in->prefix_pos++];
+		buffer[done++] = c;
+		if (c == '\n') {
+			buffer[done] = 0;
+			in->position += done;
+			return buffer;
+		}
+	}
+	buffer[done] = 0;
+	if (done < max && IOGets(in->io, buffer + done, size - (int) done) != NULL) {
+		done += strlen(buffer + done);
+	}
+	in->position += done;
+	return done != 0 ? buffer : NULL;
+}
+
+// Moves to offset from the start of the stream. Forward moves read through, so they work on pipes;
+// moving back needs a seekable file.
+bool8 PrefixedSkipTo(cc_prefixed_file* in, u64 offset) {
+	if (offset >= in->position) {
+		u8 discard[4096];
+		while (in->position < offset) {
+			size_t want = offset - in->position < sizeof(discard) ? (size_t) (offset - in->position) : sizeof(discard);
+			if (PrefixedRead(in, discard, want) != want) {
+				return false;
+			}
+		}
+		return true;
+	}
+	if (offset < in->prefix_size) {
+		if (in->position > in->prefix_size && !IOSeek(in->io, in->prefix_size)) {
+			return false;
+		}
+		in->prefix_pos = (size_t) offset;
+	}
+	else {
+		if (!IOSeek(in->io, offset)) {
+			return false;
+		}
+		in->prefix_pos = in->prefix_size;
+	}
+	in->position = offset;
+	return true;
+}
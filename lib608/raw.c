@@ -5,9 +5,13 @@ License: GPL v3 or later
 (see License.txt)
 */
 
+#include "config.h" // for HAVE_PREAD and large file support, before any system header
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#if HAVE_PREAD || HAVE_PWRITE || HAVE_FTRUNCATE
+#include <unistd.h>
+#endif
 #include "608.h"
 #include "log.h"
 
@@ -52,20 +56,221 @@ static const ccdata_hdr ccd_header = {
 // number of 0x8080's encountered before output of ReadRaw stops
 unsigned int MAX_NULLS=2;
 
+bool8 InitRawSegmenter(raw_segmenter* seg, f64 fps, bool8 drop) {
+	if (seg == NULL) {
+		log_write(LOG_ERROR, use_colors, "InitRawSegmenter: invalid segmenter pointer\n");
+		return false;
+	}
+	memset(seg, 0, sizeof(raw_segmenter));
+	seg->allocated = 8192;
+	seg->data = malloc(seg->allocated);
+	if (seg->data == NULL) {
+		log_write(LOG_FATAL, use_colors, "InitRawSegmenter: Memory allocation for output data failed\n");
+		return false;
+	}
+	seg->fps = fps;
+	seg->drop = drop;
+	seg->channel = 3; // Assume we're in XDS mode by default
+	StatsBuffer(seg->allocated, false);
+	return true;
+}
+
+bool8 SegmentRawPair(raw_segmenter* seg, u16 cc, s64 frame) {
+	if (cc_active_stats != NULL) {
+		if (cc == 0) {
+			cc_active_stats->padding_in++;
+		}
+		else {
+			cc_active_stats->words_in++;
+		}
+	}
+	if (seg->output) {
+		seg->cc_cnt++;
+	}
+	if (cc == 0 && !seg->output) {
+		return true;
+	}
+	if (cc != 0) {
+		seg->null_cnt = 0;
+	}
+	if (cc == 0 && seg->output) {
+		seg->null_cnt++;
+		// Padding will be auto applied due to how pointers work in C, lol
+	}
+	bool8 was_output = seg->output;
+	if (seg->null_cnt > MAX_NULLS) {
+		seg->cc_cnt -= (seg->null_cnt-1); // safe to set here as this condition can only be triggered by a null, and the very next check will also unset the output flag. -1 due to 1-based index of cc_cnt
+		seg->null_cnt = 0;
+		seg->eol = true;
+		log_write(LOG_TRACE, use_colors, "SegmentRawPair: Null count exceeds %d, setting eol\n", MAX_NULLS);
+	}
+	if (cc == 0 && seg->eol) {
+		seg->eol = false;
+		seg->output = false;
+		log_write(LOG_TRACE, use_colors, "SegmentRawPair: Stopping output\n");
+	}
+	// Check for a repeat CR code (bit 9: channel, bit 12: field)
+	if (!((cc | 0x900) == 0x1d2d) && seg->received_cr) {
+		seg->eol = false;
+		seg->output = false;
+		log_write(LOG_TRACE, use_colors, "SegmentRawPair: Stopping output\n");
+	}
+	bool8 isControlCode = (cc | 0x90f) == 0x1d2f;
+	bool8 isXDS = (cc | 0xf7f) == 0xf7f;
+	if (isControlCode || isXDS) {
+		u16 control_check = cc & 0x2f;
+		u16 xds_check = (cc & 0xf00) >> 8;
+		bool8 isValidXDSCode = isXDS && (xds_check > 0) && (xds_check <= 0xf);
+		if ((isControlCode && ((control_check == 0x20) || (control_check == 0x25) || (control_check == 0x26) || (control_check == 0x27) || (control_check == 0x29) || (control_check == 0x2a) || (control_check == 0x2b))) || (isValidXDSCode && xds_check != 0xf)) {
+			log_write(LOG_TRACE, use_colors, "SegmentRawPair: XDS or control code recieved.\n");
+			int check_channel = 1;
+			bool8 field = (cc & 0x100) >> 8;
+			bool8 bchannel = (cc & 0x800) >> 11;
+			if ((isControlCode && field) || isValidXDSCode) {
+				check_channel += 2;
+			}
+			if (isControlCode && bchannel) {
+				check_channel += 1;
+			}
+			if (seg->cc_cnt > 1 && seg->channel != check_channel) {
+				seg->output = false;
+				log_write(LOG_TRACE, use_colors, "SegmentRawPair: Changing to channel %d from %d\n", check_channel, seg->channel);
+				TraceRecord("channel change", frame, seg->cc_cnt);
+			}
+			if (seg->cc_cnt > 2) {
+				seg->output = false;
+				log_write(LOG_TRACE, use_colors, "SegmentRawPair: Stopping output\n");
+			}
+			seg->channel = check_channel;
+		}
+		if ((isControlCode && ((control_check == 0x2c) || (control_check == 0x2f))) || (isValidXDSCode && xds_check == 0xf)) {
+			log_write(LOG_TRACE, use_colors, "SegmentRawPair: EOC, EDM, or XDS terminator recieved, setting eol\n");
+			seg->eol = true;
+		}
+		if (isControlCode && (control_check == 0x2d)) {
+			seg->received_cr = true;
+		}
+		else {
+			seg->received_cr = false;
+		}
+	}
+	if (was_output && !seg->output) {
+		TraceRecord("segment end", frame, seg->cc_cnt);
+	}
+	scc_entry* entry = (scc_entry*) (((u8*) seg->data) + seg->offset);
+	if (cc != 0 && !seg->output) {
+		log_write(LOG_TRACE, use_colors, "SegmentRawPair: Starting a new record for pts %d\n", (u32) frame);
+		TraceRecord("segment start", frame, 0);
+		if (seg->record_count != 0 && seg->cc_cnt != 1) { // 1-based index; that condition should never happen
+			entry->entry_count = seg->cc_cnt-1;
+			seg->offset += sizeof(scc_entry)+((seg->cc_cnt-1)*sizeof(u16));
+			entry = (scc_entry*) (((u8*) seg->data) + seg->offset);
+		}
+		entry->pts.tc = int2tc(frame, seg->fps, seg->drop);
+		seg->record_count++;
+		if (cc_active_stats != NULL) {
+			cc_active_stats->records_in++;
+		}
+		seg->output = true;
+		seg->cc_cnt = 1;
+	}
+	log_write(LOG_TRACE, use_colors, "SegmentRawPair: CC data @ frame %08x: %04x (%c%c)\n", (u32) frame, cc, cc >> 8, cc & 0xff);
+	entry->entries[seg->cc_cnt-1] = cc;
+	if (seg->allocated - seg->offset < sizeof(u16)*seg->cc_cnt + 0x20) {
+		scc_entry* _cc_data = realloc(seg->data, seg->allocated + 8192);
+		if (_cc_data == NULL) {
+			log_write(LOG_FATAL, use_colors, "SegmentRawPair: Couldn't reallocate output buffer\n");
+			free(seg->data);
+			seg->data = NULL;
+			return false;
+		}
+		seg->data = _cc_data;
+		seg->allocated += 8192;
+		StatsBuffer(seg->allocated, true);
+		log_write(LOG_TRACE, use_colors, "SegmentRawPair: realloc success with %d bytes\n", (u32) seg->allocated);
+	}
+	return true;
+}
+
+// Feeds padding for frames [frame, next_frame), for sources that skip over empty frames
+bool8 SegmentRawGap(raw_segmenter* seg, s64 frame, s64 next_frame) {
+	// Past MAX_NULLS+1 nulls the segmenter's state doesn't change anymore
+	if (next_frame - frame > MAX_NULLS + 2) {
+		if (cc_active_stats != NULL) {
+			cc_active_stats->padding_in += next_frame - (frame + MAX_NULLS + 2);
+		}
+		next_frame = frame + MAX_NULLS + 2;
+	}
+	for (; frame < next_frame; frame++) {
+		if (!SegmentRawPair(seg, 0, frame)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+scc_entry* FinishRawSegmenter(raw_segmenter* seg, size_t* length) {
+	if (seg->data == NULL) {
+		*length = 0;
+		return NULL;
+	}
+	// We've reached the end. Set record count on the last CC entry.
+	if (seg->record_count != 0) {
+		scc_entry* entry = (scc_entry*) (((u8*) seg->data) + seg->offset);
+		entry->entry_count = seg->cc_cnt-1;
+		seg->offset += sizeof(scc_entry)+((seg->cc_cnt-1)*sizeof(u16));
+	}
+	log_write(LOG_DEBUG, use_colors, "FinishRawSegmenter: Wrote %d bytes of CC data, from %d records of input\n", (u32) seg->offset, seg->record_count);
+	*length = seg->offset;
+	scc_entry* ret = seg->data;
+	seg->data = NULL;
+	return ret;
+}
+
+// Hands the records the segmenter has closed to callback and drops them, so only the open record stays in memory
+void DrainRawSegmenter(raw_segmenter* seg, scc_entry_callback callback, void* ctx) {
+	if (seg->data == NULL || seg->offset == 0) {
+		return;
+	}
+	size_t read_bytes = 0;
+	while (read_bytes < seg->offset) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) seg->data) + read_bytes);
+		callback(entry, ctx);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	size_t open_size = sizeof(scc_entry) + (sizeof(u16) * seg->cc_cnt);
+	if (open_size > seg->allocated - seg->offset) {
+		open_size = seg->allocated - seg->offset;
+	}
+	memmove(seg->data, ((u8*) seg->data) + seg->offset, open_size);
+	seg->offset = 0;
+}
+
 scc_entry* ReadRaw(FILE* raw, size_t* length, f32 fps, timecode start, bool8 drop) {
 	if (raw == NULL) {
 		log_write(LOG_ERROR, use_colors, "ReadRaw: invalid file descriptor\n");
 		return NULL;
 	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, raw, NULL, 0);
+	return ReadRawPrefixed(&in, length, fps, start, drop);
+}
+
+// Same as ReadRaw, for a stream whose first bytes were already read (see PeekFormat)
+scc_entry* ReadRawPrefixed(cc_prefixed_file* raw, size_t* length, f32 fps, timecode start, bool8 drop) {
+	if (raw == NULL || raw->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadRaw: invalid file descriptor\n");
+		return NULL;
+	}
 	u8 check[4];
-	if (fread(&check, 1, 4, raw) != 4) {
+	if (PrefixedRead(raw, &check, 4) != 4) {
 		// check read error
-		if (ferror(raw)) {
+		if (raw->io->error) {
 			log_write(LOG_ERROR, use_colors, "ReadRaw: Error reading file (%d: %s)\n", errno, strerror(errno));
 			return NULL;
 		}
 		// check eof
-		else if (feof(raw)) {
+		else if (raw->io->eof) {
 			log_write(LOG_ERROR, use_colors, "ReadRaw: unexpected end of file\n");
 			return NULL;
 		}
@@ -77,149 +282,225 @@ scc_entry* ReadRaw(FILE* raw, size_t* length, f32 fps, timecode start, bool8 dro
 		log_write(LOG_ERROR, use_colors, "ReadRaw: Input is not a raw broadcast file\n");
 		return NULL;
 	}
-	size_t allocated = 8192;
-	scc_entry* cc_data = malloc(allocated);
-	if (cc_data == NULL) {
-		log_write(LOG_FATAL, use_colors, "ReadRaw: Memory allocation for output data failed\n");
+	raw_segmenter seg;
+	if (!InitRawSegmenter(&seg, fps, drop)) {
 		return NULL;
 	}
-	u8* output_ptr = (u8*) cc_data;
-	u8* end_ptr = (u8*) cc_data+allocated;
-	log_write(LOG_TRACE, use_colors, "ReadRaw: *** Pointer Locations ***\n\toutput_ptr 0x%08x\n\tend_ptr 0x%08x\n\tcc_data 0x%08x\n", (u32) output_ptr, (u32) end_ptr, (u32) cc_data);
+	f64 started = StatsStart();
 	s64 current_frame = tc2int(start, fps)-1; // sub 1 due to loop
 	// ftell() = 4, is past the header so go for it!
 	u8 read_ccs[2] = {0, 0};
-	unsigned int null_cnt = 0;
-	unsigned int cc_cnt = 0;
-	int record_count = 0;
-	int channel = 3; // Assume we're in XDS mode by default
-	bool8 output = false;
-	bool8 received_cr = false;
-	bool8 eol = false; // sets frame count on current record
-	while (fread(read_ccs, 1, 2, raw) == 2) {
+	while (PrefixedRead(raw, read_ccs, 2) == 2) {
 		current_frame++;
 		// Get read_ccs into native byte order
-		u16 cc = ((read_ccs[0] << 8) | read_ccs[1]) & 0x7f7f;
-		if (output) {
-			cc_cnt++;
-		}
-		if (cc == 0 && !output) {
-			continue;
-		}
-		if (cc != 0) {
-			null_cnt = 0;
-		}
-		if (cc == 0 && output) {
-			null_cnt++;
-			// Padding will be auto applied due to how pointers work in C, lol
-		}
-		if (null_cnt > MAX_NULLS) {
-			cc_cnt -= (null_cnt-1); // safe to set here as this condition can only be triggered by a null, and the very next check will also unset the output flag. -1 due to 1-based index of cc_cnt
-			null_cnt = 0;
-			eol = true;
-			log_write(LOG_TRACE, use_colors, "ReadRaw: Null count exceeds %d, setting eol\n", MAX_NULLS);
-		}
-		if (cc == 0 && eol) {
-			eol = false;
-			output = false;
-			log_write(LOG_TRACE, use_colors, "ReadRaw: Stopping output\n");
-		}
-		// Check for a repeat CR code (bit 9: channel, bit 12: field)
-		if (!((cc | 0x900) == 0x1d2d) && received_cr) {
-			eol = false;
-			output = false;
-			log_write(LOG_TRACE, use_colors, "ReadRaw: Stopping output\n");
-		}
-		bool8 isControlCode = (cc | 0x90f) == 0x1d2f;
-		bool8 isXDS = (cc | 0xf7f) == 0xf7f;
-		if (isControlCode || isXDS) {
-			u16 control_check = cc & 0x2f;
-			u16 xds_check = (cc & 0xf00) >> 8;
-			bool8 isValidXDSCode = isXDS && (xds_check > 0) && (xds_check <= 0xf);
-			if ((isControlCode && ((control_check == 0x20) || (control_check == 0x25) || (control_check == 0x26) || (control_check == 0x27) || (control_check == 0x29) || (control_check == 0x2a) || (control_check == 0x2b))) || (isValidXDSCode && xds_check != 0xf)) {
-				log_write(LOG_TRACE, use_colors, "ReadRaw: XDS or control code recieved.\n");
-				int check_channel = 1;
-				bool8 field = (cc & 0x100) >> 8;
-				bool8 bchannel = (cc & 0x800) >> 11;
-				if ((isControlCode && field) || isValidXDSCode) {
-					check_channel += 2;
-				}
-				if (isControlCode && bchannel) {
-					check_channel += 1;
-				}
-				if (cc_cnt > 1 && channel != check_channel) {
-					output = false;
-					log_write(LOG_TRACE, use_colors, "ReadRaw: Changing to channel %d from %d\n", check_channel, channel);
-				}
-				if (cc_cnt > 2) {
-					output = false;
-					log_write(LOG_TRACE, use_colors, "ReadRaw: Stopping output\n");
-				}
-				channel = check_channel;
-			}
-			if ((isControlCode && ((control_check == 0x2c) || (control_check == 0x2f))) || (isValidXDSCode && xds_check == 0xf)) {
-				log_write(LOG_TRACE, use_colors, "ReadRaw: EOC, EDM, or XDS terminator recieved, setting eol\n");
-				eol = true;
-			}
-			if (isControlCode && (control_check == 0x2d)) {
-				received_cr = true;
-			}
-			else {
-				received_cr = false;
-			}
+		u16 cc = ((read_ccs[0] << 8) | read_ccs[1]);
+		StatsParity(cc);
+		if (!SegmentRawPair(&seg, cc & 0x7f7f, current_frame)) {
+			return NULL;
 		}
-		if (cc != 0 && !output) {
-			log_write(LOG_TRACE, use_colors, "ReadRaw: Starting a new record for pts %d\n", (u32) current_frame);
-			if (record_count != 0 && cc_cnt != 1) { // 1-based index; that condition should never happen
-				((scc_entry*) output_ptr)->entry_count = cc_cnt-1;
-				output_ptr += sizeof(scc_entry)+((cc_cnt-1)*sizeof(u16));
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += raw->position;
+	}
+	StatsPhase(CC_PHASE_READ, started);
+	return FinishRawSegmenter(&seg, length);
+}
+// Reads count bytes at offset without disturbing the stream's position (so it's safe on a FILE* shared with other readers).
+// Returns the number of bytes read, or -1 on an error.
+static s64 readAt(FILE* raw, u8* buffer, size_t count, s64 offset) {
+#if HAVE_PREAD
+	size_t done = 0;
+	while (done < count) {
+		ssize_t ret = pread(fileno(raw), buffer + done, count - done, (off_t) (offset + done));
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
 			}
-			((scc_entry*) output_ptr)->pts.tc = int2tc(current_frame, fps, drop);
-			record_count++;
-			output = true;
-			cc_cnt = 1;
-		}
-		log_write(LOG_TRACE, use_colors, "ReadRaw: CC data @ frame %08x: %04x (%c%c)\n", (u32) current_frame, cc, cc >> 8, cc & 0xff);
-		((scc_entry*) output_ptr)->entries[cc_cnt-1] = cc;
-		if ((((u32) end_ptr) - ((u32) output_ptr) - sizeof(u16)*cc_cnt) < 0x20) {
-			scc_entry* _cc_data = realloc(cc_data, allocated + 8192);
-			if (_cc_data == NULL) {
-				log_write(LOG_FATAL, use_colors, "ReadRaw: Couldn't reallocate output buffer\n");
-				free(cc_data);
+			return -1;
+		}
+		if (ret == 0) {
+			break;
+		}
+		done += ret;
+	}
+	return done;
+#else
+	if (fseek(raw, (long) offset, SEEK_SET) != 0) {
+		return -1;
+	}
+	size_t done = fread(buffer, 1, count, raw);
+	return ferror(raw) ? -1 : (s64) done;
+#endif
+}
+
+// Segments only frames [first, end) of a raw file (counted from the first byte pair; end < 0 reads to the end of the file).
+// Each frame sits at 4 + 2 * frame in the file, so only the window is read, whatever the file's length.
+// pts are those ReadRaw would give the same frames; a record cut by the window's start begins at its first frame.
+scc_entry* ReadRawWindow(FILE* raw, size_t* length, f32 fps, timecode start, bool8 drop, s64 first, s64 end) {
+	if (raw == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadRawWindow: invalid file descriptor\n");
+		return NULL;
+	}
+	if (first < 0 || (end >= 0 && end < first)) {
+		log_write(LOG_ERROR, use_colors, "ReadRawWindow: invalid window [%d, %d)\n", (s32) first, (s32) end);
+		return NULL;
+	}
+	u8 read_ccs[8192];
+	s64 read_bytes = readAt(raw, read_ccs, 4, 0);
+	if (read_bytes < 0) {
+		log_write(LOG_ERROR, use_colors, "ReadRawWindow: Error reading file (%d: %s)\n", errno, strerror(errno));
+		return NULL;
+	}
+	if (read_bytes != 4 || memcmp(read_ccs, file_header, 4) != 0) {
+		log_write(LOG_ERROR, use_colors, "ReadRawWindow: Input is not a raw broadcast file\n");
+		return NULL;
+	}
+	raw_segmenter seg;
+	if (!InitRawSegmenter(&seg, fps, drop)) {
+		return NULL;
+	}
+	f64 started = StatsStart();
+	s64 current_frame = tc2int(start, fps) + first;
+	s64 offset = 4 + (2 * first);
+	s64 end_offset = end < 0 ? -1 : 4 + (2 * end);
+	while (end_offset < 0 || offset < end_offset) {
+		size_t want = sizeof(read_ccs);
+		if (end_offset >= 0 && end_offset - offset < (s64) want) {
+			want = (size_t) (end_offset - offset);
+		}
+		read_bytes = readAt(raw, read_ccs, want, offset);
+		if (read_bytes < 0) {
+			log_write(LOG_ERROR, use_colors, "ReadRawWindow: Error reading file (%d: %s)\n", errno, strerror(errno));
+			free(seg.data);
+			return NULL;
+		}
+		for (s64 i = 0; i + 1 < read_bytes; i += 2) {
+			u16 cc = ((read_ccs[i] << 8) | read_ccs[i+1]);
+			StatsParity(cc);
+			if (!SegmentRawPair(&seg, cc & 0x7f7f, current_frame)) {
 				return NULL;
 			}
-			log_write(LOG_TRACE, use_colors, "ReadRaw: realloc success with %d bytes\n", allocated);
-			// fix telemetry data
-			output_ptr = (u8*) (((u32) _cc_data) + (((u32) output_ptr) - ((u32) cc_data)));
-			cc_data = _cc_data;
-			_cc_data = NULL;
-			allocated+=8192;
-			end_ptr = (u8*) cc_data+allocated;
-			log_write(LOG_TRACE, use_colors, "ReadRaw: *** Pointer Locations ***\n\toutput_ptr 0x%08x\n\tend_ptr 0x%08x\n\tcc_data 0x%08x\n", (u32) output_ptr, (u32) end_ptr, (u32) cc_data);
+			current_frame++;
+		}
+		offset += read_bytes;
+		if (read_bytes < (s64) want) {
+			break; // end of file
 		}
 	}
-	// We've reached the end. Set record count on the last CC entry.
-	((scc_entry*) output_ptr)->entry_count = cc_cnt-1;
-	output_ptr += sizeof(scc_entry)+((cc_cnt-1)*sizeof(u16));
-	log_write(LOG_DEBUG, use_colors, "ReadRaw: Wrote %d bytes of CC data, from %d records of input\n", ((u32) output_ptr) - ((u32) cc_data), record_count);
-	*length = ((u32) output_ptr) - ((u32) cc_data);
-	return cc_data;
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += 4 + (offset - 4 - (2 * first));
+	}
+	StatsPhase(CC_PHASE_READ, started);
+	log_write(LOG_DEBUG, use_colors, "ReadRawWindow: Read %d bytes from offset %d\n", (u32) (offset - 4 - (2 * first)), (u32) (4 + (2 * first)));
+	return FinishRawSegmenter(&seg, length);
+}
+
+// Calls back once per frame of a raw broadcast file, so readers never need the whole file in memory
+bool8 StreamRaw(FILE* raw, f64 fps, timecode start, cc_pair_callback callback, void* ctx) {
+	if (raw == NULL) {
+		log_write(LOG_ERROR, use_colors, "StreamRaw: invalid file descriptor\n");
+		return false;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, raw, NULL, 0);
+	return StreamRawPrefixed(&in, fps, start, callback, ctx);
 }
+
+bool8 StreamRawPrefixed(cc_prefixed_file* raw, f64 fps, timecode start, cc_pair_callback callback, void* ctx) {
+	if (raw == NULL || raw->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "StreamRaw: invalid file descriptor\n");
+		return false;
+	}
+	u8 check[4];
+	if (PrefixedRead(raw, &check, 4) != 4) {
+		if (raw->io->error) {
+			log_write(LOG_ERROR, use_colors, "StreamRaw: Error reading file (%d: %s)\n", errno, strerror(errno));
+		}
+		else {
+			log_write(LOG_ERROR, use_colors, "StreamRaw: unexpected end of file\n");
+		}
+		return false;
+	}
+	if (memcmp(check, file_header, 4) != 0) {
+		log_write(LOG_ERROR, use_colors, "StreamRaw: Input is not a raw broadcast file\n");
+		return false;
+	}
+	f64 started = StatsStart();
+	s64 first_frame = tc2int(start, fps);
+	s64 current_frame = first_frame;
+	u8 read_ccs[4096];
+	size_t read_size;
+	// PrefixedRead fills the buffer across the end of the prefix, so pairs never straddle two reads
+	while ((read_size = PrefixedRead(raw, read_ccs, sizeof(read_ccs))) >= 2) {
+		for (size_t i = 0; i + 1 < read_size; i += 2) {
+			u16 cc = ((read_ccs[i] << 8) | read_ccs[i+1]);
+			StatsParity(cc);
+			callback(cc & 0x7f7f, current_frame, ctx);
+			current_frame++;
+		}
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += raw->position;
+	}
+	StatsPhase(CC_PHASE_READ, started);
+	if (raw->io->error) {
+		log_write(LOG_ERROR, use_colors, "StreamRaw: Error reading file (%d: %s)\n", errno, strerror(errno));
+		return false;
+	}
+	log_write(LOG_DEBUG, use_colors, "StreamRaw: Read %d frames\n", (u32) (current_frame - first_frame));
+	return true;
+}
+
+typedef struct {
+	cc_decoder* dec;
+	u8 field;
+} raw_decode_ctx;
+
+static void decodeRawPair(u16 cc, s64 frame, void* ctx) {
+	raw_decode_ctx* decode_ctx = (raw_decode_ctx*) ctx;
+	DecodePair(decode_ctx->dec, decode_ctx->field, cc, frame);
+}
+
+// Feeds a raw broadcast file straight into the decoder, one frame per byte pair, without building records
+bool8 DecodeRaw(cc_decoder* dec, FILE* raw, timecode start, u8 field) {
+	raw_decode_ctx decode_ctx = {dec, field};
+	dec->drop = start.drop;
+	return StreamRaw(raw, dec->fps, start, decodeRawPair, &decode_ctx);
+}
+
+bool8 DecodeRawPrefixed(cc_decoder* dec, cc_prefixed_file* raw, timecode start, u8 field) {
+	raw_decode_ctx decode_ctx = {dec, field};
+	dec->drop = start.drop;
+	return StreamRawPrefixed(raw, dec->fps, start, decodeRawPair, &decode_ctx);
+}
+
 scc_entry* ReadNW4R(FILE* nw4r, size_t* length) {
 	if (nw4r == NULL) {
 		log_write(LOG_ERROR, use_colors, "ReadNW4R: Invalid file descriptor\n");
 		return NULL;
 	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, nw4r, NULL, 0);
+	return ReadNW4RPrefixed(&in, length);
+}
+
+// Sections are read in header order, skipping forward to each one, so a pipe works as long as they're laid out in that order (WriteNW4R's always are)
+scc_entry* ReadNW4RPrefixed(cc_prefixed_file* nw4r, size_t* length) {
+	if (nw4r == NULL || nw4r->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadNW4R: Invalid file descriptor\n");
+		return NULL;
+	}
+	f64 started = StatsStart();
 	bcc_hdr header;
-	if (fread(&header, 1, 0x40, nw4r) != 0x40) {
+	if (PrefixedRead(nw4r, &header, 0x40) != 0x40) {
 NW4R_read_error:
 		// check read error
-		if (ferror(nw4r)) {
+		if (nw4r->io->error) {
 			log_write(LOG_ERROR, use_colors, "ReadNW4R: Error reading file (%d: %s)\n", errno, strerror(errno));
 			return NULL;
 		}
 		// check eof
-		else if (feof(nw4r)) {
+		else if (nw4r->io->eof) {
 			log_write(LOG_ERROR, use_colors, "ReadNW4R: unexpected end of file\n");
 			return NULL;
 		}
@@ -248,8 +529,14 @@ NW4R_read_error:
 				continue;
 			}
 			ccdata_hdr data_hdr;
-			fseek(nw4r, (s32) header.sections[i].offset, SEEK_SET);
-			if (fread(&data_hdr, 1, 8, nw4r) != 8) {
+			if (!PrefixedSkipTo(nw4r, header.sections[i].offset)) {
+				if (!nw4r->io->error && !nw4r->io->eof) {
+					log_write(LOG_ERROR, use_colors, "ReadNW4R: Can't seek back to section %d on this input\n", i);
+					return NULL;
+				}
+				goto NW4R_read_error;
+			}
+			if (PrefixedRead(nw4r, &data_hdr, 8) != 8) {
 				goto NW4R_read_error;
 			}
 			if (memcmp(data_hdr.magic, "DATA", 4) == 0) {
@@ -268,13 +555,17 @@ NW4R_read_error:
 					log_write(LOG_FATAL, use_colors, "ReadNW4R: Couldn't allocate output buffer\n");
 					return NULL;
 				}
-				fseek(nw4r, (s32) (header.sections[i].offset+sizeof(ccdata_hdr)), SEEK_SET);
-				*length = fread(out, 1, read_size, nw4r);
-				if (ferror(nw4r)) {
+				if (!PrefixedSkipTo(nw4r, header.sections[i].offset+sizeof(ccdata_hdr))) {
+					*length = 0;
+				}
+				else {
+					*length = PrefixedRead(nw4r, out, read_size);
+				}
+				if (nw4r->io->error) {
 					log_write(LOG_ERROR, use_colors, "ReadNW4R: Error reading file (%d: %s)\n", errno, strerror(errno));
 					// There may be CC data sucessfully read in before an error occurs; for example if the file gets deleted or rewritten midway through the read process, if an external USB/other device is unplugged, or some other I/O error occurs. This is why we do not bother to return NULL here, and since the data has already been malloc'd, it's safe to return the length reported by fread even if it's != 0. And if it is 0, the final output container will be conpletely empty with no additional data.
 				}
-				else if (feof(nw4r)) {
+				else if (nw4r->io->eof) {
 					log_write(LOG_WARN, use_colors, "ReadNW4R: unexpected end of file\n"); // Same message, different log level (here at least some CC data gets returned for sure)
 				}
 				else if (*length != read_size) { // else if, as "unexpected EOF" can cover this case, for example, if an weird I/O error occurs but fread doesn't return an error of any kind
@@ -298,6 +589,12 @@ NW4R_read_error:
 						entry = (scc_entry*) input_ptr;
 					}
 				}
+				if (cc_active_stats != NULL) {
+					cc_active_stats->bytes_in += nw4r->position;
+					StatsBuffer(read_size, false);
+					StatsTrack(out, *length, false);
+				}
+				StatsPhase(CC_PHASE_READ, started);
 				log_write(LOG_DEBUG, use_colors, "ReadNW4R: Read 0x%08x bytes of input\n", *length);
 				return out;
 			}
@@ -313,7 +610,14 @@ NW4R_read_error:
 		return NULL;
 	}
 }
-u32 WriteRaw(scc_entry* in, size_t* length, FILE* out, f32 fps, timecode start, timecode end) {
+u32 WriteRaw(const scc_entry* in, const size_t* length, FILE* out, f32 fps, timecode start, timecode end) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteRawIO(in, length, out != NULL ? &io : NULL, fps, start, end);
+}
+
+// The track goes through a cc_raw_writer a record at a time, so in is only read
+u32 WriteRawIO(const scc_entry* in, const size_t* length, cc_io* out, f32 fps, timecode start, timecode end) {
 	if (in == NULL) {
 		log_write(LOG_FATAL, use_colors, "WriteRaw: invalid input pointer\n");
 		return 0;
@@ -322,90 +626,366 @@ u32 WriteRaw(scc_entry* in, size_t* length, FILE* out, f32 fps, timecode start,
 		log_write(LOG_ERROR, use_colors, "WriteRaw: invalid file descriptor\n");
 		return 0;
 	}
-	unsigned int read_bytes = 0;
-	u8* input_ptr = (u8*) in;
-	scc_entry* entry = (scc_entry*) input_ptr;
-	s64 current_frame = tc2int(start, fps);
-	s64 last_frame = tc2int(end, fps);
-	s64 next_frame = tc2int(default_timecode, fps);
-	s64 first_frame = tc2int(entry->pts.tc, fps);
-	log_write(LOG_TRACE, use_colors, "Start: %d End: %d, Current: %d, Next: %d\n", (u32) first_frame, (u32) last_frame, (u32) current_frame, (u32) next_frame);
-	if (current_frame > last_frame)  {
+	f64 started = StatsStart();
+	cc_raw_writer writer;
+	if (!InitRawWriterIO(&writer, out, fps, start, end)) {
+		StatsPhase(CC_PHASE_WRITE, started);
+		return writer.written_bytes;
+	}
+	size_t read_bytes = 0;
+	while (read_bytes < *length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		if (!WriteRawEntry(&writer, entry)) {
+			break;
+		}
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	u32 written_bytes = FinishRawWriter(&writer);
+	StatsPhase(CC_PHASE_WRITE, started);
+	return written_bytes;
+}
+
+// Writes the raw header; the padding before the first record waits for it, in case it starts before start
+bool8 InitRawWriter(cc_raw_writer* writer, FILE* out, f64 fps, timecode start, timecode end) {
+	if (writer == NULL || out == NULL) {
+		log_write(LOG_ERROR, use_colors, "InitRawWriter: invalid file descriptor\n");
+		return false;
+	}
+	cc_io file_io;
+	InitFileIO(&file_io, out);
+	if (!InitRawWriterIO(writer, &file_io, fps, start, end)) {
+		return false;
+	}
+	writer->file_io = file_io;
+	writer->out = &writer->file_io;
+	return true;
+}
+
+bool8 InitRawWriterIO(cc_raw_writer* writer, cc_io* out, f64 fps, timecode start, timecode end) {
+	if (writer == NULL || out == NULL) {
+		log_write(LOG_ERROR, use_colors, "InitRawWriter: invalid file descriptor\n");
+		return false;
+	}
+	memset(writer, 0, sizeof(cc_raw_writer));
+	writer->out = out;
+	writer->fps = fps;
+	writer->frame = tc2int(start, fps);
+	writer->end_frame = tc2int(end, fps);
+	if (writer->frame > writer->end_frame) {
 		log_write(LOG_WARN, use_colors, "WriteRaw: start > end (adjusting end pts)\n");
-		last_frame = current_frame;
-	}
-	if (first_frame < current_frame) {
-		log_write(LOG_WARN, use_colors, "WriteRaw: start pts of input data before specified start time (using pts of first entry)\n");
-		current_frame = first_frame;
-	}
-	unsigned int written_bytes = fwrite(file_header, 1, 4, out);
-	if (ferror(out)) {
-		goto raw_file_error;
-	}
-	u16 padding_bytes = 0;
-	while(read_bytes < *length) {
-		next_frame = tc2int(entry->pts.tc, fps);
-		log_write(LOG_TRACE, use_colors, "WriteRaw: Next Frame %d\n", (s32) next_frame);
-		if (next_frame < current_frame) {
-			log_write(LOG_ERROR, use_colors, "Timecode %02d:%02hhu:%02hhu%c%02hhu is out of order, or the caption data before it is too big. Aborting.\n", entry->pts.tc.hours, entry->pts.tc.minutes, entry->pts.tc.seconds, entry->pts.tc.drop ? ';' : ':', entry->pts.tc.frames);
-			return written_bytes;
-		}
-		log_write(LOG_TRACE, use_colors, "WriteRaw: 0x8080 padding bytes to write: %d\n", (next_frame - current_frame));
-		for (int i = 0; i < (next_frame - current_frame); i++) {
-			u16 write = fixParity(padding_bytes);
-			written_bytes += fwrite(&write, 2, 1, out);
-			if (ferror(out)) {
-				goto raw_file_error;
+		writer->end_frame = writer->frame;
+	}
+	writer->written_bytes = IOWrite(out, file_header, 4);
+	if (out->error) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		writer->failed = true;
+		return false;
+	}
+	return true;
+}
+
+static bool8 writeRawPadding(cc_raw_writer* writer, s64 count) {
+	u8 padding[256];
+	memset(padding, 0x80, sizeof(padding)); // fixParity(0)
+	while (count > 0) {
+		size_t pairs = count < (s64) (sizeof(padding) / 2) ? (size_t) count : sizeof(padding) / 2;
+		writer->written_bytes += IOWrite(writer->out, padding, 2 * pairs);
+		if (writer->out->error) {
+			log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+			writer->failed = true;
+			return false;
+		}
+		if (cc_active_stats != NULL) {
+			cc_active_stats->padding_out += pairs;
+		}
+		count -= pairs;
+	}
+	return true;
+}
+
+// Pads up to the record's frame and writes its words. Like WriteRaw, an out of order record stops the output for good.
+bool8 WriteRawEntry(cc_raw_writer* writer, const scc_entry* entry) {
+	if (writer->failed) {
+		return false;
+	}
+	s64 next_frame = tc2int(entry->pts.tc, writer->fps);
+	if (!writer->started) {
+		writer->started = true;
+		if (next_frame < writer->frame) {
+			log_write(LOG_WARN, use_colors, "WriteRaw: start pts of input data before specified start time (using pts of first entry)\n");
+			writer->frame = next_frame;
+		}
+	}
+	if (next_frame < writer->frame) {
+		log_write(LOG_ERROR, use_colors, "Timecode %02d:%02hhu:%02hhu%c%02hhu is out of order, or the caption data before it is too big. Aborting.\n", entry->pts.tc.hours, entry->pts.tc.minutes, entry->pts.tc.seconds, entry->pts.tc.drop ? ';' : ':', entry->pts.tc.frames);
+		if (cc_active_stats != NULL) {
+			cc_active_stats->out_of_order++;
+		}
+		writer->failed = true;
+		return false;
+	}
+	if (!writeRawPadding(writer, next_frame - writer->frame)) {
+		return false;
+	}
+	writer->frame = next_frame;
+	TraceRecord("write record", next_frame, entry->entry_count);
+	u8 bytes[512];
+	for (unsigned int i = 0; i < entry->entry_count; i += sizeof(bytes) / 2) {
+		unsigned int pairs = entry->entry_count - i < sizeof(bytes) / 2 ? entry->entry_count - i : sizeof(bytes) / 2;
+		for (unsigned int j = 0; j < pairs; j++) {
+			u16 cc = fixParity(entry->entries[i+j]);
+			bytes[2*j] = (u8) (cc >> 8);
+			bytes[(2*j)+1] = (u8) (cc & 0xff);
+		}
+		writer->written_bytes += IOWrite(writer->out, bytes, 2 * pairs);
+		if (writer->out->error) {
+			log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+			writer->failed = true;
+			return false;
+		}
+	}
+	writer->frame += entry->entry_count;
+	if (cc_active_stats != NULL) {
+		cc_active_stats->records_out++;
+		cc_active_stats->words_out += entry->entry_count;
+	}
+	return true;
+}
+
+// Pads out to the end timecode, or writes the one extra 0x8080 WriteRaw ends with
+u32 FinishRawWriter(cc_raw_writer* writer) {
+	if (!writer->failed) {
+		writeRawPadding(writer, writer->end_frame > writer->frame ? writer->end_frame - writer->frame : 1);
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += writer->written_bytes;
+	}
+	log_write(LOG_DEBUG, use_colors, "FinishRawWriter: wrote %d bytes\n", writer->written_bytes);
+	return writer->written_bytes;
+}
+
+// Writes count bytes at offset without moving the stream's position. Returns false on an error.
+static bool8 writeAt(FILE* raw, const u8* buffer, size_t count, s64 offset) {
+#if HAVE_PWRITE
+	size_t done = 0;
+	while (done < count) {
+		ssize_t ret = pwrite(fileno(raw), buffer + done, count - done, (off_t) (offset + done));
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
 			}
+			return false;
+		}
+		done += ret;
+	}
+	return true;
+#else
+	if (fseek(raw, (long) offset, SEEK_SET) != 0) {
+		return false;
+	}
+	return fwrite(buffer, 1, count, raw) == count && fflush(raw) == 0;
+#endif
+}
+
+// Where WriteRaw puts a track: the frame of the first byte pair, and how many byte pairs follow the header
+static bool8 rawLayout(const scc_entry* in, size_t length, f64 fps, timecode start, timecode end, s64* first, s64* frames) {
+	s64 frame = tc2int(start, fps);
+	s64 end_frame = tc2int(end, fps);
+	if (frame > end_frame) {
+		end_frame = frame;
+	}
+	*first = frame;
+	size_t read_bytes = 0;
+	while (read_bytes < length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		s64 next_frame = tc2int(entry->pts.tc, fps);
+		if (read_bytes == 0 && next_frame < frame) {
+			frame = next_frame;
+			*first = frame;
 		}
-		current_frame+=(next_frame - current_frame);
-		log_write(LOG_TRACE, use_colors, "WriteRaw: Current Frame %d\n", (s32) current_frame);
-		for (unsigned int i = 0; i < entry->entry_count; i++) {
-			log_write(LOG_TRACE, use_colors, "WriteRaw: CC to encode 0x%04x\n", entry->entries[i]);
-			entry->entries[i] = fixParity(entry->entries[i]);
-			u8 bytes[2] = {(u8) ((entry->entries[i] >> 8) & 0xff), (u8) (entry->entries[i] & 0xff)};
-			log_write(LOG_TRACE, use_colors, "WriteRaw: Entry address 0x%08x\n", (u32) &(entry->entries[i]));
-			u8* byte_pair = (u8*) &(entry->entries[i]);
-			byte_pair[0] = bytes[0];
-			byte_pair[1] = bytes[1];
-			log_write(LOG_TRACE, use_colors, "WriteRaw: Encoded CC 0x%02x%02x\n", byte_pair[0], byte_pair[1]);
-		}
-		written_bytes += fwrite(entry->entries, 2, entry->entry_count, out);
-		if (ferror(out)) {
-			goto raw_file_error;
-		}
-		current_frame += entry->entry_count;
-		log_write(LOG_TRACE, use_colors, "WriteRaw: Current Frame %d\n", (u32) current_frame);
+		if (next_frame < frame) {
+			log_write(LOG_ERROR, use_colors, "PatchRaw: Timecode %02d:%02hhu:%02hhu%c%02hhu is out of order, or the caption data before it is too big\n", entry->pts.tc.hours, entry->pts.tc.minutes, entry->pts.tc.seconds, entry->pts.tc.drop ? ';' : ':', entry->pts.tc.frames);
+			return false;
+		}
+		frame = next_frame + entry->entry_count;
 		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
-		input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
-		entry = (scc_entry*) input_ptr;
-		log_write(LOG_TRACE, use_colors, "WriteRaw: *** input_ptr location 0x%08x ***\n\t*** %d bytes left ***\n", (u32) input_ptr, *length - read_bytes);
-	}
-	if (last_frame > current_frame) {
-		for (int i = 0; i < (last_frame - current_frame); i++) {
-			u16 write = fixParity(padding_bytes);
-			written_bytes += fwrite(&write, 2, 1, out);
-			if (ferror(out)) {
-				goto raw_file_error;
+	}
+	*frames = (end_frame > frame ? end_frame : frame + 1) - *first;
+	return true;
+}
+
+// Frame of the cursor's next word, or -1 once it has none left
+static s64 nextWordFrame(const scc_cursor* cursor) {
+	if (SCCCursorDone(cursor)) {
+		return -1;
+	}
+	return cursor->index != 0 || cursor->entry_frame <= cursor->frame ? cursor->frame : cursor->entry_frame;
+}
+
+// Writes the buffered byte pairs from buffer_frame up to (not including) end
+static bool8 writePatch(FILE* raw, const u8* buffer, size_t used, s64 buffer_frame, s64 end, s64 first, cc_patch_report* report) {
+	s64 pairs = end - buffer_frame < (s64) (used / 2) ? end - buffer_frame : (s64) (used / 2);
+	if (pairs <= 0) {
+		return true;
+	}
+	if (!writeAt(raw, buffer, (size_t) (2 * pairs), 4 + (2 * (buffer_frame - first)))) {
+		return false;
+	}
+	report->frames += pairs;
+	report->last_frame = buffer_frame + pairs - 1 - first;
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += 2 * pairs;
+	}
+	return true;
+}
+
+// Rewrites a raw file that WriteRaw made from old (with the same fps, start and end) so that it holds in instead,
+// writing only the frames that differ. The file must be open for reading and writing. It grows or is cut to in's
+// length, so it ends up as WriteRaw would write in. Both tracks have to be in order, as WriteRaw needs them.
+bool8 PatchRaw(FILE* raw, const scc_entry* old, size_t old_length, const scc_entry* in, size_t length, f64 fps, timecode start, timecode end, cc_patch_report* report) {
+	if (old == NULL || in == NULL || report == NULL) {
+		log_write(LOG_FATAL, use_colors, "PatchRaw: invalid input pointer\n");
+		return false;
+	}
+	if (raw == NULL) {
+		log_write(LOG_ERROR, use_colors, "PatchRaw: invalid file descriptor\n");
+		return false;
+	}
+	memset(report, 0, sizeof(cc_patch_report));
+	report->first_frame = -1;
+	report->last_frame = -1;
+	s64 old_first, old_frames, first, frames;
+	if (!rawLayout(old, old_length, fps, start, end, &old_first, &old_frames) || !rawLayout(in, length, fps, start, end, &first, &frames)) {
+		return false;
+	}
+	if (first != old_first) {
+		log_write(LOG_ERROR, use_colors, "PatchRaw: the first caption moved before the start of the file, so every frame moves (write the whole file instead)\n");
+		return false;
+	}
+	// Patching a file that wasn't written from old would put the changes in the wrong places
+	u8 header[4];
+	if (fseek(raw, 0, SEEK_END) != 0 || (s64) ftell(raw) != 4 + (2 * old_frames) || readAt(raw, header, 4, 0) != 4 || memcmp(header, file_header, 4) != 0) {
+		log_write(LOG_ERROR, use_colors, "PatchRaw: the raw file doesn't match the old track\n");
+		return false;
+	}
+	f64 started = StatsStart();
+	scc_cursor old_cursor, new_cursor;
+	InitSCCCursor(&old_cursor, old, old_length, fps, first);
+	InitSCCCursor(&new_cursor, in, length, fps, first);
+	s64 stop = first + frames;
+	s64 old_stop = first + old_frames; // every frame from here on is new to the file
+	u8 buffer[4096];
+	size_t used = 0;
+	s64 range_start = -1; // -1 while no range is open
+	s64 buffer_frame = 0;
+	s64 last_changed = 0;
+	s64 frame = first;
+	while (frame < stop) {
+		if (range_start < 0) {
+			// Padding in both tracks matches, so skip to the next word of either
+			s64 old_next = nextWordFrame(&old_cursor);
+			s64 new_next = nextWordFrame(&new_cursor);
+			s64 next = old_stop < stop ? old_stop : stop;
+			if (old_next >= 0 && old_next < next) {
+				next = old_next;
+			}
+			if (new_next >= 0 && new_next < next) {
+				next = new_next;
 			}
+			if (next > frame) {
+				frame = next;
+				old_cursor.frame = frame;
+				new_cursor.frame = frame;
+				continue;
+			}
+		}
+		u16 old_cc, new_cc;
+		NextSCCWord(&old_cursor, &old_cc);
+		NextSCCWord(&new_cursor, &new_cc);
+		old_cc = fixParity(old_cc);
+		new_cc = fixParity(new_cc);
+		if (frame >= old_stop || old_cc != new_cc) {
+			if (range_start < 0) {
+				range_start = frame;
+				buffer_frame = frame;
+				used = 0;
+				report->ranges++;
+				if (report->first_frame < 0) {
+					report->first_frame = frame - first;
+				}
+			}
+			last_changed = frame;
 		}
+		if (range_start >= 0) {
+			buffer[used++] = (u8) (new_cc >> 8);
+			buffer[used++] = (u8) (new_cc & 0xff);
+			if (frame - last_changed >= CC_PATCH_GAP || frame + 1 == stop) {
+				if (!writePatch(raw, buffer, used, buffer_frame, last_changed + 1, first, report)) {
+					goto PatchRaw_file_error;
+				}
+				TraceRecord("patch range", range_start, (u32) (last_changed + 1 - range_start));
+				range_start = -1;
+			}
+			else if (used == sizeof(buffer)) {
+				if (!writePatch(raw, buffer, used, buffer_frame, buffer_frame + (s64) (used / 2), first, report)) {
+					goto PatchRaw_file_error;
+				}
+				buffer_frame += used / 2;
+				used = 0;
+			}
+		}
+		frame++;
 	}
-	else {
-		// Write an extra 0x8080 at the end to match McPoodle's tools
-		u16 write = fixParity(padding_bytes);
-		written_bytes += fwrite(&write, 2, 1, out);
-		if (ferror(out)) {
-			goto raw_file_error;
+	if (frames != old_frames) {
+		report->resized = true;
+	}
+	if (frames < old_frames) {
+#if HAVE_FTRUNCATE
+		if (ftruncate(fileno(raw), (off_t) (4 + (2 * frames))) != 0) {
+			goto PatchRaw_file_error;
 		}
+#else
+		log_write(LOG_ERROR, use_colors, "PatchRaw: files can't be shortened on this system (write the whole file instead)\n");
+		return false;
+#endif
 	}
-	log_write(LOG_DEBUG, use_colors, "WriteRaw: wrote %d bytes, from %d bytes of input\n", written_bytes, *length);
-	return written_bytes;
-raw_file_error:
+	StatsPhase(CC_PHASE_WRITE, started);
+	log_write(LOG_DEBUG, use_colors, "PatchRaw: rewrote %d ranges, %lld of %lld frames\n", report->ranges, (long long) report->frames, (long long) frames);
+	return true;
+PatchRaw_file_error:
 	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
-	return written_bytes;
+	return false;
 }
 
-u32 WriteNW4R(scc_entry* in, size_t* length, FILE* out, u8 field, bool8 swap) {
+// One record as NW4R stores it, byte-swapped through a copy if swap is set. Returns 0 on a write error.
+static u32 writeNW4RRecord(const scc_entry* entry, cc_io* out, bool8 swap) {
+	if (!swap) {
+		size_t size = sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		u32 written_bytes = IOWrite(out, entry, size);
+		return out->error ? 0 : written_bytes;
+	}
+	scc_entry header;
+	header.pts.raw = byteswap32(entry->pts.raw);
+	header.entry_count = byteswap32(entry->entry_count);
+	u32 written_bytes = IOWrite(out, &header, sizeof(scc_entry));
+	u16 buffer[256];
+	for (unsigned int i = 0; i < entry->entry_count; i += 256) {
+		unsigned int count = entry->entry_count - i < 256 ? entry->entry_count - i : 256;
+		for (unsigned int j = 0; j < count; j++) {
+			buffer[j] = byteswap16(entry->entries[i+j]);
+		}
+		written_bytes += IOWrite(out, buffer, sizeof(u16) * count);
+	}
+	return out->error ? 0 : written_bytes;
+}
+
+u32 WriteNW4R(const scc_entry* in, const size_t* length, FILE* out, u8 field, bool8 swap) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteNW4RIO(in, length, out != NULL ? &io : NULL, field, swap);
+}
+
+u32 WriteNW4RIO(const scc_entry* in, const size_t* length, cc_io* out, u8 field, bool8 swap) {
 	if (in == NULL) {
 		log_write(LOG_FATAL, use_colors, "WriteNW4R: invalid input pointer\n");
 		return 0;
@@ -414,15 +994,74 @@ u32 WriteNW4R(scc_entry* in, size_t* length, FILE* out, u8 field, bool8 swap) {
 		log_write(LOG_ERROR, use_colors, "WriteNW4R: invalid file descriptor\n");
 		return 0;
 	}
+	f64 started = StatsStart();
+	unsigned int written_bytes = WriteNW4RHeaderIO(out, field, swap, *length);
+	if (written_bytes == 0) {
+		return 0;
+	}
+	StatsTrack(in, *length, true);
+	if (!swap) {
+		// Records are already laid out as NW4R stores them
+		written_bytes += IOWrite(out, in, *length);
+		if (out->error) {
+			goto NW4R_file_error;
+		}
+	}
+	else {
+		size_t read_bytes = 0;
+		while (read_bytes < *length) {
+			const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+			u32 entry_bytes = writeNW4RRecord(entry, out, swap);
+			if (entry_bytes == 0) {
+				goto NW4R_file_error;
+			}
+			written_bytes += entry_bytes;
+			read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		}
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += written_bytes;
+	}
+	StatsPhase(CC_PHASE_WRITE, started);
+	log_write(LOG_DEBUG, use_colors, "WriteNW4R: wrote %d bytes, from %d bytes of input\n", written_bytes, *length);
+	return written_bytes;
+NW4R_file_error:
+	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	return written_bytes;
+}
+
+// Writes one record after WriteNW4RHeader, for callers that write a track a record at a time
+u32 WriteNW4REntryIO(const scc_entry* entry, cc_io* out, bool8 swap) {
+	u32 written_bytes = writeNW4RRecord(entry, out, swap);
+	if (written_bytes == 0) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += written_bytes;
+		cc_active_stats->records_out++;
+		cc_active_stats->words_out += entry->entry_count;
+	}
+	return written_bytes;
+}
+
+// Writes the BCC and DATA headers for length bytes of records; the records themselves follow
+u32 WriteNW4RHeader(FILE* out, u8 field, bool8 swap, size_t length) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteNW4RHeaderIO(out != NULL ? &io : NULL, field, swap, length);
+}
+
+u32 WriteNW4RHeaderIO(cc_io* out, u8 field, bool8 swap, size_t length) {
 	field &= 0x1;
 	bcc_hdr header = {0};
 	memcpy(&header, &bcc1_header, sizeof(bcc_hdr));
 	if (field) {
 		header.magic[3] = '2';
 	}
-	header.size = sizeof(bcc_hdr) + sizeof(ccdata_hdr) + *length;
+	header.size = sizeof(bcc_hdr) + sizeof(ccdata_hdr) + length;
 	header.sections[0].offset = sizeof(bcc_hdr);
-	header.sections[0].size = sizeof(ccdata_hdr) + *length;
+	header.sections[0].size = sizeof(ccdata_hdr) + length;
 	if (swap) {
 		header.bom = 0xfffe;
 		header.size = byteswap32(header.size);
@@ -433,45 +1072,38 @@ u32 WriteNW4R(scc_entry* in, size_t* length, FILE* out, u8 field, bool8 swap) {
 		}
 	}
 	header.section_count = byteswap16(header.section_count);
-	unsigned int written_bytes = fwrite(&header, 1, sizeof(bcc_hdr), out);
-	if (ferror(out)) {
-		goto NW4R_file_error;
+	unsigned int written_bytes = IOWrite(out, &header, sizeof(bcc_hdr));
+	if (out->error) {
+		goto NW4R_header_error;
 	}
 	ccdata_hdr s1hdr = {0};
 	memcpy(&s1hdr, &ccd_header, sizeof(ccdata_hdr));
-	s1hdr.size = sizeof(ccdata_hdr) + *length;
+	s1hdr.size = sizeof(ccdata_hdr) + length;
 	if (swap) {
 		s1hdr.size = byteswap32(s1hdr.size);
 	}
-	written_bytes += fwrite(&s1hdr, 1, sizeof(ccdata_hdr), out);
-	if (ferror(out)) {
-		goto NW4R_file_error;
-	}
-	if (swap) {
-		unsigned int read_bytes = 0;
-		u8* input_ptr = (u8*) in;
-		scc_entry* entry = (scc_entry*) input_ptr;
-		unsigned int entry_count = 0;
-		while (read_bytes < *length) {
-			entry_count = entry->entry_count;
-			entry->entry_count = byteswap32(entry_count);
-			entry->pts.raw = byteswap32(entry->pts.raw);
-			for (unsigned int i=0; i < entry_count; i++) {
-				entry->entries[i] = byteswap16(entry->entries[i]);
-			}
-			read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry_count);
-			input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry_count);
-			entry = (scc_entry*) input_ptr;
-		}
-	}
-	written_bytes += fwrite(in, 1, *length, out);
-	if (ferror(out)) {
-		goto NW4R_file_error;
+	written_bytes += IOWrite(out, &s1hdr, sizeof(ccdata_hdr));
+	if (out->error) {
+		goto NW4R_header_error;
 	}
-	log_write(LOG_DEBUG, use_colors, "WriteNW4R: wrote %d bytes, from %d bytes of input\n", written_bytes, *length);
 	return written_bytes;
-NW4R_file_error:
+NW4R_header_error:
 	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+	return 0;
+}
+
+u32 WriteRawHeader(FILE* out) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteRawHeaderIO(out != NULL ? &io : NULL);
+}
+
+u32 WriteRawHeaderIO(cc_io* out) {
+	unsigned int written_bytes = IOWrite(out, file_header, 4);
+	if (out->error) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
 	return written_bytes;
 }
 
@@ -0,0 +1,276 @@
+/*
+rcwt.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h> // llround
+#include "608.h"
+#include "log.h"
+
+// CCExtractor's "raw captions with time" format: an 11 byte header, then blocks of
+// a 64-bit little endian timestamp in ms, a 16-bit little endian triplet count, and cc_data triplets
+
+static const u8 rcwt_header[11] = {
+	0xcc, 0xcc, 0xed, // magic
+	0xcc, // creating program (CCExtractor's id; there isn't one for us)
+	0x00, 0x05, // program version
+	0x00, 0x01, // format version
+	0x00, 0x00, 0x00
+};
+
+// Most blocks hold one frame worth of triplets, but the count field allows for up to 0xffff
+#define RCWT_MAX_TRIPLETS 0xffff
+
+scc_entry* ReadRCWT(FILE* rcwt, size_t* length, scc_entry** field2, size_t* length2, f64 fps, bool8 drop) {
+	if (rcwt == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadRCWT: invalid file descriptor\n");
+		return NULL;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, rcwt, NULL, 0);
+	return ReadRCWTPrefixed(&in, length, field2, length2, fps, drop);
+}
+
+// Same as ReadRCWT, for a stream whose first bytes were already read (see PeekFormat)
+scc_entry* ReadRCWTPrefixed(cc_prefixed_file* rcwt, size_t* length, scc_entry** field2, size_t* length2, f64 fps, bool8 drop) {
+	if (rcwt == NULL || rcwt->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadRCWT: invalid file descriptor\n");
+		return NULL;
+	}
+	f64 stats_started = StatsStart();
+	u8 check[11];
+	if (PrefixedRead(rcwt, check, 11) != 11) {
+		// check read error
+		if (rcwt->io->error) {
+			log_write(LOG_ERROR, use_colors, "ReadRCWT: Error reading file (%d: %s)\n", errno, strerror(errno));
+			return NULL;
+		}
+		// check eof
+		else if (rcwt->io->eof) {
+			log_write(LOG_ERROR, use_colors, "ReadRCWT: unexpected end of file\n");
+			return NULL;
+		}
+		else { // fread was successful but didn't return expected amount of bytes
+			return NULL;
+		}
+	}
+	if (memcmp(check, rcwt_header, 3) != 0) {
+		log_write(LOG_ERROR, use_colors, "ReadRCWT: Input is not an RCWT file\n");
+		return NULL;
+	}
+	if (check[6] != 0 || check[7] != 1) {
+		log_write(LOG_WARN, use_colors, "ReadRCWT: RCWT format version not v0.1, decoding errors may happen\n");
+	}
+	// Only one block is held at a time
+	u8* block = malloc(RCWT_MAX_TRIPLETS * 3);
+	if (block == NULL) {
+		log_write(LOG_FATAL, use_colors, "ReadRCWT: couldn't allocate read buffer\n");
+		return NULL;
+	}
+	raw_segmenter seg1, seg2;
+	if (!InitRawSegmenter(&seg1, fps, drop)) {
+		free(block);
+		return NULL;
+	}
+	if (field2 != NULL && !InitRawSegmenter(&seg2, fps, drop)) {
+		free(seg1.data);
+		free(block);
+		return NULL;
+	}
+	raw_segmenter* segs[2] = {&seg1, field2 != NULL ? &seg2 : NULL};
+	s64 next_frame[2] = {0, 0};
+	bool8 started[2] = {false, false};
+	unsigned int block_count = 0;
+	u8 block_hdr[10];
+	while (PrefixedRead(rcwt, block_hdr, 10) == 10) {
+		s64 fts = 0;
+		for (int i = 7; i >= 0; i--) {
+			fts = (fts << 8) | block_hdr[i];
+		}
+		u16 cc_count = (u16) (block_hdr[8] | (block_hdr[9] << 8));
+		if (PrefixedRead(rcwt, block, 3 * (size_t) cc_count) != 3 * (size_t) cc_count) {
+			log_write(LOG_WARN, use_colors, "ReadRCWT: unexpected end of file in block %d\n", block_count);
+			break;
+		}
+		// Timing comes straight from the timestamp
+		s64 frame = llround((f64) fts * fps / 1000.0f);
+		for (unsigned int i = 0; i < cc_count; i++) {
+			u8* triplet = block + (i*3);
+			if ((triplet[0] & 0x04) == 0 || (triplet[0] & 0x03) > 1) {
+				continue;
+			}
+			u8 field = triplet[0] & 0x01;
+			if (segs[field] == NULL) {
+				continue;
+			}
+			s64 pair_frame = frame;
+			// Extra pairs in the same block, or timestamps that went backwards, go right after the previous pair
+			if (started[field] && pair_frame < next_frame[field]) {
+				pair_frame = next_frame[field];
+			}
+			u16 cc = (u16) ((triplet[1] << 8) | triplet[2]);
+			StatsParity(cc);
+			cc &= 0x7f7f;
+			if (started[field] && !SegmentRawGap(segs[field], next_frame[field], pair_frame)) {
+				goto RCWT_alloc_error;
+			}
+			if (!SegmentRawPair(segs[field], cc, pair_frame)) {
+				goto RCWT_alloc_error;
+			}
+			started[field] = true;
+			next_frame[field] = pair_frame + 1;
+		}
+		block_count++;
+	}
+	if (rcwt->io->error) {
+		log_write(LOG_ERROR, use_colors, "ReadRCWT: Error reading file (%d: %s)\n", errno, strerror(errno));
+	}
+	free(block);
+	block = NULL;
+	// Close the final records, as a raw file would
+	if (!SegmentRawPair(&seg1, 0, next_frame[0]) || (field2 != NULL && !SegmentRawPair(&seg2, 0, next_frame[1]))) {
+		goto RCWT_alloc_error;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += rcwt->position;
+	}
+	StatsPhase(CC_PHASE_READ, stats_started);
+	log_write(LOG_DEBUG, use_colors, "ReadRCWT: Read %d blocks\n", block_count);
+	if (field2 != NULL) {
+		*field2 = FinishRawSegmenter(&seg2, length2);
+	}
+	return FinishRawSegmenter(&seg1, length);
+RCWT_alloc_error:
+	// SegmentRawPair frees the buffer of the segmenter that failed
+	free(seg1.data);
+	if (field2 != NULL) {
+		free(seg2.data);
+	}
+	free(block);
+	return NULL;
+}
+
+u32 WriteRCWT(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, FILE* out, f64 fps) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteRCWTIO(in, length, in2, length2, out != NULL ? &io : NULL, fps);
+}
+
+u32 WriteRCWTIO(const scc_entry* in, const size_t* length, const scc_entry* in2, const size_t* length2, cc_io* out, f64 fps) {
+	if (in == NULL && in2 == NULL) {
+		log_write(LOG_FATAL, use_colors, "WriteRCWT: invalid input pointer\n");
+		return 0;
+	}
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteRCWT: invalid file descriptor\n");
+		return 0;
+	}
+	size_t l1 = in != NULL ? *length : 0;
+	size_t l2 = in2 != NULL ? *length2 : 0;
+	f64 stats_started = StatsStart();
+	unsigned int written_bytes = IOWrite(out, rcwt_header, 11);
+	if (out->error) {
+		goto RCWT_file_error;
+	}
+	s64 current_frame = 0;
+	bool8 have_start = false;
+	if (l1 != 0) {
+		current_frame = tc2int(in->pts.tc, fps);
+		have_start = true;
+	}
+	if (l2 != 0 && (!have_start || tc2int(in2->pts.tc, fps) < current_frame)) {
+		current_frame = tc2int(in2->pts.tc, fps);
+	}
+	s64 last_frame = GetSCCEndFrame(in, l1, fps);
+	s64 end2 = GetSCCEndFrame(in2, l2, fps);
+	if (last_frame < end2) {
+		last_frame = end2;
+	}
+	scc_cursor cursor1, cursor2;
+	InitSCCCursor(&cursor1, in, l1, fps, current_frame);
+	InitSCCCursor(&cursor2, in2, l2, fps, current_frame);
+	unsigned int block_count = 0;
+	// Frames where neither field has caption data are left out; their time is implied by the timestamps
+	for (; current_frame < last_frame; current_frame++) {
+		u16 cc[2];
+		bool8 has[2];
+		has[0] = NextSCCWord(&cursor1, &cc[0]);
+		has[1] = NextSCCWord(&cursor2, &cc[1]);
+		if (!has[0] && !has[1]) {
+			continue;
+		}
+		u8 block[10 + 6];
+		s64 fts = llround((f64) current_frame * 1000.0f / fps);
+		for (int i = 0; i < 8; i++) {
+			block[i] = (u8) ((fts >> (i*8)) & 0xff);
+		}
+		u16 cc_count = 0;
+		u8* block_ptr = block + 10;
+		for (int i = 0; i < 2; i++) {
+			if (!has[i]) {
+				continue;
+			}
+			u16 word = fixParity(cc[i]);
+			*block_ptr++ = (u8) (0x04 | i); // cc_valid, field
+			*block_ptr++ = (u8) (word >> 8);
+			*block_ptr++ = (u8) (word & 0xff);
+			cc_count++;
+		}
+		block[8] = (u8) (cc_count & 0xff);
+		block[9] = (u8) (cc_count >> 8);
+		written_bytes += IOWrite(out, block, 10 + (cc_count*3));
+		if (out->error) {
+			goto RCWT_file_error;
+		}
+		block_count++;
+	}
+	log_write(LOG_DEBUG, use_colors, "WriteRCWT: Wrote %d bytes in %d blocks, from %d bytes of input\n", written_bytes, block_count, (u32) (l1 + l2));
+	goto RCWT_stats;
+RCWT_file_error:
+	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+RCWT_stats:
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += written_bytes;
+		StatsTrack(in, l1, true);
+		StatsTrack(in2, l2, true);
+	}
+	StatsPhase(CC_PHASE_WRITE, stats_started);
+	return written_bytes;
+}
+
+bool8 IsRCWTFile(FILE* file) {
+	bool8 ret = false;
+	if (file == NULL) {
+		log_write(LOG_ERROR, use_colors, "IsRCWTFile: Invalid file descriptor\n");
+		return false;
+	}
+	u8 check[3];
+	if (fread(&check, 1, 3, file) != 3) {
+		// check read error
+		if (ferror(file)) {
+			log_write(LOG_ERROR, use_colors, "IsRCWTFile: Error reading file (%d: %s)\n", errno, strerror(errno));
+			return false;
+		}
+		// check eof
+		else if (feof(file)) {
+			log_write(LOG_ERROR, use_colors, "IsRCWTFile: unexpected end of file\n");
+			fseek(file, 0, SEEK_SET);
+			return false;
+		}
+		else { // fread was successful but didn't return expected amount of bytes
+			fseek(file, 0, SEEK_SET);
+			return false;
+		}
+	}
+	// Seek back to allow input functions and further checks to work properly
+	fseek(file, 0, SEEK_SET);
+	ret = memcmp(check, rcwt_header, 3) == 0;
+	log_write(LOG_DEBUG, use_colors, "IsRCWTFile: %s\n", ret ? "True" : "False");
+	return ret;
+}
@@ -0,0 +1,121 @@
+/*
+retime.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Moves every record of a track to another frame rate, timecode mode, speed or offset.
+// Timecodes are read and written as SMPTE labels with integer math, and each frame is converted as
+// frame * in_den * out_num * speed_den / (in_num * out_den * speed_num), rounded to the nearest frame, so nothing drifts.
+
+// Frames per second a timecode label counts: 30 for 29.97, 24 for 23.976 and so on
+static u32 nominalRate(u32 num, u32 den) {
+	return (num + (den / 2)) / den;
+}
+
+// Dropframe drops 2 labels a minute at 30 fps and 4 at 60, except every tenth minute
+static u32 droppedLabels(u32 nominal) {
+	return nominal == 30 ? 2 : (nominal == 60 ? 4 : 0);
+}
+
+s64 TimecodeToFrame(timecode tc, u32 nominal) {
+	s64 total_minutes = (60 * (s64) tc.hours) + tc.minutes;
+	s64 frame = ((((s64) tc.hours * 3600) + ((s64) tc.minutes * 60) + tc.seconds) * nominal) + tc.frames;
+	u32 dropped = droppedLabels(nominal);
+	if (tc.drop && dropped != 0) {
+		frame -= dropped * (total_minutes - (total_minutes / 10));
+	}
+	return frame;
+}
+
+timecode FrameToTimecode(s64 frame, u32 nominal, bool8 drop) {
+	timecode tc = default_timecode;
+	u32 dropped = droppedLabels(nominal);
+	if (frame < 0 || nominal == 0) {
+		return tc;
+	}
+	if (drop && dropped != 0) {
+		s64 per_ten_minutes = (600 * (s64) nominal) - (9 * dropped);
+		s64 per_minute = (60 * (s64) nominal) - dropped;
+		s64 tens = frame / per_ten_minutes;
+		s64 rest = frame % per_ten_minutes;
+		frame += 9 * dropped * tens;
+		if (rest > dropped) {
+			frame += dropped * ((rest - dropped) / per_minute);
+		}
+	}
+	tc.frames = (u8) (frame % nominal);
+	frame /= nominal;
+	tc.seconds = (u8) (frame % 60);
+	frame /= 60;
+	tc.minutes = (u8) (frame % 60);
+	tc.hours = (s16) (frame / 60);
+	tc.drop = drop && dropped != 0;
+	return tc;
+}
+
+// Retimes in place. Records that end up before frame 0 are removed, which can shrink *length.
+bool8 RetimeSCC(scc_entry* in, size_t* length, const cc_retime* retime, cc_retime_report* report) {
+	if (in == NULL || retime == NULL) {
+		log_write(LOG_FATAL, use_colors, "RetimeSCC: invalid input pointer\n");
+		return false;
+	}
+	if (retime->in_num == 0 || retime->in_den == 0 || retime->out_num == 0 || retime->out_den == 0 || retime->speed_num == 0 || retime->speed_den == 0) {
+		log_write(LOG_ERROR, use_colors, "RetimeSCC: frame rates and speed can't be 0\n");
+		return false;
+	}
+	u32 in_nominal = nominalRate(retime->in_num, retime->in_den);
+	u32 out_nominal = nominalRate(retime->out_num, retime->out_den);
+	bool8 out_drop = retime->out_drop;
+	if (out_drop && droppedLabels(out_nominal) == 0) {
+		log_write(LOG_WARN, use_colors, "RetimeSCC: %d fps has no dropframe timecode (writing non-dropframe)\n", out_nominal);
+		out_drop = false;
+	}
+	s64 numerator = (s64) retime->in_den * retime->out_num * retime->speed_den;
+	s64 denominator = (s64) retime->in_num * retime->out_den * retime->speed_num;
+	memset(report, 0, sizeof(cc_retime_report));
+	f64 started = StatsStart();
+	size_t read_bytes = 0;
+	size_t write_bytes = 0;
+	s64 next_frame = 0;
+	while (read_bytes < *length) {
+		scc_entry* entry = (scc_entry*) (((u8*) in) + read_bytes);
+		size_t entry_size = sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		read_bytes += entry_size;
+		report->records++;
+		s64 frame = TimecodeToFrame(entry->pts.tc, in_nominal);
+		frame = (((2 * frame * numerator) + denominator) / (2 * denominator)) + retime->offset;
+		if (frame < 0) {
+			log_write(LOG_DEBUG, use_colors, "RetimeSCC: %02d:%02hhu:%02hhu%c%02hhu lands before 0 (removing)\n", entry->pts.tc.hours, entry->pts.tc.minutes, entry->pts.tc.seconds, entry->pts.tc.drop ? ';' : ':', entry->pts.tc.frames);
+			report->removed++;
+			continue;
+		}
+		// The retimed track still has to fit in one byte pair per frame
+		if (write_bytes != 0 && frame < next_frame) {
+			report->overlaps++;
+			report->max_overlap = next_frame - frame > report->max_overlap ? next_frame - frame : report->max_overlap;
+		}
+		entry->pts.tc = FrameToTimecode(frame, out_nominal, out_drop);
+		if (write_bytes != read_bytes - entry_size) {
+			memmove(((u8*) in) + write_bytes, entry, entry_size);
+		}
+		write_bytes += entry_size;
+		next_frame = frame + entry->entry_count > next_frame ? frame + entry->entry_count : next_frame;
+	}
+	*length = write_bytes;
+	report->end_frame = next_frame;
+	StatsPhaseSpan(CC_PHASE_PROCESS, "retime", started);
+	if (report->removed != 0) {
+		log_write(LOG_WARN, use_colors, "RetimeSCC: removed %d records that landed before 00:00:00:00\n", report->removed);
+	}
+	if (report->overlaps != 0) {
+		log_write(LOG_WARN, use_colors, "RetimeSCC: %d records overlap the data before them after retiming, by up to %d frames\n", report->overlaps, (s32) report->max_overlap);
+	}
+	log_write(LOG_DEBUG, use_colors, "RetimeSCC: %d records, %d removed, %d overlapping, ends on frame %d\n", report->records, report->removed, report->overlaps, (s32) report->end_frame);
+	return true;
+}
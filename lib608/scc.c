@@ -9,141 +9,496 @@ License: GPL v3 or later
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "608.h"
 #include "log.h"
 
-scc_entry* ReadSCC(FILE* scc, size_t* length) {
-	if (scc == NULL) {
-		log_write(LOG_ERROR, use_colors, "ReadSCC: invalid file descriptor\n");
-		return NULL;
+// Parses the timestamp at the start of an SCC line. Returns false for blank or malformed lines.
+static bool8 parseSCCTimestamp(const char* read_buffer, int line, int record_count, bool8* df, timecode* entry_tc, const char* caller) {
+	s16 hr = 0;
+	u8 min = 0;
+	u8 sec = 0;
+	u8 frames = 0;
+	char drop = ':';
+	if (sscanf(read_buffer, "%hd:%02hhd:%02hhd%c%02hhd", &hr, &min, &sec, &drop, &frames) != 5) {
+		// Could've just been a newline, lol
+		if ((strcmp("\n", read_buffer) != 0) && (strcmp("\r\n", read_buffer) != 0) && (strcmp("\n\r", read_buffer) != 0)) {
+			log_write(LOG_WARN, use_colors, "%s: Malformed timestamp at line %d (ignoring)\n", caller, line);
+			if (cc_active_stats != NULL) {
+				cc_active_stats->malformed_lines++;
+			}
+		}
+		return false;
 	}
+	// assert consistent dropframe status
+	if ((drop == ':') && (*df)) {
+		log_write(LOG_TRACE | LOG_LIBRARY, use_colors, "%s: inconsistent drop frame status, assuming non drop frame\n", caller);
+		*df = false;
+	}
+	else if ((record_count != 0) && ((drop == ';') && (!*df))) {
+		log_write(LOG_TRACE | LOG_LIBRARY, use_colors, "%s: inconsistent drop frame status, assuming drop frame\n", caller);
+		*df = true;
+	}
+	else if (drop == ';') {
+		*df = true;
+	}
+	else if (drop == ':') {
+		*df = false;
+	}
+	else {
+		log_write(LOG_WARN, use_colors, "%s: Malformed timestamp at line %d (ignoring)\n", caller, line);
+		if (cc_active_stats != NULL) {
+			cc_active_stats->malformed_lines++;
+		}
+		return false;
+	}
+	entry_tc->hours = (s16) hr;
+	entry_tc->minutes = (u8) (min & 0x3f);
+	entry_tc->seconds = (u8) (sec & 0x3f);
+	entry_tc->frames = (u8) (frames & 0x7f);
+	entry_tc->drop = (bool8) (*df & 0x1);
+	return true;
+}
+
+// Decodes the byte pairs of an SCC line into entries. Returns how many were decoded.
+static unsigned int parseSCCData(const char* cc_ptr, unsigned int caption_count, u16* entries, int line, const char* caller) {
+	unsigned int decoded_cc_count = 0;
+	u16 cc = 0;
+	for (unsigned int i = 0; i < caption_count; i++) {
+		if (sscanf(cc_ptr+(i*5), "%04hx", &cc) != 1) {
+			log_write(LOG_WARN, use_colors, "%s: Caption data at line %d is invalid\n", caller, line);
+			if (cc_active_stats != NULL) {
+				cc_active_stats->malformed_lines++;
+			}
+			break;
+		}
+		StatsParity(cc);
+		entries[i] = cc & 0x7f7f; // strip parity bits
+		log_write(LOG_TRACE, use_colors, "%s: Decoded caption data: 0x%04hx\n", caller, cc & 0x7f7f);
+		decoded_cc_count++;
+	}
+	return decoded_cc_count;
+}
+
+// Reads and checks the "Scenarist_SCC V1.0" header, up to the end of its line
+static bool8 readSCCHeader(cc_prefixed_file* scc, const char* caller) {
+	char header[64];
 	u8 v1, v2;
-	if (fscanf(scc, "Scenarist_SCC V%1hhd.%1hhd", &v1, &v2) != 2) {
+	u64 start = scc->position;
+	if (PrefixedGets(scc, header, sizeof(header)) == NULL || sscanf(header, "Scenarist_SCC V%1hhd.%1hhd", &v1, &v2) != 2) {
 		// check read error
-		if (ferror(scc)) {
-			log_write(LOG_ERROR, use_colors, "ReadSCC: Error reading file (%d: %s)\n", errno, strerror(errno));
-			return NULL;
+		if (scc->io->error) {
+			log_write(LOG_ERROR, use_colors, "%s: Error reading file (%d: %s)\n", caller, errno, strerror(errno));
+			return false;
 		}
 		// check eof
-		else if (feof(scc)) {
-			log_write(LOG_ERROR, use_colors, "ReadSCC: unexpected end of file\n");
-			return NULL;
+		else if (scc->io->eof && scc->position == 0) {
+			log_write(LOG_ERROR, use_colors, "%s: unexpected end of file\n", caller);
+			return false;
 		}
-		log_write(LOG_ERROR, use_colors, "ReadSCC: Input is not an SCC file\n");
-		return NULL;
+		log_write(LOG_ERROR, use_colors, "%s: Input is not an SCC file\n", caller);
+		return false;
+	}
+	// Whatever else is on the header line goes with it
+	while (strchr(header, '\n') == NULL && PrefixedGets(scc, header, sizeof(header)) != NULL);
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += scc->position - start;
 	}
 	if ((v1 != 1) || (v2 != 0)) {
-		log_write(LOG_WARN, use_colors, "ReadSCC: SCC version not v1.0, decoding errors may happen\n");
+		log_write(LOG_WARN, use_colors, "%s: SCC version not v1.0, decoding errors may happen\n", caller);
 	}
 	log_write(LOG_DEBUG, use_colors, "Found Scenarist SCC file v%hhd.%hhd\n", v1, v2);
+	return true;
+}
+
+typedef struct {
+	char magic[4]; // SCCX
+	u16 bom;
+	u16 version;
+	u64 file_size;
+	s64 file_mtime;
+	u32 count;
+	u32 interval;
+} scc_index_hdr;
+
+static bool8 sccFileStat(FILE* scc, u64* size, s64* mtime) {
+	struct stat st;
+	if (fstat(fileno(scc), &st) != 0) {
+		log_write(LOG_ERROR, use_colors, "Can't stat SCC file (%d: %s)\n", errno, strerror(errno));
+		return false;
+	}
+	*size = (u64) st.st_size;
+	*mtime = (s64) st.st_mtime;
+	return true;
+}
+
+// Parses lines from the current position up to stop (-1: the end of the file), keeping records with frames in [first, end).
+// If index is set, it gets a checkpoint every SCC_INDEX_INTERVAL records. Offsets come from scc->position.
+static scc_entry* readSCCLines(cc_prefixed_file* scc, size_t* length, scc_index* index, s64 first, s64 end, s64 stop, int line, const char* caller) {
 	char* read_buffer = malloc(4096); //overkill, but we gotta cover all the bases
 	if (read_buffer == NULL) {
-		log_write(LOG_FATAL, use_colors, "ReadSCC: couldn't allocate read buffer\n");
+		log_write(LOG_FATAL, use_colors, "%s: couldn't allocate read buffer\n", caller);
 		return NULL;
 	}
+	f64 started = StatsStart();
+	u64 start_position = scc->position;
 	int record_count = 0;
-	int line = 1; //technically we're positioned before the newline at the end of the header so this will still work, lol
 	timecode entry_tc = default_timecode;
-	s16 hr = 0;
-	u8 min = 0;
-	u8 sec = 0;
-	u8 frames = 0;
 	bool8 df = false;
-	char drop = ':';
-	unsigned int allocated = 8192;
+	size_t allocated = 8192;
 	scc_entry* cc_data = malloc(allocated);
 	if (cc_data == NULL) {
-		log_write(LOG_FATAL, use_colors, "ReadSCC: Memory allocation for output data failed\n");
+		log_write(LOG_FATAL, use_colors, "%s: Memory allocation for output data failed\n", caller);
 		free(read_buffer);
 		return NULL;
 	}
-	u8* output_ptr = (u8*) cc_data;
-	u8* end_ptr = (u8*) cc_data+allocated;
-	log_write(LOG_TRACE, use_colors, "ReadSCC: *** Pointer Locations ***\n\toutput_ptr 0x%08x\n\tend_ptr 0x%08x\n\tcc_data 0x%08x\n", (u32) output_ptr, (u32) end_ptr, (u32) cc_data);
-	while (fgets(read_buffer, 4096, scc) != NULL) {
-		if (sscanf(read_buffer, "%hd:%02hhd:%02hhd%c%02hhd", &hr, &min, &sec, &drop, &frames) != 5) {
-			// Could've just been a newline, lol
-			if ((strcmp("\n", read_buffer) == 0) | (strcmp("\r\n", read_buffer) == 0) | (strcmp("\n\r", read_buffer) == 0)) {
-				line++;
-				continue;
-			}
-			else {
-				log_write(LOG_WARN, use_colors, "ReadSCC: Malformed timestamp at line %d (ignoring)\n", line);
-				line++;
-				continue;
-			}
-		}
-		// assert consistent dropframe status
-		if ((drop == ':') && (df)) {
-			log_write(LOG_TRACE | LOG_LIBRARY, use_colors, "ReadSCC: inconsistent drop frame status, assuming non drop frame\n");
-			df = false;
-		}
-		else if ((record_count != 0) && ((drop == ';') && (!df))) {
-			log_write(LOG_TRACE | LOG_LIBRARY, use_colors, "ReadSCC: inconsistent drop frame status, assuming drop frame\n");
-			df = true;
+	size_t checkpoints_allocated = 0;
+	s64 max_frame = -1;
+	if (index != NULL) {
+		index->count = 0;
+		index->checkpoints = NULL;
+	}
+	size_t offset = 0;
+	s64 line_offset = (s64) scc->position;
+	while ((stop < 0 || line_offset < stop) && PrefixedGets(scc, read_buffer, 4096) != NULL) {
+		s64 next_offset = (s64) scc->position;
+		if (!parseSCCTimestamp(read_buffer, line, record_count, &df, &entry_tc, caller)) {
+			line++;
+			line_offset = next_offset;
+			continue;
 		}
-		else if (drop == ';') {
-			df = true;
+		s64 frame = TimecodeToFrame(entry_tc, 30);
+		if (index != NULL && record_count % SCC_INDEX_INTERVAL == 0) {
+			if (index->count == checkpoints_allocated) {
+				checkpoints_allocated = checkpoints_allocated == 0 ? 64 : checkpoints_allocated * 2;
+				scc_checkpoint* _checkpoints = realloc(index->checkpoints, sizeof(scc_checkpoint) * checkpoints_allocated);
+				if (_checkpoints == NULL) {
+					log_write(LOG_FATAL, use_colors, "%s: Couldn't reallocate index\n", caller);
+					goto SCC_read_error;
+				}
+				index->checkpoints = _checkpoints;
+			}
+			scc_checkpoint* checkpoint = &index->checkpoints[index->count++];
+			checkpoint->offset = line_offset;
+			checkpoint->max_before = max_frame;
+			checkpoint->min_after = frame; // minimum of this checkpoint's records for now
+			checkpoint->line = line;
+			checkpoint->reserved = 0;
 		}
-		else if (drop == ':') {
-			df = false;
+		if (index != NULL && frame < index->checkpoints[index->count-1].min_after) {
+			index->checkpoints[index->count-1].min_after = frame;
 		}
-		else {
-			log_write(LOG_WARN, use_colors, "ReadSCC: Malformed timestamp at line %d (ignoring)\n", line);
+		max_frame = frame > max_frame ? frame : max_frame;
+		record_count++;
+		line_offset = next_offset;
+		if (frame < first || (end >= 0 && frame >= end)) {
 			line++;
 			continue;
 		}
-		// write the pts to the output buffer
-		entry_tc.hours = (s16) hr;
-		entry_tc.minutes = (u8) (min & 0x3f);
-		entry_tc.seconds = (u8) (sec & 0x3f);
-		entry_tc.frames = (u8) (frames & 0x7f);
-		entry_tc.drop = (bool8) (df & 0x1);
-		record_count++;
 		char* cc_ptr = read_buffer+12;
 		unsigned int caption_count = strlen(cc_ptr)/5;
-		unsigned int decoded_cc_count = 0;
-		u16 cc = 0;
-		log_write(LOG_TRACE, use_colors, "ReadSCC: %d bytes away from end of allocated memory\n", ((u32) end_ptr) - ((u32) output_ptr));
-		if (((u32) end_ptr) - ((u32) output_ptr) < 8+(caption_count*2)) {
+		log_write(LOG_TRACE, use_colors, "%s: %d bytes away from end of allocated memory\n", caller, (u32) (allocated - offset));
+		if (allocated - offset < sizeof(scc_entry)+(caption_count*sizeof(u16))) {
 			scc_entry* _cc_data = realloc(cc_data, allocated + 8192);
 			if (_cc_data == NULL) {
-				log_write(LOG_FATAL, use_colors, "ReadSCC: Couldn't reallocate output buffer\n");
-				free(read_buffer);
-				free(cc_data);
-				return NULL;
+				log_write(LOG_FATAL, use_colors, "%s: Couldn't reallocate output buffer\n", caller);
+				goto SCC_read_error;
 			}
-			log_write(LOG_TRACE, use_colors, "ReadSCC: realloc success with %d bytes\n", allocated);
-			// fix telemetry data
-			output_ptr = (u8*) (((u32) _cc_data) + (((u32) output_ptr) - ((u32) cc_data)));
+			log_write(LOG_TRACE, use_colors, "%s: realloc success with %d bytes\n", caller, (u32) allocated);
 			cc_data = _cc_data;
 			_cc_data = NULL;
 			allocated+=8192;
-			end_ptr = (u8*) cc_data+allocated;
-			log_write(LOG_TRACE, use_colors, "ReadSCC: *** Pointer Locations ***\n\toutput_ptr 0x%08x\n\tend_ptr 0x%08x\n\tcc_data 0x%08x\n", (u32) output_ptr, (u32) end_ptr, (u32) cc_data);
+			StatsBuffer(allocated, true);
+		}
+		scc_entry* entry = (scc_entry*) (((u8*) cc_data) + offset);
+		entry->pts.tc = entry_tc;
+		entry->entry_count = parseSCCData(cc_ptr, caption_count, entry->entries, line, caller);
+		if (cc_active_stats != NULL) {
+			cc_active_stats->records_in++;
+			cc_active_stats->words_in += entry->entry_count;
+		}
+		offset += sizeof(scc_entry)+(entry->entry_count*sizeof(u16));
+		log_write(LOG_TRACE, use_colors, "%s: %d entries written for CC record %d (SCC line %d) @ %08x\n", caller, entry->entry_count, record_count, line, (u32) offset);
+		line++;
+	}
+	if (index != NULL) {
+		// Each checkpoint holds its own records' minimum; carry the later ones back
+		for (s64 i = (s64) index->count - 2; i >= 0; i--) {
+			if (index->checkpoints[i+1].min_after < index->checkpoints[i].min_after) {
+				index->checkpoints[i].min_after = index->checkpoints[i+1].min_after;
+			}
 		}
-		((scc_entry*) output_ptr)->pts.tc = entry_tc;
-		for (unsigned int i = 0; i < caption_count; i++) {
-			if (sscanf(cc_ptr+(i*5), "%04hx", &cc) != 1) {
-				log_write(LOG_WARN, use_colors, "ReadSCC: Caption data at line %d is invalid\n", line);
+	}
+	free(read_buffer);
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += scc->position - start_position;
+		StatsBuffer(allocated, false);
+	}
+	StatsPhase(CC_PHASE_READ, started);
+	log_write(LOG_DEBUG, use_colors, "%s: Wrote %d bytes of CC data, from %d lines of input\n", caller, (u32) offset, line);
+	*length = offset;
+	return cc_data;
+SCC_read_error:
+	free(read_buffer);
+	free(cc_data);
+	if (index != NULL) {
+		FreeSCCIndex(index);
+	}
+	return NULL;
+}
+
+scc_entry* ReadSCC(FILE* scc, size_t* length) {
+	if (scc == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadSCC: invalid file descriptor\n");
+		return NULL;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, scc, NULL, 0);
+	return ReadSCCPrefixed(&in, length);
+}
+
+// Same as ReadSCC, for a stream whose first bytes were already read (see PeekFormat)
+scc_entry* ReadSCCPrefixed(cc_prefixed_file* scc, size_t* length) {
+	if (scc == NULL || scc->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadSCC: invalid file descriptor\n");
+		return NULL;
+	}
+	if (!readSCCHeader(scc, "ReadSCC")) {
+		return NULL;
+	}
+	return readSCCLines(scc, length, NULL, 0, -1, -1, 2, "ReadSCC");
+}
+
+// Same as ReadSCC, and also fills a seek index for ReadSCCRange; free it with FreeSCCIndex
+scc_entry* ReadSCCIndexed(FILE* scc, size_t* length, scc_index* index) {
+	return ReadSCCRangeIndexed(scc, length, index, 0, -1);
+}
+
+// Same as ReadSCCRange without an index, and fills one for the whole file on the way, so a missing index
+// costs only the parse that was needed anyway
+scc_entry* ReadSCCRangeIndexed(FILE* scc, size_t* length, scc_index* index, s64 first, s64 end) {
+	if (scc == NULL || index == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadSCCIndexed: invalid file descriptor\n");
+		return NULL;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, scc, NULL, 0);
+	// Checkpoints are offsets from the start of the file, so read it from the top
+	if (fseek(scc, 0, SEEK_SET) != 0 || !sccFileStat(scc, &index->file_size, &index->file_mtime) || !readSCCHeader(&in, "ReadSCCIndexed")) {
+		return NULL;
+	}
+	scc_entry* ret = readSCCLines(&in, length, index, first, end, -1, 2, "ReadSCCIndexed");
+	if (ret != NULL) {
+		log_write(LOG_DEBUG, use_colors, "ReadSCCIndexed: %d checkpoints\n", index->count);
+	}
+	return ret;
+}
+
+// Reads only the records with frames in [first, end) (end < 0 reads to the end). With an index, parsing starts at the
+// last checkpoint that nothing in the range can come before, and stops once nothing later can fall in the range.
+scc_entry* ReadSCCRange(FILE* scc, size_t* length, const scc_index* index, s64 first, s64 end) {
+	if (scc == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadSCCRange: invalid file descriptor\n");
+		return NULL;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, scc, NULL, 0);
+	// Checkpoints are file offsets, so always start from the top
+	if (fseek(scc, 0, SEEK_SET) != 0 || !readSCCHeader(&in, "ReadSCCRange")) {
+		return NULL;
+	}
+	s64 stop = -1;
+	int line = 2;
+	if (index != NULL && index->count != 0) {
+		u32 start = 0;
+		while (start + 1 < index->count && index->checkpoints[start+1].max_before < first) {
+			start++;
+		}
+		for (u32 i = start + 1; end >= 0 && i < index->count; i++) {
+			if (index->checkpoints[i].min_after >= end) {
+				stop = index->checkpoints[i].offset;
 				break;
 			}
-			((scc_entry*) output_ptr)->entries[i] = cc & 0x7f7f; // strip parity bits
-			log_write(LOG_TRACE, use_colors, "ReadSCC: Decoded caption data: 0x%04hx\n", cc & 0x7f7f);
-			decoded_cc_count++;
 		}
-		((scc_entry*) output_ptr)->entry_count = decoded_cc_count;
-		output_ptr+=sizeof(scc_entry)+(decoded_cc_count*sizeof(u16));
-		log_write(LOG_TRACE, use_colors, "ReadSCC: %d entries written for CC record %d (SCC line %d) @ %08x\n", decoded_cc_count, record_count, line, (u32) output_ptr);
+		if (fseek(scc, (long) index->checkpoints[start].offset, SEEK_SET) != 0) {
+			log_write(LOG_ERROR, use_colors, "ReadSCCRange: Error seeking file (%d: %s)\n", errno, strerror(errno));
+			return NULL;
+		}
+		in.position = (u64) index->checkpoints[start].offset;
+		line = index->checkpoints[start].line;
+		log_write(LOG_DEBUG, use_colors, "ReadSCCRange: parsing from line %d (offset %d) to offset %d\n", line, (u32) index->checkpoints[start].offset, (s32) stop);
+	}
+	return readSCCLines(&in, length, NULL, first, end, stop, line, "ReadSCCRange");
+}
+
+u32 WriteSCCIndex(const scc_index* index, FILE* out) {
+	if (index == NULL || out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteSCCIndex: invalid file descriptor\n");
+		return 0;
+	}
+	scc_index_hdr header = {
+		.magic = "SCCX",
+		.bom = 0xfeff,
+		.version = 1,
+		.file_size = index->file_size,
+		.file_mtime = index->file_mtime,
+		.count = index->count,
+		.interval = SCC_INDEX_INTERVAL
+	};
+	u32 written_bytes = fwrite(&header, 1, sizeof(header), out);
+	written_bytes += fwrite(index->checkpoints, 1, sizeof(scc_checkpoint) * index->count, out);
+	if (ferror(out)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
+	log_write(LOG_DEBUG, use_colors, "WriteSCCIndex: Wrote %d checkpoints\n", index->count);
+	return written_bytes;
+}
+
+bool8 ReadSCCIndex(FILE* in, scc_index* index) {
+	if (in == NULL || index == NULL) {
+		log_write(LOG_ERROR, use_colors, "ReadSCCIndex: invalid file descriptor\n");
+		return false;
+	}
+	scc_index_hdr header;
+	if (fread(&header, 1, sizeof(header), in) != sizeof(header) || memcmp(header.magic, "SCCX", 4) != 0 || header.bom != 0xfeff || header.version != 1) {
+		log_write(LOG_WARN, use_colors, "ReadSCCIndex: not an SCC index written by this version (ignoring)\n");
+		return false;
+	}
+	index->file_size = header.file_size;
+	index->file_mtime = header.file_mtime;
+	index->count = header.count;
+	index->checkpoints = malloc(sizeof(scc_checkpoint) * (header.count != 0 ? header.count : 1));
+	if (index->checkpoints == NULL) {
+		log_write(LOG_FATAL, use_colors, "ReadSCCIndex: Couldn't allocate %d checkpoints\n", header.count);
+		return false;
+	}
+	if (fread(index->checkpoints, sizeof(scc_checkpoint), header.count, in) != header.count) {
+		log_write(LOG_WARN, use_colors, "ReadSCCIndex: index is truncated (ignoring)\n");
+		FreeSCCIndex(index);
+		return false;
+	}
+	return true;
+}
+
+// An index is stale once the SCC file's size or modification time changed
+bool8 IsSCCIndexCurrent(const scc_index* index, FILE* scc) {
+	u64 size;
+	s64 mtime;
+	if (index == NULL || scc == NULL || !sccFileStat(scc, &size, &mtime)) {
+		return false;
+	}
+	bool8 ret = size == index->file_size && mtime == index->file_mtime;
+	log_write(LOG_DEBUG, use_colors, "IsSCCIndexCurrent: %s\n", ret ? "True" : "False");
+	return ret;
+}
+
+void FreeSCCIndex(scc_index* index) {
+	free(index->checkpoints);
+	index->checkpoints = NULL;
+	index->count = 0;
+}
+
+// Hands each record to callback as its line is parsed, so only one line is held at a time
+static bool8 streamSCCLines(cc_prefixed_file* scc, scc_entry_callback callback, void* ctx, const char* caller) {
+	if (!readSCCHeader(scc, caller)) {
+		return false;
+	}
+	char* read_buffer = malloc(4096 + sizeof(scc_entry) + (sizeof(u16) * (4096/5)));
+	if (read_buffer == NULL) {
+		log_write(LOG_FATAL, use_colors, "%s: couldn't allocate read buffer\n", caller);
+		return false;
+	}
+	// One line's worth of record lives right after the line buffer
+	scc_entry* entry = (scc_entry*) (read_buffer + 4096);
+	f64 started = StatsStart();
+	u64 start_position = scc->position;
+	int record_count = 0;
+	int line = 2;
+	bool8 df = false;
+	while (PrefixedGets(scc, read_buffer, 4096) != NULL) {
+		if (!parseSCCTimestamp(read_buffer, line, record_count, &df, &entry->pts.tc, caller)) {
+			line++;
+			continue;
+		}
+		record_count++;
+		char* cc_ptr = read_buffer+12;
+		entry->entry_count = parseSCCData(cc_ptr, strlen(cc_ptr)/5, entry->entries, line, caller);
+		if (cc_active_stats != NULL) {
+			cc_active_stats->records_in++;
+			cc_active_stats->words_in += entry->entry_count;
+		}
+		callback(entry, ctx);
 		line++;
 	}
-	//free(read_buffer); // (apparently done by fgets above upon eof)
-	log_write(LOG_DEBUG, use_colors, "ReadSCC: Wrote %d bytes of CC data, from %d lines of input\n", ((u32) output_ptr) - ((u32) cc_data), line);
-	*length = ((u32) output_ptr) - ((u32) cc_data);
-	return cc_data;
+	free(read_buffer);
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_in += scc->position - start_position;
+	}
+	StatsPhase(CC_PHASE_READ, started);
+	if (scc->io->error) {
+		log_write(LOG_ERROR, use_colors, "%s: Error reading file (%d: %s)\n", caller, errno, strerror(errno));
+		return false;
+	}
+	log_write(LOG_DEBUG, use_colors, "%s: Read %d records from %d lines of input\n", caller, record_count, line);
+	return true;
+}
+
+bool8 StreamSCC(FILE* scc, scc_entry_callback callback, void* ctx) {
+	if (scc == NULL) {
+		log_write(LOG_ERROR, use_colors, "StreamSCC: invalid file descriptor\n");
+		return false;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, scc, NULL, 0);
+	return streamSCCLines(&in, callback, ctx, "StreamSCC");
+}
+
+bool8 StreamSCCPrefixed(cc_prefixed_file* scc, scc_entry_callback callback, void* ctx) {
+	if (scc == NULL || scc->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "StreamSCC: invalid file descriptor\n");
+		return false;
+	}
+	return streamSCCLines(scc, callback, ctx, "StreamSCC");
+}
+
+typedef struct {
+	cc_decoder* dec;
+	u8 field;
+} scc_decode_ctx;
+
+static void decodeSCCEntry(const scc_entry* entry, void* ctx) {
+	scc_decode_ctx* decode_ctx = (scc_decode_ctx*) ctx;
+	DecodeEntry(decode_ctx->dec, entry, decode_ctx->field);
+}
+
+// Streams an SCC file through the decoder a line at a time
+bool8 DecodeSCCFile(cc_decoder* dec, FILE* scc, u8 field) {
+	if (scc == NULL) {
+		log_write(LOG_ERROR, use_colors, "DecodeSCCFile: invalid file descriptor\n");
+		return false;
+	}
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, scc, NULL, 0);
+	return DecodeSCCFilePrefixed(dec, &in, field);
+}
+
+bool8 DecodeSCCFilePrefixed(cc_decoder* dec, cc_prefixed_file* scc, u8 field) {
+	if (scc == NULL || scc->io == NULL) {
+		log_write(LOG_ERROR, use_colors, "DecodeSCCFile: invalid file descriptor\n");
+		return false;
+	}
+	scc_decode_ctx decode_ctx = {dec, field};
+	return streamSCCLines(scc, decodeSCCEntry, &decode_ctx, "DecodeSCCFile");
+}
+
+u32 WriteSCC(const scc_entry* in, const size_t* length, FILE* out) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteSCCIO(in, length, out != NULL ? &io : NULL);
 }
 
-u32 WriteSCC(scc_entry* in, size_t* length, FILE* out) {
+u32 WriteSCCIO(const scc_entry* in, const size_t* length, cc_io* out) {
 	if (in == NULL) {
 		log_write(LOG_FATAL, use_colors, "WriteSCC: invalid input pointer\n");
 		return 0;
@@ -152,48 +507,81 @@ u32 WriteSCC(scc_entry* in, size_t* length, FILE* out) {
 		log_write(LOG_ERROR, use_colors, "WriteSCC: invalid file descriptor\n");
 		return 0;
 	}
+	f64 started = StatsStart();
 	// Start with the SCC header...
-	char* out_buf = (char*) malloc(4096); // is this overkill?
-	if (out_buf == NULL) {
-		log_write(LOG_FATAL, use_colors, "WriteSCC: Couldn't allocate output buffer\n");
+	u32 written_bytes = WriteSCCHeaderIO(out);
+	if (written_bytes == 0) {
 		return 0;
 	}
-	sprintf(out_buf, "Scenarist_SCC V%1hhd.%1hhd\n", 1, 0); // TODO: Write the appropriate newline bytes for the host, instead of hardcoding Unix newlines (ReadSCC already accounts for this)
-	unsigned int written_bytes = fwrite(out_buf, 1, strlen(out_buf), out);
-	if (ferror(out)) {
-		goto SCC_file_error;
-	}
-	unsigned int read_bytes = 0;
-	u8* input_ptr = (u8*) in;
-	scc_entry* entry = (scc_entry*) input_ptr;
-	unsigned int entry_count = 0;
+	size_t read_bytes = 0;
 	while (read_bytes < *length) {
-		// The timestamp
-		timecode ts = entry->pts.tc;
-		sprintf(out_buf, "\n%02d:%02hhd:%02hhd%c%02hhd\t", ts.hours, ts.minutes, ts.seconds, ts.drop ? ';' : ':', ts.frames); 
-		written_bytes += fwrite(out_buf, 1, strlen(out_buf), out);
-		if (ferror(out)) {
-			goto SCC_file_error;
-		}
-		// The entries
-		entry_count = entry->entry_count;
-		log_write(LOG_DEBUG, use_colors, "WriteSCC: processing %d records for pts 0x%08x\n", entry_count, entry->pts.raw);
-		for (unsigned int i=0; i < entry_count; i++) {
-			sprintf(out_buf, "%04hx%c", fixParity(entry->entries[i]), (i + 1) == entry_count ? '\n' : ' ');
-			written_bytes += fwrite(out_buf, 1, strlen(out_buf), out);
-			if (ferror(out)) {
-				goto SCC_file_error;
-			}
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		log_write(LOG_DEBUG, use_colors, "WriteSCC: processing %d records for pts 0x%08x\n", entry->entry_count, entry->pts.raw);
+		u32 entry_bytes = WriteSCCEntryIO(entry, out);
+		if (entry_bytes == 0) {
+			StatsPhase(CC_PHASE_WRITE, started);
+			return written_bytes;
 		}
-		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry_count);
-		input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry_count);
-		entry = (scc_entry*) input_ptr;
+		written_bytes += entry_bytes;
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
 	}
+	StatsPhase(CC_PHASE_WRITE, started);
 	log_write(LOG_DEBUG, use_colors, "WriteSCC: Wrote %d bytes, from %d bytes of input\n", written_bytes, *length);
-	free(out_buf);
 	return written_bytes;
-SCC_file_error:
-	log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+}
+
+u32 WriteSCCHeader(FILE* out) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteSCCHeaderIO(out != NULL ? &io : NULL);
+}
+
+u32 WriteSCCHeaderIO(cc_io* out) {
+	char header[32];
+	sprintf(header, "Scenarist_SCC V%1hhd.%1hhd\n", 1, 0); // TODO: Write the appropriate newline bytes for the host, instead of hardcoding Unix newlines (ReadSCC already accounts for this)
+	u32 written_bytes = IOWrite(out, header, strlen(header));
+	if (out->error) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += written_bytes;
+	}
+	return written_bytes;
+}
+
+// Writes one record as an SCC line (with the blank line before it). Returns 0 on a write error.
+u32 WriteSCCEntry(const scc_entry* entry, FILE* out) {
+	cc_io io;
+	InitFileIO(&io, out);
+	return WriteSCCEntryIO(entry, out != NULL ? &io : NULL);
+}
+
+u32 WriteSCCEntryIO(const scc_entry* entry, cc_io* out) {
+	char out_buf[4096];
+	size_t used = 0;
+	u32 written_bytes = 0;
+	// The timestamp
+	timecode ts = entry->pts.tc;
+	used += sprintf(out_buf, "\n%02d:%02hhd:%02hhd%c%02hhd\t", ts.hours, ts.minutes, ts.seconds, ts.drop ? ';' : ':', ts.frames);
+	// The entries
+	for (unsigned int i = 0; i < entry->entry_count; i++) {
+		if (sizeof(out_buf) - used < 8) {
+			written_bytes += IOWrite(out, out_buf, used);
+			used = 0;
+		}
+		used += sprintf(out_buf + used, "%04hx%c", fixParity(entry->entries[i]), (i + 1) == entry->entry_count ? '\n' : ' ');
+	}
+	written_bytes += IOWrite(out, out_buf, used);
+	if (out->error) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->bytes_out += written_bytes;
+		cc_active_stats->records_out++;
+		cc_active_stats->words_out += entry->entry_count;
+	}
 	return written_bytes;
 }
 
@@ -0,0 +1,330 @@
+/*
+schedule.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h> // llround
+#include "608.h"
+#include "log.h"
+
+// Fits caption data into the 2 bytes per frame of line 21.
+// Record i has to start at or after the end of record i-1. With S_i the number of words before record i,
+// u_i = pts_i - S_i only has to be non-decreasing, so the least squares fit of u to the requested times is
+// an isotonic regression, solved in one pass by pooling adjacent violators. Records that fit stay where they are;
+// clashing runs are spread around their requested times, loading some earlier (pre-roll) and delaying others.
+
+typedef struct {
+	s64 sum; // sum of the requested u of the records in the block
+	s64 count;
+	size_t last; // index of the last record in the block
+} schedule_block;
+
+// Steps a timecode by one frame, skipping the frame numbers dropframe leaves out
+static void nextFrame(timecode* tc, u8 frame_count) {
+	if (++tc->frames < frame_count) {
+		return;
+	}
+	tc->frames = 0;
+	if (++tc->seconds > 59) {
+		tc->seconds = 0;
+		if (++tc->minutes > 59) {
+			tc->minutes = 0;
+			tc->hours++;
+		}
+		if (tc->drop && (tc->minutes % 10) != 0) {
+			tc->frames = 2;
+		}
+	}
+}
+
+static void previousFrame(timecode* tc, u8 frame_count) {
+	u8 first = (tc->drop && tc->seconds == 0 && (tc->minutes % 10) != 0) ? 2 : 0;
+	if (tc->frames > first) {
+		tc->frames--;
+		return;
+	}
+	tc->frames = (u8) (frame_count - 1);
+	if (tc->seconds-- == 0) {
+		tc->seconds = 59;
+		if (tc->minutes-- == 0) {
+			tc->minutes = 59;
+			tc->hours--;
+		}
+	}
+}
+
+// int2tc can be a second off around minute boundaries, and WriteRaw places records with tc2int,
+// so look around its answer for the first timecode that tc2int maps to (or past) the frame
+static timecode frameTimecode(s64 frame, f64 fps, bool8 drop) {
+	u8 frame_count = (u8) (fps + 0.5f);
+	timecode tc = int2tc(frame, fps, drop);
+	for (u32 i = 0; i < 2u * frame_count && tc2int(tc, fps) > frame; i++) {
+		if (tc.hours == 0 && tc.minutes == 0 && tc.seconds == 0 && tc.frames == 0) {
+			break;
+		}
+		previousFrame(&tc, frame_count);
+	}
+	for (u32 i = 0; i < 4u * frame_count && tc2int(tc, fps) < frame; i++) {
+		nextFrame(&tc, frame_count);
+	}
+	return tc;
+}
+
+// Puts a record on the frame it was scheduled to, and counts the move in the report.
+// warn_shift only picks the moves worth a warning; nothing limits how far a record goes.
+static void moveRecord(scc_entry* entry, s64 requested, s64 frame, f64 fps, s64 warn_shift, cc_schedule_report* report) {
+	s64 shift = frame - requested;
+	if (shift != 0) {
+		TraceRecord("reschedule", frame, entry->entry_count);
+		timecode old_tc = entry->pts.tc;
+		entry->pts.tc = frameTimecode(frame, fps, old_tc.drop);
+		s64 error = shift < 0 ? -shift : shift;
+		report->moved++;
+		report->total_error += error;
+		if (shift < 0) {
+			report->early++;
+			report->max_early = error > report->max_early ? error : report->max_early;
+		}
+		else {
+			report->late++;
+			report->max_late = error > report->max_late ? error : report->max_late;
+		}
+		if (error > warn_shift) {
+			report->over_warn_shift++;
+		}
+		log_write(error > warn_shift ? LOG_WARN : LOG_DEBUG, use_colors, "ScheduleSCC: %02d:%02hhu:%02hhu%c%02hhu moved %d frames to %02d:%02hhu:%02hhu%c%02hhu%s\n", old_tc.hours, old_tc.minutes, old_tc.seconds, old_tc.drop ? ';' : ':', old_tc.frames, (s32) shift, entry->pts.tc.hours, entry->pts.tc.minutes, entry->pts.tc.seconds, entry->pts.tc.drop ? ';' : ':', entry->pts.tc.frames, error > warn_shift ? " (over warning threshold)" : "");
+	}
+}
+
+bool8 ScheduleSCC(scc_entry* in, size_t* length, f64 fps, s64 warn_shift, cc_schedule_report* report) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "ScheduleSCC: invalid input pointer\n");
+		return false;
+	}
+	memset(report, 0, sizeof(cc_schedule_report));
+	size_t record_count = 0;
+	size_t read_bytes = 0;
+	while (read_bytes < *length) {
+		scc_entry* entry = (scc_entry*) (((u8*) in) + read_bytes);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		record_count++;
+	}
+	if (record_count == 0) {
+		return true;
+	}
+	f64 stats_started = StatsStart();
+	s64* requested = malloc(sizeof(s64) * record_count);
+	schedule_block* blocks = malloc(sizeof(schedule_block) * record_count);
+	if (requested == NULL || blocks == NULL) {
+		log_write(LOG_FATAL, use_colors, "ScheduleSCC: Couldn't allocate scheduling buffers\n");
+		free(requested);
+		free(blocks);
+		return false;
+	}
+	size_t block_count = 0;
+	s64 words_before = 0;
+	read_bytes = 0;
+	for (size_t i = 0; i < record_count; i++) {
+		scc_entry* entry = (scc_entry*) (((u8*) in) + read_bytes);
+		requested[i] = tc2int(entry->pts.tc, fps);
+		blocks[block_count].sum = requested[i] - words_before;
+		blocks[block_count].count = 1;
+		blocks[block_count].last = i;
+		block_count++;
+		// Pool while the block before wants to be later than this one
+		while (block_count > 1 && blocks[block_count-2].sum * blocks[block_count-1].count > blocks[block_count-1].sum * blocks[block_count-2].count) {
+			blocks[block_count-2].sum += blocks[block_count-1].sum;
+			blocks[block_count-2].count += blocks[block_count-1].count;
+			blocks[block_count-2].last = blocks[block_count-1].last;
+			block_count--;
+		}
+		words_before += entry->entry_count;
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	// Write back the new times. Rounding the block means keeps u non-decreasing, and u can't go below 0 since pts can't.
+	words_before = 0;
+	read_bytes = 0;
+	size_t i = 0;
+	for (size_t b = 0; b < block_count; b++) {
+		s64 u = llround((f64) blocks[b].sum / (f64) blocks[b].count);
+		if (u < 0) {
+			u = 0;
+		}
+		for (; i <= blocks[b].last; i++) {
+			scc_entry* entry = (scc_entry*) (((u8*) in) + read_bytes);
+			moveRecord(entry, requested[i], u + words_before, fps, warn_shift, report);
+			words_before += entry->entry_count;
+			read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		}
+	}
+	free(requested);
+	free(blocks);
+	StatsPhaseSpan(CC_PHASE_PROCESS, "schedule", stats_started);
+	log_write(LOG_DEBUG, use_colors, "ScheduleSCC: %d of %d records moved (%d earlier, %d later, %d over warning threshold), total error %d frames\n", report->moved, (u32) record_count, report->early, report->late, report->over_warn_shift, (s32) report->total_error);
+	return true;
+}
+
+// The streaming scheduler runs the same pooling one record at a time. A block only gets written out once
+// CC_STREAM_WINDOW records wait behind it; later blocks are kept from going before it, where ScheduleSCC could have pooled them.
+
+static void releaseSlot(cc_stream_scheduler* sched, u16 slot) {
+	sched->free_slots[sched->free_count++] = slot;
+}
+
+// Hands on the records of the oldest block
+static void emitBlock(cc_stream_scheduler* sched) {
+	cc_stream_block* block = &sched->blocks[sched->block_head];
+	s64 u = llround((f64) block->sum / (f64) block->count);
+	if (u < sched->floor) {
+		u = sched->floor;
+	}
+	sched->floor = u;
+	while (sched->scheduled_count != 0) {
+		u16 slot = sched->scheduled[sched->scheduled_head];
+		cc_stream_record* record = &sched->records[slot];
+		if (record->sequence > block->last) {
+			break;
+		}
+		moveRecord(record->entry, record->requested, u + record->words_before, sched->fps, sched->warn_shift, &sched->report);
+		sched->callback(record->entry, sched->ctx);
+		releaseSlot(sched, slot);
+		sched->scheduled_head++;
+		sched->scheduled_count--;
+	}
+	sched->block_head++;
+	sched->block_count--;
+}
+
+static void scheduleRecord(cc_stream_scheduler* sched, u16 slot) {
+	cc_stream_record* record = &sched->records[slot];
+	if (!sched->schedule) {
+		sched->callback(record->entry, sched->ctx);
+		releaseSlot(sched, slot);
+		return;
+	}
+	record->words_before = sched->total_words;
+	record->sequence = sched->sequence++;
+	// Both queues only ever drop from the front, so they're moved back down once they reach the end
+	if (sched->scheduled_head + sched->scheduled_count == CC_STREAM_SLOTS) {
+		memmove(sched->scheduled, sched->scheduled + sched->scheduled_head, sizeof(u16) * sched->scheduled_count);
+		sched->scheduled_head = 0;
+	}
+	sched->scheduled[sched->scheduled_head + sched->scheduled_count++] = slot;
+	if (sched->block_head + sched->block_count == CC_STREAM_SLOTS) {
+		memmove(sched->blocks, sched->blocks + sched->block_head, sizeof(cc_stream_block) * sched->block_count);
+		sched->block_head = 0;
+	}
+	cc_stream_block* blocks = sched->blocks + sched->block_head;
+	blocks[sched->block_count].sum = record->requested - sched->total_words;
+	blocks[sched->block_count].count = 1;
+	blocks[sched->block_count].last = record->sequence;
+	sched->block_count++;
+	// Pool while the block before wants to be later than this one
+	while (sched->block_count > 1 && blocks[sched->block_count-2].sum * blocks[sched->block_count-1].count > blocks[sched->block_count-1].sum * blocks[sched->block_count-2].count) {
+		blocks[sched->block_count-2].sum += blocks[sched->block_count-1].sum;
+		blocks[sched->block_count-2].count += blocks[sched->block_count-1].count;
+		blocks[sched->block_count-2].last = blocks[sched->block_count-1].last;
+		sched->block_count--;
+	}
+	sched->total_words += record->entry->entry_count;
+	while (sched->scheduled_count > CC_STREAM_WINDOW) {
+		emitBlock(sched);
+	}
+}
+
+// Moves the earliest record out of the ordering window
+static void releasePending(cc_stream_scheduler* sched) {
+	u16 slot = sched->pending[0];
+	sched->pending_count--;
+	memmove(sched->pending, sched->pending + 1, sizeof(u16) * sched->pending_count);
+	if (sched->records[slot].frame > sched->released_frame) {
+		sched->released_frame = sched->records[slot].frame;
+	}
+	scheduleRecord(sched, slot);
+}
+
+// Records go to callback in frame order. Without schedule, they're only put in order.
+void InitStreamScheduler(cc_stream_scheduler* sched, f64 fps, bool8 schedule, s64 warn_shift, scc_entry_callback callback, void* ctx) {
+	memset(sched, 0, sizeof(cc_stream_scheduler));
+	for (u16 i = 0; i < CC_STREAM_SLOTS; i++) {
+		sched->free_slots[i] = CC_STREAM_SLOTS - 1 - i;
+	}
+	sched->free_count = CC_STREAM_SLOTS;
+	sched->released_frame = -1;
+	sched->fps = fps;
+	sched->schedule = schedule;
+	sched->warn_shift = warn_shift;
+	sched->callback = callback;
+	sched->ctx = ctx;
+}
+
+bool8 PushStreamScheduler(cc_stream_scheduler* sched, const scc_entry* entry) {
+	if (sched->free_count == 0) {
+		log_write(LOG_FATAL, use_colors, "PushStreamScheduler: no free slots (corrupted state?)\n");
+		return false;
+	}
+	u16 slot = sched->free_slots[sched->free_count-1];
+	cc_stream_record* record = &sched->records[slot];
+	size_t size = sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	// Slots keep their buffers, so a steady stream stops allocating once the largest record has been seen
+	if (record->allocated < size) {
+		scc_entry* _entry = realloc(record->entry, size);
+		if (_entry == NULL) {
+			log_write(LOG_FATAL, use_colors, "PushStreamScheduler: Couldn't allocate record buffer\n");
+			return false;
+		}
+		record->entry = _entry;
+		record->allocated = size;
+	}
+	sched->free_count--;
+	memcpy(record->entry, entry, size);
+	record->requested = tc2int(entry->pts.tc, sched->fps);
+	record->frame = record->requested < 0 ? 0 : record->requested;
+	sched->record_count++;
+	bool8 unordered = record->frame < sched->released_frame;
+	if (unordered) {
+		sched->unordered++;
+	}
+	// Stable: after the records on the same frame that came before it
+	u16 pos = sched->pending_count;
+	while (pos > 0 && sched->records[sched->pending[pos-1]].frame > record->frame) {
+		pos--;
+	}
+	if ((unordered || pos != sched->pending_count) && cc_active_stats != NULL) {
+		cc_active_stats->out_of_order++;
+	}
+	if (pos != sched->pending_count) {
+		TraceRecord("reorder", record->frame, entry->entry_count);
+		sched->reordered++;
+		memmove(sched->pending + pos + 1, sched->pending + pos, sizeof(u16) * (sched->pending_count - pos));
+	}
+	sched->pending[pos] = slot;
+	sched->pending_count++;
+	if (sched->pending_count > CC_STREAM_WINDOW) {
+		releasePending(sched);
+	}
+	return true;
+}
+
+bool8 FinishStreamScheduler(cc_stream_scheduler* sched) {
+	while (sched->pending_count != 0) {
+		releasePending(sched);
+	}
+	while (sched->block_count != 0) {
+		emitBlock(sched);
+	}
+	for (u16 i = 0; i < CC_STREAM_SLOTS; i++) {
+		free(sched->records[i].entry);
+		sched->records[i].entry = NULL;
+		sched->records[i].allocated = 0;
+	}
+	if (sched->unordered != 0) {
+		log_write(LOG_WARN, use_colors, "FinishStreamScheduler: %d records were more than %d records out of order, and were scheduled where they came\n", sched->unordered, CC_STREAM_WINDOW);
+	}
+	log_write(LOG_DEBUG, use_colors, "FinishStreamScheduler: %d records, %d reordered, %d moved (%d earlier, %d later, %d over warning threshold), total error %d frames\n", sched->record_count, sched->reordered, sched->report.moved, sched->report.early, sched->report.late, sched->report.over_warn_shift, (s32) sched->report.total_error);
+	return true;
+}
@@ -0,0 +1,192 @@
+/*
+sort.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Puts scc_entry records in frame order, as WriteRaw needs them.
+// Only (frame, record) keys are sorted, with an LSD radix sort on the frame number, so every record is copied exactly once.
+// Radix sorting is stable: records on the same frame keep their input order, and merged tracks keep their order on ties.
+
+#define SORT_RADIX_BITS 11
+#define SORT_RADIX_SIZE (1 << SORT_RADIX_BITS)
+
+typedef struct {
+	u64 frame;
+	const scc_entry* entry;
+} sort_key;
+
+// Sorts count keys, using temp as scratch space; returns whichever of the two buffers holds the result
+static sort_key* radixSort(sort_key* keys, sort_key* temp, size_t count, u64 max_frame) {
+	size_t* histogram = malloc(sizeof(size_t) * SORT_RADIX_SIZE);
+	if (histogram == NULL) {
+		return NULL;
+	}
+	for (u8 shift = 0; shift < 64 && (max_frame >> shift) != 0; shift += SORT_RADIX_BITS) {
+		memset(histogram, 0, sizeof(size_t) * SORT_RADIX_SIZE);
+		for (size_t i = 0; i < count; i++) {
+			histogram[(keys[i].frame >> shift) & (SORT_RADIX_SIZE - 1)]++;
+		}
+		size_t total = 0;
+		for (size_t digit = 0; digit < SORT_RADIX_SIZE; digit++) {
+			size_t digit_count = histogram[digit];
+			histogram[digit] = total;
+			total += digit_count;
+		}
+		for (size_t i = 0; i < count; i++) {
+			temp[histogram[(keys[i].frame >> shift) & (SORT_RADIX_SIZE - 1)]++] = keys[i];
+		}
+		sort_key* swap = keys;
+		keys = temp;
+		temp = swap;
+	}
+	free(histogram);
+	return keys;
+}
+
+static size_t countRecords(const scc_entry* in, size_t length) {
+	size_t record_count = 0;
+	size_t read_bytes = 0;
+	while (read_bytes < length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		record_count++;
+	}
+	return record_count;
+}
+
+// Merges count tracks into one new track in frame order. The inputs are left alone.
+// If moved isn't NULL, it gets the number of records that aren't where plain concatenation would have put them.
+scc_entry* MergeSCC(scc_entry** tracks, size_t* lengths, u8 count, size_t* length, f64 fps, u32* moved) {
+	if (tracks == NULL || lengths == NULL) {
+		log_write(LOG_FATAL, use_colors, "MergeSCC: invalid input pointer\n");
+		return NULL;
+	}
+	size_t record_count = 0;
+	size_t total_length = 0;
+	for (u8 t = 0; t < count; t++) {
+		if (tracks[t] != NULL) {
+			record_count += countRecords(tracks[t], lengths[t]);
+			total_length += lengths[t];
+		}
+	}
+	scc_entry* out = malloc(total_length != 0 ? total_length : 1);
+	sort_key* keys = malloc(sizeof(sort_key) * (record_count + 1));
+	sort_key* temp = malloc(sizeof(sort_key) * (record_count + 1));
+	if (out == NULL || keys == NULL || temp == NULL) {
+		log_write(LOG_FATAL, use_colors, "MergeSCC: Couldn't allocate sort buffers\n");
+		goto merge_error;
+	}
+	size_t k = 0;
+	u64 max_frame = 0;
+	for (u8 t = 0; t < count; t++) {
+		if (tracks[t] == NULL) {
+			continue;
+		}
+		size_t read_bytes = 0;
+		while (read_bytes < lengths[t]) {
+			const scc_entry* entry = (const scc_entry*) (((const u8*) tracks[t]) + read_bytes);
+			s64 frame = tc2int(entry->pts.tc, fps);
+			keys[k].frame = frame < 0 ? 0 : (u64) frame;
+			keys[k].entry = entry;
+			max_frame = keys[k].frame > max_frame ? keys[k].frame : max_frame;
+			k++;
+			read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		}
+	}
+	sort_key* sorted = radixSort(keys, temp, record_count, max_frame);
+	if (sorted == NULL) {
+		log_write(LOG_FATAL, use_colors, "MergeSCC: Couldn't allocate sort buffers\n");
+		goto merge_error;
+	}
+	u32 out_of_place = 0;
+	size_t write_bytes = 0;
+	const u8* concatenated = NULL;
+	size_t concatenated_track = 0;
+	size_t concatenated_bytes = 0;
+	for (size_t i = 0; i < record_count; i++) {
+		const scc_entry* entry = sorted[i].entry;
+		size_t entry_size = sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		// Where the record would be if the tracks were simply appended to each other
+		while (concatenated_track < count && (tracks[concatenated_track] == NULL || concatenated_bytes >= lengths[concatenated_track])) {
+			concatenated_track++;
+			concatenated_bytes = 0;
+		}
+		concatenated = concatenated_track < count ? ((const u8*) tracks[concatenated_track]) + concatenated_bytes : NULL;
+		if ((const u8*) entry != concatenated) {
+			out_of_place++;
+		}
+		if (concatenated != NULL) {
+			concatenated_bytes += sizeof(scc_entry) + (sizeof(u16) * ((const scc_entry*) concatenated)->entry_count);
+		}
+		memcpy(((u8*) out) + write_bytes, entry, entry_size);
+		write_bytes += entry_size;
+	}
+	free(keys);
+	free(temp);
+	*length = write_bytes;
+	if (moved != NULL) {
+		*moved = out_of_place;
+	}
+	log_write(LOG_DEBUG, use_colors, "MergeSCC: %d records from %d tracks, %d out of place\n", (u32) record_count, count, out_of_place);
+	return out;
+
+	merge_error:
+	free(out);
+	free(keys);
+	free(temp);
+	return NULL;
+}
+
+// Sorts one track by frame. The track is only rebuilt when it's out of order; then *in is freed and replaced.
+bool8 SortSCC(scc_entry** in, size_t* length, f64 fps, u32* moved) {
+	if (in == NULL || *in == NULL) {
+		log_write(LOG_FATAL, use_colors, "SortSCC: invalid input pointer\n");
+		return false;
+	}
+	if (moved != NULL) {
+		*moved = 0;
+	}
+	f64 stats_started = StatsStart();
+	// Most files are already in order, which a single pass can tell
+	size_t read_bytes = 0;
+	s64 previous = -1;
+	bool8 sorted = true;
+	while (read_bytes < *length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) *in) + read_bytes);
+		s64 frame = tc2int(entry->pts.tc, fps);
+		if (frame < previous) {
+			sorted = false;
+			break;
+		}
+		previous = frame;
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	if (sorted) {
+		StatsPhaseSpan(CC_PHASE_PROCESS, "sort", stats_started);
+		return true;
+	}
+	size_t out_length;
+	u32 out_of_place = 0;
+	scc_entry* out = MergeSCC(in, length, 1, &out_length, fps, &out_of_place);
+	if (out == NULL) {
+		return false;
+	}
+	if (moved != NULL) {
+		*moved = out_of_place;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->out_of_order += out_of_place;
+	}
+	free(*in);
+	*in = out;
+	*length = out_length;
+	StatsPhaseSpan(CC_PHASE_PROCESS, "sort", stats_started);
+	return true;
+}
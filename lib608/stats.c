@@ -0,0 +1,163 @@
+/*
+stats.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include "config.h" // for HAVE_CLOCK_GETTIME
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "608.h"
+#include "log.h"
+
+// Per conversion counters. Like the log level, there's one set for the process; a tool points
+// cc_active_stats at its cc_stats for the conversion, and everything lib608 reads or writes meanwhile counts.
+
+cc_stats* cc_active_stats = NULL;
+
+static const char* const phase_names[CC_PHASES] = {"read", "process", "write"};
+// What the phases are called in a trace, unless the caller names the span
+static const char* const span_names[CC_PHASES] = {"parse", "process", "write"};
+
+// Seconds from an arbitrary start; also the trace clock
+f64 StatsClock() {
+#if HAVE_CLOCK_GETTIME
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (f64) ts.tv_sec + ((f64) ts.tv_nsec / 1e9);
+#else
+	return (f64) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void InitStats(cc_stats* stats) {
+	memset(stats, 0, sizeof(cc_stats));
+	stats->started = StatsClock();
+}
+
+// Returns the stats that were active before
+cc_stats* SetStats(cc_stats* stats) {
+	cc_stats* previous = cc_active_stats;
+	cc_active_stats = stats;
+	return previous;
+}
+
+void FinishStats(cc_stats* stats) {
+	stats->total = StatsClock() - stats->started;
+}
+
+// Start of a timed phase; nothing is timed while there are no stats or trace to take it
+f64 StatsStart() {
+	return cc_active_stats != NULL || TraceActive() ? StatsClock() : 0;
+}
+
+// Ends a phase in the stats, and as a span in the trace
+void StatsPhase(u8 phase, f64 started) {
+	StatsPhaseSpan(phase, NULL, started);
+}
+
+// Same, with the span named after what the phase did, so a sort doesn't show up as a retime
+void StatsPhaseSpan(u8 phase, const char* span, f64 started) {
+	if (started == 0 || phase >= CC_PHASES) {
+		return;
+	}
+	if (cc_active_stats != NULL) {
+		cc_active_stats->seconds[phase] += StatsClock() - started;
+	}
+	TraceSpan(span != NULL ? span : span_names[phase], started);
+}
+
+void StatsBuffer(size_t allocated, bool8 grown) {
+	if (cc_active_stats == NULL) {
+		return;
+	}
+	if (grown) {
+		cc_active_stats->reallocs++;
+	}
+	if (allocated > cc_active_stats->peak_buffer) {
+		cc_active_stats->peak_buffer = allocated;
+	}
+}
+
+// Takes a word as it was in the file, parity bits and all
+void StatsParity(u16 word) {
+	if (cc_active_stats != NULL && fixParity(word & 0x7f7f) != word) {
+		cc_active_stats->parity_errors++;
+	}
+}
+
+// Counts a whole track's records and words, for formats that read or write the track in one piece
+void StatsTrack(const scc_entry* in, size_t length, bool8 output) {
+	if (cc_active_stats == NULL || in == NULL) {
+		return;
+	}
+	u32 records = 0;
+	u64 words = 0;
+	size_t read_bytes = 0;
+	while (read_bytes < length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) in) + read_bytes);
+		records++;
+		words += entry->entry_count;
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	if (output) {
+		cc_active_stats->records_out += records;
+		cc_active_stats->words_out += words;
+	}
+	else {
+		cc_active_stats->records_in += records;
+		cc_active_stats->words_in += words;
+	}
+}
+
+static u32 writeJSONString(FILE* out, const char* str) {
+	if (str == NULL) {
+		return (u32) fprintf(out, "null");
+	}
+	u32 written = (u32) fprintf(out, "\"");
+	for (; *str != 0; str++) {
+		if (*str == '"' || *str == '\\') {
+			written += (u32) fprintf(out, "\\%c", *str);
+		}
+		else if ((u8) *str < 0x20) {
+			written += (u32) fprintf(out, "\\u%04x", (u8) *str);
+		}
+		else {
+			written += (u32) fprintf(out, "%c", *str);
+		}
+	}
+	return written + (u32) fprintf(out, "\"");
+}
+
+// One JSON object, on one line so a log shipper can take it as is
+u32 WriteStatsJSON(const cc_stats* stats, FILE* out, const char* input, const char* output) {
+	if (stats == NULL || out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteStatsJSON: invalid file descriptor\n");
+		return 0;
+	}
+	u32 written_bytes = (u32) fprintf(out, "{\"input\": ");
+	written_bytes += writeJSONString(out, input);
+	written_bytes += (u32) fprintf(out, ", \"output\": ");
+	written_bytes += writeJSONString(out, output);
+	written_bytes += (u32) fprintf(out, ", \"bytes_in\": %llu, \"bytes_out\": %llu, \"records_in\": %u, \"records_out\": %u, \"words_in\": %llu, \"words_out\": %llu, \"padding_in\": %llu, \"padding_out\": %llu",
+		(unsigned long long) stats->bytes_in, (unsigned long long) stats->bytes_out, stats->records_in, stats->records_out,
+		(unsigned long long) stats->words_in, (unsigned long long) stats->words_out, (unsigned long long) stats->padding_in, (unsigned long long) stats->padding_out);
+	written_bytes += (u32) fprintf(out, ", \"reallocs\": %u, \"peak_buffer\": %llu, \"parity_errors\": %u, \"malformed_lines\": %u, \"out_of_order\": %u, \"seconds\": {",
+		stats->reallocs, (unsigned long long) stats->peak_buffer, stats->parity_errors, stats->malformed_lines, stats->out_of_order);
+	for (u8 i = 0; i < CC_PHASES; i++) {
+		written_bytes += (u32) fprintf(out, "\"%s\": %.6f, ", phase_names[i], stats->seconds[i]);
+	}
+	written_bytes += (u32) fprintf(out, "\"total\": %.6f}", stats->total);
+	if (stats->total > 0) {
+		written_bytes += (u32) fprintf(out, ", \"mb_per_s_in\": %.3f", (f64) stats->bytes_in / stats->total / 1e6);
+	}
+	written_bytes += (u32) fprintf(out, "}\n");
+	if (ferror(out)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
+	return written_bytes;
+}
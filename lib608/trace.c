@@ -0,0 +1,156 @@
+/*
+trace.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Timed spans and per-record events, kept in a fixed ring per thread and written out as Chrome trace JSON
+// (chrome://tracing, Perfetto). Recording an event is a clock read and a store; once the ring is full the oldest
+// events are overwritten, so a long conversion keeps its last CC_TRACE_EVENTS events.
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define TRACE_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define TRACE_THREAD_LOCAL __thread
+#else
+#define TRACE_THREAD_LOCAL
+#endif
+
+typedef struct {
+	const char* name; // only the pointer is kept, so names must be string literals
+	f64 started;
+	f64 duration; // negative for a point event
+	s64 frame;
+	u32 words;
+} trace_event;
+
+typedef struct {
+	trace_event* events;
+	size_t capacity;
+	u64 recorded; // the ring holds the last capacity of these
+	u32 tid;
+} trace_ring;
+
+static TRACE_THREAD_LOCAL trace_ring* ring = NULL;
+static u32 next_tid = 1;
+static f64 epoch = 0;
+
+// capacity is in events; 0 takes CC_TRACE_EVENTS. Only the calling thread records into the ring.
+bool8 StartTrace(size_t capacity) {
+	if (ring != NULL) {
+		return true;
+	}
+	if (capacity == 0) {
+		capacity = CC_TRACE_EVENTS;
+	}
+	trace_ring* _ring = malloc(sizeof(trace_ring));
+	if (_ring == NULL) {
+		log_write(LOG_FATAL, use_colors, "StartTrace: Couldn't allocate trace buffer\n");
+		return false;
+	}
+	_ring->events = malloc(sizeof(trace_event) * capacity);
+	if (_ring->events == NULL) {
+		log_write(LOG_FATAL, use_colors, "StartTrace: Couldn't allocate trace buffer\n");
+		free(_ring);
+		return false;
+	}
+	_ring->capacity = capacity;
+	_ring->recorded = 0;
+	_ring->tid = next_tid++;
+	if (epoch == 0) {
+		epoch = StatsClock();
+	}
+	ring = _ring;
+	return true;
+}
+
+void StopTrace() {
+	if (ring == NULL) {
+		return;
+	}
+	free(ring->events);
+	free(ring);
+	ring = NULL;
+}
+
+bool8 TraceActive() {
+	return ring != NULL;
+}
+
+// Start of a span; 0 while the thread isn't tracing
+f64 TraceStart() {
+	return ring != NULL ? StatsClock() : 0;
+}
+
+static trace_event* nextEvent() {
+	trace_event* event = &ring->events[ring->recorded % ring->capacity];
+	ring->recorded++;
+	return event;
+}
+
+void TraceSpan(const char* name, f64 started) {
+	if (ring == NULL || started == 0) {
+		return;
+	}
+	f64 now = StatsClock();
+	trace_event* event = nextEvent();
+	event->name = name;
+	event->started = started;
+	event->duration = now - started;
+	event->frame = -1;
+	event->words = 0;
+}
+
+void TraceRecord(const char* name, s64 frame, u32 words) {
+	if (ring == NULL) {
+		return;
+	}
+	trace_event* event = nextEvent();
+	event->name = name;
+	event->started = StatsClock();
+	event->duration = -1;
+	event->frame = frame;
+	event->words = words;
+}
+
+// Writes the calling thread's events, oldest first
+u32 WriteTraceJSON(FILE* out) {
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteTraceJSON: invalid file descriptor\n");
+		return 0;
+	}
+	if (ring == NULL) {
+		log_write(LOG_ERROR, use_colors, "WriteTraceJSON: tracing wasn't started\n");
+		return 0;
+	}
+	u64 first = ring->recorded > ring->capacity ? ring->recorded - ring->capacity : 0;
+	u32 written_bytes = (u32) fprintf(out, "{\"traceEvents\": [\n");
+	for (u64 i = first; i < ring->recorded; i++) {
+		const trace_event* event = &ring->events[i % ring->capacity];
+		// Timestamps are in microseconds
+		f64 ts = (event->started - epoch) * 1e6;
+		if (event->duration >= 0) {
+			written_bytes += (u32) fprintf(out, "{\"name\": \"%s\", \"cat\": \"lib608\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}",
+				event->name, ts, event->duration * 1e6, ring->tid);
+		}
+		else {
+			written_bytes += (u32) fprintf(out, "{\"name\": \"%s\", \"cat\": \"lib608\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {\"frame\": %lld, \"words\": %u}}",
+				event->name, ts, ring->tid, (long long) event->frame, event->words);
+		}
+		written_bytes += (u32) fprintf(out, i + 1 < ring->recorded ? ",\n" : "\n");
+	}
+	written_bytes += (u32) fprintf(out, "], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_events\": %llu}}\n", (unsigned long long) first);
+	if (ferror(out)) {
+		log_write(LOG_ERROR, use_colors, "Error writing file (%d: %s)\n", errno, strerror(errno));
+		return 0;
+	}
+	return written_bytes;
+}
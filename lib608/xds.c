@@ -0,0 +1,254 @@
+/*
+xds.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "608.h"
+#include "log.h"
+
+// Extended Data Services packets, as carried in Field 2
+// Start codes are odd (0x01-0x0d) and followed by the packet type; the even code after each one continues an interrupted packet of that class.
+// 0x0f ends a packet, followed by a checksum making the 7-bit sum of the start code, type, data, end code and checksum 0.
+
+static const char* const mpaa_ratings[8] = {"N/A", "G", "PG", "PG-13", "R", "NC-17", "X", "Not Rated"};
+static const char* const us_tv_ratings[8] = {"None", "TV-Y", "TV-Y7", "TV-G", "TV-PG", "TV-14", "TV-MA", "None"};
+static const char* const canada_en_ratings[8] = {"E", "C", "C8+", "G", "PG", "14+", "18+", "Invalid"};
+static const char* const canada_fr_ratings[8] = {"E", "G", "8 ans +", "13 ans +", "16 ans +", "18 ans +", "Invalid", "Invalid"};
+
+static void copyText(char* out, const u8* data, u8 length) {
+	u8 i;
+	for (i = 0; i < length && data[i] != 0; i++) {
+		out[i] = (char) data[i];
+	}
+	// Names are padded to an even length with spaces or nulls
+	while (i > 0 && out[i-1] == ' ') {
+		i--;
+	}
+	out[i] = 0;
+}
+
+static void decodeRating(xds_packet* packet) {
+	if (packet->length < 2) {
+		return;
+	}
+	u8 b1 = packet->data[0];
+	u8 b2 = packet->data[1];
+	u8 a0 = (b1 >> 3) & 0x1;
+	u8 a1 = (b1 >> 4) & 0x1;
+	packet->kind = XDS_PACKET_RATING;
+	if (a1 == 0) { // 00 is MPAA, 01 is US TV
+		packet->rating.system = a0 ? XDS_RATING_US_TV : XDS_RATING_MPAA;
+	}
+	else if (a0 == 0) { // 10 is MPAA as sent by older equipment
+		packet->rating.system = XDS_RATING_MPAA;
+	}
+	else {
+		u8 a2 = (b1 >> 5) & 0x1;
+		u8 a3 = (b2 >> 3) & 0x1;
+		packet->rating.system = a3 ? XDS_RATING_UNKNOWN : (a2 ? XDS_RATING_CANADA_FR : XDS_RATING_CANADA_EN);
+	}
+	switch (packet->rating.system) {
+		case XDS_RATING_MPAA:
+			packet->rating.level = b1 & 0x07;
+			packet->rating.name = mpaa_ratings[packet->rating.level];
+			break;
+		case XDS_RATING_US_TV:
+			packet->rating.level = b2 & 0x07;
+			packet->rating.name = us_tv_ratings[packet->rating.level];
+			packet->rating.dialogue = (b1 >> 5) & 0x1;
+			packet->rating.language = (b2 >> 3) & 0x1;
+			packet->rating.sex = (b2 >> 4) & 0x1;
+			packet->rating.violence = (b2 >> 5) & 0x1;
+			break;
+		case XDS_RATING_CANADA_EN:
+			packet->rating.level = b2 & 0x07;
+			packet->rating.name = canada_en_ratings[packet->rating.level];
+			break;
+		case XDS_RATING_CANADA_FR:
+			packet->rating.level = b2 & 0x07;
+			packet->rating.name = canada_fr_ratings[packet->rating.level];
+			break;
+		default:
+			packet->rating.name = "Unknown";
+			break;
+	}
+}
+
+static void decodeTimeOfDay(xds_packet* packet) {
+	if (packet->length < 6) {
+		return;
+	}
+	const u8* data = packet->data;
+	packet->kind = XDS_PACKET_TIME_OF_DAY;
+	packet->time.minute = data[0] & 0x3f;
+	packet->time.hour = data[1] & 0x1f;
+	packet->time.dst = (data[1] >> 5) & 0x1;
+	packet->time.day = data[2] & 0x1f;
+	packet->time.leap_day = (data[2] >> 5) & 0x1;
+	packet->time.month = data[3] & 0x0f;
+	packet->time.tape_delayed = (data[3] >> 4) & 0x1;
+	packet->time.zero_seconds = (data[3] >> 5) & 0x1;
+	packet->time.day_of_week = data[4] & 0x07;
+	packet->time.year = (u16) (1990 + (data[5] & 0x3f));
+}
+
+static void decodePacket(xds_packet* packet) {
+	packet->kind = XDS_PACKET_OTHER;
+	if (!packet->checksum_ok) {
+		return;
+	}
+	if (packet->xds_class == XDS_CLASS_CURRENT && packet->type == 0x03) {
+		packet->kind = XDS_PACKET_PROGRAM_NAME;
+		copyText(packet->text, packet->data, packet->length);
+	}
+	else if (packet->xds_class == XDS_CLASS_CURRENT && packet->type == 0x05) {
+		decodeRating(packet);
+	}
+	else if (packet->xds_class == XDS_CLASS_CHANNEL && packet->type == 0x01) {
+		packet->kind = XDS_PACKET_NETWORK_NAME;
+		copyText(packet->text, packet->data, packet->length);
+	}
+	else if (packet->xds_class == XDS_CLASS_CHANNEL && packet->type == 0x02 && packet->length >= 4) {
+		packet->kind = XDS_PACKET_CALL_LETTERS;
+		copyText(packet->station.call_letters, packet->data, 4);
+		if (packet->length >= 6 && packet->data[4] >= '0' && packet->data[4] <= '9' && packet->data[5] >= '0' && packet->data[5] <= '9') {
+			packet->station.channel = (u8) (((packet->data[4] - '0') * 10) + (packet->data[5] - '0'));
+		}
+	}
+	else if (packet->xds_class == XDS_CLASS_MISC && packet->type == 0x01) {
+		decodeTimeOfDay(packet);
+	}
+}
+
+void InitXDSAssembler(xds_assembler* xds, xds_packet_callback callback, void* ctx) {
+	memset(xds, 0, sizeof(xds_assembler));
+	xds->current = -1;
+	xds->callback = callback;
+	xds->ctx = ctx;
+}
+
+// Feeds one Field 2 byte pair (parity stripped) to the assembler
+void AssembleXDSPair(xds_assembler* xds, u16 cc, s64 frame) {
+	u8 b1 = (cc >> 8) & 0x7f;
+	u8 b2 = cc & 0x7f;
+	if (b1 == 0 && b2 == 0) {
+		return; // padding
+	}
+	if (b1 >= 0x01 && b1 <= 0x0e) {
+		u8 index = (u8) ((b1 - 1) >> 1);
+		if (b1 & 0x01) { // start
+			if (xds->partial[index].active) {
+				log_write(LOG_DEBUG, use_colors, "AssembleXDSPair: class 0x%02hhx type 0x%02hhx restarted before it ended at frame %d\n", (u8) ((index*2) + 1), xds->partial[index].type, (s32) frame);
+				xds->error_count++;
+			}
+			xds->partial[index].active = true;
+			xds->partial[index].type = b2;
+			xds->partial[index].length = 0;
+			xds->partial[index].sum = (u8) (b1 + b2);
+			xds->current = (s8) index;
+		}
+		else if (xds->partial[index].active && xds->partial[index].type == b2) { // continue, which isn't part of the checksum
+			xds->current = (s8) index;
+		}
+		else {
+			log_write(LOG_DEBUG, use_colors, "AssembleXDSPair: continue code 0x%04x without a packet to continue at frame %d\n", cc, (s32) frame);
+			xds->current = -1;
+		}
+		return;
+	}
+	if (b1 == 0x0f) {
+		if (xds->current < 0) {
+			return;
+		}
+		u8 index = (u8) xds->current;
+		xds->current = -1;
+		xds->partial[index].active = false;
+		xds_packet packet;
+		memset(&packet, 0, sizeof(xds_packet));
+		packet.xds_class = (u8) ((index*2) + 1);
+		packet.type = xds->partial[index].type;
+		packet.frame = frame;
+		packet.length = xds->partial[index].length;
+		memcpy(packet.data, xds->partial[index].data, packet.length);
+		packet.checksum_ok = ((xds->partial[index].sum + b1 + b2) & 0x7f) == 0;
+		if (!packet.checksum_ok) {
+			log_write(LOG_DEBUG, use_colors, "AssembleXDSPair: checksum mismatch for class 0x%02hhx type 0x%02hhx at frame %d\n", packet.xds_class, packet.type, (s32) frame);
+			xds->error_count++;
+		}
+		decodePacket(&packet);
+		xds->packet_count++;
+		if (xds->callback != NULL) {
+			xds->callback(&packet, xds->ctx);
+		}
+		return;
+	}
+	if (b1 < 0x20) {
+		// Caption control codes end XDS; interrupted packets can still be continued later
+		xds->current = -1;
+		return;
+	}
+	if (xds->current < 0) {
+		return;
+	}
+	u8 index = (u8) xds->current;
+	u8 count = b2 != 0 ? 2 : 1;
+	if (xds->partial[index].length + count > XDS_MAX_DATA) {
+		log_write(LOG_DEBUG, use_colors, "AssembleXDSPair: class 0x%02hhx type 0x%02hhx packet too long at frame %d (dropping)\n", (u8) ((index*2) + 1), xds->partial[index].type, (s32) frame);
+		xds->partial[index].active = false;
+		xds->current = -1;
+		xds->error_count++;
+		return;
+	}
+	xds->partial[index].data[xds->partial[index].length++] = b1;
+	if (b2 != 0) {
+		xds->partial[index].data[xds->partial[index].length++] = b2;
+	}
+	xds->partial[index].sum = (u8) (xds->partial[index].sum + b1 + b2);
+}
+
+bool8 AssembleXDS(xds_assembler* xds, scc_entry* in, size_t* length, f64 fps) {
+	if (in == NULL) {
+		log_write(LOG_FATAL, use_colors, "AssembleXDS: invalid input pointer\n");
+		return false;
+	}
+	size_t read_bytes = 0;
+	u8* input_ptr = (u8*) in;
+	scc_entry* entry = (scc_entry*) input_ptr;
+	s64 next_frame = 0;
+	while (read_bytes < *length) {
+		s64 frame = tc2int(entry->pts.tc, fps);
+		// Overlapping records are pushed back, as they would be on air
+		if (read_bytes != 0 && frame < next_frame) {
+			frame = next_frame;
+		}
+		for (unsigned int i = 0; i < entry->entry_count; i++) {
+			AssembleXDSPair(xds, entry->entries[i], frame + i);
+		}
+		next_frame = frame + entry->entry_count;
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		input_ptr += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+		entry = (scc_entry*) input_ptr;
+	}
+	log_write(LOG_DEBUG, use_colors, "AssembleXDS: %d packets, %d errors\n", xds->packet_count, xds->error_count);
+	return true;
+}
+
+static void assembleRawPair(u16 cc, s64 frame, void* ctx) {
+	AssembleXDSPair((xds_assembler*) ctx, cc, frame);
+}
+
+// Pulls the XDS packets out of a Field 2 raw file while reading it. Returns the number of packets found.
+u32 ReadXDS(FILE* raw, f64 fps, timecode start, xds_packet_callback callback, void* ctx) {
+	xds_assembler xds;
+	InitXDSAssembler(&xds, callback, ctx);
+	if (!StreamRaw(raw, fps, start, assembleRawPair, &xds)) {
+		return 0;
+	}
+	log_write(LOG_DEBUG, use_colors, "ReadXDS: %d packets, %d errors\n", xds.packet_count, xds.error_count);
+	return xds.packet_count;
+}
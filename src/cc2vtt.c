@@ -0,0 +1,474 @@
+/*
+cc2vtt.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "608.h"
+#include "config.h" // for git
+#include "log.h"
+
+static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper git integration
+
+enum{
+	MODE_RAW,
+	MODE_SCC,
+	MODE_NW4R,
+	MODE_MCC,
+	MODE_RCWT
+}; // This is used to select the input format
+
+static void prog_header(char* name);
+static void usage(char* name);
+
+// Reads frames [first, end) of an SCC file, through its sidecar index when there is one.
+// A missing or stale index is rebuilt by the same full parse that reads the window.
+static scc_entry* readSCCWindow(FILE* in_file, const char* index_path, s64 first, s64 end, size_t* length) {
+	scc_index index = {0, 0, 0, NULL};
+	scc_entry* ccd;
+	if (index_path == NULL) {
+		return ReadSCCRange(in_file, length, NULL, first, end);
+	}
+	FILE* index_file = fopen(index_path, "rb");
+	bool8 have_index = false;
+	if (index_file != NULL) {
+		have_index = ReadSCCIndex(index_file, &index) && IsSCCIndexCurrent(&index, in_file);
+		fclose(index_file);
+	}
+	if (have_index) {
+		ccd = ReadSCCRange(in_file, length, &index, first, end);
+		FreeSCCIndex(&index);
+		return ccd;
+	}
+	FreeSCCIndex(&index);
+	log_write(LOG_INFO, use_colors, "Index %s is missing or stale, rebuilding it\n", index_path);
+	ccd = ReadSCCRangeIndexed(in_file, length, &index, first, end);
+	if (ccd == NULL) {
+		return NULL;
+	}
+	index_file = fopen(index_path, "wb");
+	if (index_file == NULL) {
+		log_write(LOG_WARN, use_colors, "Can't open file %s (%d: %s)\n", index_path, errno, strerror(errno));
+	}
+	else {
+		WriteSCCIndex(&index, index_file);
+		fclose(index_file);
+	}
+	FreeSCCIndex(&index);
+	return ccd;
+}
+
+int main(int argc, char **argv) {
+	u8 log_level = LOG_DEFAULT;
+	use_colors = isatty(STDERR_FILENO);
+	prog_header(argv[0]);
+	change_log_level(log_level);
+	u8 mode = MODE_RAW;
+	u8 format = CC_EXPORT_VTT;
+	u8 channel = 0;
+	f64 fps = 30/1.001f;
+	bool8 drop = false;
+	f64 segment_duration = 0;
+	u64 mpegts = 900000; // the usual 10 second offset of HLS packagers
+	char* file_path = NULL;
+	char* output_file = NULL;
+	timecode start_timecode = default_timecode;
+	s16 stc_hrs;
+	u8 stc_min;
+	u8 stc_sec;
+	u8 stc_frames;
+	char* window_str[2] = {NULL, NULL}; // --from and --to
+	char* index_path = NULL;
+	int c;
+
+	const struct option long_options[] = {
+		{"input", required_argument, 0, 'i'},
+		{"format", required_argument, 0, 'f'},
+		{"channel", required_argument, 0, 'c'},
+		{"fps", required_argument, 0, 0x80},
+		{"verbose", no_argument, 0, 'v'},
+		{"quiet", no_argument, 0, 'q'},
+		{"start_time", required_argument, 0, 0x84},
+		{"segment", required_argument, 0, 0x85},
+		{"mpegts", required_argument, 0, 0x86},
+		{"from", required_argument, 0, 0x87},
+		{"to", required_argument, 0, 0x88},
+		{"index", required_argument, 0, 0x89},
+		{"log_level", required_argument, 0, 0x83},
+		{"help", no_argument, 0, 'h'},
+		{"dropframe", no_argument, 0, 'd'},
+		{0, 0, 0, 0}
+	};
+	int option_index = 0;
+	opterr = 0;
+
+	while(1) {
+		int curind = optind;
+		c = getopt_long(argc, argv, ":c:df:hi:qv", long_options, &option_index);
+		if (c == -1) {
+			log_write(LOG_TRACE, use_colors, "Finished parsing command line options.\n");
+			break;
+		}
+		switch (c) {
+			case 0:
+				log_write(LOG_WARN, use_colors, "getopt_long Type 2 option, shouldn't happen normally\n");
+				break;
+			case 'c':
+				if (sscanf(optarg, "%hhu", &channel) == 0 || channel < 1 || channel > 4) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --channel: %s (will assume 1)\n", optarg);
+					channel = 1;
+				}
+				channel--;
+				log_write(LOG_DEBUG, use_colors, "channel = CC%hhu\n", channel + 1);
+				break;
+			case 'd':
+				drop = true;
+				break;
+			case 'f':
+				if (strcmp("vtt", optarg) == 0) {
+					format = CC_EXPORT_VTT;
+				}
+				else if (strcmp("srt", optarg) == 0) {
+					format = CC_EXPORT_SRT;
+				}
+				else if (strcmp("ttml", optarg) == 0) {
+					format = CC_EXPORT_TTML;
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --format: %s (will assume vtt)\n", optarg);
+					format = CC_EXPORT_VTT;
+				}
+				break;
+			case 'q':
+				change_log_level(LOG_FATAL | LOG_ERROR);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 2;
+			case 'i':
+				log_write(LOG_DEBUG, use_colors, "in = %s\n", optarg);
+				file_path = optarg;
+				break;
+			case 'v':
+				change_log_level(LOG_VERBOSE);
+				break;
+			case 0x80:
+				if (sscanf(optarg, "%lf", &fps) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --fps: %s (will assume 29.97 fps)\n", optarg);
+					fps = 30.0f/1.001f;
+				}
+				log_write(LOG_DEBUG, use_colors, "fps = %lf\n", fps);
+				break;
+			case 0x83:
+				if (sscanf(optarg, "%hhu", &log_level) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --log_level: %s (assuming %d)\n", optarg, LOG_DEFAULT);
+				}
+				log_write(LOG_DEBUG, use_colors, "log level = %hhu\n",  log_level);
+				change_log_level(log_level);
+				break;
+			case 0x84:
+				sscanf(optarg, "%02hd:%02hhu:%02hhu:%02hhu", &stc_hrs, &stc_min, &stc_sec, &stc_frames);
+				start_timecode.hours = stc_hrs;
+				start_timecode.minutes = (u8) (stc_min & 0x3f);
+				start_timecode.seconds = (u8) (stc_sec & 0x3f);
+				start_timecode.frames = (u8) (stc_frames & 0x7f);
+				log_write(LOG_DEBUG, use_colors, "start_tc %02hd:%02hhu:%02hhu:%02hhu\n", start_timecode.hours, start_timecode.minutes, start_timecode.seconds, start_timecode.frames);
+				break;
+			case 0x85:
+				if (sscanf(optarg, "%lf", &segment_duration) == 0 || segment_duration <= 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --segment: %s (will not segment)\n", optarg);
+					segment_duration = 0;
+				}
+				log_write(LOG_DEBUG, use_colors, "segment duration = %lf\n", segment_duration);
+				break;
+			case 0x86:
+				if (sscanf(optarg, "%llu", (unsigned long long*) &mpegts) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --mpegts: %s (will assume 900000)\n", optarg);
+					mpegts = 900000;
+				}
+				log_write(LOG_DEBUG, use_colors, "mpegts = %llu\n", (unsigned long long) mpegts);
+				break;
+			case 0x87:
+			case 0x88:
+				window_str[c - 0x87] = optarg;
+				break;
+			case 0x89:
+				index_path = optarg;
+				break;
+			case ':':
+				if (optopt < 0x80) {
+					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
+				}
+				else {
+					log_write(LOG_ERROR, use_colors, "Option %s requires an argument\n", argv[curind]);
+				}
+				return 1;
+			case '?':
+			default:
+				if (optopt) {
+					log_write(LOG_WARN, use_colors, "Invalid option -%c (ignoring)\n", optopt);
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid option %s (ignoring)\n", argv[curind]);
+				}
+				break;
+		}
+	}
+	if (optind < argc) {
+		output_file = argv[optind++];
+		log_write(LOG_DEBUG, use_colors, "output to %s...\n", output_file);
+	}
+	while (optind < argc) {
+		log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[optind++]);
+	}
+
+	if ((file_path == NULL) || (strcmp("", file_path) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An input file is required.\n");
+		return 3;
+	}
+
+	FILE* in_file = fopen(file_path, "r");
+	if (in_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
+		return 3;
+	}
+
+	const char* mode_str[] = {"raw", "scc", "nw4r", "mcc", "rcwt"};
+	const char* format_str[] = {"srt", "vtt", "ttml"};
+
+	// Detected from one read of the first bytes, which the readers then take as a prefix, so pipes work too
+	u8 probe[CC_PROBE_SIZE];
+	size_t probe_size = 0;
+	u8 probed = PeekFormat(in_file, probe, &probe_size);
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, in_file, probe, probe_size);
+
+	if (probed == CC_FORMAT_NW4R) {
+		mode = MODE_NW4R;
+	}
+	else if (probed == CC_FORMAT_RAW) {
+		mode = MODE_RAW;
+	}
+	else if (probed == CC_FORMAT_MCC) {
+		mode = MODE_MCC;
+	}
+	else if (probed == CC_FORMAT_RCWT) {
+		mode = MODE_RCWT;
+	}
+	else if (probed == CC_FORMAT_SCC) {
+		mode = MODE_SCC;
+	}
+	else {
+		log_write(LOG_ERROR, use_colors, "Input is not in a recognized format!\n");
+		fclose(in_file);
+		return 6;
+	}
+
+	u8 field = channel >> 1;
+	if (mode == MODE_NW4R) {
+		// NW4R files only hold one field
+		field = ProbeNW4RField(probe, probe_size);
+		if (field > 1) {
+			fclose(in_file);
+			return 6;
+		}
+		if ((channel >> 1) != field) {
+			log_write(LOG_WARN, use_colors, "Input only holds Field %hhu data, using CC%hhu\n", field + 1, (field*2) + (channel & 0x1) + 1);
+			channel = (field*2) + (channel & 0x1);
+		}
+	}
+
+	if ((output_file == NULL) || (strcmp("", output_file) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An output file is required.\n");
+		fclose(in_file);
+		return 3;
+	}
+
+	start_timecode.drop = drop;
+	if (segment_duration > 0 && format != CC_EXPORT_VTT) {
+		log_write(LOG_WARN, use_colors, "HLS segments are always WebVTT, ignoring --format\n");
+		format = CC_EXPORT_VTT;
+	}
+
+	// When segmenting, the output is a prefix for the playlist and segment files
+	FILE* out_file = NULL;
+	if (segment_duration == 0) {
+		out_file = fopen(output_file, "w+");
+		if (out_file == NULL) {
+			log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+			fclose(in_file);
+			return 3;
+		}
+	}
+
+	log_write(LOG_INFO, use_colors, "Input: %s\nOutput: %s\nInput Format: %s\nOutput Format: %s\nFPS: %f\nTimestamp Offset: %02d:%02hhu:%02hhu:%02hhu\nChannel: CC%hhu\n", file_path, output_file, mode_str[mode], format_str[format], fps, start_timecode.hours, start_timecode.minutes, start_timecode.seconds, start_timecode.frames, channel + 1);
+	if (segment_duration > 0) {
+		log_write(LOG_INFO, use_colors, "Segment Duration: %f\nMPEGTS: %llu\n", segment_duration, (unsigned long long) mpegts);
+	}
+
+	cc_exporter* exp = NULL;
+	cc_hls_segmenter* seg = NULL;
+	cc_decoder dec;
+	if (segment_duration > 0) {
+		seg = malloc(sizeof(cc_hls_segmenter));
+		if (seg == NULL || !InitHLSSegmenter(seg, output_file, channel, fps, start_timecode, segment_duration, mpegts)) {
+			log_write(LOG_FATAL, use_colors, "Couldn't set up segmenter\n");
+			free(seg);
+			fclose(in_file);
+			return 5;
+		}
+		InitDecoder(&dec, fps, SegmentHLSEvent, seg);
+	}
+	else {
+		exp = malloc(sizeof(cc_exporter));
+		if (exp == NULL || !InitExporter(exp, out_file, format, channel, fps)) {
+			log_write(LOG_FATAL, use_colors, "Couldn't set up exporter\n");
+			free(exp);
+			fclose(in_file);
+			fclose(out_file);
+			return 5;
+		}
+		InitDecoder(&dec, fps, ExportEvent, exp);
+	}
+
+	// Raw and SCC input are decoded while reading, so only one frame or line is held at a time
+	bool8 ok = false;
+	if (mode == MODE_RAW) {
+		ok = DecodeRawPrefixed(&dec, &in, start_timecode, field);
+	}
+	else if (mode == MODE_SCC && (window_str[0] != NULL || window_str[1] != NULL || index_path != NULL)) {
+		s64 window[2] = {0, -1};
+		for (int i = 0; i < 2; i++) {
+			if (window_str[i] == NULL) {
+				continue;
+			}
+			timecode window_tc = default_timecode;
+			char separator = ':';
+			if (sscanf(window_str[i], "%hd:%hhu:%hhu%c%hhu", &stc_hrs, &stc_min, &stc_sec, &separator, &stc_frames) != 5) {
+				log_write(LOG_WARN, use_colors, "Invalid parameter for option --%s: %s (ignoring)\n", i == 0 ? "from" : "to", window_str[i]);
+				continue;
+			}
+			window_tc.hours = stc_hrs;
+			window_tc.minutes = stc_min;
+			window_tc.seconds = stc_sec;
+			window_tc.frames = stc_frames;
+			window_tc.drop = separator == ';' || separator == '.';
+			window[i] = TimecodeToFrame(window_tc, 30);
+		}
+		size_t read_ccs = 0;
+		scc_entry* ccd = readSCCWindow(in_file, index_path, window[0], window[1], &read_ccs);
+		ok = ccd != NULL && DecodeSCC(&dec, ccd, &read_ccs, field);
+		free(ccd);
+	}
+	else if (mode == MODE_SCC) {
+		ok = DecodeSCCFilePrefixed(&dec, &in, field);
+	}
+	else {
+		size_t read_ccs = 0;
+		size_t read_ccs2 = 0;
+		scc_entry* ccd = NULL;
+		scc_entry* ccd2 = NULL;
+		if (mode == MODE_NW4R) ccd=ReadNW4RPrefixed(&in, &read_ccs);
+		else if (mode == MODE_MCC) ccd=ReadMCCPrefixed(&in, &read_ccs, &ccd2, &read_ccs2);
+		else ccd=ReadRCWTPrefixed(&in, &read_ccs, &ccd2, &read_ccs2, fps, drop);
+		if (mode != MODE_NW4R && field == 1) {
+			ok = ccd2 != NULL && DecodeSCC(&dec, ccd2, &read_ccs2, field);
+		}
+		else {
+			ok = ccd != NULL && DecodeSCC(&dec, ccd, &read_ccs, field);
+		}
+		if (ccd != NULL) {
+			free(ccd);
+		}
+		if (ccd2 != NULL) {
+			free(ccd2);
+		}
+	}
+	FinishDecoder(&dec);
+	if (seg != NULL) {
+		FinishHLSSegmenter(seg);
+		free(seg);
+	}
+	else {
+		FinishExporter(exp);
+		free(exp);
+		fclose(out_file);
+	}
+	fclose(in_file);
+	return ok ? 0 : 5;
+}
+
+static void prog_header(char* name) {
+	log_write(LOG_APPLICATION, false, "%s version", name);
+	if (strcmp("", versionInfo.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", versionInfo.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", versionInfo.major, versionInfo.minor, versionInfo.revision, versionInfo.build);
+	}
+	log_write(LOG_APPLICATION, false, "\nlib608 version:");
+	if (strcmp("", library_version.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", library_version.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	log_write(LOG_APPLICATION, false, "\n\n%s is distributed under the terms of the GNU General Public License v3 or later; view these terms in the included License.txt file.\n\n", name);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s -i <input> <output>\n"
+	"Input can be raw, SCC, NW4R, MCC or RCWT; the format is autodetected.\n\n"
+	"Detailed option listing:\n"
+	"--input\t-i <file>\n"
+	"\tSpecifies in input file (required)\n"
+	"--format\t-f <vtt|srt|ttml>\n"
+	"\tSpecifies the output format. Defaults to vtt.\n"
+	"--channel\t-c <1-4>\n"
+	"\tSpecifies which caption channel (CC1-CC4) to export. Defaults to 1.\n"
+	"--segment <seconds>\n"
+	"\tSplits WebVTT output into HLS segments of this length. The output is then used as a prefix:\n"
+	"\t<output>.m3u8 is the playlist, and <output>0.vtt, <output>1.vtt, ... are the segments.\n"
+	"\tCue times are relative to --start-time.\n"
+	"--mpegts <ticks>\n"
+	"\tSpecifies the 90kHz MPEG-TS timestamp of --start-time for X-TIMESTAMP-MAP. Defaults to 900000.\n"
+	"--from <00:00:00:00>\n"
+	"--to <00:00:00:00>\n"
+	"\tFor SCC input, only exports captions from this timecode up to (not including) that one.\n"
+	"--index <file>\n"
+	"\tFor SCC input, seeks with this sidecar index, so only the lines needed are parsed.\n"
+	"\tThe index is written (or rewritten, if the SCC file changed since) on first use.\n"
+	"--fps <fps>\n"
+	"\tSpecifies fps (For cue times, and raw and rcwt input)\n"
+	"--verbose\t-v\n"
+	"\tBe more verbose.\n"
+	"--quiet\t-q\n"
+	"\tOnly output errors.\n"
+	"--start-time <00:00:00:00>\n"
+	"\tSpecifies an offset to be applied to raw input, and the start of the first HLS segment.\n"
+	"--log_level <level>\n"
+	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
+	"\t\t1: Fatal\n"
+	"\t\t2: Error\n"
+	"\t\t4: Warning\n"
+	"\t\t8: Info\n"
+	"\t\t16: Debug\n"
+	"\t\t32: Trace\n"
+	"\t\t64: Library messages\n"
+	"\t\t128: Application messages (internally only)\n"
+	"--dropframe\t-d\n"
+	"\tSpecifies dropframe for the input\n"
+	"--help\t-h\n"
+	"\tShows this info\n"
+	"\n\n", name);
+}
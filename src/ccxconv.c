@@ -0,0 +1,338 @@
+/*
+ccxconv.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "608.h"
+#include "config.h" // for git
+#include "log.h"
+
+static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper git integration
+
+enum{
+	MODE_RAW,
+	MODE_SCC,
+	MODE_NW4R,
+	MODE_CCX
+}; // This is used to select the input and output formats
+
+static void prog_header(char* name);
+static void usage(char* name);
+
+int main(int argc, char **argv) {
+	u8 log_level = LOG_DEFAULT;
+	use_colors = isatty(STDERR_FILENO);
+	prog_header(argv[0]);
+	change_log_level(log_level);
+	u8 mode = MODE_CCX;
+	u8 field = 0;
+	bool8 checkpoints = false;
+	bool8 verify = false;
+	bool8 swap = !WORDS_BIGENDIAN;
+	bool8 drop = false;
+	f64 fps = 29.97003f; // same as scc2raw
+	char* file_path = NULL;
+	char* output_file = NULL;
+	int c;
+
+	const struct option long_options[] = {
+		{"input", required_argument, 0, 'i'},
+		{"mode", required_argument, 0, 'm'},
+		{"field2", no_argument, 0, '2'},
+		{"checkpoints", no_argument, 0, 0x87},
+		{"verify", no_argument, 0, 0x88},
+		{"swap", no_argument, 0, 0x86},
+		{"fps", required_argument, 0, 0x80},
+		{"dropframe", no_argument, 0, 'd'},
+		{"verbose", no_argument, 0, 'v'},
+		{"quiet", no_argument, 0, 'q'},
+		{"log_level", required_argument, 0, 0x83},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int option_index = 0;
+	opterr = 0;
+
+	while(1) {
+		int curind = optind;
+		c = getopt_long(argc, argv, ":2dhi:m:qv", long_options, &option_index);
+		if (c == -1) {
+			log_write(LOG_TRACE, use_colors, "Finished parsing command line options.\n");
+			break;
+		}
+		switch (c) {
+			case 0:
+				log_write(LOG_WARN, use_colors, "getopt_long Type 2 option, shouldn't happen normally\n");
+				break;
+			case '2':
+				field = 1;
+				break;
+			case 'd':
+				drop = true;
+				break;
+			case 'i':
+				log_write(LOG_DEBUG, use_colors, "in = %s\n", optarg);
+				file_path = optarg;
+				break;
+			case 'm':
+				if (strcasecmp("raw", optarg) == 0) {
+					mode = MODE_RAW;
+				}
+				else if (strcasecmp("scc", optarg) == 0) {
+					mode = MODE_SCC;
+				}
+				else if (strcasecmp("nw4r", optarg) == 0) {
+					mode = MODE_NW4R;
+				}
+				else if (strcasecmp("ccx", optarg) == 0) {
+					mode = MODE_CCX;
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "--mode must be 'raw', 'scc', 'nw4r' or 'ccx', assuming ccx mode\n");
+					mode = MODE_CCX;
+				}
+				break;
+			case 0x86:
+				swap = !swap;
+				break;
+			case 0x87:
+				checkpoints = true;
+				break;
+			case 0x88:
+				verify = true;
+				break;
+			case 'q':
+				change_log_level(LOG_FATAL | LOG_ERROR);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 2;
+			case 'v':
+				change_log_level(LOG_VERBOSE);
+				break;
+			case 0x80:
+				if (sscanf(optarg, "%lf", &fps) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --fps: %s (will assume 29.97 fps)\n", optarg);
+					fps = 30.0f/1.001f;
+				}
+				log_write(LOG_DEBUG, use_colors, "fps = %lf\n", fps);
+				break;
+			case 0x83:
+				if (sscanf(optarg, "%hhu", &log_level) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --log_level: %s (assuming %d)\n", optarg, LOG_DEFAULT);
+				}
+				log_write(LOG_DEBUG, use_colors, "log level = %hhu\n",  log_level);
+				change_log_level(log_level);
+				break;
+			case ':':
+				if (optopt < 0x80) {
+					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
+				}
+				else {
+					log_write(LOG_ERROR, use_colors, "Option %s requires an argument\n", argv[curind]);
+				}
+				return 1;
+			case '?':
+			default:
+				if (optopt) {
+					log_write(LOG_WARN, use_colors, "Invalid option -%c (ignoring)\n", optopt);
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid option %s (ignoring)\n", argv[curind]);
+				}
+				break;
+		}
+	}
+	if (optind < argc) {
+		output_file = argv[optind++];
+		log_write(LOG_DEBUG, use_colors, "output to %s...\n", output_file);
+	}
+	while (optind < argc) {
+		log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[optind++]);
+	}
+
+	if ((file_path == NULL) || (strcmp("", file_path) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An input file is required.\n");
+		return 3;
+	}
+	if (((output_file == NULL) || (strcmp("", output_file) == 0)) && !verify) {
+		log_write(LOG_ERROR, use_colors, "An output file is required.\n");
+		return 3;
+	}
+	FILE* in_file = fopen(file_path, "r");
+	if (in_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
+		return 3;
+	}
+
+	const char* mode_str[] = {"raw", "scc", "nw4r", "ccx"};
+	u8 in_mode;
+	if (IsCCXFile(in_file)) {
+		in_mode = MODE_CCX;
+	}
+	else if (IsNW4RFile(in_file)) {
+		in_mode = MODE_NW4R;
+	}
+	else if (IsRawFile(in_file)) {
+		in_mode = MODE_RAW;
+	}
+	else if (IsSCCFile(in_file)) {
+		in_mode = MODE_SCC;
+	}
+	else {
+		log_write(LOG_ERROR, use_colors, "Input is not in a recognized format!\n");
+		fclose(in_file);
+		return 6;
+	}
+
+	// A CCX file is used in place; everything else is read into memory
+	cc_ccx ccx;
+	scc_entry* ccd = NULL;
+	size_t read_ccs = 0;
+	int ret = 0;
+	if (in_mode == MODE_CCX) {
+		if (!OpenCCX(&ccx, in_file)) {
+			fclose(in_file);
+			return 5;
+		}
+		if (verify && !VerifyCCX(&ccx)) {
+			ret = 7;
+		}
+		ccd = ccx.data;
+		read_ccs = ccx.length;
+		field = ccx.field;
+		fps = ccx.fps;
+	}
+	else {
+		if (in_mode == MODE_NW4R) {
+			field = GetNW4RField(in_file);
+			ccd = ReadNW4R(in_file, &read_ccs);
+		}
+		else if (in_mode == MODE_RAW) {
+			ccd = ReadRaw(in_file, &read_ccs, (f32) fps, default_timecode, drop);
+		}
+		else {
+			ccd = ReadSCC(in_file, &read_ccs);
+		}
+		if (ccd == NULL) {
+			fclose(in_file);
+			return 5;
+		}
+	}
+	fclose(in_file);
+	if (output_file == NULL || strcmp("", output_file) == 0) {
+		// --verify on its own
+		if (in_mode == MODE_CCX) {
+			CloseCCX(&ccx);
+		}
+		else {
+			free(ccd);
+		}
+		return ret;
+	}
+
+	log_write(LOG_INFO, use_colors, "Input: %s (%s)\nOutput: %s (%s)\nFPS: %f\nField: %d\n", file_path, mode_str[in_mode], output_file, mode_str[mode], fps, field + 1);
+
+	FILE* out_file = fopen(output_file, "w+");
+	if (out_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		ret = 3;
+	}
+	else {
+		u32 written_bytes = 0;
+		switch (mode) {
+			case MODE_RAW:
+				written_bytes = WriteRaw(ccd, &read_ccs, out_file, (f32) fps, default_timecode, default_timecode);
+				break;
+			case MODE_SCC:
+				written_bytes = WriteSCC(ccd, &read_ccs, out_file);
+				break;
+			case MODE_NW4R:
+				written_bytes = WriteNW4R(ccd, &read_ccs, out_file, field, swap);
+				break;
+			case MODE_CCX:
+				written_bytes = WriteCCX(ccd, read_ccs, out_file, fps, field, checkpoints);
+				break;
+		}
+		if (written_bytes == 0) {
+			ret = 5;
+		}
+		fclose(out_file);
+	}
+	if (in_mode == MODE_CCX) {
+		CloseCCX(&ccx);
+	}
+	else {
+		free(ccd);
+	}
+	return ret;
+}
+
+static void prog_header(char* name) {
+	log_write(LOG_APPLICATION, false, "%s version", name);
+	if (strcmp("", versionInfo.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", versionInfo.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", versionInfo.major, versionInfo.minor, versionInfo.revision, versionInfo.build);
+	}
+	log_write(LOG_APPLICATION, false, "\nlib608 version:");
+	if (strcmp("", library_version.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", library_version.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	log_write(LOG_APPLICATION, false, "\n\n%s is distributed under the terms of the GNU General Public License v3 or later; view these terms in the included License.txt file.\n\n", name);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s -i <input> -m <format> <output>\n"
+	"Converts between SCC, raw, NW4R and CCX files. The input format is autodetected.\n"
+	"CCX files are indexed and page aligned, so they open with a memory map instead of a full parse.\n\n"
+	"Detailed option listing:\n"
+	"--input\t-i <file>\n"
+	"\tSpecifies in input file (required)\n"
+	"--mode\t-m [scc|raw|nw4r|ccx]\n"
+	"\tSpecify output format. Defaults to ccx.\n"
+	"--field2\t-2\n"
+	"\tMarks SCC or raw input as Field 2 data (NW4R and CCX files record their field).\n"
+	"--checkpoints\n"
+	"\tFor CCX output, also stores decoder checkpoints for random-access rendering.\n"
+	"--verify\n"
+	"\tFor CCX input, checks every section's checksum. Exits with 7 on a mismatch. The output is optional.\n"
+	"--swap\n"
+	"\tFor NW4R output, swap the byte order.\n"
+	"--fps <fps>\n"
+	"\tSpecifies fps\n"
+	"--dropframe\t-d\n"
+	"\tSpecifies dropframe for raw input\n"
+	"--verbose\t-v\n"
+	"\tBe more verbose.\n"
+	"--quiet\t-q\n"
+	"\tOnly output errors.\n"
+	"--log_level <level>\n"
+	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
+	"\t\t1: Fatal\n"
+	"\t\t2: Error\n"
+	"\t\t4: Warning\n"
+	"\t\t8: Info\n"
+	"\t\t16: Debug\n"
+	"\t\t32: Trace\n"
+	"\t\t64: Library messages\n"
+	"\t\t128: Application messages (internally only)\n"
+	"--help\t-h\n"
+	"\tShows this info\n"
+	"\n\n", name);
+}
@@ -21,12 +21,213 @@ static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper gi
 enum{
 	MODE_RAW,
 	MODE_DVD,
-	MODE_NW4R
+	MODE_NW4R,
+	MODE_MCC,
+	MODE_RCWT
 }; // This is used to select the input format
 
 static void prog_header(char* name);
 static void usage(char* name);
 
+typedef struct {
+	raw_segmenter seg;
+	FILE* out;
+	bool8 failed;
+} stream_ctx;
+
+static void writeSCCRecord(const scc_entry* entry, void* ctx) {
+	stream_ctx* stream = (stream_ctx*) ctx;
+	if (!stream->failed && WriteSCCEntry(entry, stream->out) == 0) {
+		stream->failed = true;
+	}
+}
+
+static void segmentPair(u16 cc, s64 frame, void* ctx) {
+	stream_ctx* stream = (stream_ctx*) ctx;
+	if (stream->seg.data == NULL) {
+		return;
+	}
+	if (!SegmentRawPair(&stream->seg, cc, frame)) {
+		stream->failed = true;
+		return;
+	}
+	DrainRawSegmenter(&stream->seg, writeSCCRecord, stream);
+}
+
+// Each record is written as soon as the segmenter closes it, so only the open record is ever held
+static char* trace_file = NULL;
+
+// Extra outputs from --also, written in the same pass as the main one
+#define MAX_ALSO 8
+
+typedef struct {
+	char* path;
+	FILE* file;
+	cc_io io;
+	cc_fanout_output output;
+} also_output;
+
+static also_output also[MAX_ALSO];
+static u8 also_count = 0;
+
+// <format>:<file>, where format is raw, scc, nw4r (big-endian) or nw4r_le
+static bool8 addAlso(char* arg) {
+	if (also_count == MAX_ALSO) {
+		log_write(LOG_ERROR, use_colors, "At most %d --also outputs can be given\n", MAX_ALSO);
+		return false;
+	}
+	char* path = strchr(arg, ':');
+	if (path == NULL || path[1] == 0) {
+		log_write(LOG_ERROR, use_colors, "Invalid parameter for option --also: %s (expected <format>:<file>)\n", arg);
+		return false;
+	}
+	also_output* a = &also[also_count];
+	memset(a, 0, sizeof(also_output));
+	size_t name_length = (size_t) (path - arg);
+	if (name_length == 3 && strncasecmp("raw", arg, 3) == 0) {
+		a->output.format = CC_FORMAT_RAW;
+	}
+	else if (name_length == 3 && strncasecmp("scc", arg, 3) == 0) {
+		a->output.format = CC_FORMAT_SCC;
+	}
+	else if (name_length == 4 && strncasecmp("nw4r", arg, 4) == 0) {
+		a->output.format = CC_FORMAT_NW4R;
+		a->output.swap = !WORDS_BIGENDIAN;
+	}
+	else if (name_length == 7 && strncasecmp("nw4r_le", arg, 7) == 0) {
+		a->output.format = CC_FORMAT_NW4R;
+		a->output.swap = WORDS_BIGENDIAN;
+	}
+	else {
+		log_write(LOG_ERROR, use_colors, "--also format must be either 'raw', 'scc', 'nw4r' or 'nw4r_le': %s\n", arg);
+		return false;
+	}
+	a->path = path + 1;
+	also_count++;
+	return true;
+}
+
+static bool8 openAlso() {
+	for (u8 i = 0; i < also_count; i++) {
+		also[i].file = strcmp("-", also[i].path) == 0 ? stdout : fopen(also[i].path, "w");
+		if (also[i].file == NULL) {
+			log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", also[i].path, errno, strerror(errno));
+			return false;
+		}
+		InitFileIO(&also[i].io, also[i].file);
+		also[i].output.out = &also[i].io;
+	}
+	return true;
+}
+
+static void closeAlso() {
+	for (u8 i = 0; i < also_count; i++) {
+		if (also[i].file != NULL && also[i].file != stdout) {
+			fclose(also[i].file);
+		}
+		also[i].file = NULL;
+	}
+}
+
+static bool8 alsoNeedsOrder() {
+	for (u8 i = 0; i < also_count; i++) {
+		if (also[i].output.format == CC_FORMAT_RAW) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// What scc2raw does to a track before writing it as raw, with its default warning threshold
+static bool8 orderTrack(scc_entry** ccd, size_t* length, f64 fps) {
+	u32 reordered;
+	cc_schedule_report report;
+	if (!SortSCC(ccd, length, fps, &reordered) || !ScheduleSCC(*ccd, length, fps, 15, &report)) {
+		return false;
+	}
+	if (reordered != 0) {
+		log_write(LOG_INFO, use_colors, "Reordered %d out of order records\n", reordered);
+	}
+	if (report.moved != 0) {
+		log_write(LOG_INFO, use_colors, "Rescheduled %d records to fit the caption bandwidth (%d earlier by up to %d frames, %d later by up to %d frames)\n", report.moved, report.early, (s32) report.max_early, report.late, (s32) report.max_late);
+	}
+	return true;
+}
+
+// The SCC output and the --also ones, in one pass over the track
+static bool8 writeFanOut(const scc_entry* ccd, const size_t* length, FILE* out, u8 field, f64 fps, timecode start) {
+	cc_fanout_output outputs[MAX_ALSO + 1];
+	cc_io main_io;
+	InitFileIO(&main_io, out);
+	memset(&outputs[0], 0, sizeof(cc_fanout_output));
+	outputs[0].format = CC_FORMAT_SCC;
+	outputs[0].out = &main_io;
+	u8 count = 1;
+	for (u8 i = 0; i < also_count; i++) {
+		also[i].output.field = field;
+		outputs[count++] = also[i].output;
+	}
+	return WriteFanOut(ccd, length, outputs, count, fps, start, start);
+}
+
+// Registered with atexit, so the trace covers the run whichever way it ends
+static void writeTrace(void) {
+	FILE* out = strcmp("-", trace_file) == 0 ? stderr : fopen(trace_file, "w");
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", trace_file, errno, strerror(errno));
+	}
+	else {
+		WriteTraceJSON(out);
+		if (out != stderr) {
+			fclose(out);
+		}
+	}
+	StopTrace();
+}
+
+// - writes to stderr, since stdout may be carrying the captions
+static void reportStats(cc_stats* stats, const char* stats_file, const char* input, const char* output) {
+	if (stats_file == NULL) {
+		return;
+	}
+	FinishStats(stats);
+	SetStats(NULL);
+	FILE* out = strcmp("-", stats_file) == 0 ? stderr : fopen(stats_file, "w");
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", stats_file, errno, strerror(errno));
+		return;
+	}
+	WriteStatsJSON(stats, out, input, output);
+	if (out != stderr) {
+		fclose(out);
+	}
+}
+
+static bool8 streamRawToSCC(cc_prefixed_file* in, FILE* out, f64 fps, timecode start, bool8 drop) {
+	stream_ctx stream = {.out = out, .failed = false};
+	if (!InitRawSegmenter(&stream.seg, fps, drop)) {
+		return false;
+	}
+	if (WriteSCCHeader(out) == 0) {
+		free(stream.seg.data);
+		return false;
+	}
+	bool8 ok = StreamRawPrefixed(in, fps, start, segmentPair, &stream);
+	size_t length = 0;
+	scc_entry* rest = FinishRawSegmenter(&stream.seg, &length);
+	if (rest == NULL) {
+		return false;
+	}
+	size_t read_bytes = 0;
+	while (read_bytes < length) {
+		const scc_entry* entry = (const scc_entry*) (((const u8*) rest) + read_bytes);
+		writeSCCRecord(entry, &stream);
+		read_bytes += sizeof(scc_entry) + (sizeof(u16) * entry->entry_count);
+	}
+	free(rest);
+	return ok && !stream.failed;
+}
+
 int main(int argc, char **argv) {
 	u8 log_level = LOG_DEFAULT;
 	// is this the right way to do that?
@@ -46,6 +247,9 @@ int main(int argc, char **argv) {
 	u8 stc_min;
 	u8 stc_sec;
 	u8 stc_frames;
+	char* window_str[2] = {NULL, NULL}; // --from and --to
+	char* stats_file = NULL;
+	cc_stats stats;
 	int c;
 
 	const struct option long_options[] = {
@@ -57,6 +261,11 @@ int main(int argc, char **argv) {
 		{"quiet", no_argument, 0, 'q'},
 		//{"version", no_argument, 0, 0x82},
 		{"start_time", required_argument, 0, 0x84},
+		{"from", required_argument, 0, 0x85},
+		{"to", required_argument, 0, 0x86},
+		{"stats", required_argument, 0, 0x87},
+		{"trace", required_argument, 0, 0x88},
+		{"also", required_argument, 0, 0x89},
 		{"limit", required_argument, 0, 'l'},
 		{"log_level", required_argument, 0, 0x83},
 		{"help", no_argument, 0, 'h'},
@@ -131,6 +340,24 @@ int main(int argc, char **argv) {
 				start_timecode.frames = (u8) (stc_frames & 0x7f);
 				log_write(LOG_DEBUG, use_colors, "start_tc %02hd:%02hhu:%02hhu:%02hhu\n", start_timecode.hours, start_timecode.minutes, start_timecode.seconds, start_timecode.frames);
 				break;
+			case 0x85:
+			case 0x86:
+				window_str[c - 0x85] = optarg;
+				break;
+			case 0x87:
+				stats_file = optarg;
+				break;
+			case 0x88:
+				if (trace_file == NULL && StartTrace(0)) {
+					atexit(writeTrace);
+				}
+				trace_file = optarg;
+				break;
+			case 0x89:
+				if (!addAlso(optarg)) {
+					return 1;
+				}
+				break;
 			case ':':
 				if (optopt < 0x80) {
 					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
@@ -169,20 +396,33 @@ int main(int argc, char **argv) {
 		return 3;
 	}
 
-	FILE* in_file = fopen(file_path, "r");
+	FILE* in_file = strcmp("-", file_path) == 0 ? stdin : fopen(file_path, "r");
 	if (in_file == NULL) {
 		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
 		return 3;
 	}
 
-	const char* mode_str[] = {"raw", "dvd", "nw4r"};
+	const char* mode_str[] = {"raw", "dvd", "nw4r", "mcc", "rcwt"};
 
-	if (IsNW4RFile(in_file)) {
+	// Detected from one read of the first bytes, which the readers then take as a prefix, so pipes work too
+	u8 probe[CC_PROBE_SIZE];
+	size_t probe_size = 0;
+	u8 format = PeekFormat(in_file, probe, &probe_size);
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, in_file, probe, probe_size);
+
+	if (format == CC_FORMAT_NW4R) {
 		mode = MODE_NW4R;
 	}
-	else if (IsRawFile(in_file)) {
+	else if (format == CC_FORMAT_RAW) {
 		mode = MODE_RAW;
 	}
+	else if (format == CC_FORMAT_MCC) {
+		mode = MODE_MCC;
+	}
+	else if (format == CC_FORMAT_RCWT) {
+		mode = MODE_RCWT;
+	}
 	// else if (IsDVDFile(in_file)) {
 		// mode = MODE_DVD;
 	// }
@@ -198,7 +438,7 @@ int main(int argc, char **argv) {
 		return 3;
 	}
 
-	FILE* out_file = fopen(output_file, "w+");
+	FILE* out_file = strcmp("-", output_file) == 0 ? stdout : fopen(output_file, "w+");
 	if (out_file == NULL) {
 		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
 		fclose(in_file);
@@ -237,7 +477,7 @@ int main(int argc, char **argv) {
 		}
 	}
 	else if (mode == MODE_NW4R) {
-		u8 field = GetNW4RField(in_file);
+		u8 field = ProbeNW4RField(probe, probe_size);
 		if (field == 0) {
 			field1 = true;
 			field2 = false;
@@ -246,7 +486,7 @@ int main(int argc, char **argv) {
 			field1 = false;
 			field2 = true;
 		}
-		else { // Should never happen, as we've already called IsNW4RFile
+		else { // Should never happen, as the probe already found an NW4R header
 			fclose(in_file);
 			fclose(out_file);
 			if (out_file2 != NULL) {
@@ -255,9 +495,9 @@ int main(int argc, char **argv) {
 			return 6;
 		}
 	}
-	else if (mode == MODE_RAW) {
+	else if (mode == MODE_RAW || mode == MODE_MCC || mode == MODE_RCWT) {
 		if (field1 && field2) {
-			log_write(LOG_WARN, use_colors, "Detected raw format, which only supports one field, and both fields are specified. Assuming Field 1.\n");
+			log_write(LOG_WARN, use_colors, "Detected %s format, and both fields are specified, but only one can be output. Assuming Field 1.\n", mode_str[mode]);
 			field1 = true;
 			field2 = false;
 		}
@@ -284,12 +524,77 @@ int main(int argc, char **argv) {
 	}
 	log_write(LOG_INFO, false, "\n");
 
-	unsigned int read_ccs;
+	if (!openAlso()) {
+		closeAlso();
+		fclose(in_file);
+		fclose(out_file);
+		return 3;
+	}
+
+	if (stats_file != NULL) {
+		InitStats(&stats);
+		SetStats(&stats);
+	}
+
+	size_t read_ccs;
 	scc_entry* ccd;
 	//unsigned int read_ccs2;
 	//scc_entry* ccd2;
-	if (mode == MODE_RAW) ccd=ReadRaw(in_file, &read_ccs, fps, start_timecode, drop);
-	else if (mode == MODE_NW4R) ccd=ReadNW4R(in_file, &read_ccs);
+	if (mode == MODE_RAW && (window_str[0] != NULL || window_str[1] != NULL)) {
+		// Only the window is read, so previewing part of a long capture doesn't cost the whole file
+		s64 window[2] = {0, -1};
+		for (int i = 0; i < 2; i++) {
+			if (window_str[i] == NULL) {
+				continue;
+			}
+			timecode window_tc = default_timecode;
+			if (sscanf(window_str[i], "%02hd:%02hhu:%02hhu:%02hhu", &stc_hrs, &stc_min, &stc_sec, &stc_frames) != 4) {
+				log_write(LOG_ERROR, use_colors, "Invalid parameter for option --%s: %s\n", i == 0 ? "from" : "to", window_str[i]);
+				SetStats(NULL);
+				fclose(in_file);
+				fclose(out_file);
+				closeAlso();
+				return 1;
+			}
+			window_tc.hours = stc_hrs;
+			window_tc.minutes = stc_min;
+			window_tc.seconds = stc_sec;
+			window_tc.frames = stc_frames;
+			window_tc.drop = drop;
+			window[i] = tc2int(window_tc, fps) - tc2int(start_timecode, fps);
+			if (window[i] < 0) {
+				window[i] = 0;
+			}
+		}
+		ccd=ReadRawWindow(in_file, &read_ccs, fps, start_timecode, drop, window[0], window[1]);
+	}
+	else if (mode == MODE_RAW && also_count != 0) {
+		// The NW4R header needs the length of the whole track, so with --also it's read first
+		ccd=ReadRawPrefixed(&in, &read_ccs, fps, start_timecode, drop);
+	}
+	else if (mode == MODE_RAW) {
+		// Raw input converts as it's read, whatever its length
+		bool8 ok = streamRawToSCC(&in, out_file, (f32) fps, start_timecode, drop);
+		fclose(in_file);
+		fclose(out_file);
+		reportStats(&stats, stats_file, file_path, output_file);
+		return ok ? 0 : 5;
+	}
+	else if (mode == MODE_NW4R) ccd=ReadNW4RPrefixed(&in, &read_ccs);
+	else if (mode == MODE_MCC || mode == MODE_RCWT) {
+		size_t read_ccs2;
+		scc_entry* ccd2 = NULL;
+		if (mode == MODE_MCC) ccd=ReadMCCPrefixed(&in, &read_ccs, &ccd2, &read_ccs2);
+		else ccd=ReadRCWTPrefixed(&in, &read_ccs, &ccd2, &read_ccs2, fps, drop);
+		if (field2 && ccd != NULL) {
+			free(ccd);
+			ccd = ccd2;
+			read_ccs = read_ccs2;
+		}
+		else if (ccd2 != NULL) {
+			free(ccd2);
+		}
+	}
 	// else if (mode == MODE_DVD) ReadDVD(in_file, ccd, &read_ccs, ccd2, &read_ccs2, fps, start_timecode);
 	log_write(LOG_TRACE, use_colors, "address of ccd 0x%08x\n", (u32) ccd);
 	if (ccd == NULL) {
@@ -298,6 +603,8 @@ int main(int argc, char **argv) {
 		if (out_file2 != NULL) {
 			fclose(out_file2);
 		}
+		closeAlso();
+		reportStats(&stats, stats_file, file_path, output_file);
 		return 5;
 	}
 
@@ -308,7 +615,19 @@ int main(int argc, char **argv) {
 		//}
 	//}
 
-	WriteSCC(ccd, &read_ccs, out_file);
+	bool8 ok = true;
+	if (also_count != 0) {
+		// Raw outputs come out as scc2raw would write the SCC one: sorted, scheduled, and just above 29.97 fps
+		// so rounded timecodes stay in order. The other outputs then get the same track.
+		f64 raw_fps = fps == 30/1.001f ? 29.97003f : fps;
+		if (alsoNeedsOrder()) {
+			ok = orderTrack(&ccd, &read_ccs, (f32) raw_fps);
+		}
+		ok = ok && writeFanOut(ccd, &read_ccs, out_file, field2 ? 1 : 0, (f32) raw_fps, start_timecode);
+	}
+	else {
+		WriteSCC(ccd, &read_ccs, out_file);
+	}
 	// comment out to prevent "maybe used uninitialized" warning
 	//if (mode == MODE_DVD && ccd2 != NULL) WriteSCC(ccd2, &read_ccs2, out_file2);
 
@@ -323,7 +642,9 @@ int main(int argc, char **argv) {
 	if (out_file2 != NULL) {
 		fclose(out_file2);
 	}
-	return 0;
+	closeAlso();
+	reportStats(&stats, stats_file, file_path, output_file);
+	return ok ? 0 : 5;
 }
 
 static void prog_header(char* name) {
@@ -349,9 +670,10 @@ static void usage(char* name) {
 	"The basic usage is:\n"
 	"\n%s -i <input> <output>\n"
 	/*"If the input is DVD format, a second output can be specified.\n*/"\n"
+	"Use - as the input or output for stdin or stdout. Raw input is converted as it's read.\n\n"
 	"Detailed option listing:\n"
 	"--input\t-i <file>\n"
-	"\tSpecifies in input file (required)\n"
+	"\tSpecifies in input file (required). - reads from stdin.\n"
 	"--fps <fps>\n"
 	"\tSpecifies fps (For raw and dvd output)\n"
 	"--field[1|2]\t-[1|2]\n"
@@ -363,6 +685,18 @@ static void usage(char* name) {
 	"\tOnly output errors.\n"
 	"--start-time <00:00:00:00>\n"
 	"\tSpecifies an offset to be applied to the input material.\n"
+	"--from <00:00:00:00>\n"
+	"--to <00:00:00:00>\n"
+	"\tFor raw input, only reads captions from this timecode up to (not including) that one.\n"
+	"--also <format>:<file>\n"
+	"\tAlso writes the captions as raw, scc, nw4r (big-endian) or nw4r_le, in the same pass as the SCC output.\n"
+	"\tCan be given more than once. Raw input is then read whole rather than converted as it's read.\n"
+	"\tWith a raw output, all outputs are sorted and scheduled as scc2raw does it.\n"
+	"--stats <file>\n"
+	"\tWrites counters and timings for the conversion as one line of JSON. - writes to stderr.\n"
+	"--trace <file>\n"
+	"\tWrites the time spent in each step, and what happened to each record, as Chrome trace JSON\n"
+	"\t(chrome://tracing or Perfetto). - writes to stderr.\n"
 	"--log_level <level>\n"
 	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
 	"\t\t1: Fatal\n"
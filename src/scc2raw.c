@@ -21,12 +21,216 @@ static const VersionInfo versionInfo = {0, 5, 0, 1, VERSION}; // todo: proper gi
 enum{
 	MODE_RAW,
 	MODE_DVD,
-	MODE_NW4R
+	MODE_NW4R,
+	MODE_MCC,
+	MODE_RCWT
 };
 
 static void prog_header(char* name);
 static void usage(char* name);
 
+typedef struct {
+	cc_stream_scheduler sched;
+	cc_raw_writer writer;
+	bool8 failed;
+} stream_ctx;
+
+static void writeRawRecord(const scc_entry* entry, void* ctx) {
+	WriteRawEntry((cc_raw_writer*) ctx, entry);
+}
+
+static void pushRecord(const scc_entry* entry, void* ctx) {
+	stream_ctx* stream = (stream_ctx*) ctx;
+	if (!stream->failed && !PushStreamScheduler(&stream->sched, entry)) {
+		stream->failed = true;
+	}
+}
+
+static char* trace_file = NULL;
+
+// Extra outputs from --also, written in the same pass as the main one
+#define MAX_ALSO 8
+
+typedef struct {
+	char* path;
+	FILE* file;
+	cc_io io;
+	cc_fanout_output output;
+} also_output;
+
+static also_output also[MAX_ALSO];
+static u8 also_count = 0;
+
+// <format>:<file>, where format is raw, scc, nw4r (big-endian) or nw4r_le
+static bool8 addAlso(char* arg) {
+	if (also_count == MAX_ALSO) {
+		log_write(LOG_ERROR, use_colors, "At most %d --also outputs can be given\n", MAX_ALSO);
+		return false;
+	}
+	char* path = strchr(arg, ':');
+	if (path == NULL || path[1] == 0) {
+		log_write(LOG_ERROR, use_colors, "Invalid parameter for option --also: %s (expected <format>:<file>)\n", arg);
+		return false;
+	}
+	also_output* a = &also[also_count];
+	memset(a, 0, sizeof(also_output));
+	size_t name_length = (size_t) (path - arg);
+	if (name_length == 3 && strncasecmp("raw", arg, 3) == 0) {
+		a->output.format = CC_FORMAT_RAW;
+	}
+	else if (name_length == 3 && strncasecmp("scc", arg, 3) == 0) {
+		a->output.format = CC_FORMAT_SCC;
+	}
+	else if (name_length == 4 && strncasecmp("nw4r", arg, 4) == 0) {
+		a->output.format = CC_FORMAT_NW4R;
+		a->output.swap = !WORDS_BIGENDIAN;
+	}
+	else if (name_length == 7 && strncasecmp("nw4r_le", arg, 7) == 0) {
+		a->output.format = CC_FORMAT_NW4R;
+		a->output.swap = WORDS_BIGENDIAN;
+	}
+	else {
+		log_write(LOG_ERROR, use_colors, "--also format must be either 'raw', 'scc', 'nw4r' or 'nw4r_le': %s\n", arg);
+		return false;
+	}
+	a->path = path + 1;
+	also_count++;
+	return true;
+}
+
+static bool8 openAlso() {
+	for (u8 i = 0; i < also_count; i++) {
+		also[i].file = strcmp("-", also[i].path) == 0 ? stdout : fopen(also[i].path, "w");
+		if (also[i].file == NULL) {
+			log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", also[i].path, errno, strerror(errno));
+			return false;
+		}
+		InitFileIO(&also[i].io, also[i].file);
+		also[i].output.out = &also[i].io;
+	}
+	return true;
+}
+
+static void closeAlso() {
+	for (u8 i = 0; i < also_count; i++) {
+		if (also[i].file != NULL && also[i].file != stdout) {
+			fclose(also[i].file);
+		}
+		also[i].file = NULL;
+	}
+}
+
+static bool8 alsoNeedsOrder() {
+	for (u8 i = 0; i < also_count; i++) {
+		if (also[i].output.format == CC_FORMAT_RAW) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Raw and NW4R main outputs go in the same pass as the --also ones; MCC and RCWT are written on their own first
+static bool8 writeFanOut(const scc_entry* ccd, const size_t* length, FILE* out, u8 mode, u8 field, bool8 swap, f64 fps, timecode start, timecode end) {
+	cc_fanout_output outputs[MAX_ALSO + 1];
+	cc_io main_io;
+	u8 count = 0;
+	if (mode == MODE_RAW || mode == MODE_NW4R) {
+		InitFileIO(&main_io, out);
+		memset(&outputs[0], 0, sizeof(cc_fanout_output));
+		outputs[0].format = mode == MODE_RAW ? CC_FORMAT_RAW : CC_FORMAT_NW4R;
+		outputs[0].out = &main_io;
+		outputs[0].field = field;
+		outputs[0].swap = swap;
+		count++;
+	}
+	for (u8 i = 0; i < also_count; i++) {
+		also[i].output.field = field;
+		outputs[count++] = also[i].output;
+	}
+	return WriteFanOut(ccd, length, outputs, count, fps, start, end);
+}
+
+// Registered with atexit, so the trace covers the run whichever way it ends
+static void writeTrace(void) {
+	FILE* out = strcmp("-", trace_file) == 0 ? stderr : fopen(trace_file, "w");
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", trace_file, errno, strerror(errno));
+	}
+	else {
+		WriteTraceJSON(out);
+		if (out != stderr) {
+			fclose(out);
+		}
+	}
+	StopTrace();
+}
+
+// - writes to stderr, since stdout may be carrying the captions
+static void reportStats(cc_stats* stats, const char* stats_file, const char* input, const char* output) {
+	if (stats_file == NULL) {
+		return;
+	}
+	FinishStats(stats);
+	SetStats(NULL);
+	FILE* out = strcmp("-", stats_file) == 0 ? stderr : fopen(stats_file, "w");
+	if (out == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", stats_file, errno, strerror(errno));
+		return;
+	}
+	WriteStatsJSON(stats, out, input, output);
+	if (out != stderr) {
+		fclose(out);
+	}
+}
+
+// The old SCC as it went into the raw file: sorted and scheduled with the same settings
+static scc_entry* readOldTrack(const char* path, size_t* length, f64 fps, bool8 schedule, s32 warn_shift) {
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", path, errno, strerror(errno));
+		return NULL;
+	}
+	scc_entry* old = ReadSCC(file, length);
+	fclose(file);
+	if (old == NULL) {
+		return NULL;
+	}
+	u32 reordered;
+	cc_schedule_report report;
+	if (!SortSCC(&old, length, fps, &reordered) || (schedule && !ScheduleSCC(old, length, fps, warn_shift, &report))) {
+		free(old);
+		return NULL;
+	}
+	return old;
+}
+
+// SCC lines go through a window of records straight to the raw file, so memory doesn't depend on the input's length
+static bool8 streamSCCToRaw(cc_prefixed_file* in, FILE* out, f64 fps, timecode start, timecode end, bool8 schedule, s32 warn_shift) {
+	stream_ctx* stream = malloc(sizeof(stream_ctx));
+	if (stream == NULL) {
+		log_write(LOG_FATAL, use_colors, "Couldn't allocate stream buffers\n");
+		return false;
+	}
+	stream->failed = false;
+	InitStreamScheduler(&stream->sched, fps, schedule, warn_shift, writeRawRecord, &stream->writer);
+	bool8 ok = InitRawWriter(&stream->writer, out, fps, start, end) && StreamSCCPrefixed(in, pushRecord, stream);
+	FinishStreamScheduler(&stream->sched);
+	FinishRawWriter(&stream->writer);
+	ok = ok && !stream->failed && !stream->writer.failed;
+	if (stream->sched.reordered != 0) {
+		log_write(LOG_INFO, use_colors, "Reordered %d out of order records\n", stream->sched.reordered);
+	}
+	cc_schedule_report* report = &stream->sched.report;
+	if (report->moved != 0) {
+		log_write(LOG_INFO, use_colors, "Rescheduled %d records to fit the caption bandwidth (%d earlier by up to %d frames, %d later by up to %d frames)\n", report->moved, report->early, (s32) report->max_early, report->late, (s32) report->max_late);
+	}
+	if (report->over_warn_shift != 0) {
+		log_write(LOG_WARN, use_colors, "%d records moved by more than %d frames (--warn_shift)\n", report->over_warn_shift, warn_shift);
+	}
+	free(stream);
+	return ok;
+}
+
 int main(int argc, char **argv) {
 	u8 log_level = LOG_DEFAULT;
 	// is this the right way to do that?
@@ -47,6 +251,12 @@ int main(int argc, char **argv) {
 	u8 stc_sec;
 	u8 stc_frames;
 	timecode pad_tc = default_timecode;
+	bool8 schedule = true;
+	bool8 stream = false;
+	s32 warn_shift = 15;
+	char* stats_file = NULL;
+	char* patch_file = NULL;
+	cc_stats stats;
 	int c;
 
 	const struct option long_options[] = {
@@ -56,6 +266,13 @@ int main(int argc, char **argv) {
 		{"field2", no_argument, 0, '2'},
 		{"swap", no_argument, 0, 0x86},
 		{"mode", required_argument, 0, 'm'},
+		{"no_schedule", no_argument, 0, 0x87},
+		{"warn_shift", required_argument, 0, 0x88},
+		{"stream", no_argument, 0, 0x89},
+		{"stats", required_argument, 0, 0x8a},
+		{"trace", required_argument, 0, 0x8b},
+		{"also", required_argument, 0, 0x8c},
+		{"patch", required_argument, 0, 0x8d},
 		//{"input2", required_argument, 0, 0x81},
 		{"verbose", no_argument, 0, 'v'},
 		{"quiet", no_argument, 0, 'q'},
@@ -107,8 +324,14 @@ int main(int argc, char **argv) {
 				else if (strcasecmp("nw4r", optarg) == 0) {
 					mode = MODE_NW4R;
 				}
+				else if (strcasecmp("mcc", optarg) == 0) {
+					mode = MODE_MCC;
+				}
+				else if (strcasecmp("rcwt", optarg) == 0) {
+					mode = MODE_RCWT;
+				}
 				else {
-					log_write(LOG_WARN, use_colors, "--mode must be either "/*'dvd', */"'raw' or 'nw4r', assuming raw mode\n", optarg);
+					log_write(LOG_WARN, use_colors, "--mode must be either "/*'dvd', */"'raw', 'nw4r', 'mcc' or 'rcwt', assuming raw mode\n", optarg);
 					mode = MODE_RAW;
 				}
 				log_write(LOG_DEBUG, use_colors, "dvdmode = %hhu\n", mode);
@@ -155,6 +378,36 @@ int main(int argc, char **argv) {
 			case 0x86:
 				swap = !swap;
 				break;
+			case 0x87:
+				schedule = false;
+				break;
+			case 0x88:
+				if (sscanf(optarg, "%d", &warn_shift) == 0 || warn_shift < 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --warn_shift: %s (assuming 15)\n", optarg);
+					warn_shift = 15;
+				}
+				log_write(LOG_DEBUG, use_colors, "warn_shift = %d\n", warn_shift);
+				break;
+			case 0x89:
+				stream = true;
+				break;
+			case 0x8a:
+				stats_file = optarg;
+				break;
+			case 0x8b:
+				if (trace_file == NULL && StartTrace(0)) {
+					atexit(writeTrace);
+				}
+				trace_file = optarg;
+				break;
+			case 0x8c:
+				if (!addAlso(optarg)) {
+					return 1;
+				}
+				break;
+			case 0x8d:
+				patch_file = optarg;
+				break;
 			case ':':
 				if (optopt < 0x80) {
 					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
@@ -189,13 +442,16 @@ int main(int argc, char **argv) {
 		return 3;
 	}
 
-	FILE* in_file = fopen(file_path, "r");
+	FILE* in_file = strcmp("-", file_path) == 0 ? stdin : fopen(file_path, "r");
 	if (in_file == NULL) {
 		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
 		return 3;
 	}
 
-	if (!IsSCCFile(in_file)) {
+	// Checked on one read of the first bytes, which ReadSCCPrefixed then picks up after, so pipes work too
+	u8 probe[CC_PROBE_SIZE];
+	size_t probe_size = 0;
+	if (PeekFormat(in_file, probe, &probe_size) != CC_FORMAT_SCC) {
 		log_write(LOG_ERROR, use_colors, "Input is not an SCC file!\n");
 		fclose(in_file);
 		return 6;
@@ -207,14 +463,27 @@ int main(int argc, char **argv) {
 		return 3;
 	}
 
-	FILE* out_file = fopen(output_file, "w+");
+	if (patch_file != NULL && (mode != MODE_RAW || also_count != 0 || strcmp("-", output_file) == 0)) {
+		log_write(LOG_ERROR, use_colors, "--patch only applies to a raw output file, without --also\n");
+		fclose(in_file);
+		return 1;
+	}
+
+	// A patched file is changed where it is, so it has to exist already
+	FILE* out_file = strcmp("-", output_file) == 0 ? stdout : fopen(output_file, patch_file != NULL ? "r+" : "w+");
 	if (out_file == NULL) {
 		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
 		fclose(in_file);
 		return 3;
 	}
+	if (!openAlso()) {
+		closeAlso();
+		fclose(in_file);
+		fclose(out_file);
+		return 3;
+	}
 
-	const char* mode_str[] = {"raw", "dvd", "nw4r"};
+	const char* mode_str[] = {"raw", "dvd", "nw4r", "mcc", "rcwt"};
 
 	if (field1 && field2 && mode != MODE_DVD) {
 		log_write(LOG_ERROR, use_colors, "Mode %s can't contain both fields 1 and 2!\n", mode_str[mode]);
@@ -234,8 +503,8 @@ int main(int argc, char **argv) {
 		field1 = true;
 		field2 = false;
 	}
-	// NW4R format supports Field 1 or 2, but not both at once. If none was specified, we assume Field 1.
-	else if (mode == MODE_NW4R) {
+	// NW4R, MCC and RCWT formats support Field 1 or 2, but not both at once. If none was specified, we assume Field 1.
+	else if (mode == MODE_NW4R || mode == MODE_MCC || mode == MODE_RCWT) {
 		if (!field1 && !field2) {
 			field1=true;
 		}
@@ -301,8 +570,32 @@ int main(int argc, char **argv) {
 	}
 	log_write(LOG_INFO, false, "\n");
 
-	u32 read_ccs;
-	scc_entry* ccd = ReadSCC(in_file, &read_ccs);
+	if (stats_file != NULL) {
+		InitStats(&stats);
+		SetStats(&stats);
+	}
+
+	cc_prefixed_file in;
+	InitPrefixedFile(&in, in_file, probe, probe_size);
+	if (stream && mode != MODE_RAW) {
+		log_write(LOG_WARN, use_colors, "--stream only applies to raw output, reading the whole track\n");
+	}
+	else if (stream && also_count != 0) {
+		log_write(LOG_WARN, use_colors, "--stream doesn't apply with --also, reading the whole track\n");
+	}
+	else if (stream && patch_file != NULL) {
+		log_write(LOG_WARN, use_colors, "--stream doesn't apply with --patch, reading the whole track\n");
+	}
+	else if (stream) {
+		bool8 ok = streamSCCToRaw(&in, out_file, (f32) fps, start_timecode, pad_tc, schedule, warn_shift);
+		fclose(in_file);
+		fclose(out_file);
+		reportStats(&stats, stats_file, file_path, output_file);
+		return ok ? 0 : 5;
+	}
+
+	size_t read_ccs;
+	scc_entry* ccd = ReadSCCPrefixed(&in, &read_ccs);
 	log_write(LOG_TRACE, use_colors, "address of ccd 0x%08x\n", (u32) ccd);
 	if (ccd == NULL) {
 		// error reporting done within function
@@ -311,11 +604,13 @@ int main(int argc, char **argv) {
 			fclose(in_file2);
 		}
 		fclose(out_file);
+		closeAlso();
+		reportStats(&stats, stats_file, file_path, output_file);
 		return 5;
 	}
 
 	// DVD format
-	u32 read_ccs2 = 0;
+	size_t read_ccs2 = 0;
 	scc_entry* ccd2 = NULL;
 	if (mode == MODE_DVD && in_file2 != NULL) { 
 		ccd2 = ReadSCC(in_file2, &read_ccs2);
@@ -324,11 +619,74 @@ int main(int argc, char **argv) {
 			fclose(in_file);
 			fclose(in_file2);
 			fclose(out_file);
+			closeAlso();
+			reportStats(&stats, stats_file, file_path, output_file);
 			return 5;
 		}
 	}
 
-	if (mode == MODE_RAW) {
+	// ReadSCC takes records in any order, but they're written out in frame order.
+	// Every output of a fan-out gets the same track, so a raw --also output has NW4R and SCC ones sorted and scheduled too.
+	bool8 order = mode != MODE_NW4R || alsoNeedsOrder();
+	if (order) {
+		u32 reordered;
+		if (!SortSCC(&ccd, &read_ccs, (f32) fps, &reordered)) {
+			free(ccd);
+			fclose(in_file);
+			if (in_file2 != NULL) {
+				fclose(in_file2);
+			}
+			fclose(out_file);
+			closeAlso();
+			reportStats(&stats, stats_file, file_path, output_file);
+			return 5;
+		}
+		if (reordered != 0) {
+			log_write(LOG_INFO, use_colors, "Reordered %d out of order records\n", reordered);
+		}
+	}
+
+	// Everything but NW4R is laid out frame by frame, where clashing records would otherwise be cut or rejected
+	if (schedule && order) {
+		cc_schedule_report report;
+		if (!ScheduleSCC(ccd, &read_ccs, (f32) fps, warn_shift, &report)) {
+			free(ccd);
+			fclose(in_file);
+			if (in_file2 != NULL) {
+				fclose(in_file2);
+			}
+			fclose(out_file);
+			closeAlso();
+			reportStats(&stats, stats_file, file_path, output_file);
+			return 5;
+		}
+		if (report.moved != 0) {
+			log_write(LOG_INFO, use_colors, "Rescheduled %d records to fit the caption bandwidth (%d earlier by up to %d frames, %d later by up to %d frames)\n", report.moved, report.early, (s32) report.max_early, report.late, (s32) report.max_late);
+		}
+		if (report.over_warn_shift != 0) {
+			log_write(LOG_WARN, use_colors, "%d records moved by more than %d frames (--warn_shift)\n", report.over_warn_shift, warn_shift);
+		}
+	}
+
+	bool8 ok = true;
+	bool8 fan_out = also_count != 0 && (mode == MODE_RAW || mode == MODE_NW4R);
+	if (fan_out) {
+		ok = writeFanOut(ccd, &read_ccs, out_file, mode, field, swap, (f32) fps, start_timecode, pad_tc);
+	}
+	else if (mode == MODE_RAW && patch_file != NULL) {
+		size_t old_length;
+		scc_entry* old = readOldTrack(patch_file, &old_length, (f32) fps, schedule, warn_shift);
+		cc_patch_report report;
+		ok = old != NULL && PatchRaw(out_file, old, old_length, ccd, read_ccs, (f32) fps, start_timecode, pad_tc, &report);
+		free(old);
+		if (ok) {
+			log_write(LOG_INFO, use_colors, "Patched %d ranges, %lld frames%s\n", report.ranges, (long long) report.frames, report.resized ? ", and resized the file" : "");
+		}
+		else {
+			log_write(LOG_ERROR, use_colors, "%s wasn't patched\n", output_file);
+		}
+	}
+	else if (mode == MODE_RAW) {
 		WriteRaw(ccd, &read_ccs, out_file, fps, start_timecode, pad_tc);
 	}
 	else if (mode == MODE_DVD) {
@@ -339,9 +697,28 @@ int main(int argc, char **argv) {
 			//WriteDVD(ccd, &read_ccs, ccd2, &read_ccs2, out_file, fps, start_timecode, pad_tc, 5);
 		}
 	}
+	else if (mode == MODE_MCC) {
+		if (field == 1) {
+			WriteMCC(NULL, NULL, ccd, &read_ccs, out_file, fps);
+		}
+		else {
+			WriteMCC(ccd, &read_ccs, NULL, NULL, out_file, fps);
+		}
+	}
+	else if (mode == MODE_RCWT) {
+		if (field == 1) {
+			WriteRCWT(NULL, NULL, ccd, &read_ccs, out_file, fps);
+		}
+		else {
+			WriteRCWT(ccd, &read_ccs, NULL, NULL, out_file, fps);
+		}
+	}
 	else {
 		WriteNW4R(ccd, &read_ccs, out_file, field, swap);
 	}
+	if (also_count != 0 && !fan_out) {
+		ok = writeFanOut(ccd, &read_ccs, out_file, mode, field, swap, (f32) fps, start_timecode, pad_tc);
+	}
 
 	if (ccd != NULL) {
 		free(ccd);
@@ -354,7 +731,9 @@ int main(int argc, char **argv) {
 		fclose(in_file2);
 	}
 	fclose(out_file);
-	return 0;
+	closeAlso();
+	reportStats(&stats, stats_file, file_path, output_file);
+	return ok ? 0 : 5;
 }
 
 static void prog_header(char* name) {
@@ -378,19 +757,40 @@ static void prog_header(char* name) {
 static void usage(char* name) {
 	log_write(LOG_APPLICATION, false,
 	"The basic usage is:\n"
-	"\n%s -i <input> <output>\n\n"
+	"\n%s -i <input> <output>\n"
+	"Use - as the input or output for stdin or stdout.\n\n"
 	"Detailed option listing:\n"
 	"--input\t-i <file>\n"
-	"\tSpecifies in input file (required)\n"
+	"\tSpecifies in input file (required). - reads from stdin.\n"
 	"--fps <fps>\n"
 	"\tSpecifies fps (For raw and dvd output)\n"
 	"--field[1|2]\t-[1|2]\n"
 	/*"\tFor DVD output, specify which fields to include.\n"*/
 	"\tFor NW4R output, controls the \"field\" value in the file's header.\n"
+	"\tFor MCC and RCWT output, controls which field the captions are carried in.\n"
 	"--swap\n"
 	"\tFor NW4R output, output little-endian files.\n"
-	"--mode\t-m [raw|nw4r]\n"/*|dvd]\n"*/
+	"--mode\t-m [raw|nw4r|mcc|rcwt]\n"/*|dvd]\n"*/
 	"\tSpecify output format.\n"
+	"--warn_shift <frames>\n"
+	"\tWarn about captions moved by more than this many frames to fit the caption bandwidth. Defaults to 15.\n"
+	"\tThis only sets when a warning is logged; captions are moved as far as they need to go regardless.\n"
+	"--no_schedule\n"
+	"\tDon't move overlapping captions; they are written as timed in the input.\n"
+	"--stream\n"
+	"\tFor raw output, write records as they are read, holding at most 256 records for ordering and scheduling.\n"
+	"\tMemory use doesn't grow with the input. Records further out of order than that are scheduled where they come.\n"
+	"--also <format>:<file>\n"
+	"\tAlso writes the captions as raw, scc, nw4r (big-endian) or nw4r_le, in the same pass as the main output.\n"
+	"\tCan be given more than once. With a raw output, the NW4R and SCC ones are sorted and scheduled too.\n"
+	"--patch <old.scc>\n"
+	"\tFor raw output, update an existing raw file written from old.scc with the same options, rewriting only the\n"
+	"\tframes where the input differs from it.\n"
+	"--stats <file>\n"
+	"\tWrites counters and timings for the conversion as one line of JSON. - writes to stderr.\n"
+	"--trace <file>\n"
+	"\tWrites the time spent in each step, and what happened to each record, as Chrome trace JSON\n"
+	"\t(chrome://tracing or Perfetto). - writes to stderr.\n"
 	/*"--input2 <file>\n"
 	"\tSpecifies a second input file for DVD output.\n"*/
 	"--verbose\t-v\n"
@@ -0,0 +1,266 @@
+/*
+sccedl.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "608.h"
+#include "config.h" // for git
+#include "log.h"
+
+static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper git integration
+
+static void prog_header(char* name);
+static void usage(char* name);
+
+int main(int argc, char **argv) {
+	u8 log_level = LOG_DEFAULT;
+	use_colors = isatty(STDERR_FILENO);
+	prog_header(argv[0]);
+	change_log_level(log_level);
+	f64 fps = 29.97003f; // same as scc2raw
+	char* rebase_str = NULL;
+	char* edl_path = NULL;
+	char* file_path = NULL;
+	char* output_file = NULL;
+	int c;
+
+	const struct option long_options[] = {
+		{"edl", required_argument, 0, 'e'},
+		{"input", required_argument, 0, 'i'},
+		{"fps", required_argument, 0, 0x80},
+		{"rebase", required_argument, 0, 0x84},
+		{"verbose", no_argument, 0, 'v'},
+		{"quiet", no_argument, 0, 'q'},
+		{"log_level", required_argument, 0, 0x83},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int option_index = 0;
+	opterr = 0;
+
+	while(1) {
+		int curind = optind;
+		c = getopt_long(argc, argv, ":e:hi:qv", long_options, &option_index);
+		if (c == -1) {
+			log_write(LOG_TRACE, use_colors, "Finished parsing command line options.\n");
+			break;
+		}
+		switch (c) {
+			case 0:
+				log_write(LOG_WARN, use_colors, "getopt_long Type 2 option, shouldn't happen normally\n");
+				break;
+			case 'e':
+				log_write(LOG_DEBUG, use_colors, "edl = %s\n", optarg);
+				edl_path = optarg;
+				break;
+			case 'i':
+				log_write(LOG_DEBUG, use_colors, "in = %s\n", optarg);
+				file_path = optarg;
+				break;
+			case 0x80:
+				if (sscanf(optarg, "%lf", &fps) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --fps: %s (will assume 29.97 fps)\n", optarg);
+					fps = 30.0f/1.001f;
+				}
+				log_write(LOG_DEBUG, use_colors, "fps = %lf\n", fps);
+				break;
+			case 0x84:
+				rebase_str = optarg;
+				break;
+			case 'q':
+				change_log_level(LOG_FATAL | LOG_ERROR);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 2;
+			case 'v':
+				change_log_level(LOG_VERBOSE);
+				break;
+			case 0x83:
+				if (sscanf(optarg, "%hhu", &log_level) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --log_level: %s (assuming %d)\n", optarg, LOG_DEFAULT);
+				}
+				log_write(LOG_DEBUG, use_colors, "log level = %hhu\n",  log_level);
+				change_log_level(log_level);
+				break;
+			case ':':
+				if (optopt < 0x80) {
+					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
+				}
+				else {
+					log_write(LOG_ERROR, use_colors, "Option %s requires an argument\n", argv[curind]);
+				}
+				return 1;
+			case '?':
+			default:
+				if (optopt) {
+					log_write(LOG_WARN, use_colors, "Invalid option -%c (ignoring)\n", optopt);
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid option %s (ignoring)\n", argv[curind]);
+				}
+				break;
+		}
+	}
+	if (optind < argc) {
+		output_file = argv[optind++];
+		log_write(LOG_DEBUG, use_colors, "output to %s...\n", output_file);
+	}
+	while (optind < argc) {
+		log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[optind++]);
+	}
+
+	if ((edl_path == NULL) || (strcmp("", edl_path) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An EDL file is required.\n");
+		return 3;
+	}
+	if ((file_path == NULL) || (strcmp("", file_path) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An input file is required.\n");
+		return 3;
+	}
+	if ((output_file == NULL) || (strcmp("", output_file) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An output file is required.\n");
+		return 3;
+	}
+	u32 nominal = (u32) (fps + 0.5);
+	s64 rebase = 0;
+	if (rebase_str != NULL) {
+		timecode rebase_tc = default_timecode;
+		s16 hrs;
+		u8 min, sec, frames;
+		char separator = ':';
+		if (sscanf(rebase_str, "%hd:%hhu:%hhu%c%hhu", &hrs, &min, &sec, &separator, &frames) != 5) {
+			log_write(LOG_ERROR, use_colors, "Invalid parameter for option --rebase: %s\n", rebase_str);
+			return 1;
+		}
+		rebase_tc.hours = hrs;
+		rebase_tc.minutes = min;
+		rebase_tc.seconds = sec;
+		rebase_tc.frames = frames;
+		rebase_tc.drop = separator == ';' || separator == '.';
+		rebase = TimecodeToFrame(rebase_tc, nominal);
+	}
+
+	FILE* edl_file = fopen(edl_path, "r");
+	if (edl_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", edl_path, errno, strerror(errno));
+		return 3;
+	}
+	size_t event_count;
+	cc_edl_event* events = ReadEDL(edl_file, nominal, &event_count);
+	fclose(edl_file);
+	if (events == NULL) {
+		return 5;
+	}
+	FILE* in_file = fopen(file_path, "r");
+	if (in_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
+		free(events);
+		return 3;
+	}
+	bool8 raw = IsRawFile(in_file);
+	if (!raw && !IsSCCFile(in_file)) {
+		log_write(LOG_ERROR, use_colors, "Input is neither an SCC file nor a raw file!\n");
+		fclose(in_file);
+		free(events);
+		return 6;
+	}
+
+	log_write(LOG_INFO, use_colors, "Input: %s\nEDL: %s (%d events)\nOutput: %s\nFPS: %f\nRebase: %d frames\n", file_path, edl_path, (u32) event_count, output_file, fps, (s32) rebase);
+
+	int ret = 0;
+	FILE* out_file = fopen(output_file, "w+");
+	if (out_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		fclose(in_file);
+		free(events);
+		return 3;
+	}
+	if (raw) {
+		// Raw input is cut while it's read, and comes out raw
+		if (ApplyEDLRaw(in_file, out_file, events, event_count, rebase) == 0) {
+			ret = 5;
+		}
+		fclose(in_file);
+	}
+	else {
+		size_t read_ccs;
+		scc_entry* ccd = ReadSCC(in_file, &read_ccs);
+		fclose(in_file);
+		size_t out_length;
+		scc_entry* edited = NULL;
+		if (ccd == NULL || !SortSCC(&ccd, &read_ccs, (f32) fps, NULL) || (edited = ApplyEDL(ccd, read_ccs, events, event_count, nominal, rebase, &out_length)) == NULL) {
+			ret = 5;
+		}
+		else {
+			WriteSCC(edited, &out_length, out_file);
+		}
+		free(edited);
+		free(ccd);
+	}
+	fclose(out_file);
+	free(events);
+	return ret;
+}
+
+static void prog_header(char* name) {
+	log_write(LOG_APPLICATION, false, "%s version", name);
+	if (strcmp("", versionInfo.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", versionInfo.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", versionInfo.major, versionInfo.minor, versionInfo.revision, versionInfo.build);
+	}
+	log_write(LOG_APPLICATION, false, "\nlib608 version:");
+	if (strcmp("", library_version.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", library_version.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	log_write(LOG_APPLICATION, false, "\n\n%s is distributed under the terms of the GNU General Public License v3 or later; view these terms in the included License.txt file.\n\n", name);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s -e <edl> -i <input> <output>\n"
+	"Cuts an SCC or raw file to match a CMX3600 EDL. The output has the input's format.\n"
+	"Events have to keep the source's order; captions are erased and resumed at each splice.\n\n"
+	"Detailed option listing:\n"
+	"--edl\t-e <file>\n"
+	"\tSpecifies the EDL (required)\n"
+	"--input\t-i <file>\n"
+	"\tSpecifies in input file (required)\n"
+	"--fps <fps>\n"
+	"\tSpecifies fps\n"
+	"--rebase <00:00:00:00>\n"
+	"\tSubtracts this timecode from the record timecodes, e.g. 01:00:00:00 for a program that starts at hour 1.\n"
+	"\tRaw files always start at frame 0, so their record timecodes usually need this.\n"
+	"--verbose\t-v\n"
+	"\tBe more verbose.\n"
+	"--quiet\t-q\n"
+	"\tOnly output errors.\n"
+	"--log_level <level>\n"
+	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
+	"\t\t1: Fatal\n"
+	"\t\t2: Error\n"
+	"\t\t4: Warning\n"
+	"\t\t8: Info\n"
+	"\t\t16: Debug\n"
+	"\t\t32: Trace\n"
+	"\t\t64: Library messages\n"
+	"\t\t128: Application messages (internally only)\n"
+	"--help\t-h\n"
+	"\tShows this info\n"
+	"\n\n", name);
+}
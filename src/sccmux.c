@@ -0,0 +1,289 @@
+/*
+sccmux.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "608.h"
+#include "config.h" // for git
+#include "log.h"
+
+static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper git integration
+
+enum{
+	MODE_RAW,
+	MODE_NW4R
+}; // This is used to select the output format
+
+static void prog_header(char* name);
+static void usage(char* name);
+
+int main(int argc, char **argv) {
+	u8 log_level = LOG_DEFAULT;
+	use_colors = isatty(STDERR_FILENO);
+	prog_header(argv[0]);
+	change_log_level(log_level);
+	u8 mode = MODE_RAW;
+	bool8 swap = !WORDS_BIGENDIAN;
+	f64 fps = 29.97003f; // same as scc2raw
+	char* file_paths[CC_MUX_XDS + 1] = {NULL};
+	char* output_file = NULL;
+	int c;
+
+	const struct option long_options[] = {
+		{"cc1", required_argument, 0, 0x90},
+		{"cc2", required_argument, 0, 0x91},
+		{"cc3", required_argument, 0, 0x92},
+		{"cc4", required_argument, 0, 0x93},
+		{"xds", required_argument, 0, 0x94},
+		{"mode", required_argument, 0, 'm'},
+		{"swap", no_argument, 0, 0x86},
+		{"fps", required_argument, 0, 0x80},
+		{"verbose", no_argument, 0, 'v'},
+		{"quiet", no_argument, 0, 'q'},
+		{"log_level", required_argument, 0, 0x83},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int option_index = 0;
+	opterr = 0;
+
+	while(1) {
+		int curind = optind;
+		c = getopt_long(argc, argv, ":hm:qv", long_options, &option_index);
+		if (c == -1) {
+			log_write(LOG_TRACE, use_colors, "Finished parsing command line options.\n");
+			break;
+		}
+		switch (c) {
+			case 0:
+				log_write(LOG_WARN, use_colors, "getopt_long Type 2 option, shouldn't happen normally\n");
+				break;
+			case 0x90:
+			case 0x91:
+			case 0x92:
+			case 0x93:
+			case 0x94:
+				file_paths[c - 0x90] = optarg;
+				log_write(LOG_DEBUG, use_colors, "input %d = %s\n", c - 0x90, optarg);
+				break;
+			case 'm':
+				if (strcasecmp("raw", optarg) == 0) {
+					mode = MODE_RAW;
+				}
+				else if (strcasecmp("nw4r", optarg) == 0) {
+					mode = MODE_NW4R;
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "--mode must be either 'raw' or 'nw4r', assuming raw mode\n");
+					mode = MODE_RAW;
+				}
+				break;
+			case 0x86:
+				swap = !swap;
+				break;
+			case 'q':
+				change_log_level(LOG_FATAL | LOG_ERROR);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 2;
+			case 'v':
+				change_log_level(LOG_VERBOSE);
+				break;
+			case 0x80:
+				if (sscanf(optarg, "%lf", &fps) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --fps: %s (will assume 29.97 fps)\n", optarg);
+					fps = 30.0f/1.001f;
+				}
+				log_write(LOG_DEBUG, use_colors, "fps = %lf\n", fps);
+				break;
+			case 0x83:
+				if (sscanf(optarg, "%hhu", &log_level) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --log_level: %s (assuming %d)\n", optarg, LOG_DEFAULT);
+				}
+				log_write(LOG_DEBUG, use_colors, "log level = %hhu\n",  log_level);
+				change_log_level(log_level);
+				break;
+			case ':':
+				if (optopt < 0x80) {
+					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
+				}
+				else {
+					log_write(LOG_ERROR, use_colors, "Option %s requires an argument\n", argv[curind]);
+				}
+				return 1;
+			case '?':
+			default:
+				if (optopt) {
+					log_write(LOG_WARN, use_colors, "Invalid option -%c (ignoring)\n", optopt);
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid option %s (ignoring)\n", argv[curind]);
+				}
+				break;
+		}
+	}
+	if (optind < argc) {
+		output_file = argv[optind++];
+		log_write(LOG_DEBUG, use_colors, "output to %s...\n", output_file);
+	}
+	while (optind < argc) {
+		log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[optind++]);
+	}
+
+	// Each output file holds one field: CC1 and CC2 in Field 1, CC3, CC4 and XDS in Field 2
+	u8 input_count = 0;
+	bool8 field1 = false;
+	bool8 field2 = false;
+	for (u8 i = 0; i <= CC_MUX_XDS; i++) {
+		if (file_paths[i] != NULL && strcmp("", file_paths[i]) != 0) {
+			input_count++;
+			if (i < 2) {
+				field1 = true;
+			}
+			else {
+				field2 = true;
+			}
+		}
+	}
+	if (input_count == 0) {
+		log_write(LOG_ERROR, use_colors, "At least one input file is required.\n");
+		return 3;
+	}
+	if (field1 && field2) {
+		log_write(LOG_ERROR, use_colors, "Inputs for both fields were given, but an output file holds only one field. Mux each field separately.\n");
+		return 4;
+	}
+	if (mode == MODE_RAW && field2) {
+		log_write(LOG_ERROR, use_colors, "Raw output only holds Field 1 (CC1 and CC2); use --mode nw4r for Field 2.\n");
+		return 4;
+	}
+	if ((output_file == NULL) || (strcmp("", output_file) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An output file is required.\n");
+		return 3;
+	}
+	if (mode != MODE_NW4R && swap != !WORDS_BIGENDIAN) {
+		log_write(LOG_WARN, use_colors, "Option --swap is relevant only when mode = NW4R (ignoring) \n");
+		swap = !WORDS_BIGENDIAN;
+	}
+
+	const char* channel_str[] = {"CC1", "CC2", "CC3", "CC4", "XDS"};
+	const char* mode_str[] = {"raw", "nw4r"};
+	log_write(LOG_INFO, use_colors, "Output: %s\nFPS: %f\nMode: %s\nField: %d\n", output_file, fps, mode_str[mode], field2 ? 2 : 1);
+
+	cc_mux_input inputs[CC_MUX_XDS + 1];
+	u8 count = 0;
+	int ret = 0;
+	for (u8 i = 0; i <= CC_MUX_XDS; i++) {
+		if (file_paths[i] == NULL || strcmp("", file_paths[i]) == 0) {
+			continue;
+		}
+		log_write(LOG_INFO, use_colors, "%s: %s\n", channel_str[i], file_paths[i]);
+		FILE* in_file = fopen(file_paths[i], "r");
+		if (in_file == NULL) {
+			log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_paths[i], errno, strerror(errno));
+			ret = 3;
+			goto cleanup;
+		}
+		if (!IsSCCFile(in_file)) {
+			log_write(LOG_ERROR, use_colors, "Input %s is not an SCC file!\n", file_paths[i]);
+			fclose(in_file);
+			ret = 6;
+			goto cleanup;
+		}
+		size_t length;
+		scc_entry* track = ReadSCC(in_file, &length);
+		fclose(in_file);
+		if (track == NULL || !SortSCC(&track, &length, (f32) fps, NULL)) {
+			free(track);
+			ret = 5;
+			goto cleanup;
+		}
+		inputs[count].track = track;
+		inputs[count].length = length;
+		inputs[count].channel = i;
+		count++;
+	}
+
+	FILE* out_file = fopen(output_file, "w+");
+	if (out_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		ret = 3;
+		goto cleanup;
+	}
+	if (MuxSCC(inputs, count, field2 ? 1 : 0, mode == MODE_NW4R ? CC_MUX_NW4R : CC_MUX_RAW, out_file, (f32) fps, swap) == 0) {
+		ret = 5;
+	}
+	fclose(out_file);
+
+	cleanup:
+	for (u8 i = 0; i < count; i++) {
+		free((scc_entry*) inputs[i].track);
+	}
+	return ret;
+}
+
+static void prog_header(char* name) {
+	log_write(LOG_APPLICATION, false, "%s version", name);
+	if (strcmp("", versionInfo.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", versionInfo.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", versionInfo.major, versionInfo.minor, versionInfo.revision, versionInfo.build);
+	}
+	log_write(LOG_APPLICATION, false, "\nlib608 version:");
+	if (strcmp("", library_version.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", library_version.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	log_write(LOG_APPLICATION, false, "\n\n%s is distributed under the terms of the GNU General Public License v3 or later; view these terms in the included License.txt file.\n\n", name);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s --cc1 <input> --cc2 <input> <output>\n"
+	"Inputs are SCC files. Control codes are moved to the channel each input is muxed into.\n\n"
+	"Detailed option listing:\n"
+	"--cc1 <file>\n"
+	"--cc2 <file>\n"
+	"\tSpecifies the inputs for the Field 1 channels\n"
+	"--cc3 <file>\n"
+	"--cc4 <file>\n"
+	"--xds <file>\n"
+	"\tSpecifies the inputs for Field 2 (NW4R output only)\n"
+	"--mode\t-m [raw|nw4r]\n"
+	"\tSpecify output format. Defaults to raw.\n"
+	"--swap\n"
+	"\tFor NW4R output, swap the byte order.\n"
+	"--fps <fps>\n"
+	"\tSpecifies fps\n"
+	"--verbose\t-v\n"
+	"\tBe more verbose.\n"
+	"--quiet\t-q\n"
+	"\tOnly output errors.\n"
+	"--log_level <level>\n"
+	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
+	"\t\t1: Fatal\n"
+	"\t\t2: Error\n"
+	"\t\t4: Warning\n"
+	"\t\t8: Info\n"
+	"\t\t16: Debug\n"
+	"\t\t32: Trace\n"
+	"\t\t64: Library messages\n"
+	"\t\t128: Application messages (internally only)\n"
+	"--help\t-h\n"
+	"\tShows this info\n"
+	"\n\n", name);
+}
@@ -0,0 +1,295 @@
+/*
+sccretime.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "608.h"
+#include "config.h" // for git
+#include "log.h"
+
+static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper git integration
+
+static void prog_header(char* name);
+static void usage(char* name);
+
+// Takes 30000/1001 style rationals, or decimals with the NTSC rates mapped to their exact values
+static bool8 parseRational(const char* str, u32* num, u32* den) {
+	f64 value;
+	if (strchr(str, '/') != NULL) {
+		return sscanf(str, "%u/%u", num, den) == 2 && *num != 0 && *den != 0;
+	}
+	if (sscanf(str, "%lf", &value) != 1 || value <= 0) {
+		return false;
+	}
+	const u32 ntsc[] = {24, 30, 48, 60};
+	for (int i = 0; i < 4; i++) {
+		f64 rate = ntsc[i] / 1.001;
+		if (value > rate - 0.005 && value < rate + 0.005) {
+			*num = ntsc[i] * 1000;
+			*den = 1001;
+			return true;
+		}
+	}
+	*num = (u32) ((value * 1000) + 0.5);
+	*den = 1000;
+	// Keep whole rates as n/1
+	if (*num % 1000 == 0) {
+		*num /= 1000;
+		*den = 1;
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	u8 log_level = LOG_DEFAULT;
+	use_colors = isatty(STDERR_FILENO);
+	prog_header(argv[0]);
+	change_log_level(log_level);
+	cc_retime retime = {30000, 1001, 0, 0, 1, 1, 0, false};
+	s8 out_drop = -1; // keep the input's
+	bool8 negative_offset = false;
+	char* offset_str = NULL;
+	char* file_path = NULL;
+	char* output_file = NULL;
+	int c;
+
+	const struct option long_options[] = {
+		{"input", required_argument, 0, 'i'},
+		{"in_fps", required_argument, 0, 0x80},
+		{"out_fps", required_argument, 0, 0x81},
+		{"speed", required_argument, 0, 0x82},
+		{"offset", required_argument, 0, 0x84},
+		{"dropframe", no_argument, 0, 'd'},
+		{"nondropframe", no_argument, 0, 'n'},
+		{"verbose", no_argument, 0, 'v'},
+		{"quiet", no_argument, 0, 'q'},
+		{"log_level", required_argument, 0, 0x83},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int option_index = 0;
+	opterr = 0;
+
+	while(1) {
+		int curind = optind;
+		c = getopt_long(argc, argv, ":dhi:nqv", long_options, &option_index);
+		if (c == -1) {
+			log_write(LOG_TRACE, use_colors, "Finished parsing command line options.\n");
+			break;
+		}
+		switch (c) {
+			case 0:
+				log_write(LOG_WARN, use_colors, "getopt_long Type 2 option, shouldn't happen normally\n");
+				break;
+			case 'd':
+				out_drop = true;
+				break;
+			case 'n':
+				out_drop = false;
+				break;
+			case 'i':
+				log_write(LOG_DEBUG, use_colors, "in = %s\n", optarg);
+				file_path = optarg;
+				break;
+			case 0x80:
+				if (!parseRational(optarg, &retime.in_num, &retime.in_den)) {
+					log_write(LOG_ERROR, use_colors, "Invalid parameter for option --in_fps: %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 0x81:
+				if (!parseRational(optarg, &retime.out_num, &retime.out_den)) {
+					log_write(LOG_ERROR, use_colors, "Invalid parameter for option --out_fps: %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 0x82:
+				if (!parseRational(optarg, &retime.speed_num, &retime.speed_den)) {
+					log_write(LOG_ERROR, use_colors, "Invalid parameter for option --speed: %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 0x84:
+				negative_offset = optarg[0] == '-';
+				offset_str = negative_offset ? optarg + 1 : optarg;
+				break;
+			case 'q':
+				change_log_level(LOG_FATAL | LOG_ERROR);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 2;
+			case 'v':
+				change_log_level(LOG_VERBOSE);
+				break;
+			case 0x83:
+				if (sscanf(optarg, "%hhu", &log_level) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --log_level: %s (assuming %d)\n", optarg, LOG_DEFAULT);
+				}
+				log_write(LOG_DEBUG, use_colors, "log level = %hhu\n",  log_level);
+				change_log_level(log_level);
+				break;
+			case ':':
+				if (optopt < 0x80) {
+					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
+				}
+				else {
+					log_write(LOG_ERROR, use_colors, "Option %s requires an argument\n", argv[curind]);
+				}
+				return 1;
+			case '?':
+			default:
+				if (optopt) {
+					log_write(LOG_WARN, use_colors, "Invalid option -%c (ignoring)\n", optopt);
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid option %s (ignoring)\n", argv[curind]);
+				}
+				break;
+		}
+	}
+	if (optind < argc) {
+		output_file = argv[optind++];
+		log_write(LOG_DEBUG, use_colors, "output to %s...\n", output_file);
+	}
+	while (optind < argc) {
+		log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[optind++]);
+	}
+
+	if ((file_path == NULL) || (strcmp("", file_path) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An input file is required.\n");
+		return 3;
+	}
+	if ((output_file == NULL) || (strcmp("", output_file) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An output file is required.\n");
+		return 3;
+	}
+	if (retime.out_num == 0) {
+		retime.out_num = retime.in_num;
+		retime.out_den = retime.in_den;
+	}
+	u32 out_nominal = (retime.out_num + (retime.out_den / 2)) / retime.out_den;
+
+	FILE* in_file = fopen(file_path, "r");
+	if (in_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
+		return 3;
+	}
+	if (!IsSCCFile(in_file)) {
+		log_write(LOG_ERROR, use_colors, "Input is not an SCC file!\n");
+		fclose(in_file);
+		return 6;
+	}
+	size_t read_ccs;
+	scc_entry* ccd = ReadSCC(in_file, &read_ccs);
+	fclose(in_file);
+	if (ccd == NULL) {
+		return 5;
+	}
+	retime.out_drop = out_drop < 0 ? (read_ccs != 0 && ccd->pts.tc.drop) : (bool8) out_drop;
+	if (offset_str != NULL) {
+		timecode offset_tc = default_timecode;
+		s16 hrs;
+		u8 min, sec, frames;
+		char separator = ':';
+		if (sscanf(offset_str, "%hd:%hhu:%hhu%c%hhu", &hrs, &min, &sec, &separator, &frames) != 5) {
+			log_write(LOG_ERROR, use_colors, "Invalid parameter for option --offset: %s\n", offset_str);
+			free(ccd);
+			return 1;
+		}
+		offset_tc.hours = hrs;
+		offset_tc.minutes = min;
+		offset_tc.seconds = sec;
+		offset_tc.frames = frames;
+		offset_tc.drop = separator == ';' || separator == '.';
+		retime.offset = TimecodeToFrame(offset_tc, out_nominal);
+		if (negative_offset) {
+			retime.offset = -retime.offset;
+		}
+	}
+
+	log_write(LOG_INFO, use_colors, "Input: %s\nOutput: %s\nFPS: %d/%d -> %d/%d%s\nSpeed: %d/%d\nOffset: %d frames\n", file_path, output_file, retime.in_num, retime.in_den, retime.out_num, retime.out_den, retime.out_drop ? " (dropframe)" : "", retime.speed_num, retime.speed_den, (s32) retime.offset);
+
+	cc_retime_report report;
+	if (!RetimeSCC(ccd, &read_ccs, &retime, &report)) {
+		free(ccd);
+		return 5;
+	}
+	FILE* out_file = fopen(output_file, "w+");
+	if (out_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		free(ccd);
+		return 3;
+	}
+	WriteSCC(ccd, &read_ccs, out_file);
+	fclose(out_file);
+	free(ccd);
+	log_write(LOG_INFO, use_colors, "Retimed %d records\n", report.records - report.removed);
+	// Let batch jobs pick out the tracks that need attention
+	return report.overlaps != 0 ? 7 : 0;
+}
+
+static void prog_header(char* name) {
+	log_write(LOG_APPLICATION, false, "%s version", name);
+	if (strcmp("", versionInfo.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", versionInfo.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", versionInfo.major, versionInfo.minor, versionInfo.revision, versionInfo.build);
+	}
+	log_write(LOG_APPLICATION, false, "\nlib608 version:");
+	if (strcmp("", library_version.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", library_version.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	log_write(LOG_APPLICATION, false, "\n\n%s is distributed under the terms of the GNU General Public License v3 or later; view these terms in the included License.txt file.\n\n", name);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s -i <input> <output>\n"
+	"Exits with 7 if the retimed captions no longer fit in 2 bytes per frame.\n\n"
+	"Detailed option listing:\n"
+	"--input\t-i <file>\n"
+	"\tSpecifies in input file (required)\n"
+	"--in_fps <fps>\n"
+	"\tSpecifies the input frame rate, as a decimal (29.97) or a ratio (30000/1001). Defaults to 29.97.\n"
+	"--out_fps <fps>\n"
+	"\tSpecifies the output frame rate. Defaults to the input frame rate.\n"
+	"--speed <ratio>\n"
+	"\tSpecifies a playback speed change, e.g. 25/24 for a PAL speed-up or 1000/1001 for a pull-down.\n"
+	"--offset <[-]00:00:00:00>\n"
+	"\tShifts the output by this timecode, in output frames.\n"
+	"--dropframe\t-d\n"
+	"--nondropframe\t-n\n"
+	"\tWrites dropframe or non-dropframe timecodes. Defaults to the input's.\n"
+	"--verbose\t-v\n"
+	"\tBe more verbose.\n"
+	"--quiet\t-q\n"
+	"\tOnly output errors.\n"
+	"--log_level <level>\n"
+	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
+	"\t\t1: Fatal\n"
+	"\t\t2: Error\n"
+	"\t\t4: Warning\n"
+	"\t\t8: Info\n"
+	"\t\t16: Debug\n"
+	"\t\t32: Trace\n"
+	"\t\t64: Library messages\n"
+	"\t\t128: Application messages (internally only)\n"
+	"--help\t-h\n"
+	"\tShows this info\n"
+	"\n\n", name);
+}
@@ -0,0 +1,303 @@
+/*
+txt2scc.c
+part of Luma's EIA-608 Tools
+License: GPL v3 or later
+(see License.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "608.h"
+#include "config.h" // for git
+#include "log.h"
+
+static const VersionInfo versionInfo = {0, 5, 0, 0, VERSION}; // todo: proper git integration
+
+enum{
+	MODE_SCC,
+	MODE_RAW,
+	MODE_NW4R
+}; // This is used to select the output format
+
+static void prog_header(char* name);
+static void usage(char* name);
+
+int main(int argc, char **argv) {
+	u8 log_level = LOG_DEFAULT;
+	use_colors = isatty(STDERR_FILENO);
+	prog_header(argv[0]);
+	change_log_level(log_level);
+	u8 mode = MODE_SCC;
+	u8 style = CC_MODE_POPON;
+	u8 rows = 3;
+	u8 channel = 0;
+	bool8 center = true;
+	bool8 center_set = false;
+	bool8 swap = !WORDS_BIGENDIAN;
+	f64 fps = 30/1.001f;
+	bool8 drop = false;
+	char* file_path = NULL;
+	char* output_file = NULL;
+	int c;
+
+	const struct option long_options[] = {
+		{"input", required_argument, 0, 'i'},
+		{"format", required_argument, 0, 'f'},
+		{"style", required_argument, 0, 's'},
+		{"rows", required_argument, 0, 'r'},
+		{"channel", required_argument, 0, 'c'},
+		{"left", no_argument, 0, 'l'},
+		{"center", no_argument, 0, 0x85},
+		{"swap", no_argument, 0, 0x86},
+		{"fps", required_argument, 0, 0x80},
+		{"verbose", no_argument, 0, 'v'},
+		{"quiet", no_argument, 0, 'q'},
+		{"log_level", required_argument, 0, 0x83},
+		{"help", no_argument, 0, 'h'},
+		{"dropframe", no_argument, 0, 'd'},
+		{0, 0, 0, 0}
+	};
+	int option_index = 0;
+	opterr = 0;
+
+	while(1) {
+		int curind = optind;
+		c = getopt_long(argc, argv, ":c:df:hi:lqr:s:v", long_options, &option_index);
+		if (c == -1) {
+			log_write(LOG_TRACE, use_colors, "Finished parsing command line options.\n");
+			break;
+		}
+		switch (c) {
+			case 0:
+				log_write(LOG_WARN, use_colors, "getopt_long Type 2 option, shouldn't happen normally\n");
+				break;
+			case 'c':
+				if (sscanf(optarg, "%hhu", &channel) == 0 || channel < 1 || channel > 4) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --channel: %s (will assume 1)\n", optarg);
+					channel = 1;
+				}
+				channel--;
+				log_write(LOG_DEBUG, use_colors, "channel = CC%hhu\n", channel + 1);
+				break;
+			case 'd':
+				drop = true;
+				break;
+			case 'f':
+				if (strcmp("scc", optarg) == 0) {
+					mode = MODE_SCC;
+				}
+				else if (strcmp("raw", optarg) == 0) {
+					mode = MODE_RAW;
+				}
+				else if (strcmp("nw4r", optarg) == 0) {
+					mode = MODE_NW4R;
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --format: %s (will assume scc)\n", optarg);
+					mode = MODE_SCC;
+				}
+				break;
+			case 'l':
+				center = false;
+				center_set = true;
+				break;
+			case 0x85:
+				center = true;
+				center_set = true;
+				break;
+			case 0x86:
+				swap = !swap;
+				break;
+			case 'r':
+				if (sscanf(optarg, "%hhu", &rows) == 0 || rows < 2 || rows > 4) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --rows: %s (will assume 3)\n", optarg);
+					rows = 3;
+				}
+				break;
+			case 's':
+				if (strcmp("popon", optarg) == 0) {
+					style = CC_MODE_POPON;
+				}
+				else if (strcmp("rollup", optarg) == 0) {
+					style = CC_MODE_ROLLUP;
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --style: %s (will assume popon)\n", optarg);
+					style = CC_MODE_POPON;
+				}
+				break;
+			case 'q':
+				change_log_level(LOG_FATAL | LOG_ERROR);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 2;
+			case 'i':
+				log_write(LOG_DEBUG, use_colors, "in = %s\n", optarg);
+				file_path = optarg;
+				break;
+			case 'v':
+				change_log_level(LOG_VERBOSE);
+				break;
+			case 0x80:
+				if (sscanf(optarg, "%lf", &fps) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --fps: %s (will assume 29.97 fps)\n", optarg);
+					fps = 30.0f/1.001f;
+				}
+				log_write(LOG_DEBUG, use_colors, "fps = %lf\n", fps);
+				break;
+			case 0x83:
+				if (sscanf(optarg, "%hhu", &log_level) == 0) {
+					log_write(LOG_WARN, use_colors, "Invalid parameter for option --log_level: %s (assuming %d)\n", optarg, LOG_DEFAULT);
+				}
+				log_write(LOG_DEBUG, use_colors, "log level = %hhu\n",  log_level);
+				change_log_level(log_level);
+				break;
+			case ':':
+				if (optopt < 0x80) {
+					log_write(LOG_ERROR, use_colors, "Option -%c requires an argument\n", optopt);
+				}
+				else {
+					log_write(LOG_ERROR, use_colors, "Option %s requires an argument\n", argv[curind]);
+				}
+				return 1;
+			case '?':
+			default:
+				if (optopt) {
+					log_write(LOG_WARN, use_colors, "Invalid option -%c (ignoring)\n", optopt);
+				}
+				else {
+					log_write(LOG_WARN, use_colors, "Invalid option %s (ignoring)\n", argv[curind]);
+				}
+				break;
+		}
+	}
+	if (optind < argc) {
+		output_file = argv[optind++];
+		log_write(LOG_DEBUG, use_colors, "output to %s...\n", output_file);
+	}
+	while (optind < argc) {
+		log_write(LOG_WARN, use_colors, "Trailing option %s was found (ignoring).\n", argv[optind++]);
+	}
+
+	if ((file_path == NULL) || (strcmp("", file_path) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An input file is required.\n");
+		return 3;
+	}
+	if ((output_file == NULL) || (strcmp("", output_file) == 0)) {
+		log_write(LOG_ERROR, use_colors, "An output file is required.\n");
+		return 3;
+	}
+	// Raw output only carries Field 1
+	if (mode == MODE_RAW && channel > 1) {
+		log_write(LOG_WARN, use_colors, "Raw output only holds Field 1, using CC%hhu\n", (channel & 0x1) + 1);
+		channel &= 0x1;
+	}
+	// Roll-up captions are normally left aligned
+	if (!center_set) {
+		center = style == CC_MODE_POPON;
+	}
+
+	FILE* in_file = fopen(file_path, "r");
+	if (in_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", file_path, errno, strerror(errno));
+		return 3;
+	}
+	FILE* out_file = fopen(output_file, "w+");
+	if (out_file == NULL) {
+		log_write(LOG_ERROR, use_colors, "Can't open file %s (%d: %s)\n", output_file, errno, strerror(errno));
+		fclose(in_file);
+		return 3;
+	}
+
+	const char* mode_str[] = {"scc", "raw", "nw4r"};
+	log_write(LOG_INFO, use_colors, "Input: %s\nOutput: %s\nOutput Format: %s\nFPS: %f\nStyle: %s\nChannel: CC%hhu\n", file_path, output_file, mode_str[mode], fps, style == CC_MODE_POPON ? "pop-on" : "roll-up", channel + 1);
+
+	size_t read_ccs;
+	scc_entry* ccd = EncodeTextFile(in_file, &read_ccs, style, channel, rows, center, fps, drop);
+	if (ccd == NULL) {
+		fclose(in_file);
+		fclose(out_file);
+		return 5;
+	}
+	if (mode == MODE_SCC) {
+		WriteSCC(ccd, &read_ccs, out_file);
+	}
+	else if (mode == MODE_RAW) {
+		WriteRaw(ccd, &read_ccs, out_file, fps, default_timecode, default_timecode);
+	}
+	else {
+		WriteNW4R(ccd, &read_ccs, out_file, channel >> 1, swap);
+	}
+	free(ccd);
+	fclose(in_file);
+	fclose(out_file);
+	return 0;
+}
+
+static void prog_header(char* name) {
+	log_write(LOG_APPLICATION, false, "%s version", name);
+	if (strcmp("", versionInfo.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", versionInfo.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", versionInfo.major, versionInfo.minor, versionInfo.revision, versionInfo.build);
+	}
+	log_write(LOG_APPLICATION, false, "\nlib608 version:");
+	if (strcmp("", library_version.git_rev) != 0) {
+		log_write(LOG_APPLICATION, false, " %s", library_version.git_rev);
+	}
+	else {
+		log_write(LOG_APPLICATION, false, " %hd.%hd.%hd.%hd", library_version.major, library_version.minor, library_version.revision, library_version.build);
+	}
+	log_write(LOG_APPLICATION, false, "\n\n%s is distributed under the terms of the GNU General Public License v3 or later; view these terms in the included License.txt file.\n\n", name);
+}
+
+static void usage(char* name) {
+	log_write(LOG_APPLICATION, false,
+	"The basic usage is:\n"
+	"\n%s -i <input> <output>\n"
+	"Input can be SubRip (.srt) or WebVTT (.vtt).\n\n"
+	"Detailed option listing:\n"
+	"--input\t-i <file>\n"
+	"\tSpecifies in input file (required)\n"
+	"--format\t-f <scc|raw|nw4r>\n"
+	"\tSpecifies the output format. Defaults to scc.\n"
+	"--style\t-s <popon|rollup>\n"
+	"\tSpecifies the caption style. Defaults to popon.\n"
+	"--rows\t-r <2-4>\n"
+	"\tSpecifies the roll-up window size. Defaults to 3.\n"
+	"--channel\t-c <1-4>\n"
+	"\tSpecifies the caption channel (CC1-CC4). Defaults to 1.\n"
+	"--left\t-l\n"
+	"--center\n"
+	"\tAligns rows to the left or center. Pop-on defaults to center, roll-up to left.\n"
+	"--swap\n"
+	"\tFor NW4R output, swap the byte order (the default matches scc2raw)\n"
+	"--fps <fps>\n"
+	"\tSpecifies fps\n"
+	"--verbose\t-v\n"
+	"\tBe more verbose.\n"
+	"--quiet\t-q\n"
+	"\tOnly output errors.\n"
+	"--log_level <level>\n"
+	"\tSpecify a custom log level. Defaults to 207. Log bitmasks are as follows:\n"
+	"\t\t1: Fatal\n"
+	"\t\t2: Error\n"
+	"\t\t4: Warning\n"
+	"\t\t8: Info\n"
+	"\t\t16: Debug\n"
+	"\t\t32: Trace\n"
+	"\t\t64: Library messages\n"
+	"\t\t128: Application messages (internally only)\n"
+	"--dropframe\t-d\n"
+	"\tSpecifies dropframe for the output\n"
+	"--help\t-h\n"
+	"\tShows this info\n"
+	"\n\n", name);
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+# The cues cc2vtt makes from raw, and from a muxed raw track, have to match the ones it makes from the SCC they came from.
+# rollup-edm.scc ends a roll-up caption with an EDM, and raw and muxed tracks pad every frame instead of leaving gaps.
+srcdir=${srcdir:-.}
+BINDIR=${BINDIR:-../src}
+out=rollup-cues.$$
+set -e
+"$BINDIR/cc2vtt" -i "$srcdir/rollup-edm.scc" -o $out.scc.vtt >/dev/null 2>&1
+"$BINDIR/scc2raw" -i "$srcdir/rollup-edm.scc" -o $out.raw >/dev/null 2>&1
+"$BINDIR/cc2vtt" -i $out.raw -o $out.raw.vtt >/dev/null 2>&1
+"$BINDIR/sccmux" --cc1 "$srcdir/rollup-edm.scc" --cc2 "$srcdir/rollup-edm-cc2.scc" $out.mux.raw >/dev/null 2>&1
+"$BINDIR/cc2vtt" -i $out.mux.raw -o $out.mux.vtt >/dev/null 2>&1
+set +e
+status=0
+if ! cmp -s $out.scc.vtt $out.raw.vtt; then
+	echo "raw cues differ from the SCC ones:"
+	diff $out.scc.vtt $out.raw.vtt
+	status=1
+fi
+# Muxing delays the pop-on caption while it shares the channel, so only the roll-up cues are compared
+tail -n 7 $out.scc.vtt > $out.scc.tail.vtt
+tail -n 7 $out.mux.vtt > $out.mux.tail.vtt
+if ! cmp -s $out.scc.tail.vtt $out.mux.tail.vtt; then
+	echo "muxed roll-up cues differ from the SCC ones:"
+	diff $out.scc.tail.vtt $out.mux.tail.vtt
+	status=1
+fi
+rm -f $out.*
+exit $status